@@ -0,0 +1,41 @@
+#include "allocation_counter.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::atomic<std::size_t> allocations { 0 };
+
+auto counted_allocate(std::size_t size) -> void* {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    // `malloc(0)` may return a null pointer, which `operator new` is not allowed to do.
+    if (void* const ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+}  // namespace
+
+namespace bench {
+auto allocation_count() -> std::size_t {
+    return allocations.load(std::memory_order_relaxed);
+}
+}  // namespace bench
+
+// Replacements of the global allocation functions. The array forms and the `std::nothrow_t` forms
+// are implemented by the standard library in terms of these, so they are counted as well.
+auto operator new(std::size_t size) -> void* {
+    return counted_allocate(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t /*unused*/) noexcept {
+    std::free(ptr);
+}
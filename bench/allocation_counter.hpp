@@ -0,0 +1,13 @@
+#ifndef ANNOTATE_SNIPPETS_BENCH_ALLOCATION_COUNTER_HPP
+#define ANNOTATE_SNIPPETS_BENCH_ALLOCATION_COUNTER_HPP
+
+#include <cstddef>
+
+namespace bench {
+/// Returns the number of calls to the global `operator new` made by the whole program so far. The
+/// benchmark executable replaces the global allocation functions to maintain this counter, so that
+/// each benchmark can report how many heap allocations a single render performs.
+auto allocation_count() -> std::size_t;
+}  // namespace bench
+
+#endif  // ANNOTATE_SNIPPETS_BENCH_ALLOCATION_COUNTER_HPP
@@ -0,0 +1,110 @@
+#include "annotate_snippets/annotated_source.hpp"
+#include "annotate_snippets/source_file.hpp"
+#include "workloads.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace {
+/// Returns the byte offsets of `count` annotations scattered over the whole generated source code,
+/// in an order that does not follow the source code, as they are produced by a compiler reporting
+/// unrelated errors.
+auto scattered_byte_offsets(std::size_t count) -> std::vector<std::size_t> {
+    std::size_t const size = bench::generated_source().size();
+
+    std::vector<std::size_t> result;
+    result.reserve(count);
+    // A simple linear congruential generator, so that the offsets are the same in every run.
+    std::uint64_t state = 1;
+    for (std::size_t idx = 0; idx != count; ++idx) {
+        state = state * 6'364'136'223'846'793'005 + 1'442'695'040'888'963'407;
+        result.push_back(static_cast<std::size_t>((state >> 33) % size));
+    }
+    return result;
+}
+
+/// Measures converting the byte offsets of the annotations to line and column numbers using the
+/// line offset cache, which is filled lazily.
+void add_annotations_line_cache(benchmark::State& state) {
+    std::string const& source = bench::generated_source();
+    std::vector<std::size_t> const offsets =
+        scattered_byte_offsets(static_cast<std::size_t>(state.range(0)));
+
+    for (auto _ : state) {
+        ants::AnnotatedSource annotated(source);
+        for (std::size_t const offset : offsets) {
+            annotated.add_annotation(offset, offset + 1);
+        }
+        benchmark::DoNotOptimize(annotated.primary_spans().data());
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) * state.range(0));
+}
+
+/// Measures converting the byte offsets of the annotations to line and column numbers using the
+/// dense line index. Building the index is part of the measured time.
+void add_annotations_line_index(benchmark::State& state) {
+    std::string const& source = bench::generated_source();
+    std::vector<std::size_t> const offsets =
+        scattered_byte_offsets(static_cast<std::size_t>(state.range(0)));
+
+    for (auto _ : state) {
+        ants::AnnotatedSource annotated(source);
+        annotated.build_line_index();
+        for (std::size_t const offset : offsets) {
+            annotated.add_annotation(offset, offset + 1);
+        }
+        benchmark::DoNotOptimize(annotated.primary_spans().data());
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) * state.range(0));
+}
+
+/// Measures converting the byte offsets of the annotations with `add_annotations()`, which sorts
+/// the offsets and resolves them in one scan of the source code.
+void add_annotations_bulk(benchmark::State& state) {
+    std::string const& source = bench::generated_source();
+    std::vector<ants::LabeledByteSpan> spans;
+    for (std::size_t const offset :
+         scattered_byte_offsets(static_cast<std::size_t>(state.range(0)))) {
+        spans.push_back({ .beg = offset, .end = offset + 1, .label = {} });
+    }
+
+    for (auto _ : state) {
+        ants::AnnotatedSource annotated(source);
+        annotated.add_annotations(spans);
+        benchmark::DoNotOptimize(annotated.primary_spans().data());
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) * state.range(0));
+}
+
+/// Measures creating one annotated source per annotation, as many diagnostics pointing into the
+/// same file do, with all of them sharing the line index of one `SourceFile`. The index is built
+/// once outside of the measured loop.
+void add_annotations_source_file(benchmark::State& state) {
+    auto const file = ants::SourceFile::view(bench::generated_source());
+    std::vector<std::size_t> const offsets =
+        scattered_byte_offsets(static_cast<std::size_t>(state.range(0)));
+    file->line_index();
+
+    for (auto _ : state) {
+        for (std::size_t const offset : offsets) {
+            ants::AnnotatedSource annotated(file);
+            annotated.add_annotation(offset, offset + 1);
+            benchmark::DoNotOptimize(annotated.primary_spans().data());
+        }
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) * state.range(0));
+}
+}  // namespace
+
+BENCHMARK(add_annotations_line_cache)->Arg(10)->Arg(100)->Arg(500);
+BENCHMARK(add_annotations_line_index)->Arg(10)->Arg(100)->Arg(500);
+BENCHMARK(add_annotations_bulk)->Arg(10)->Arg(100)->Arg(500);
+BENCHMARK(add_annotations_source_file)->Arg(10)->Arg(100)->Arg(500);
@@ -0,0 +1,179 @@
+#include "allocation_counter.hpp"
+#include "annotate_snippets/annotated_source.hpp"
+#include "annotate_snippets/diag.hpp"
+#include "annotate_snippets/output_sink.hpp"
+#include "annotate_snippets/renderer/human_renderer.hpp"
+#include "annotate_snippets/style.hpp"
+#include "annotate_snippets/style_spec.hpp"
+#include "annotate_snippets/styled_string.hpp"
+#include "annotate_snippets/styled_string_view.hpp"
+#include "workloads.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "benchmark/benchmark.h"
+
+namespace {
+using DiagFactory = auto (*)() -> ants::Diag<bench::Level> const&;
+
+/// A style sheet close to the one used by `rustc`, so that the cost of resolving styles is included
+/// in the measurement of the `std::ostream` overload.
+auto rustc_style_sheet(ants::Style const& style, bench::Level level) -> ants::StyleSpec {
+    switch (style.as_predefined_style()) {
+    case ants::Style::LineNumber:
+    case ants::Style::SecondaryUnderline:
+    case ants::Style::SecondaryLabel:
+        return ants::StyleSpec::BrightBlue + ants::StyleSpec::Bold;
+    case ants::Style::PrimaryMessage:
+        return ants::StyleSpec::Default + ants::StyleSpec::Bold;
+    case ants::Style::PrimaryTitle:
+    case ants::Style::SecondaryTitle:
+    case ants::Style::PrimaryUnderline:
+    case ants::Style::PrimaryLabel:
+        return (level == bench::Level::Error ? ants::StyleSpec::BrightRed
+                                             : ants::StyleSpec::BrightYellow)
+            + ants::StyleSpec::Bold;
+    default:
+        return {};
+    }
+}
+
+/// Reports the counters shared by all benchmarks: the number of rendered diagnostics per second,
+/// the number of rendered bytes per second, and the average number of heap allocations per render.
+void report_counters(benchmark::State& state, std::size_t bytes, std::size_t allocations) {
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+    state.SetBytesProcessed(static_cast<std::int64_t>(bytes));
+    state.counters["allocs_per_render"] = benchmark::Counter(
+        static_cast<double>(allocations),
+        benchmark::Counter::kAvgIterations
+    );
+}
+
+/// Measures `HumanRenderer::render_diag(Diag const&)`, which renders the diagnostic into a
+/// `StyledString`. The same diagnostic is rendered in every iteration without being copied.
+void render_styled_string(benchmark::State& state, DiagFactory make_diag) {
+    ants::Diag<bench::Level> const& diag = make_diag();
+    ants::HumanRenderer const renderer;
+
+    std::size_t bytes = 0;
+    std::size_t const allocations_before = bench::allocation_count();
+
+    for (auto _ : state) {
+        ants::StyledString const result = renderer.render_diag(diag);
+        benchmark::DoNotOptimize(result.content().data());
+        bytes += result.content().size();
+    }
+
+    report_counters(state, bytes, bench::allocation_count() - allocations_before);
+}
+
+/// Measures `HumanRenderer::render_diag(std::ostream&, Diag const&, StyleSheet)`. The output stream
+/// is reset after every iteration so that its buffer does not grow without bound; resetting it is
+/// part of the measured time.
+void render_ostream(benchmark::State& state, DiagFactory make_diag) {
+    ants::Diag<bench::Level> const& diag = make_diag();
+    ants::HumanRenderer const renderer;
+    std::ostringstream out;
+
+    std::size_t bytes = 0;
+    std::size_t const allocations_before = bench::allocation_count();
+
+    for (auto _ : state) {
+        renderer.render_diag(out, diag, rustc_style_sheet);
+        bytes += static_cast<std::size_t>(out.tellp());
+
+        out.seekp(0);
+        benchmark::ClobberMemory();
+    }
+
+    report_counters(state, bytes, bench::allocation_count() - allocations_before);
+}
+
+/// Measures `HumanRenderer::render_diag(Sink&, Diag const&, StyleSheet)` with a `StringSink`. The
+/// string is cleared after every iteration, which keeps its capacity.
+void render_string_sink(benchmark::State& state, DiagFactory make_diag) {
+    ants::Diag<bench::Level> const& diag = make_diag();
+    ants::HumanRenderer const renderer;
+    std::string target;
+    ants::StringSink sink(target);
+
+    std::size_t bytes = 0;
+    std::size_t const allocations_before = bench::allocation_count();
+
+    for (auto _ : state) {
+        renderer.render_diag(sink, diag, rustc_style_sheet);
+        benchmark::DoNotOptimize(target.data());
+        bytes += target.size();
+
+        target.clear();
+    }
+
+    report_counters(state, bytes, bench::allocation_count() - allocations_before);
+}
+
+/// Measures the rendering of a line with `state.range(0)` pairs of adjacent annotations, where the
+/// label of the first annotation of each pair cannot be rendered inline, with the labels placed by
+/// `label_placement`. The labels of neighbouring annotations overlap, so the graph placement
+/// compares all pairs of annotations, while the size of the rendering only grows linearly.
+void place_adjacent_labels(
+    benchmark::State& state,
+    ants::HumanRenderer::LabelPlacement label_placement
+) {
+    auto const pair_num = static_cast<std::size_t>(state.range(0));
+    std::string source;
+    for (std::size_t idx = 0; idx != pair_num; ++idx) {
+        source.append("aabb      ");
+    }
+
+    ants::AnnotatedSource annotated(source, "generated.cpp");
+    for (std::size_t idx = 0; idx != pair_num; ++idx) {
+        annotated.add_annotation(idx * 10, idx * 10 + 2, ants::StyledStringView::inferred("x"));
+        annotated.add_secondary_annotation(
+            idx * 10 + 2,
+            idx * 10 + 4,
+            ants::StyledStringView::inferred("y")
+        );
+    }
+    auto const diag = ants::Diag(bench::Level::Warning, ants::StyledStringView::inferred("lint"))
+                          .with_source(std::move(annotated));
+
+    ants::HumanRenderer renderer;
+    renderer.diagnostic_width = std::numeric_limits<unsigned>::max();
+    renderer.label_placement = label_placement;
+
+    for (auto _ : state) {
+        ants::StyledString const result = renderer.render_diag(diag);
+        benchmark::DoNotOptimize(result.content().data());
+    }
+
+    state.SetComplexityN(state.range(0));
+}
+}  // namespace
+
+#define ANNOTATE_SNIPPETS_RENDER_BENCHMARKS(workload)                                             \
+    BENCHMARK_CAPTURE(render_styled_string, workload, &bench::workload);                           \
+    BENCHMARK_CAPTURE(render_ostream, workload, &bench::workload);                                 \
+    BENCHMARK_CAPTURE(render_string_sink, workload, &bench::workload);
+
+ANNOTATE_SNIPPETS_RENDER_BENCHMARKS(many_singleline_spans)
+ANNOTATE_SNIPPETS_RENDER_BENCHMARKS(nested_multiline_spans)
+ANNOTATE_SNIPPETS_RENDER_BENCHMARKS(huge_source_few_annotations)
+ANNOTATE_SNIPPETS_RENDER_BENCHMARKS(many_annotated_lines)
+ANNOTATE_SNIPPETS_RENDER_BENCHMARKS(cjk_emoji_lines)
+ANNOTATE_SNIPPETS_RENDER_BENCHMARKS(tab_heavy_lines)
+
+BENCHMARK_CAPTURE(place_adjacent_labels, graph, ants::HumanRenderer::GraphPlacement)
+    ->RangeMultiplier(2)
+    ->Range(128, 2'048)
+    ->Complexity();
+BENCHMARK_CAPTURE(place_adjacent_labels, sweep, ants::HumanRenderer::SweepPlacement)
+    ->RangeMultiplier(2)
+    ->Range(128, 2'048)
+    ->Complexity();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,247 @@
+#include "workloads.hpp"
+
+#include "annotate_snippets/annotated_source.hpp"
+#include "annotate_snippets/diag.hpp"
+#include "annotate_snippets/styled_string_view.hpp"
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace bench {
+namespace {
+/// Stores the labels of the generated annotations. `AnnotatedSource` only refers to the label
+/// strings, so they must outlive the diagnostics. `std::deque` never relocates its elements when
+/// growing at the end.
+auto label_pool() -> std::deque<std::string>& {
+    static std::deque<std::string> pool;
+    return pool;
+}
+
+auto make_label(std::string label) -> ants::StyledStringView {
+    return ants::StyledStringView::inferred(label_pool().emplace_back(std::move(label)));
+}
+}  // namespace
+
+auto many_singleline_spans() -> ants::Diag<Level> const& {
+    static std::string const source = [] {
+        std::string result = "auto const result = compute(";
+        for (unsigned idx = 0; idx != 48; ++idx) {
+            if (idx != 0) {
+                result.append(", ");
+            }
+            result.append("argument_").append(std::to_string(idx));
+        }
+        result.append(");\n");
+
+        for (unsigned idx = 0; idx != 8; ++idx) {
+            result.append("consume(result, ").append(std::to_string(idx)).append(");\n");
+        }
+
+        return result;
+    }();
+
+    static ants::Diag<Level> const diag = [] {
+        ants::AnnotatedSource annotated(source, "many_singleline_spans.cpp");
+
+        // Annotate every argument on the first line, alternating between primary and secondary
+        // annotations.
+        std::size_t pos = 0;
+        for (unsigned idx = 0; (pos = source.find("argument_", pos)) != std::string::npos; ++idx) {
+            std::size_t const end = source.find_first_of(",)", pos);
+            if (idx % 2 == 0) {
+                annotated.add_annotation(pos, end, make_label("argument " + std::to_string(idx)));
+            } else {
+                annotated.add_secondary_annotation(pos, end, make_label("converted here"));
+            }
+            pos = end;
+        }
+
+        // Annotate the call on each of the remaining lines.
+        for (pos = 0; (pos = source.find("consume", pos)) != std::string::npos; pos += 7) {
+            annotated.add_secondary_annotation(pos, pos + 7, make_label("consumed here"));
+        }
+
+        return ants::Diag(Level::Error, "mismatched types", "E0308")
+            .with_source(std::move(annotated))
+            .with_sub_diag_entry(Level::Note, "arguments are converted implicitly");
+    }();
+
+    return diag;
+}
+
+auto nested_multiline_spans() -> ants::Diag<Level> const& {
+    constexpr unsigned depth = 16;
+
+    static std::string const source = [] {
+        std::string result;
+        for (unsigned idx = 0; idx != depth; ++idx) {
+            result.append(idx * 4, ' ').append("if (condition_").append(std::to_string(idx));
+            result.append(") {\n");
+        }
+        result.append(depth * 4, ' ').append("do_something();\n");
+        for (unsigned idx = depth; idx-- != 0;) {
+            result.append(idx * 4, ' ').append("}\n");
+        }
+        return result;
+    }();
+
+    static ants::Diag<Level> const diag = [] {
+        ants::AnnotatedSource annotated(source, "nested_multiline_spans.cpp");
+
+        // Each span starts at the opening brace of a scope and ends at the matching closing brace.
+        for (unsigned idx = 0; idx != depth; ++idx) {
+            ants::SourceLocation const beg {
+                .line = idx,
+                .col = static_cast<unsigned>(idx * 4 + 16 + std::to_string(idx).size()),
+            };
+            ants::SourceLocation const end {
+                .line = 2 * depth - idx,
+                .col = idx * 4 + 1,
+            };
+
+            if (idx + 1 == depth) {
+                annotated.add_annotation(beg, end, make_label("innermost scope"));
+            } else {
+                annotated.add_secondary_annotation(
+                    beg,
+                    end,
+                    make_label("scope " + std::to_string(idx))
+                );
+            }
+        }
+
+        return ants::Diag(Level::Warning, "statement is nested too deeply")
+            .with_source(std::move(annotated));
+    }();
+
+    return diag;
+}
+
+auto generated_source() -> std::string const& {
+    static std::string const source = [] {
+        std::string result;
+        for (unsigned idx = 0; idx != generated_source_line_count; ++idx) {
+            result.append("constexpr int generated_value_").append(std::to_string(idx));
+            result.append(" = ").append(std::to_string(idx * 7)).append(";\n");
+        }
+        return result;
+    }();
+
+    return source;
+}
+
+auto huge_source_few_annotations() -> ants::Diag<Level> const& {
+    constexpr unsigned line_count = generated_source_line_count;
+
+    static ants::Diag<Level> const diag = [] {
+        std::string const& source = generated_source();
+        ants::AnnotatedSource annotated(source, "huge_source_few_annotations.cpp");
+
+        // Annotate a few identifiers in the middle and near the end of the file.
+        for (unsigned const line : { line_count / 2, line_count / 2 + 3, line_count - 10 }) {
+            std::string const name = "generated_value_" + std::to_string(line);
+            std::size_t const pos = source.find(name + " ");
+            annotated.add_annotation(pos, pos + name.size(), make_label("defined here"));
+        }
+
+        return ants::Diag(Level::Error, "redefinition of generated values")
+            .with_source(std::move(annotated));
+    }();
+
+    return diag;
+}
+
+auto many_annotated_lines() -> ants::Diag<Level> const& {
+    constexpr unsigned line_count = 5'000;
+
+    static ants::Diag<Level> const diag = [] {
+        std::string const& source = generated_source();
+        ants::AnnotatedSource annotated(source, "many_annotated_lines.cpp");
+
+        std::size_t pos = 0;
+        for (unsigned line = 0; line != line_count; ++line) {
+            // Annotate the name and the initializer of the declaration on each line.
+            std::size_t const name = source.find("generated_value_", pos);
+            std::size_t const name_end = source.find(' ', name);
+            std::size_t const value = name_end + 3;
+            std::size_t const value_end = source.find(';', value);
+
+            annotated.add_annotation(name, name_end, make_label("declared here"));
+            annotated.add_secondary_annotation(value, value_end, make_label("value"));
+            pos = value_end;
+        }
+
+        return ants::Diag(Level::Error, "too many generated values")
+            .with_source(std::move(annotated));
+    }();
+
+    return diag;
+}
+
+auto cjk_emoji_lines() -> ants::Diag<Level> const& {
+    static std::string const source = [] {
+        std::string result;
+        for (unsigned idx = 0; idx != 20; ++idx) {
+            result.append("let 名前_").append(std::to_string(idx));
+            result.append(" = \"こんにちは世界、안녕하세요\"; // 😀🎉🚀 完了 ✅\n");
+        }
+        return result;
+    }();
+
+    static ants::Diag<Level> const diag = [] {
+        ants::AnnotatedSource annotated(source, "cjk_emoji_lines.rs");
+
+        std::string_view const literal = "\"こんにちは世界、안녕하세요\"";
+        std::string_view const emojis = "😀🎉🚀";
+
+        for (std::size_t pos = 0; (pos = source.find(literal, pos)) != std::string::npos;) {
+            annotated.add_annotation(pos, pos + literal.size(), make_label("文字列リテラル"));
+
+            std::size_t const emoji_pos = source.find(emojis, pos);
+            annotated.add_secondary_annotation(
+                emoji_pos,
+                emoji_pos + emojis.size(),
+                make_label("emoji 🎉")
+            );
+            pos = emoji_pos;
+        }
+
+        return ants::Diag(Level::Warning, "non-ASCII string literal")
+            .with_source(std::move(annotated));
+    }();
+
+    return diag;
+}
+
+auto tab_heavy_lines() -> ants::Diag<Level> const& {
+    static std::string const source = [] {
+        std::string result;
+        for (unsigned idx = 0; idx != 40; ++idx) {
+            result.append(idx % 4 + 1, '\t').append("if (flag_").append(std::to_string(idx));
+            result.append(")\t{\tcall(value,\tother);\t}\t// tab\tseparated\n");
+        }
+        return result;
+    }();
+
+    static ants::Diag<Level> const diag = [] {
+        ants::AnnotatedSource annotated(source, "tab_heavy_lines.c");
+
+        for (std::size_t pos = 0; (pos = source.find("call(", pos)) != std::string::npos;) {
+            std::size_t const end = source.find(';', pos);
+            annotated.add_annotation(pos, end, make_label("call"));
+
+            std::size_t const comment = source.find("//", end);
+            annotated.add_secondary_annotation(comment, comment + 2, make_label("comment"));
+            pos = end;
+        }
+
+        return ants::Diag(Level::Warning, "mixed tabs in expression")
+            .with_source(std::move(annotated));
+    }();
+
+    return diag;
+}
+}  // namespace bench
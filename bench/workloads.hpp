@@ -0,0 +1,66 @@
+#ifndef ANNOTATE_SNIPPETS_BENCH_WORKLOADS_HPP
+#define ANNOTATE_SNIPPETS_BENCH_WORKLOADS_HPP
+
+#include "annotate_snippets/diag.hpp"
+
+#include <string>
+
+namespace bench {
+enum class Level {
+    Error,
+    Warning,
+    Note,
+    Help,
+};
+
+inline auto display_string(Level level) -> char const* {
+    switch (level) {
+    case Level::Error:
+        return "error";
+    case Level::Warning:
+        return "warning";
+    case Level::Note:
+        return "note";
+    case Level::Help:
+        return "help";
+    default:
+        return "";
+    }
+}
+
+// Each of the following functions returns a diagnostic representing a typical (or pathological)
+// input of the renderer. The source code and labels referenced by the diagnostics are stored in
+// static storage, so the returned diagnostics stay valid for the whole program and can be copied
+// freely.
+
+/// A single long line carrying dozens of labeled single-line annotations, mixed with a few
+/// shorter annotated lines.
+auto many_singleline_spans() -> ants::Diag<Level> const&;
+
+/// Deeply nested multi-line annotations, such as a diagnostic pointing at every enclosing scope
+/// of a statement.
+auto nested_multiline_spans() -> ants::Diag<Level> const&;
+
+/// The number of lines of the source code returned by `generated_source()`.
+inline constexpr unsigned generated_source_line_count = 50'000;
+
+/// A generated source file with 50,000 short lines of declarations.
+auto generated_source() -> std::string const&;
+
+/// The generated source file from `generated_source()` with only a handful of annotations,
+/// specified by byte offsets.
+auto huge_source_few_annotations() -> ants::Diag<Level> const&;
+
+/// The first 5,000 lines of the generated source file from `generated_source()`, each carrying a
+/// primary and a secondary annotation, so that the renderer handles thousands of annotated lines.
+auto many_annotated_lines() -> ants::Diag<Level> const&;
+
+/// Lines dominated by CJK characters and emojis, whose display width differs from their length in
+/// bytes.
+auto cjk_emoji_lines() -> ants::Diag<Level> const&;
+
+/// Tab-indented lines with tabs between the annotated tokens.
+auto tab_heavy_lines() -> ants::Diag<Level> const&;
+}  // namespace bench
+
+#endif  // ANNOTATE_SNIPPETS_BENCH_WORKLOADS_HPP
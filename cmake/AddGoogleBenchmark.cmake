@@ -0,0 +1,36 @@
+if (NOT DEFINED GOOGLEBENCHMARK_PATH)
+    set(GOOGLEBENCHMARK_PATH "${CMAKE_SOURCE_DIR}/benchmark")
+endif()
+
+message(STATUS "Looking for Google Benchmark sources in ${GOOGLEBENCHMARK_PATH}")
+
+# We never want to build the tests of Google Benchmark itself.
+set(BENCHMARK_ENABLE_TESTING OFF CACHE BOOL "" FORCE)
+set(BENCHMARK_ENABLE_INSTALL OFF CACHE BOOL "" FORCE)
+
+if (EXISTS "${GOOGLEBENCHMARK_PATH}" AND IS_DIRECTORY "${GOOGLEBENCHMARK_PATH}" AND
+    EXISTS "${GOOGLEBENCHMARK_PATH}/CMakeLists.txt")
+    message(STATUS "Found Google Benchmark sources in ${GOOGLEBENCHMARK_PATH}")
+
+    add_subdirectory(${GOOGLEBENCHMARK_PATH})
+else()
+    find_package(benchmark QUIET)
+
+    if (benchmark_FOUND)
+        message(STATUS "Found installed Google Benchmark ${benchmark_VERSION}")
+    else()
+        message(STATUS "Did not find Google Benchmark. Fetching from GitHub...")
+
+        include(FetchContent)
+        FetchContent_Declare(
+            benchmark
+            GIT_REPOSITORY https://github.com/google/benchmark.git
+            GIT_TAG v1.8.3
+        )
+        FetchContent_MakeAvailable(benchmark)
+    endif()
+endif()
+
+if (TARGET benchmark AND NOT TARGET benchmark::benchmark)
+    add_library(benchmark::benchmark ALIAS benchmark)
+endif()
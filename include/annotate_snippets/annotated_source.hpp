@@ -1,12 +1,18 @@
 #ifndef ANNOTATE_SNIPPETS_ANNOTATED_SOURCE_HPP
 #define ANNOTATE_SNIPPETS_ANNOTATED_SOURCE_HPP
 
+#include "annotate_snippets/line_index.hpp"
+#include "annotate_snippets/source_file.hpp"
+#include "annotate_snippets/styled_string.hpp"
 #include "annotate_snippets/styled_string_view.hpp"
 
 #include <concepts>
 #include <cstddef>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <ranges>
+#include <span>
 #include <string_view>
 #include <utility>
 #include <vector>
@@ -31,6 +37,22 @@ struct LabeledSpan {
     /// The label attached to this span. If label.empty() is true, we consider the annotation to
     /// have no label attached.
     StyledStringView label;
+    /// The function producing the label of this span, if the label is deferred. When it is not
+    /// empty, `label` is ignored: the function is called when the renderer reaches the annotated
+    /// source (and not at all if the source is not rendered, for example, because of the output
+    /// limits of the renderer), and the produced label is kept alive until the source is rendered.
+    DeferredStyledString deferred_label;
+};
+
+/// Represents a single annotation span given by the byte offsets `[beg, end)` in the source code,
+/// with an optional label. Used to add many annotations at once (see
+/// `AnnotatedSource::add_primary_annotations()`).
+struct LabeledByteSpan {
+    std::size_t beg;
+    std::size_t end;
+    /// The label attached to this span. If label.empty() is true, we consider the annotation to
+    /// have no label attached.
+    StyledStringView label;
 };
 
 /// Represents source code with some annotations.
@@ -40,6 +62,10 @@ struct LabeledSpan {
 /// own the code.
 class AnnotatedSource {
 public:
+    /// Memoizes the offsets of the lines found by the `const` lookups of an `AnnotatedSource`
+    /// outside of the object (see `line_offset(unsigned, LineOffsetMemo&)`).
+    using LineOffsetMemo = std::pmr::map<unsigned, std::size_t>;
+
     /// Creates an `AnnotatedSource` object that is not associated with any code snippet.
     AnnotatedSource() = default;
     /// Creates an `AnnotatedSource` object that is associated with code snippet `source`.
@@ -48,6 +74,13 @@ public:
     /// origin as `origin`.
     explicit AnnotatedSource(std::string_view source, std::string_view origin) :
         source_(source), origin_(origin) { }
+    /// Creates an `AnnotatedSource` object associated with the shared source file `file`. The
+    /// source code and the origin are taken from `file`, which is kept alive by this object, and
+    /// the line index of `file` is used to locate lines (see `line_index()`).
+    ///
+    /// Throws `std::invalid_argument` if `file` is `nullptr`, which is what `SourceFile::mapped()`
+    /// returns if the file cannot be mapped.
+    explicit AnnotatedSource(std::shared_ptr<SourceFile const> file);
 
     auto source() const -> std::string_view {
         return source_;
@@ -57,6 +90,12 @@ public:
         return origin_;
     }
 
+    /// Returns the shared source file this object is associated with, or `nullptr` if it is not
+    /// created from a `SourceFile`.
+    auto source_file() const -> std::shared_ptr<SourceFile const> const& {
+        return file_;
+    }
+
     void set_origin(std::string_view origin) {
         origin_ = origin;
     }
@@ -89,19 +128,64 @@ public:
         return std::move(*this);
     }
 
-    auto line_offsets_cache() const -> auto& {
+    auto line_offsets_cache() const -> std::map<unsigned, std::size_t> const& {
         return line_offsets_;
     }
 
-    auto line_offsets_cache() -> auto& {
+    auto line_offsets_cache() -> std::map<unsigned, std::size_t>& {
         return line_offsets_;
     }
 
-    /// Returns the offset of the first byte of line `line`. If this information is already cached
-    /// in `line_offsets_` then the cached result is returned, otherwise the result will be
-    /// calculated in place and cached.
+    /// Returns the dense line index of the source code, or `nullptr` if it has not been built by
+    /// `build_line_index()` and this object is not associated with a `SourceFile` whose index is
+    /// used (see `SourceFile::uses_line_index()`). In the latter case, the index of the file is
+    /// returned, which is built on the first call.
+    auto line_index() const -> LineIndex const* {
+        if (line_index_ != nullptr) {
+            return line_index_.get();
+        } else if (file_ != nullptr && file_->uses_line_index()) {
+            return &file_->line_index();
+        } else {
+            return nullptr;
+        }
+    }
+
+    /// Scans the whole source code once and builds a dense index of the offsets of the first byte
+    /// of all lines. Afterwards, `line_offset()`, `byte_offset_to_line_col()` and `line_content()`
+    /// look up the index instead of `line_offsets_`, which is neither consulted nor updated.
+    ///
+    /// This is preferable for large source code with many annotations, where filling the cache
+    /// line by line is much slower than a single scan. If this object is associated with a
+    /// `SourceFile`, the index of the file is used instead of building a new one.
+    void build_line_index();
+
+    auto with_line_index() & -> AnnotatedSource& {
+        build_line_index();
+        return *this;
+    }
+
+    auto with_line_index() && -> AnnotatedSource&& {
+        build_line_index();
+        return std::move(*this);
+    }
+
+    /// Returns the offset of the first byte of line `line`. If the line index has been built, the
+    /// result is looked up in the index. Otherwise, if this information is already cached in
+    /// `line_offsets_` then the cached result is returned, otherwise the result will be calculated
+    /// in place and cached.
     auto line_offset(unsigned line) -> std::size_t;
 
+    /// Same as the non-`const` overload, except that the calculated result is not cached. This
+    /// method only reads the object, so it can be called concurrently on the same object.
+    auto line_offset(unsigned line) const -> std::size_t;
+
+    /// Same as the `const` overload, except that the calculated results are stored in `memo`, which
+    /// is consulted along with `line_offsets_` by the later calls with the same `memo`. Lines that
+    /// are already cached in `line_offsets_` are not copied into `memo`. This is how the renderers
+    /// locate many lines of a `const` annotated source: `memo` is part of the scratch state of a
+    /// single rendering, so the object itself is left untouched.
+    auto line_offset(unsigned line, LineOffsetMemo& memo) const -> std::size_t;
+
     void set_line_offset(unsigned line, std::size_t offset) {
         line_offsets_[line] = offset;
     }
@@ -121,15 +205,42 @@ public:
 
     /// Returns the line and column number of the byte at offset `byte_offset` in the source code.
     ///
-    /// This method caches the position of the first character of the line where `byte_offset` is
-    /// located into the cache `line_offsets_`.
+    /// Unless the line index has been built, this method caches the position of the first
+    /// character of the line where `byte_offset` is located into the cache `line_offsets_`.
     auto byte_offset_to_line_col(std::size_t byte_offset) -> SourceLocation;
 
+    /// Same as the non-`const` overload, except that nothing is cached.
+    auto byte_offset_to_line_col(std::size_t byte_offset) const -> SourceLocation;
+
+    /// Converts each byte offset in `byte_offsets` to its line and column number as
+    /// `byte_offset_to_line_col()` does, and stores the result to the element of `locations` at the
+    /// same index. `locations` must be at least as long as `byte_offsets`.
+    ///
+    /// Unless the line index has been built, the offsets are sorted and resolved in one forward
+    /// scan of the source code up to the largest offset, instead of one search per offset. Like
+    /// `byte_offset_to_line_col()`, this method caches the position of the first character of each
+    /// line that contains one of the offsets.
+    void byte_offsets_to_line_cols(
+        std::span<std::size_t const> byte_offsets,
+        std::span<SourceLocation> locations
+    );
+
+    /// Same as the non-`const` overload, except that nothing is cached.
+    void byte_offsets_to_line_cols(
+        std::span<std::size_t const> byte_offsets,
+        std::span<SourceLocation> locations
+    ) const;
+
     /// Returns the content of the line `line`. If the line does not exist, returns an empty string.
+    /// Nothing is cached (see the `const` overload of `line_offset()`).
     ///
     /// Note that the returned string does not include the trailing newline character, whether it is
     /// '\n' or '\r\n'.
-    auto line_content(unsigned line) -> std::string_view;
+    auto line_content(unsigned line) const -> std::string_view;
+
+    /// Same as `line_content(unsigned)`, except that the lines are located with
+    /// `line_offset(unsigned, LineOffsetMemo&)`.
+    auto line_content(unsigned line, LineOffsetMemo& memo) const -> std::string_view;
 
     auto primary_spans() const -> std::vector<LabeledSpan> const& {
         return primary_spans_;
@@ -156,6 +267,7 @@ public:
             .beg = beg,
             .end = end,
             .label = std::move(label),
+            .deferred_label {},
         });
     }
 
@@ -295,6 +407,7 @@ public:
             .beg = beg,
             .end = end,
             .label = std::move(label),
+            .deferred_label {},
         });
     }
 
@@ -548,7 +661,220 @@ public:
         return std::move(*this);
     }
 
+    /// Adds a primary (secondary) annotation whose label is produced by `label` when the annotated
+    /// source is rendered (see `LabeledSpan::deferred_label`), so that expensive labels are only
+    /// built for the diagnostics that are actually rendered.
+    void add_primary_deferred_annotation(
+        SourceLocation beg,
+        SourceLocation end,
+        DeferredStyledString label
+    ) {
+        primary_spans_.push_back(LabeledSpan {
+            .beg = beg,
+            .end = end,
+            .label {},
+            .deferred_label = std::move(label),
+        });
+    }
+
+    auto with_primary_deferred_annotation(
+        SourceLocation beg,
+        SourceLocation end,
+        DeferredStyledString label
+    ) & -> AnnotatedSource& {
+        add_primary_deferred_annotation(beg, end, std::move(label));
+        return *this;
+    }
+
+    auto with_primary_deferred_annotation(
+        SourceLocation beg,
+        SourceLocation end,
+        DeferredStyledString label
+    ) && -> AnnotatedSource&& {
+        add_primary_deferred_annotation(beg, end, std::move(label));
+        return std::move(*this);
+    }
+
+    void add_primary_deferred_annotation(
+        std::size_t byte_beg,
+        std::size_t byte_end,
+        DeferredStyledString label
+    ) {
+        add_primary_deferred_annotation(
+            byte_offset_to_line_col(byte_beg),
+            byte_offset_to_line_col(byte_end),
+            std::move(label)
+        );
+    }
+
+    auto with_primary_deferred_annotation(
+        std::size_t byte_beg,
+        std::size_t byte_end,
+        DeferredStyledString label
+    ) & -> AnnotatedSource& {
+        add_primary_deferred_annotation(byte_beg, byte_end, std::move(label));
+        return *this;
+    }
+
+    auto with_primary_deferred_annotation(
+        std::size_t byte_beg,
+        std::size_t byte_end,
+        DeferredStyledString label
+    ) && -> AnnotatedSource&& {
+        add_primary_deferred_annotation(byte_beg, byte_end, std::move(label));
+        return std::move(*this);
+    }
+
+    void add_secondary_deferred_annotation(
+        SourceLocation beg,
+        SourceLocation end,
+        DeferredStyledString label
+    ) {
+        secondary_spans_.push_back(LabeledSpan {
+            .beg = beg,
+            .end = end,
+            .label {},
+            .deferred_label = std::move(label),
+        });
+    }
+
+    auto with_secondary_deferred_annotation(
+        SourceLocation beg,
+        SourceLocation end,
+        DeferredStyledString label
+    ) & -> AnnotatedSource& {
+        add_secondary_deferred_annotation(beg, end, std::move(label));
+        return *this;
+    }
+
+    auto with_secondary_deferred_annotation(
+        SourceLocation beg,
+        SourceLocation end,
+        DeferredStyledString label
+    ) && -> AnnotatedSource&& {
+        add_secondary_deferred_annotation(beg, end, std::move(label));
+        return std::move(*this);
+    }
+
+    void add_secondary_deferred_annotation(
+        std::size_t byte_beg,
+        std::size_t byte_end,
+        DeferredStyledString label
+    ) {
+        add_secondary_deferred_annotation(
+            byte_offset_to_line_col(byte_beg),
+            byte_offset_to_line_col(byte_end),
+            std::move(label)
+        );
+    }
+
+    auto with_secondary_deferred_annotation(
+        std::size_t byte_beg,
+        std::size_t byte_end,
+        DeferredStyledString label
+    ) & -> AnnotatedSource& {
+        add_secondary_deferred_annotation(byte_beg, byte_end, std::move(label));
+        return *this;
+    }
+
+    auto with_secondary_deferred_annotation(
+        std::size_t byte_beg,
+        std::size_t byte_end,
+        DeferredStyledString label
+    ) && -> AnnotatedSource&& {
+        add_secondary_deferred_annotation(byte_beg, byte_end, std::move(label));
+        return std::move(*this);
+    }
+
+    /// Adds a primary annotation for each span in `spans`, in order. This has the same effect as
+    /// calling `add_primary_annotation()` for each span, but the byte offsets of all spans are
+    /// converted at once (see `byte_offsets_to_line_cols()`), which is much faster for many spans.
+    template <std::ranges::input_range Range>
+        requires std::convertible_to<std::ranges::range_reference_t<Range>, LabeledByteSpan>
+    void add_primary_annotations(Range&& spans) {
+        add_labeled_byte_spans(primary_spans_, std::forward<Range>(spans));
+    }
+
+    template <std::ranges::input_range Range>
+        requires std::convertible_to<std::ranges::range_reference_t<Range>, LabeledByteSpan>
+    auto with_primary_annotations(Range&& spans) & -> AnnotatedSource& {
+        add_primary_annotations(std::forward<Range>(spans));
+        return *this;
+    }
+
+    template <std::ranges::input_range Range>
+        requires std::convertible_to<std::ranges::range_reference_t<Range>, LabeledByteSpan>
+    auto with_primary_annotations(Range&& spans) && -> AnnotatedSource&& {
+        add_primary_annotations(std::forward<Range>(spans));
+        return std::move(*this);
+    }
+
+    /// Adds a secondary annotation for each span in `spans`, in order. This has the same effect as
+    /// calling `add_secondary_annotation()` for each span, but the byte offsets of all spans are
+    /// converted at once (see `byte_offsets_to_line_cols()`), which is much faster for many spans.
+    template <std::ranges::input_range Range>
+        requires std::convertible_to<std::ranges::range_reference_t<Range>, LabeledByteSpan>
+    void add_secondary_annotations(Range&& spans) {
+        add_labeled_byte_spans(secondary_spans_, std::forward<Range>(spans));
+    }
+
+    template <std::ranges::input_range Range>
+        requires std::convertible_to<std::ranges::range_reference_t<Range>, LabeledByteSpan>
+    auto with_secondary_annotations(Range&& spans) & -> AnnotatedSource& {
+        add_secondary_annotations(std::forward<Range>(spans));
+        return *this;
+    }
+
+    template <std::ranges::input_range Range>
+        requires std::convertible_to<std::ranges::range_reference_t<Range>, LabeledByteSpan>
+    auto with_secondary_annotations(Range&& spans) && -> AnnotatedSource&& {
+        add_secondary_annotations(std::forward<Range>(spans));
+        return std::move(*this);
+    }
+
+    /// Same as `add_primary_annotations()`.
+    template <std::ranges::input_range Range>
+        requires std::convertible_to<std::ranges::range_reference_t<Range>, LabeledByteSpan>
+    void add_annotations(Range&& spans) {
+        add_primary_annotations(std::forward<Range>(spans));
+    }
+
+    template <std::ranges::input_range Range>
+        requires std::convertible_to<std::ranges::range_reference_t<Range>, LabeledByteSpan>
+    auto with_annotations(Range&& spans) & -> AnnotatedSource& {
+        add_annotations(std::forward<Range>(spans));
+        return *this;
+    }
+
+    template <std::ranges::input_range Range>
+        requires std::convertible_to<std::ranges::range_reference_t<Range>, LabeledByteSpan>
+    auto with_annotations(Range&& spans) && -> AnnotatedSource&& {
+        add_annotations(std::forward<Range>(spans));
+        return std::move(*this);
+    }
+
 private:
+    /// Converts the byte offsets of `spans` and appends the resulting spans to `target`. Contiguous
+    /// ranges of `LabeledByteSpan` are converted in place, while other ranges are copied first.
+    template <class Range>
+    void add_labeled_byte_spans(std::vector<LabeledSpan>& target, Range&& spans) {
+        if constexpr (std::ranges::contiguous_range<Range>
+                      && std::same_as<std::ranges::range_value_t<Range>, LabeledByteSpan>) {
+            append_converted_spans(target, std::span<LabeledByteSpan const>(spans));
+        } else {
+            std::vector<LabeledByteSpan> collected;
+            for (auto&& span : spans) {
+                collected.push_back(LabeledByteSpan(std::forward<decltype(span)>(span)));
+            }
+            append_converted_spans(target, collected);
+        }
+    }
+
+    void append_converted_spans(
+        std::vector<LabeledSpan>& target,
+        std::span<LabeledByteSpan const> spans
+    );
+
     /// The source code to be annotated.
     std::string_view source_;
     /// The origin of the source code (the file name).
@@ -569,10 +895,20 @@ private:
     ///     performance of rendering diagnostic information, because the renderer does not need to
     ///     find the starting position of a line separately.
     ///     2. If there is no information about the first byte position of a line, when the code of
-    ///     this line needs to be accessed, the information will be calculated and cached. We try to
-    ///     iterate over as few bytes as possible to find the information we need, for example we
-    ///     might process a new line from an already calculated line.
+    ///     this line needs to be accessed through a non-`const` method, the information will be
+    ///     calculated and cached. We try to iterate over as few bytes as possible to find the
+    ///     information we need, for example we might process a new line from an already calculated
+    ///     line.
+    ///
+    /// The `const` methods never modify the cache, so that rendering an `AnnotatedSource` through a
+    /// `const` reference leaves it untouched, even when it is rendered by several threads at once.
     std::map<unsigned, std::size_t> line_offsets_;
+    /// The dense index of all lines in the source code built by `build_line_index()`. It is shared
+    /// between copies of this object, since the index is immutable and depends only on `source_`.
+    std::shared_ptr<LineIndex const> line_index_;
+    /// The shared source file this object is associated with, if any. When it is not `nullptr`,
+    /// `source_` and `origin_` refer to the contents of the file.
+    std::shared_ptr<SourceFile const> file_;
     /// The (1-indexed) line number of the first line in the source code. The line numbers of
     /// subsequent lines will be calculated based on this, which allows us to provide a portion of
     /// the source code and explicitly specify the actual line number of the first line to display
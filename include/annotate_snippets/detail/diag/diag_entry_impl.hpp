@@ -3,6 +3,7 @@
 
 #include "annotate_snippets/annotated_source.hpp"
 #include "annotate_snippets/detail/diag/level.hpp"
+#include "annotate_snippets/styled_string.hpp"
 #include "annotate_snippets/styled_string_view.hpp"
 
 #include <concepts>
@@ -76,8 +77,11 @@ public:
         return diag_message_;
     }
 
+    /// Sets the title message text. Any deferred message set by `set_deferred_diag_message()` is
+    /// discarded.
     void set_diag_message(StyledStringView message) {
         diag_message_ = std::move(message);
+        deferred_diag_message_ = nullptr;
     }
 
     auto with_diag_message(StyledStringView message) & -> Derived& {
@@ -90,6 +94,31 @@ public:
         return static_cast<Derived&&>(*this);
     }
 
+    /// Returns the function producing the title message text, or an empty function if the message
+    /// is given by `diag_message()`.
+    auto deferred_diag_message() const -> DeferredStyledString const& {
+        return deferred_diag_message_;
+    }
+
+    /// Sets the function producing the title message text, which replaces `diag_message()`. The
+    /// function is called each time the renderer renders the title of this entry, and the produced
+    /// string is kept alive until the title is rendered, so the message is never built for entries
+    /// that are not rendered (for example, because of the output limits of the renderer).
+    void set_deferred_diag_message(DeferredStyledString message) {
+        diag_message_ = StyledStringView();
+        deferred_diag_message_ = std::move(message);
+    }
+
+    auto with_deferred_diag_message(DeferredStyledString message) & -> Derived& {
+        set_deferred_diag_message(std::move(message));
+        return static_cast<Derived&>(*this);
+    }
+
+    auto with_deferred_diag_message(DeferredStyledString message) && -> Derived&& {
+        set_deferred_diag_message(std::move(message));
+        return static_cast<Derived&&>(*this);
+    }
+
     auto associated_sources() const -> std::vector<AnnotatedSource> const& {
         return associated_sources_;
     }
@@ -141,6 +170,9 @@ private:
     /// The title message text of the diagnostic entry. It is displayed in front of all annotated
     /// source codes associated with this diagnostic entry.
     StyledStringView diag_message_;
+    /// The function producing the title message text when the entry is rendered, if the message is
+    /// deferred. When it is not empty, `diag_message_` is empty.
+    DeferredStyledString deferred_diag_message_;
     /// The annotated source codes associated with this diagnostic entry. The diagnostic entry may
     /// not be associated with any source code, for example, "note:" usually appears as a secondary
     /// diagnostic entry and is not associated with any source code (thus only displaying the title
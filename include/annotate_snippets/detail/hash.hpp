@@ -0,0 +1,17 @@
+#ifndef ANNOTATE_SNIPPETS_DETAIL_HASH_HPP
+#define ANNOTATE_SNIPPETS_DETAIL_HASH_HPP
+
+#include <cstddef>
+#include <functional>
+
+namespace ants::detail {
+/// `hash_combine` implementation from Boost.
+template <class T>
+auto hash_combine(std::size_t seed, T const& value) -> std::size_t {
+    std::hash<T> const hasher;
+    seed ^= hasher(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    return seed;
+}
+}  // namespace ants::detail
+
+#endif  // ANNOTATE_SNIPPETS_DETAIL_HASH_HPP
@@ -0,0 +1,76 @@
+#ifndef ANNOTATE_SNIPPETS_DETAIL_MPSC_QUEUE_HPP
+#define ANNOTATE_SNIPPETS_DETAIL_MPSC_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace ants::detail {
+/// An unbounded lock-free queue into which any number of threads push values, and from which the
+/// values are taken in batches.
+///
+/// The values are kept in a singly linked list of nodes, in the reverse order in which they are
+/// pushed. `push()` links a new node with a single compare-and-swap loop, and `pop_all()` detaches
+/// the whole list with a single exchange, so neither of them ever blocks. Since nodes are never
+/// removed one by one, the list does not suffer from the ABA problem, and `pop_all()` can also be
+/// called by several consumers at the same time, each value being taken by exactly one of them.
+template <class T>
+class MpscQueue {
+public:
+    MpscQueue() = default;
+
+    MpscQueue(MpscQueue const&) = delete;
+    auto operator=(MpscQueue const&) -> MpscQueue& = delete;
+
+    ~MpscQueue() {
+        for (Node* node = head_.load(std::memory_order_acquire); node != nullptr;) {
+            delete std::exchange(node, node->next);
+        }
+    }
+
+    void push(T value) {
+        auto* const node = new Node {
+            .value = std::move(value),
+            .next = head_.load(std::memory_order_relaxed),
+        };
+        while (!head_.compare_exchange_weak(
+            node->next,
+            node,
+            std::memory_order_release,
+            std::memory_order_relaxed
+        )) { }
+    }
+
+    /// Removes all values from the queue, and appends them to `batch` in the order in which they
+    /// were pushed. Returns the number of values taken.
+    auto pop_all(std::vector<T>& batch) -> std::size_t {
+        std::size_t const first = batch.size();
+        for (Node* node = head_.exchange(nullptr, std::memory_order_acquire); node != nullptr;) {
+            batch.push_back(std::move(node->value));
+            delete std::exchange(node, node->next);
+        }
+
+        std::reverse(batch.begin() + static_cast<std::ptrdiff_t>(first), batch.end());
+        return batch.size() - first;
+    }
+
+    /// Checks whether the queue is empty. The result may be outdated as soon as it is returned if
+    /// other threads use the queue at the same time.
+    auto empty() const -> bool {
+        return head_.load(std::memory_order_relaxed) == nullptr;
+    }
+
+private:
+    struct Node {
+        T value;
+        Node* next;
+    };
+
+    /// The most recently pushed node.
+    std::atomic<Node*> head_ = nullptr;
+};
+}  // namespace ants::detail
+
+#endif  // ANNOTATE_SNIPPETS_DETAIL_MPSC_QUEUE_HPP
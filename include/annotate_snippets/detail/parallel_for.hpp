@@ -0,0 +1,30 @@
+#ifndef ANNOTATE_SNIPPETS_DETAIL_PARALLEL_FOR_HPP
+#define ANNOTATE_SNIPPETS_DETAIL_PARALLEL_FOR_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory_resource>
+
+namespace ants::detail {
+/// Calls `body(index, scratch)` once for every `index` in `[0, count)`, distributing the calls over
+/// at most `thread_count` threads, one of which is the calling thread. If `thread_count` is 0, the
+/// number of hardware threads is used. The function returns after all calls have completed.
+///
+/// Indices are handed out one at a time from a shared counter, so a thread that finishes a cheap
+/// call immediately takes the next pending index, and expensive calls do not hold up the others.
+/// `scratch` is a memory resource owned by the calling worker thread, which is reused for all the
+/// calls made by that thread and is released when the function returns. It must not be used by
+/// other threads.
+///
+/// If a call to `body` throws an exception, no more indices are handed out, and the calls already
+/// running are completed. After all threads have been joined, the exception is rethrown on the
+/// calling thread. If several calls throw, only one of the exceptions is rethrown (that of the
+/// calling thread, if any).
+void parallel_for(
+    std::size_t count,
+    unsigned thread_count,
+    std::function<void(std::size_t, std::pmr::memory_resource*)> const& body
+);
+}  // namespace ants::detail
+
+#endif  // ANNOTATE_SNIPPETS_DETAIL_PARALLEL_FOR_HPP
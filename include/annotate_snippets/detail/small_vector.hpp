@@ -0,0 +1,248 @@
+#ifndef ANNOTATE_SNIPPETS_DETAIL_SMALL_VECTOR_HPP
+#define ANNOTATE_SNIPPETS_DETAIL_SMALL_VECTOR_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace ants::detail {
+/// A sequence container with storage for `InlineCapacity` elements inside the object, which only
+/// allocates from the heap when it grows beyond that capacity.
+///
+/// Only the operations used by this library are provided, with the same semantics as the
+/// corresponding operations of `std::vector`. The elements must be trivially copyable, so that they
+/// can be relocated by copying and need not be destroyed.
+template <class T, std::size_t InlineCapacity>
+class SmallVector {
+    static_assert(std::is_trivially_copyable_v<T> && std::is_default_constructible_v<T>);
+    static_assert(InlineCapacity != 0);
+
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using iterator = T*;
+    using const_iterator = T const*;
+
+    SmallVector() = default;
+
+    SmallVector(std::initializer_list<T> init) {
+        assign(init.begin(), init.end());
+    }
+
+    SmallVector(SmallVector const& other) {
+        assign(other.begin(), other.end());
+    }
+
+    SmallVector(SmallVector&& other) noexcept {
+        steal(other);
+    }
+
+    ~SmallVector() {
+        release_heap();
+    }
+
+    auto operator=(SmallVector const& other) -> SmallVector& {
+        if (this != &other) {
+            assign(other.begin(), other.end());
+        }
+        return *this;
+    }
+
+    auto operator=(SmallVector&& other) noexcept -> SmallVector& {
+        if (this != &other) {
+            release_heap();
+            steal(other);
+        }
+        return *this;
+    }
+
+    auto operator=(std::initializer_list<T> init) -> SmallVector& {
+        assign(init.begin(), init.end());
+        return *this;
+    }
+
+    auto begin() -> iterator {
+        return data_;
+    }
+
+    auto begin() const -> const_iterator {
+        return data_;
+    }
+
+    auto end() -> iterator {
+        return data_ + size_;
+    }
+
+    auto end() const -> const_iterator {
+        return data_ + size_;
+    }
+
+    auto size() const -> size_type {
+        return size_;
+    }
+
+    auto empty() const -> bool {
+        return size_ == 0;
+    }
+
+    auto capacity() const -> size_type {
+        return capacity_;
+    }
+
+    /// Checks whether the elements are stored inside the object.
+    auto is_inline() const -> bool {
+        return data_ == inline_storage_.data();
+    }
+
+    auto operator[](size_type index) -> T& {
+        return data_[index];
+    }
+
+    auto operator[](size_type index) const -> T const& {
+        return data_[index];
+    }
+
+    auto front() -> T& {
+        return data_[0];
+    }
+
+    auto front() const -> T const& {
+        return data_[0];
+    }
+
+    auto back() -> T& {
+        return data_[size_ - 1];
+    }
+
+    auto back() const -> T const& {
+        return data_[size_ - 1];
+    }
+
+    void reserve(size_type new_capacity) {
+        if (new_capacity > capacity_) {
+            reallocate(new_capacity);
+        }
+    }
+
+    void resize(size_type new_size) {
+        reserve(new_size);
+        std::fill(end(), data_ + std::max(new_size, size_), T());
+        size_ = new_size;
+    }
+
+    void push_back(T const& value) {
+        if (size_ == capacity_) {
+            // `value` may refer to an element of this container, so it is copied before growing.
+            T const copy = value;
+            grow(size_ + 1);
+            data_[size_++] = copy;
+        } else {
+            data_[size_++] = value;
+        }
+    }
+
+    void pop_back() {
+        --size_;
+    }
+
+    /// Removes the elements in `[first, last)`, and returns the iterator following the last
+    /// removed element.
+    auto erase(const_iterator first, const_iterator last) -> iterator {
+        iterator const pos = begin() + (first - begin());
+        iterator const new_end = std::copy(last, const_iterator(end()), pos);
+        size_ = static_cast<size_type>(new_end - begin());
+        return pos;
+    }
+
+    /// Inserts the elements of `values` before `pos`, and returns the iterator pointing to the
+    /// first inserted element.
+    auto insert(const_iterator pos, std::initializer_list<T> values) -> iterator {
+        auto const index = static_cast<size_type>(pos - begin());
+        if (size_ + values.size() > capacity_) {
+            grow(size_ + values.size());
+        }
+
+        iterator const insert_pos = begin() + index;
+        std::copy_backward(insert_pos, end(), end() + values.size());
+        std::ranges::copy(values, insert_pos);
+        size_ += values.size();
+        return insert_pos;
+    }
+
+    void clear() {
+        size_ = 0;
+    }
+
+    friend auto operator==(SmallVector const& lhs, SmallVector const& rhs) -> bool {
+        return std::ranges::equal(lhs, rhs);
+    }
+
+private:
+    /// Replaces the elements with `[first, last)`, which must not refer to this container.
+    void assign(T const* first, T const* last) {
+        auto const count = static_cast<size_type>(last - first);
+        if (count > capacity_) {
+            release_heap();
+            reset_to_inline();
+            reallocate(count);
+        }
+
+        std::copy(first, last, data_);
+        size_ = count;
+    }
+
+    /// Grows the capacity geometrically to hold at least `min_capacity` elements.
+    void grow(size_type min_capacity) {
+        reallocate(std::max(min_capacity, 2 * capacity_));
+    }
+
+    /// Moves the elements into a heap allocation of `new_capacity` elements.
+    void reallocate(size_type new_capacity) {
+        T* const new_data = std::allocator<T>().allocate(new_capacity);
+        std::copy(begin(), end(), new_data);
+
+        release_heap();
+        data_ = new_data;
+        capacity_ = new_capacity;
+    }
+
+    /// Takes the elements of `other`, leaving it empty. The heap allocation of `other` is taken
+    /// over, while inline elements are copied.
+    void steal(SmallVector& other) {
+        if (other.is_inline()) {
+            reset_to_inline();
+            std::copy(other.begin(), other.end(), data_);
+            size_ = other.size_;
+        } else {
+            data_ = other.data_;
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+        }
+
+        other.reset_to_inline();
+        other.size_ = 0;
+    }
+
+    void release_heap() {
+        if (!is_inline()) {
+            std::allocator<T>().deallocate(data_, capacity_);
+        }
+    }
+
+    void reset_to_inline() {
+        data_ = inline_storage_.data();
+        capacity_ = InlineCapacity;
+    }
+
+    std::array<T, InlineCapacity> inline_storage_ {};
+    T* data_ = inline_storage_.data();
+    size_type size_ = 0;
+    size_type capacity_ = InlineCapacity;
+};
+}  // namespace ants::detail
+
+#endif  // ANNOTATE_SNIPPETS_DETAIL_SMALL_VECTOR_HPP
@@ -1,9 +1,13 @@
 #ifndef ANNOTATE_SNIPPETS_DETAIL_STYLED_STRING_IMPL_HPP
 #define ANNOTATE_SNIPPETS_DETAIL_STYLED_STRING_IMPL_HPP
 
+#include "annotate_snippets/detail/small_vector.hpp"
 #include "annotate_snippets/style.hpp"
 
+#include <algorithm>
 #include <cstddef>
+#include <iterator>
+#include <span>
 #include <string_view>
 #include <utility>
 #include <vector>
@@ -21,27 +25,288 @@ struct StyledStringViewPart {
     auto operator==(StyledStringViewPart const& other) const -> bool = default;
 };
 
+/// An edit of the styles of a string, which sets the style of the substring in range
+/// `[start_index, end_index)` to `style`. See `StyledStringImpl::set_styles()`.
+struct StyleEdit {
+    std::size_t start_index;
+    std::size_t end_index;
+    Style style;
+};
+
+namespace detail {
+/// Internal storage for the styles of the different parts of a string.
+///
+/// A single `StyledPart` object cannot be used to represent the style of a string; at least two
+/// `StyledPart` objects are required. For two adjacent `StyledPart` objects `p1` and `p2`, the
+/// style of the substrings in the range `[p1.start_index, p2.start_index)` of the string
+/// `content_` is `p1.style`.
+struct StyledPart {
+    std::size_t start_index;
+    Style style;
+};
+
+/// Finds the part containing the character at `pos` within the parts `parts[first, count - 1)`,
+/// skipping the empty parts. `pos` must not be before the start of `parts[first]`.
+inline auto find_styled_part(
+    StyledPart const* parts,
+    std::size_t count,
+    std::size_t first,
+    std::size_t pos
+) -> std::size_t {
+    while (first + 2 < count && parts[first + 1].start_index <= pos) {
+        ++first;
+    }
+    return first;
+}
+
+/// Returns the index of the first part after `parts[index]` that starts a new style, i.e. whose
+/// style differs from the style of the part before it. Adjacent parts with the same style are
+/// treated as a single part. The last part only marks the end of the string, so it always ends the
+/// search.
+inline auto next_style_boundary(
+    StyledPart const* parts,
+    std::size_t count,
+    std::size_t index
+) -> std::size_t {
+    do {
+        ++index;
+    } while (index + 1 < count && parts[index].style == parts[index - 1].style);
+    return index;
+}
+}  // namespace detail
+
+/// A line of a `StyledStringView` or `StyledString`, viewed as a range of the
+/// `StyledStringViewPart`s consisting of consecutive characters of the same style. The newline
+/// character at the end of the line is not included. An empty line consists of a single empty
+/// part.
+///
+/// This is the lazy counterpart of an element of the return value of `styled_line_parts()`, and it
+/// yields the same parts, computing them while being iterated. It refers to the content and the
+/// styles of the string, so it becomes invalid when the string is modified or destroyed. The
+/// iterators of the line refer to the `StyledLine` object itself.
+class StyledLine {
+public:
+    class iterator {
+    public:
+        using value_type = StyledStringViewPart;
+        using difference_type = std::ptrdiff_t;
+        using iterator_concept = std::forward_iterator_tag;
+
+        iterator() = default;
+
+        auto operator*() const -> StyledStringViewPart {
+            std::size_t const part_end = std::min(
+                line_->parts_[detail::next_style_boundary(line_->parts_, line_->part_count_, part_)]
+                    .start_index,
+                line_->end_
+            );
+            return {
+                .content = line_->content_.substr(pos_, part_end - pos_),
+                .style = line_->parts_[part_].style,
+            };
+        }
+
+        auto operator++() -> iterator& {
+            pos_ = std::min(
+                line_->parts_[part_ = detail::next_style_boundary(
+                                  line_->parts_,
+                                  line_->part_count_,
+                                  part_
+                              )]
+                    .start_index,
+                line_->end_
+            );
+            part_ = detail::find_styled_part(line_->parts_, line_->part_count_, part_, pos_);
+            yields_empty_part_ = false;
+            return *this;
+        }
+
+        auto operator++(int) -> iterator {
+            iterator result = *this;
+            ++*this;
+            return result;
+        }
+
+        auto operator==(iterator const& other) const -> bool {
+            return pos_ == other.pos_ && yields_empty_part_ == other.yields_empty_part_;
+        }
+
+        auto operator==(std::default_sentinel_t /*unused*/) const -> bool {
+            return pos_ == line_->end_ && !yields_empty_part_;
+        }
+
+    private:
+        friend class StyledLine;
+
+        iterator(StyledLine const& line) :
+            line_(&line),
+            pos_(line.beg_),
+            part_(line.first_part_),
+            yields_empty_part_(line.beg_ == line.end_) { }
+
+        StyledLine const* line_ = nullptr;
+        /// The start of the current part.
+        std::size_t pos_ = 0;
+        /// The index of the styled part containing `pos_`.
+        std::size_t part_ = 0;
+        /// Indicates that the line is empty and its single empty part has not been yielded.
+        bool yields_empty_part_ = false;
+    };
+
+    auto begin() const -> iterator {
+        return iterator(*this);
+    }
+
+    auto end() const -> std::default_sentinel_t {
+        return {};
+    }
+
+    /// Returns the content of the line, without the newline character.
+    auto content() const -> std::string_view {
+        return content_.substr(beg_, end_ - beg_);
+    }
+
+private:
+    friend class StyledLineRange;
+
+    StyledLine(
+        std::string_view content,
+        detail::StyledPart const* parts,
+        std::size_t part_count,
+        std::size_t beg,
+        std::size_t first_part
+    ) :
+        content_(content),
+        parts_(parts),
+        part_count_(part_count),
+        beg_(beg),
+        end_(std::min(content.find('\n', beg), content.size())),
+        first_part_(first_part) {
+        // The '\r' before the newline character is removed together with it, unless the styles of
+        // these two characters differ.
+        if (end_ != content.size() && end_ != beg_ && content[end_ - 1] == '\r') {
+            std::size_t const part =
+                detail::find_styled_part(parts_, part_count_, first_part_, end_ - 1);
+            if (parts_[detail::next_style_boundary(parts_, part_count_, part)].start_index > end_) {
+                --end_;
+            }
+        }
+    }
+
+    std::string_view content_;
+    detail::StyledPart const* parts_;
+    std::size_t part_count_;
+    /// The range `[beg_, end_)` of the line in `content_`.
+    std::size_t beg_;
+    std::size_t end_;
+    /// The index of the styled part containing the first character of the line.
+    std::size_t first_part_;
+};
+
+/// The lines of a `StyledStringView` or `StyledString`, viewed as a range of `StyledLine`s. It is
+/// the lazy counterpart of the return value of `styled_line_parts()`: the lines are split while
+/// being iterated, without allocating any memory.
+///
+/// It refers to the content and the styles of the string, so it becomes invalid when the string is
+/// modified or destroyed.
+class StyledLineRange {
+public:
+    class iterator {
+    public:
+        using value_type = StyledLine;
+        using difference_type = std::ptrdiff_t;
+        using iterator_concept = std::forward_iterator_tag;
+
+        iterator() = default;
+
+        auto operator*() const -> StyledLine {
+            return StyledLine(range_->content_, range_->parts_, range_->part_count_, pos_, part_);
+        }
+
+        auto operator++() -> iterator& {
+            std::size_t const newline = range_->content_.find('\n', pos_);
+            pos_ = newline == std::string_view::npos ? range_->content_.size() : newline + 1;
+            part_ = detail::find_styled_part(range_->parts_, range_->part_count_, part_, pos_);
+            return *this;
+        }
+
+        auto operator++(int) -> iterator {
+            iterator result = *this;
+            ++*this;
+            return result;
+        }
+
+        auto operator==(iterator const& other) const -> bool {
+            return pos_ == other.pos_;
+        }
+
+        auto operator==(std::default_sentinel_t /*unused*/) const -> bool {
+            return pos_ == range_->content_.size();
+        }
+
+    private:
+        friend class StyledLineRange;
+
+        explicit iterator(StyledLineRange const& range) :
+            range_(&range),
+            part_(detail::find_styled_part(range.parts_, range.part_count_, 0, 0)) { }
+
+        StyledLineRange const* range_ = nullptr;
+        /// The start of the current line.
+        std::size_t pos_ = 0;
+        /// The index of the styled part containing `pos_`.
+        std::size_t part_ = 0;
+    };
+
+    StyledLineRange(std::string_view content, detail::StyledPart const* parts, std::size_t count) :
+        content_(content), parts_(parts), part_count_(count) { }
+
+    auto begin() const -> iterator {
+        return iterator(*this);
+    }
+
+    auto end() const -> std::default_sentinel_t {
+        return {};
+    }
+
+    auto empty() const -> bool {
+        return content_.empty();
+    }
+
+    /// Returns the first line. The range must not be empty.
+    auto front() const -> StyledLine {
+        return *begin();
+    }
+
+private:
+    std::string_view content_;
+    detail::StyledPart const* parts_;
+    std::size_t part_count_;
+};
+
 namespace detail {
 class StyledStringImpl {
 protected:
-    /// Internal storage for the styles of the different parts of a string.
-    ///
-    /// A single `StyledPart` object cannot be used to represent the style of a string; at least two
-    /// `StyledPart` objects are required. For two adjacent `StyledPart` objects `p1` and `p2`, the
-    /// style of the substrings in the range `[p1.start_index, p2.start_index)` of the string
-    /// `content_` is `p1.style`.
-    struct StyledPart {
-        std::size_t start_index;
-        Style style;
-    };
+    using StyledPart = detail::StyledPart;
+
+    /// The storage of the `StyledPart`s. Most strings consist of only a few parts (a uniformly
+    /// styled string needs two), which are stored inline to avoid heap allocations.
+    using StyledParts = SmallVector<StyledPart, 4>;
 
 public:
     /// Sets the style of the substring in range `[start_index, end_index)`. Any existing styles for
     /// the characters in this substring will be overwritten.
     void set_style(Style style, std::size_t start_index, std::size_t end_index);
 
+    /// Applies `edits` as if `set_style()` were called for each of them in order, so that later
+    /// edits overwrite earlier ones where they overlap. Instead of shifting the existing styles for
+    /// each edit, the edits are resolved in one sweep and merged with the existing styles in a
+    /// single pass, which takes O(P + E log E) time for P existing parts and E edits. Adjacent
+    /// parts of the same style are merged.
+    void set_styles(std::span<StyleEdit const> edits);
+
 protected:
-    std::vector<StyledPart> styled_parts_;
+    StyledParts styled_parts_;
 
     // clang-format off
     StyledStringImpl() : styled_parts_ {
@@ -49,7 +314,7 @@ protected:
     } { }
     // clang-format on
 
-    explicit StyledStringImpl(std::vector<StyledPart> parts) : styled_parts_(std::move(parts)) { }
+    explicit StyledStringImpl(StyledParts parts) : styled_parts_(std::move(parts)) { }
 
     // clang-format off
     explicit StyledStringImpl(std::size_t content_size, Style content_style) : styled_parts_ { {
@@ -59,6 +324,11 @@ protected:
     } } { }
     // clang-format on
 
+    /// Removes the styles of the first `count` characters of the string, and shifts the styles of
+    /// the remaining characters to the front. If `count` is not less than the length of the string,
+    /// the styles are reset to those of an empty string.
+    void remove_styled_parts_prefix(std::size_t count);
+
     /// Splits `content` into several `StyledStringViewPart`s by line and style, and puts substrings
     /// consisting of consecutive characters of the same style into one `StyledStringViewPart`. If
     /// there are multiple lines in a substring, splits each line into a separate
@@ -70,6 +340,12 @@ protected:
     auto styled_line_parts(  //
         std::string_view content
     ) const -> std::vector<std::vector<StyledStringViewPart>>;
+
+    /// Returns the lines of `content` as a lazy range, which yields the same lines and parts as
+    /// `styled_line_parts()` without allocating memory.
+    auto styled_lines(std::string_view content) const -> StyledLineRange {
+        return { content, styled_parts_.begin(), styled_parts_.size() };
+    }
 };
 }  // namespace detail
 }  // namespace ants
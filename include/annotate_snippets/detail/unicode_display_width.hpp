@@ -2,8 +2,10 @@
 #define ANNOTATE_SNIPPETS_DETAIL_UNICODE_DISPLAY_WIDTH_HPP
 
 #include <algorithm>
+#include <array>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <string_view>
 
 //! The following code is adapted from the open-source [fmt](https://github.com/fmtlib/fmt )
@@ -103,40 +105,80 @@ inline void for_each_codepoint(std::string_view s, F f) {
     }
 }
 
-/// Computes approximate display width of a UTF-8 string.
-inline auto display_width(std::string_view s) -> size_t {
+/// The number of code points described by each block of the width table.
+inline constexpr uint32_t code_point_width_block_size = 256;
+/// The number of blocks needed to cover all the code points.
+inline constexpr uint32_t code_point_width_block_count = 0x110000 / code_point_width_block_size;
+
+/// The widths of the code points in a block, packed into 2 bits per code point.
+using CodePointWidthBlock = std::array<uint8_t, code_point_width_block_size / 4>;
+
+/// A two-level lookup table of the display widths of all the code points. The first level maps the
+/// upper bits of a code point to a block, and the second level stores the packed widths in the
+/// block. Most of the blocks are identical (all narrow or all wide), so each distinct block is
+/// stored only once.
+///
+/// The table is generated by scripts/generate_unicode_width_table.py, which also lists the wide
+/// and zero-width code points, into src/detail/unicode_display_width_table.cpp.
+extern std::array<uint8_t, code_point_width_block_count> const code_point_width_block_index;
+extern CodePointWidthBlock const code_point_width_blocks[];
+
+/// Returns the display width of the code point `cp`. Invalid code points occupy one column.
+inline auto code_point_display_width(uint32_t cp) -> size_t {
+    if (cp >= 0x110000) {
+        return 1;
+    }
+
+    uint8_t const block = code_point_width_block_index[cp / code_point_width_block_size];
+    uint8_t const packed = code_point_width_blocks[block][cp % code_point_width_block_size / 4];
+    return (packed >> (cp % 4 * 2)) & 0b11;
+}
+
+/// Checks whether all the characters in `s` are ASCII characters. The bytes are tested 8 at a time
+/// with plain integer operations, which the compiler is free to vectorize further.
+inline auto is_ascii(std::string_view s) -> bool {
+    constexpr uint64_t high_bits = 0x8080'8080'8080'8080;
+
+    uint64_t bits = 0;
+    std::size_t idx = 0;
+    for (; idx + sizeof(uint64_t) <= s.size(); idx += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, s.data() + idx, sizeof(uint64_t));
+        bits |= word;
+    }
+    for (; idx != s.size(); ++idx) {
+        bits |= static_cast<unsigned char>(s[idx]);
+    }
+
+    return (bits & high_bits) == 0;
+}
+
+/// Computes approximate display width of a UTF-8 string, where each tab character occupies
+/// `tab_width` columns. This is the same as computing the display width of the string after
+/// replacing each tab character with `tab_width` spaces, without materializing that string.
+inline auto display_width(std::string_view s, size_t tab_width = 1) -> size_t {
+    // Each ASCII character except tab occupies one column.
+    if (is_ascii(s)) {
+        if (tab_width == 1) {
+            return s.size();
+        } else {
+            auto const tab_count = static_cast<size_t>(std::ranges::count(s, '\t'));
+            return s.size() - tab_count + tab_count * tab_width;
+        }
+    }
+
     size_t num_code_points = 0;
     // It is not a lambda for compatibility with C++14.
     // NOLINTNEXTLINE(readability-identifier-naming)
     struct count_code_points {
         size_t* count;
+        size_t tab_width;
         auto operator()(uint32_t cp, std::string_view /*unused*/) const -> bool {
-            *count += static_cast<unsigned>(
-                1
-                + (cp >= 0x1100
-                   && (cp <= 0x115f ||  // Hangul Jamo init. consonants
-                       cp == 0x2329 ||  // LEFT-POINTING ANGLE BRACKET
-                       cp == 0x232a ||  // RIGHT-POINTING ANGLE BRACKET
-                       // CJK ... Yi except IDEOGRAPHIC HALF FILL SPACE:
-                       (cp >= 0x2e80 && cp <= 0xa4cf && cp != 0x303f)
-                       || (cp >= 0xac00 && cp <= 0xd7a3) ||  // Hangul Syllables
-                       (cp >= 0xf900 && cp <= 0xfaff) ||  // CJK Compatibility Ideographs
-                       (cp >= 0xfe10 && cp <= 0xfe19) ||  // Vertical Forms
-                       (cp >= 0xfe30 && cp <= 0xfe6f) ||  // CJK Compatibility Forms
-                       (cp >= 0xff00 && cp <= 0xff60) ||  // Fullwidth Forms
-                       (cp >= 0xffe0 && cp <= 0xffe6) ||  // Fullwidth Forms
-                       (cp >= 0x20000 && cp <= 0x2fffd) ||  // CJK
-                       (cp >= 0x30000 && cp <= 0x3fffd) ||
-                       // Miscellaneous Symbols and Pictographs + Emoticons:
-                       (cp >= 0x1f300 && cp <= 0x1f64f) ||
-                       // Supplemental Symbols and Pictographs:
-                       (cp >= 0x1f900 && cp <= 0x1f9ff)))
-            );
+            *count += cp == '\t' ? tab_width : code_point_display_width(cp);
             return true;
         }
     };
-    // We could avoid branches by using utf8_decode directly.
-    for_each_codepoint(s, count_code_points { &num_code_points });
+    for_each_codepoint(s, count_code_points { &num_code_points, tab_width });
     return num_code_points;
 }
 }  // namespace ants::detail
@@ -0,0 +1,276 @@
+#ifndef ANNOTATE_SNIPPETS_DIAG_AGGREGATOR_HPP
+#define ANNOTATE_SNIPPETS_DIAG_AGGREGATOR_HPP
+
+#include "annotate_snippets/annotated_source.hpp"
+#include "annotate_snippets/detail/diag/diag_entry_impl.hpp"
+#include "annotate_snippets/detail/diag/level.hpp"
+#include "annotate_snippets/detail/hash.hpp"
+#include "annotate_snippets/diag.hpp"
+#include "annotate_snippets/style.hpp"
+#include "annotate_snippets/styled_string.hpp"
+#include "annotate_snippets/styled_string_view.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ants {
+/// A unique diagnostic collected by `DiagAggregator`, with the number of times it was added.
+template <detail::diagnostic_level Level>
+struct AggregatedDiag {
+    Diag<Level> diag;
+    std::size_t occurrence_num;
+};
+
+/// Collects diagnostics from any number of threads, and merges the duplicates, so that each unique
+/// diagnostic is rendered only once, however many times it is reported (for example, by every
+/// translation unit including the same header).
+///
+/// Two diagnostics are duplicates if all their entries have the same levels, error codes and
+/// messages, and their annotated sources have the same origins, first line numbers and spans with
+/// the same labels. The code of the annotated sources is not compared, since the sources with the
+/// same origin are assumed to be the same. The styles of messages and labels are not compared
+/// either. Diagnostics with deferred messages or labels (see `DeferredStyledString`) are never
+/// considered duplicates, since their text is not known before they are rendered.
+///
+/// The diagnostics are stored in a hash set divided into shards, each protected by its own mutex,
+/// so that threads adding diagnostics with different fingerprints rarely wait for each other. All
+/// member functions are thread-safe.
+template <detail::diagnostic_level Level>
+class DiagAggregator {
+public:
+    /// Creates an aggregator whose hash set is divided into `shard_num` shards. If `shard_num` is
+    /// 0, one shard is used.
+    explicit DiagAggregator(std::size_t shard_num = 16) :
+        shard_num_(std::max<std::size_t>(shard_num, 1)),
+        shards_(std::make_unique<Shard[]>(shard_num_)) { }
+
+    DiagAggregator(DiagAggregator const&) = delete;
+    auto operator=(DiagAggregator const&) -> DiagAggregator& = delete;
+
+    /// Adds `diag`. If an equal diagnostic has been added before, `diag` is dropped and only the
+    /// number of occurrences of the earlier one is incremented.
+    ///
+    /// @return `true` if `diag` is the first occurrence of the diagnostic.
+    auto add(Diag<Level> diag) -> bool {
+        std::size_t const hash = fingerprint(diag);
+        Shard& shard = shards_[hash % shard_num_];
+
+        std::scoped_lock const lock(shard.mutex);
+        // The diagnostics that cannot be deduplicated are not indexed, so that they are neither
+        // merged into the earlier ones nor have the later ones merged into them.
+        if (is_deduplicable(diag)) {
+            auto const [first, last] = shard.index.equal_range(hash);
+            for (std::size_t const slot_idx :
+                 std::ranges::subrange(first, last) | std::views::values) {
+                Slot& slot = shard.slots[slot_idx];
+                if (is_duplicate(slot.diag, diag)) {
+                    ++slot.occurrence_num;
+                    return false;
+                }
+            }
+
+            shard.index.emplace(hash, shard.slots.size());
+        }
+
+        shard.slots.push_back(Slot {
+            .sequence = next_sequence_.fetch_add(1, std::memory_order_relaxed),
+            .diag = std::move(diag),
+            .occurrence_num = 1,
+        });
+        return true;
+    }
+
+    /// Returns the number of unique diagnostics collected so far.
+    auto size() const -> std::size_t {
+        std::size_t result = 0;
+        for (Shard const& shard : std::span(shards_.get(), shard_num_)) {
+            std::scoped_lock const lock(shard.mutex);
+            result += shard.slots.size();
+        }
+        return result;
+    }
+
+    /// Removes all the collected diagnostics, and returns the unique ones in the order in which
+    /// they were first added, with the numbers of their occurrences.
+    auto take() -> std::vector<AggregatedDiag<Level>> {
+        std::vector<Slot> slots;
+        for (Shard& shard : std::span(shards_.get(), shard_num_)) {
+            std::scoped_lock const lock(shard.mutex);
+            std::ranges::move(shard.slots, std::back_inserter(slots));
+            shard.slots.clear();
+            shard.index.clear();
+        }
+        std::ranges::sort(slots, {}, &Slot::sequence);
+
+        std::vector<AggregatedDiag<Level>> result;
+        result.reserve(slots.size());
+        for (Slot& slot : slots) {
+            result.push_back({
+                .diag = std::move(slot.diag),
+                .occurrence_num = slot.occurrence_num,
+            });
+        }
+        return result;
+    }
+
+    /// Same as `take()`, but returns the diagnostics only. The title message of each diagnostic
+    /// that occurred more than once is followed by the summary " (N occurrences)". The summary is
+    /// appended by a deferred message (see `DiagEntry::set_deferred_diag_message()`), which refers
+    /// to the original message.
+    auto take_summarized() -> std::vector<Diag<Level>> {
+        std::vector<Diag<Level>> result;
+        for (AggregatedDiag<Level>& aggregated : take()) {
+            if (aggregated.occurrence_num > 1) {
+                aggregated.diag.set_deferred_diag_message(
+                    [message = aggregated.diag.diag_message(), num = aggregated.occurrence_num] {
+                        return summarize(message, num);
+                    }
+                );
+            }
+            result.push_back(std::move(aggregated.diag));
+        }
+        return result;
+    }
+
+private:
+    struct Slot {
+        /// The number of unique diagnostics added before this one.
+        std::uint64_t sequence;
+        Diag<Level> diag;
+        std::size_t occurrence_num;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::vector<Slot> slots;
+        /// Maps the fingerprints of the diagnostics to their indices in `slots`.
+        std::unordered_multimap<std::size_t, std::size_t> index;
+    };
+
+    std::size_t shard_num_;
+    std::unique_ptr<Shard[]> shards_;
+    std::atomic<std::uint64_t> next_sequence_ = 0;
+
+    /// Calls `visit(entry)` for the primary entry and each secondary entry of `diag`.
+    template <class Visit>
+    static void for_each_entry(Diag<Level> const& diag, Visit const& visit) {
+        visit(diag.primary_diag_entry());
+        for (DiagEntry<Level> const& entry : diag.secondary_diag_entries()) {
+            visit(entry);
+        }
+    }
+
+    /// Computes the fingerprint of `diag` from everything compared by `is_duplicate()`, except for
+    /// the levels, which are not required to be hashable and are hashed by their display strings.
+    static auto fingerprint(Diag<Level> const& diag) -> std::size_t {
+        std::size_t seed = diag.secondary_diag_entries().size();
+        for_each_entry(diag, [&]<class D>(detail::DiagEntryImpl<Level, D> const& entry) {
+            seed = detail::hash_combine(seed, detail::level_display_string(entry.level()));
+            seed = detail::hash_combine(seed, entry.error_code());
+            seed = detail::hash_combine(seed, entry.diag_message().content());
+            for (AnnotatedSource const& source : entry.associated_sources()) {
+                seed = detail::hash_combine(seed, source.origin());
+                seed = detail::hash_combine(seed, source.first_line_number());
+                for (auto const* spans : { &source.primary_spans(), &source.secondary_spans() }) {
+                    seed = detail::hash_combine(seed, spans->size());
+                    for (LabeledSpan const& span : *spans) {
+                        seed = detail::hash_combine(seed, span.beg.line);
+                        seed = detail::hash_combine(seed, span.beg.col);
+                        seed = detail::hash_combine(seed, span.end.line);
+                        seed = detail::hash_combine(seed, span.end.col);
+                        seed = detail::hash_combine(seed, span.label.content());
+                    }
+                }
+            }
+        });
+        return seed;
+    }
+
+    /// Checks whether `diag` has no deferred messages or labels.
+    static auto is_deduplicable(Diag<Level> const& diag) -> bool {
+        auto const has_deferred_label = [](LabeledSpan const& span) {
+            return static_cast<bool>(span.deferred_label);
+        };
+        auto const has_deferred_labels = [&](AnnotatedSource const& source) {
+            return std::ranges::any_of(source.primary_spans(), has_deferred_label)
+                || std::ranges::any_of(source.secondary_spans(), has_deferred_label);
+        };
+
+        bool result = true;
+        for_each_entry(diag, [&]<class D>(detail::DiagEntryImpl<Level, D> const& entry) {
+            result = result && !entry.deferred_diag_message()
+                && std::ranges::none_of(entry.associated_sources(), has_deferred_labels);
+        });
+        return result;
+    }
+
+    template <class Derived1, class Derived2>
+    static auto is_duplicate(
+        detail::DiagEntryImpl<Level, Derived1> const& lhs,
+        detail::DiagEntryImpl<Level, Derived2> const& rhs
+    ) -> bool {
+        auto const same_span = [](LabeledSpan const& lhs_span, LabeledSpan const& rhs_span) {
+            return lhs_span.beg == rhs_span.beg && lhs_span.end == rhs_span.end
+                && lhs_span.label.content() == rhs_span.label.content();
+        };
+        auto const same_source = [&](AnnotatedSource const& lhs_src,
+                                     AnnotatedSource const& rhs_src) {
+            return lhs_src.origin() == rhs_src.origin()
+                && lhs_src.first_line_number() == rhs_src.first_line_number()
+                && std::ranges::equal(lhs_src.primary_spans(), rhs_src.primary_spans(), same_span)
+                && std::ranges::equal(
+                       lhs_src.secondary_spans(),
+                       rhs_src.secondary_spans(),
+                       same_span
+                );
+        };
+
+        return lhs.level() == rhs.level() && lhs.error_code() == rhs.error_code()
+            && lhs.diag_message().content() == rhs.diag_message().content()
+            && std::ranges::equal(lhs.associated_sources(), rhs.associated_sources(), same_source);
+    }
+
+    static auto is_duplicate(Diag<Level> const& lhs, Diag<Level> const& rhs) -> bool {
+        return is_duplicate(lhs.primary_diag_entry(), rhs.primary_diag_entry())
+            && std::ranges::equal(
+                   lhs.secondary_diag_entries(),
+                   rhs.secondary_diag_entries(),
+                   [](DiagEntry<Level> const& lhs_entry, DiagEntry<Level> const& rhs_entry) {
+                       return is_duplicate(lhs_entry, rhs_entry);
+                   }
+            );
+    }
+
+    /// Builds the message `message` followed by the summary of `occurrence_num` occurrences.
+    static auto summarize(StyledStringView const& message, std::size_t occurrence_num)
+        -> StyledString {
+        StyledString result;
+        for (bool is_first = true; StyledLine const& line : message.styled_lines()) {
+            if (!std::exchange(is_first, false)) {
+                result.append_newline();
+            }
+            result.append(line);
+        }
+
+        result.append(
+            (message.empty() ? "(" : " (") + std::to_string(occurrence_num) + " occurrences)",
+            Style::Auto
+        );
+        return result;
+    }
+};
+}  // namespace ants
+
+#endif  // ANNOTATE_SNIPPETS_DIAG_AGGREGATOR_HPP
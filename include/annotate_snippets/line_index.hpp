@@ -0,0 +1,59 @@
+#ifndef ANNOTATE_SNIPPETS_LINE_INDEX_HPP
+#define ANNOTATE_SNIPPETS_LINE_INDEX_HPP
+
+#include <cstddef>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ants {
+/// A dense, immutable index of the offsets of the first byte of every line in a source code.
+///
+/// Unlike the line offset cache of `AnnotatedSource`, which is filled lazily line by line, a
+/// `LineIndex` is built by scanning the whole source code for newline characters once (using SIMD
+/// instructions where available). Afterwards, finding the start of a line is a single array access
+/// and finding the line containing a byte is a binary search.
+///
+/// The index follows the same conventions as `AnnotatedSource`: if the source code does not end
+/// with '\n', there is a hypothetical line following the actual last line which starts at
+/// `source.size()`, and every byte offset beyond the valid range of the source code belongs to the
+/// last line of the index.
+class LineIndex {
+public:
+    /// Creates an index of an empty source code.
+    LineIndex() : line_starts_ { 0 } { }
+    /// Creates the index of the lines in `source`. Note that the index does not refer to `source`
+    /// after construction.
+    explicit LineIndex(std::string_view source);
+
+    /// Returns the number of lines in the index, including the hypothetical line following the
+    /// actual last line (if any).
+    auto line_count() const -> unsigned {
+        return static_cast<unsigned>(line_starts_.size());
+    }
+
+    /// Returns the offsets of the first byte of every line, in ascending order.
+    auto line_starts() const -> std::vector<std::size_t> const& {
+        return line_starts_;
+    }
+
+    /// Returns the offset of the first byte of line `line`. If `line` exceeds the number of lines
+    /// in the source code, returns the size of the source code.
+    auto line_offset(unsigned line) const -> std::size_t {
+        return line < line_starts_.size() ? line_starts_[line] : source_size_;
+    }
+
+    /// Returns the line on which the byte at `byte_offset` is located, along with the offset of the
+    /// first byte of that line.
+    auto byte_offset_to_line(std::size_t byte_offset) const -> std::pair<unsigned, std::size_t>;
+
+private:
+    /// The offsets of the first byte of every line. It always contains at least one element (the
+    /// start of line 0).
+    std::vector<std::size_t> line_starts_;
+    /// The size of the indexed source code.
+    std::size_t source_size_ = 0;
+};
+}  // namespace ants
+
+#endif  // ANNOTATE_SNIPPETS_LINE_INDEX_HPP
@@ -0,0 +1,117 @@
+#ifndef ANNOTATE_SNIPPETS_OUTPUT_SINK_HPP
+#define ANNOTATE_SNIPPETS_OUTPUT_SINK_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace ants {
+/// Checks if `Sink` can be used as the destination of rendered text. A sink receives the rendered
+/// text through `write()`, usually one complete line (including escape sequences, if any) at a
+/// time. The string passed to `write()` is only valid during the call.
+template <class Sink>
+concept output_sink = requires(Sink& sink, std::string_view str) { sink.write(str); };
+
+/// A sink that appends the rendered text to a `std::string`.
+class StringSink {
+public:
+    explicit StringSink(std::string& target) : target_(&target) { }
+
+    void write(std::string_view str) {
+        target_->append(str);
+    }
+
+    auto target() const -> std::string& {
+        return *target_;
+    }
+
+private:
+    std::string* target_;
+};
+
+/// A sink that writes the rendered text to a C stream with `std::fwrite()`. Buffering is left to
+/// the C stream.
+class FileSink {
+public:
+    explicit FileSink(std::FILE* file) : file_(file) { }
+
+    void write(std::string_view str) {
+        std::fwrite(str.data(), 1, str.size(), file_);
+    }
+
+    auto file() const -> std::FILE* {
+        return file_;
+    }
+
+private:
+    std::FILE* file_;
+};
+
+/// A sink that writes the rendered text to a `std::ostream`. It is provided for compatibility, and
+/// writes each string with a single call to `std::ostream::write()`.
+class OStreamSink {
+public:
+    explicit OStreamSink(std::ostream& out) : out_(&out) { }
+
+    void write(std::string_view str) {
+        out_->write(str.data(), static_cast<std::streamsize>(str.size()));
+    }
+
+    auto stream() const -> std::ostream& {
+        return *out_;
+    }
+
+private:
+    std::ostream* out_;
+};
+
+#ifndef _WIN32
+/// A sink that writes the rendered text to a POSIX file descriptor.
+///
+/// Short strings are collected in an internal buffer. When the buffer cannot hold a string, the
+/// buffered text and the string are written together with a single `writev()` call, so long strings
+/// are never copied. The buffered text is written when `flush()` is called and when the sink is
+/// destroyed. Errors other than `EINTR` are ignored, and the text that cannot be written is
+/// dropped.
+class FdSink {
+public:
+    /// The capacity of the internal buffer.
+    static constexpr std::size_t buffer_capacity = 8192;
+
+    /// Creates a sink writing to `fd`. The sink does not take ownership of the file descriptor.
+    explicit FdSink(int fd) : fd_(fd) { }
+
+    // The buffered text must be written exactly once.
+    FdSink(FdSink const&) = delete;
+    auto operator=(FdSink const&) -> FdSink& = delete;
+
+    ~FdSink() {
+        flush();
+    }
+
+    void write(std::string_view str);
+
+    /// Writes the buffered text to the file descriptor.
+    void flush() {
+        write_through({});
+    }
+
+    auto fd() const -> int {
+        return fd_;
+    }
+
+private:
+    /// Writes the buffered text followed by `str` to the file descriptor, and clears the buffer.
+    void write_through(std::string_view str);
+
+    int fd_;
+    std::size_t buffer_size_ = 0;
+    std::array<char, buffer_capacity> buffer_;
+};
+#endif
+}  // namespace ants
+
+#endif  // ANNOTATE_SNIPPETS_OUTPUT_SINK_HPP
@@ -0,0 +1,269 @@
+#ifndef ANNOTATE_SNIPPETS_RENDERER_DIAG_EMITTER_HPP
+#define ANNOTATE_SNIPPETS_RENDERER_DIAG_EMITTER_HPP
+
+#include "annotate_snippets/detail/diag/level.hpp"
+#include "annotate_snippets/detail/mpsc_queue.hpp"
+#include "annotate_snippets/diag.hpp"
+#include "annotate_snippets/output_sink.hpp"
+#include "annotate_snippets/renderer/human_renderer.hpp"
+#include "annotate_snippets/style_spec.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ants {
+/// The options of `DiagEmitter`.
+struct DiagEmitterOptions {
+    /// The number of background threads rendering the diagnostics. If it is 0, one thread is used.
+    unsigned thread_count = 1;
+    /// Indicates whether the diagnostics are written in the order in which they are emitted. If it
+    /// is `false`, the diagnostics taken by a thread are written as soon as that thread has
+    /// rendered them, so with several threads, a diagnostic can be written before the diagnostics
+    /// emitted earlier. With a single thread, the order is always preserved.
+    bool preserves_order = true;
+};
+
+/// Renders diagnostics on background threads and writes them to an output sink, so that the
+/// threads producing diagnostics never wait for the rendering or for each other.
+///
+/// `emit()` takes ownership of a diagnostic and pushes it into a lock-free queue (see
+/// `detail::MpscQueue`), which is all the work done by the producing thread. The background
+/// threads take all the queued diagnostics at once, render them with a copy of the renderer given
+/// to the constructor, and write the renderings of each batch to the sink with a single call to
+/// `sink.write()`. Each thread allocates the scratch memory of the renderer from its own pool,
+/// which replaces `HumanRenderer::scratch_memory_resource` and is reused for all the diagnostics
+/// rendered by the thread. The output is the same as the one produced by calling the
+/// `render_diag()` overload for sinks for each diagnostic in the order of emission (see
+/// `DiagEmitterOptions::preserves_order`).
+///
+/// The calls to the sink are serialized, so the sink need not be thread-safe, but it is called from
+/// the background threads and must outlive the emitter. `style_sheet` is called from several
+/// threads at the same time. Note that diagnostics only refer to the strings of their messages,
+/// labels and source code, which must stay valid until the diagnostics have been written (see
+/// `flush()`), for example by using `SourceFile` and deferred labels.
+///
+/// If the rendering of a diagnostic throws an exception (e.g. a deferred message or label, or an
+/// allocation fails), nothing is written for that diagnostic, but it still counts as written, so
+/// the diagnostics emitted after it are written as usual. The first such exception is rethrown by
+/// the next call to `flush()`. The exceptions left when the emitter is destroyed are discarded.
+template <detail::diagnostic_level Level, style_sheet_for<Level> StyleSheet = PlainTextStyleSheet>
+class DiagEmitter {
+public:
+    /// Creates an emitter writing to `sink`, and starts its background threads.
+    template <output_sink Sink>
+    explicit DiagEmitter(
+        Sink& sink,
+        HumanRenderer const& renderer = {},
+        StyleSheet style_sheet = {},
+        DiagEmitterOptions options = {}
+    ) :
+        renderer_(renderer),
+        style_sheet_(std::move(style_sheet)),
+        preserves_order_(options.preserves_order),
+        sink_(&sink),
+        write_([](void* sink, std::string_view str) { static_cast<Sink*>(sink)->write(str); }),
+        flush_([]([[maybe_unused]] void* sink) {
+            if constexpr (requires(Sink& target) { target.flush(); }) {
+                static_cast<Sink*>(sink)->flush();
+            }
+        }) {
+        unsigned const thread_count = std::max(options.thread_count, 1u);
+        workers_.reserve(thread_count);
+        for (unsigned idx = 0; idx != thread_count; ++idx) {
+            workers_.emplace_back([this] { work(); });
+        }
+    }
+
+    DiagEmitter(DiagEmitter const&) = delete;
+    auto operator=(DiagEmitter const&) -> DiagEmitter& = delete;
+
+    /// Writes all the emitted diagnostics, and stops the background threads.
+    ~DiagEmitter() {
+        stopping_.store(true, std::memory_order_release);
+        signal_.fetch_add(1, std::memory_order_release);
+        signal_.notify_all();
+        workers_.clear();
+    }
+
+    /// Queues `diag` to be rendered and written by a background thread. This function can be called
+    /// from any number of threads at the same time, and never blocks.
+    void emit(Diag<Level> diag) {
+        queue_.push(Item {
+            .sequence = emitted_count_.fetch_add(1, std::memory_order_relaxed),
+            .diag = std::move(diag),
+        });
+        signal_.fetch_add(1, std::memory_order_release);
+        signal_.notify_one();
+    }
+
+    /// Waits until the queue is drained, i.e. until every diagnostic emitted before the call (and
+    /// every diagnostic emitted by other threads during the call) has been written, and then
+    /// flushes the sink if it has a `flush()` member function. If the rendering of a diagnostic
+    /// has thrown an exception since the last call, the first such exception is rethrown after the
+    /// sink is flushed.
+    void flush() {
+        for (std::uint64_t written = written_count_.load(std::memory_order_acquire);
+             written != emitted_count_.load(std::memory_order_acquire);
+             written = written_count_.load(std::memory_order_acquire)) {
+            written_count_.wait(written, std::memory_order_acquire);
+        }
+
+        std::exception_ptr exception;
+        {
+            std::scoped_lock const lock(output_mutex_);
+            flush_(sink_);
+            exception = std::exchange(exception_, nullptr);
+        }
+
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+
+    /// Returns the number of diagnostics emitted so far.
+    auto emitted_count() const -> std::uint64_t {
+        return emitted_count_.load(std::memory_order_relaxed);
+    }
+
+    /// Returns the number of diagnostics written so far, including those whose rendering failed.
+    auto written_count() const -> std::uint64_t {
+        return written_count_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Item {
+        /// The number of diagnostics emitted before this one.
+        std::uint64_t sequence;
+        Diag<Level> diag;
+    };
+
+    /// The body of the background threads: renders the queued diagnostics batch by batch, until
+    /// the emitter is destroyed and the queue is empty.
+    void work() {
+        std::pmr::unsynchronized_pool_resource scratch;
+        HumanRenderer renderer = renderer_;
+        renderer.scratch_memory_resource = &scratch;
+
+        std::vector<Item> batch;
+        std::vector<std::pair<std::uint64_t, std::string>> rendered;
+        while (true) {
+            // The signal is read before the queue, so that a diagnostic emitted after the queue is
+            // found empty changes the signal, and `wait()` returns immediately.
+            std::uint64_t const signal = signal_.load(std::memory_order_acquire);
+            if (queue_.pop_all(batch) == 0) {
+                if (stopping_.load(std::memory_order_acquire)) {
+                    return;
+                }
+                signal_.wait(signal, std::memory_order_acquire);
+                continue;
+            }
+
+            for (Item const& item : batch) {
+                std::string text;
+                StringSink sink(text);
+                try {
+                    renderer.render_diag(sink, item.diag, style_sheet_);
+                } catch (...) {
+                    // The partial rendering is dropped, and the empty rendering keeps the sequence
+                    // going.
+                    text.clear();
+                    record_exception(std::current_exception());
+                }
+                rendered.emplace_back(item.sequence, std::move(text));
+            }
+            batch.clear();
+
+            write(rendered);
+            rendered.clear();
+        }
+    }
+
+    /// Keeps `exception` to be rethrown by `flush()`, unless an earlier exception is kept.
+    void record_exception(std::exception_ptr exception) {
+        std::scoped_lock const lock(output_mutex_);
+        if (!exception_) {
+            exception_ = std::move(exception);
+        }
+    }
+
+    /// Writes the renderings in `rendered`, which are paired with the sequence numbers of their
+    /// diagnostics. To preserve the order, the renderings are held back until all the diagnostics
+    /// emitted before them are written.
+    void write(std::vector<std::pair<std::uint64_t, std::string>>& rendered) {
+        std::scoped_lock const lock(output_mutex_);
+
+        std::string output;
+        std::uint64_t written_num = 0;
+        if (!preserves_order_) {
+            for (std::string const& text : rendered | std::views::values) {
+                output.append(text);
+            }
+            written_num = rendered.size();
+        } else {
+            for (auto& [sequence, text] : rendered) {
+                held_back_.emplace(sequence, std::move(text));
+            }
+
+            for (auto iter = held_back_.begin();
+                 iter != held_back_.end() && iter->first == next_sequence_;
+                 iter = held_back_.erase(iter)) {
+                output.append(iter->second);
+                ++next_sequence_;
+                ++written_num;
+            }
+        }
+
+        if (!output.empty()) {
+            write_(sink_, output);
+        }
+
+        if (written_num != 0) {
+            written_count_.fetch_add(written_num, std::memory_order_release);
+            written_count_.notify_all();
+        }
+    }
+
+    HumanRenderer renderer_;
+    StyleSheet style_sheet_;
+    bool preserves_order_;
+
+    detail::MpscQueue<Item> queue_;
+    std::atomic<std::uint64_t> emitted_count_ = 0;
+    std::atomic<std::uint64_t> written_count_ = 0;
+    /// Changed whenever a diagnostic is queued or the emitter is being destroyed, to wake up the
+    /// background threads waiting for it.
+    std::atomic<std::uint64_t> signal_ = 0;
+    std::atomic<bool> stopping_ = false;
+
+    /// Serializes the calls to the sink, and protects the members below.
+    std::mutex output_mutex_;
+    /// The type-erased sink.
+    void* sink_;
+    void (*write_)(void*, std::string_view);
+    void (*flush_)(void*);
+    /// The sequence number of the next diagnostic to be written, if the order is preserved.
+    std::uint64_t next_sequence_ = 0;
+    /// The renderings that cannot be written yet, indexed by the sequence numbers of their
+    /// diagnostics.
+    std::map<std::uint64_t, std::string> held_back_;
+    /// The first exception thrown by the rendering since the last call to `flush()`.
+    std::exception_ptr exception_;
+
+    /// The background threads. They are declared last, so that they are started after, and joined
+    /// before, the other members are initialized and destroyed.
+    std::vector<std::jthread> workers_;
+};
+}  // namespace ants
+
+#endif  // ANNOTATE_SNIPPETS_RENDERER_DIAG_EMITTER_HPP
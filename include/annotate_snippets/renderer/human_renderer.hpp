@@ -4,29 +4,86 @@
 #include "annotate_snippets/annotated_source.hpp"
 #include "annotate_snippets/detail/diag/diag_entry_impl.hpp"
 #include "annotate_snippets/detail/diag/level.hpp"
+#include "annotate_snippets/detail/parallel_for.hpp"
 #include "annotate_snippets/detail/styled_string_impl.hpp"
 #include "annotate_snippets/diag.hpp"
+#include "annotate_snippets/output_sink.hpp"
+#include "annotate_snippets/renderer/render_cache.hpp"
+#include "annotate_snippets/renderer/render_observer.hpp"
 #include "annotate_snippets/style.hpp"
 #include "annotate_snippets/style_spec.hpp"
 #include "annotate_snippets/styled_string.hpp"
 #include "annotate_snippets/styled_string_view.hpp"
 
 #include <algorithm>
+#include <array>
+#include <bitset>
+#include <climits>
+#include <concepts>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <memory_resource>
 #include <ostream>
 #include <ranges>
+#include <string>
 #include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace ants {
+namespace detail {
+/// Provides the diagnostic level `Level` of `Diag<Level>` as the member `type`.
+template <class T>
+struct diag_level { };
+
+template <class Level>
+struct diag_level<Diag<Level>> {
+    using type = Level;
+};
+
+/// A random access range of `Diag`s, which can be rendered by `HumanRenderer::render_batch()`.
+template <class R>
+concept diag_range = std::ranges::random_access_range<R const>
+    && requires { typename diag_level<std::ranges::range_value_t<R>>::type; };
+
+/// The diagnostic level of the `Diag`s in the range `R`.
+template <diag_range R>
+using diag_range_level_t = typename diag_level<std::ranges::range_value_t<R>>::type;
+
+/// Tracks the size of the rendering of a diagnostic, which is limited by
+/// `HumanRenderer::max_output_lines` and `HumanRenderer::max_output_bytes`.
+struct OutputBudget {
+    /// The number of line breaks and bytes counted so far.
+    std::size_t line_num = 0;
+    std::size_t byte_num = 0;
+    /// The size of the prefix of the content of the render target that has been counted. It is
+    /// reset whenever the complete lines of the render target are consumed and removed.
+    std::size_t measured_size = 0;
+    /// The number of annotations in the annotated sources that have not been rendered yet.
+    std::size_t pending_annotation_num = 0;
+    /// Indicates that a limit has been reached and the trailing line has been rendered, so that
+    /// nothing more is rendered.
+    bool exhausted = false;
+
+    /// Counts the content of `render_target` after the first `measured_size` bytes.
+    void measure(StyledString const& render_target);
+
+    /// Checks whether the counted size reaches `max_lines` lines or `max_bytes` bytes, where a
+    /// limit of 0 is never reached.
+    auto is_used_up(std::size_t max_lines, std::size_t max_bytes) const -> bool;
+};
+}  // namespace detail
+
 class HumanRenderer {
 public:
     /// Default column width, used in tests and when terminal dimensions cannot be determined.
     static constexpr unsigned default_column_width = 140;
 
     /// Maximum width for diagnostic messages. When code lines exceed this width, the renderer will
-    /// attempt to reduce the lines to fit within this constraint.
+    /// attempt to reduce the lines to fit within this constraint. Specifically, only a window of
+    /// the line around its annotations is rendered, and the cut points are marked with "...".
     unsigned diagnostic_width = default_column_width;
     /// Character used for primary annotations underline. This character's display width must be 1.
     char primary_underline = '^';
@@ -110,6 +167,19 @@ public:
         ///                This label is rendered at the far right of the annotated "variable" word.
         Right,
     } label_position = Left;
+    /// The algorithm placing the labels of the annotations of each line which cannot be rendered on
+    /// the same line as their underlines (see `label_position`).
+    enum LabelPlacement : std::uint8_t {
+        /// Builds a directed graph of the constraints between the labels, and places the labels in
+        /// a topological order of the graph. The number of edges of the graph, and thus the time
+        /// spent on a line, can grow quadratically with the number of annotations on the line.
+        GraphPlacement,
+        /// Places the labels in one pass over the annotations sorted by their positions, which
+        /// takes O(n log n) time for n annotations on a line. The labels are placed exactly as
+        /// with `GraphPlacement`, so this is preferable for lines with many annotations, such as
+        /// long initializer lists in generated code.
+        SweepPlacement,
+    } label_placement = GraphPlacement;
     /// Represents the alignment of line numbers.
     enum LineNumAlignment : std::uint8_t {
         /// Aligns line numbers to the left.
@@ -129,58 +199,547 @@ public:
         ///     100 | bar(abc + def)
         AlignRight,
     } line_num_alignment = AlignRight;
+    /// The memory resource supplying the scratch memory of the renderer, i.e. the intermediate
+    /// state built while rendering the annotations of each annotated source (the annotations of
+    /// each line, the graphs used to lay them out, etc.).
+    ///
+    /// The scratch state of each annotated source is allocated from a monotonic arena, which starts
+    /// with a small buffer on the stack, obtains further memory from this resource, and is released
+    /// in one shot when the annotated source has been rendered. If this member is `nullptr`,
+    /// `std::pmr::get_default_resource()` is used. The rendered `StyledString`s themselves are
+    /// always allocated with the global allocator.
+    std::pmr::memory_resource* scratch_memory_resource = nullptr;
+    /// The minimum number of annotated sources (with at least one annotation) of a diagnostic
+    /// entry for them to be rendered in parallel. If this member is 0, the sources are always
+    /// rendered sequentially.
+    ///
+    /// In parallel mode, each source is rendered into a separate `StyledString` on one of at most
+    /// `parallel_source_thread_count` threads, and the results are spliced in the original order,
+    /// so the rendering result does not change. Each thread allocates its scratch memory from its
+    /// own pool instead of `scratch_memory_resource`. When rendering to an output stream or sink,
+    /// the lines of a source are written after the source has been rendered completely. An
+    /// exception thrown while rendering a source (e.g. by a deferred label) is rethrown on the
+    /// rendering thread once all the threads have stopped, as in the sequential mode.
+    std::size_t parallel_source_threshold = 0;
+    /// The maximum number of threads used to render the sources of a diagnostic entry in parallel,
+    /// including the rendering thread. If this member is 0, the number of hardware threads is used.
+    unsigned parallel_source_thread_count = 0;
+    /// The cache of rendered annotated sources shared by the renderers that use it. If this member
+    /// is not `nullptr`, the lines of each annotated source are looked up in the cache before they
+    /// are rendered, and are stored in the cache afterwards. See `RenderCache` for details.
+    ///
+    /// The cache must outlive all renderings that use it. When rendering to an output stream or
+    /// sink, the lines of a source are written after the source has been rendered completely.
+    RenderCache* render_cache = nullptr;
+    /// The maximum number of single-line annotations rendered on each line of source code. The
+    /// annotations of a line beyond this number are dropped, keeping the ones that are added to
+    /// the annotated source first (primary annotations are kept before secondary ones), and the
+    /// number of dropped annotations is reported in a "... N more annotations omitted" line after
+    /// the source. Multi-line annotations are never dropped. If this member is 0, the number of
+    /// annotations is not limited.
+    unsigned max_annotations_per_line = 0;
+    /// The maximum number of lines and bytes (excluding the escape sequences of styles) of the
+    /// rendering of a diagnostic, which bound the time spent on diagnostics with huge numbers of
+    /// annotations. If a member is 0, the corresponding size is not limited.
+    ///
+    /// The limits are checked before each line of source code is rendered. Once one of them is
+    /// reached, the remaining lines, sources and diagnostic entries are neither laid out nor
+    /// rendered, and a "... N more annotations omitted" line is rendered instead, where N is the
+    /// number of annotations that are not (completely) rendered. The rendering can thus exceed the
+    /// limits by the rendering of one line of source code and the trailing line.
+    ///
+    /// Since the sources are then rendered one by one, these limits disable the parallel rendering
+    /// of sources (see `parallel_source_threshold`), and a source found in `render_cache` is always
+    /// rendered completely.
+    std::size_t max_output_lines = 0;
+    std::size_t max_output_bytes = 0;
+    /// The observer notified of the phases and the counters of the layout of each annotated source,
+    /// which can be exported to a tracing system to find the inputs that are slow to render. See
+    /// `RenderObserver` for details. If this member is `nullptr`, nothing is reported.
+    ///
+    /// The observer must outlive all renderings that use it.
+    RenderObserver* render_observer = nullptr;
 
     /// Renders `diag` to a `StyledString` and returns the rendering result.
+    ///
+    /// `diag` is neither copied nor modified, so the same diagnostic can be rendered several times,
+    /// for example once for the terminal and once for a log file, even by several threads at once.
+    /// The lines of its annotated sources are located through their `const` lookups, whose results
+    /// are memoized in the scratch memory of the rendering (see
+    /// `AnnotatedSource::line_offset(unsigned, LineOffsetMemo&)`).
     template <class Level>
-    auto render_diag(Diag<Level> diag) const -> StyledString {
+    auto render_diag(Diag<Level> const& diag) const -> StyledString {
+        return render_diag_with<RuntimeConfig>(diag);
+    }
+
+    /// Renders `diag` to the output stream associated with `out`. The rendering style is specified
+    /// by `style_sheet`. As with the overload above, `diag` is left untouched.
+    template <class Level, style_sheet_for<Level> StyleSheet = PlainTextStyleSheet>
+    void render_diag(
+        std::ostream& out,
+        Diag<Level> const& diag,
+        StyleSheet style_sheet = {}
+    ) const {
+        render_diag_with<RuntimeConfig>(out, diag, style_sheet);
+    }
+
+    /// Renders `diag` to `sink`, one line per call to `sink.write()`. The rendering style is
+    /// specified by `style_sheet`, and styles are always rendered with ANSI escape sequences, so
+    /// `PlainTextStyleSheet` (the default) produces plain text. With a plain text style sheet (see
+    /// `plain_text_style_sheet`), the rendered lines are written without looking up any style, and
+    /// several complete lines may be written in one call. As with the overloads above, `diag` is
+    /// left untouched.
+    template <class Level, class Sink, style_sheet_for<Level> StyleSheet = PlainTextStyleSheet>
+        requires output_sink<Sink>
+    void render_diag(Sink& sink, Diag<Level> const& diag, StyleSheet style_sheet = {}) const {
+        render_diag_with<RuntimeConfig>(sink, diag, style_sheet);
+    }
+
+    /// Renders every diagnostic in `diags` to a `StyledString`, and returns the rendering results
+    /// in the order of `diags`. Each result is the same as the one returned by `render_diag()`.
+    ///
+    /// The diagnostics are rendered in parallel on at most `thread_count` threads, including the
+    /// calling thread, and each diagnostic is rendered entirely by one thread. If `thread_count` is
+    /// 0, the number of hardware threads is used. Every thread allocates its scratch memory from
+    /// its own pool, which replaces `scratch_memory_resource` and is released when this function
+    /// returns.
+    ///
+    /// Since rendering leaves the diagnostics untouched, a diagnostic may occur more than once in
+    /// `diags`, and may be rendered by other threads at the same time.
+    ///
+    /// If the rendering of a diagnostic throws an exception (e.g. a deferred message or label, or
+    /// an allocation fails), the remaining diagnostics are not rendered, and the exception is
+    /// rethrown on the calling thread after all threads have stopped.
+    template <detail::diag_range Diags>
+    auto render_batch(Diags const& diags, unsigned thread_count = 0) const
+        -> std::vector<StyledString> {
+        return render_batch_with<RuntimeConfig>(diags, thread_count);
+    }
+
+    /// Renders every diagnostic in `diags` to `sink`, with the styles specified by `style_sheet`.
+    /// The output is the same as the one produced by calling the `render_diag()` overload for sinks
+    /// for each diagnostic in order.
+    ///
+    /// The diagnostics are rendered in parallel as with the overload above. The renderings are kept
+    /// in memory until all diagnostics have been rendered, and are then written to `sink` by the
+    /// calling thread, with one call to `sink.write()` per diagnostic. If an exception is thrown as
+    /// with the overload above, nothing is written. Note that `style_sheet` is called from several
+    /// threads at the same time.
+    template <
+        class Sink,
+        detail::diag_range Diags,
+        style_sheet_for<detail::diag_range_level_t<Diags>> StyleSheet = PlainTextStyleSheet>
+        requires output_sink<Sink>
+    void render_batch(
+        Sink& sink,
+        Diags const& diags,
+        unsigned thread_count = 0,
+        StyleSheet style_sheet = {}
+    ) const {
+        render_batch_with<RuntimeConfig>(sink, diags, thread_count, style_sheet);
+    }
+
+    /// Appends the rendering of a single `DiagEntry` to the end of a `StyledString`.
+    template <class Level, class Derived>
+    void render_diag_entry(
+        StyledString& render_target,
+        detail::DiagEntryImpl<Level, Derived> const& diag_entry,
+        unsigned max_line_num_len,
+        bool is_secondary
+    ) const {
+        render_diag_entry_with<RuntimeConfig>(
+            render_target,
+            diag_entry,
+            max_line_num_len,
+            is_secondary
+        );
+    }
+
+    /// Renders a single `DiagEntry` to the output stream associated with `out`. The rendering style
+    /// is specified by `style_sheet`.
+    ///
+    /// The rendering is streamed: the rendered lines are written to `out` as soon as each line of
+    /// source code and its annotations have been rendered, so the memory used by the renderer is
+    /// bounded by the rendering of a single source line rather than of the whole entry.
+    template <class Level, class Derived, style_sheet_for<Level> StyleSheet>
+    void render_diag_entry(
+        std::ostream& out,
+        detail::DiagEntryImpl<Level, Derived> const& diag_entry,
+        unsigned max_line_num_len,
+        bool is_secondary,
+        StyleSheet const& style_sheet
+    ) const {
+        render_diag_entry_with<RuntimeConfig>(
+            out,
+            diag_entry,
+            max_line_num_len,
+            is_secondary,
+            style_sheet
+        );
+    }
+
+    /// Renders a single `DiagEntry` to `sink`. The rendering is streamed as with the overload
+    /// above, and the styles are rendered as with the `render_diag()` overload for sinks.
+    template <class Level, class Derived, output_sink Sink, style_sheet_for<Level> StyleSheet>
+    void render_diag_entry(
+        Sink& sink,
+        detail::DiagEntryImpl<Level, Derived> const& diag_entry,
+        unsigned max_line_num_len,
+        bool is_secondary,
+        StyleSheet const& style_sheet
+    ) const {
+        render_diag_entry_with<RuntimeConfig>(
+            sink,
+            diag_entry,
+            max_line_num_len,
+            is_secondary,
+            style_sheet
+        );
+    }
+
+protected:
+    /// Indicates that the options are read from the members of the renderer, rather than being
+    /// fixed by the configuration of `BasicHumanRenderer`.
+    struct RuntimeConfig { };
+
+    /// The overloads of `render_diag_with()`, `render_batch_with()` and `render_diag_entry_with()`
+    /// implement the public overloads of `render_diag()`, `render_batch()` and
+    /// `render_diag_entry()` with the same parameters, which call them with `RuntimeConfig`.
+    /// `BasicHumanRenderer` calls them with its `Config` instead, whose options replace the members
+    /// of the renderer, so that only the rendering for these options is instantiated.
+    template <class Config, class Level>
+    auto render_diag_with(Diag<Level> const& diag) const -> StyledString {
         StyledString render_target;
-        unsigned const max_line_num_len = compute_max_line_num_len(diag);
+        unsigned const max_line_num_len = compute_max_line_num_len<Config>(diag);
+        detail::OutputBudget budget { .pending_annotation_num = count_annotations(diag) };
 
         // Render the primary diagnostic entry.
-        render_diag_entry(
+        render_diag_entry<Config>(
             render_target,
             diag.primary_diag_entry(),
             max_line_num_len,
-            /*is_secondary=*/false
+            /*is_secondary=*/false,
+            budget,
+            {}
         );
 
-        // Render all secondary diagnostic entries.
-        for (DiagEntry<Level>& entry : diag.secondary_diag_entries()) {
+        // Render all secondary diagnostic entries, unless the output limits have been reached.
+        for (DiagEntry<Level> const& entry : diag.secondary_diag_entries()) {
+            if (budget.exhausted) {
+                break;
+            }
+
             render_target.append_newline();
-            render_diag_entry(render_target, entry, max_line_num_len, /*is_secondary=*/true);
+            render_diag_entry<Config>(
+                render_target,
+                entry,
+                max_line_num_len,
+                /*is_secondary=*/true,
+                budget,
+                {}
+            );
         }
 
         return render_target;
     }
 
-    /// Renders `diag` to the output stream associated with `out`. The rendering style is specified
-    /// by `style_sheet`.
-    template <class Level, style_sheet_for<Level> StyleSheet = PlainTextStyleSheet>
-    void render_diag(std::ostream& out, Diag<Level> diag, StyleSheet style_sheet = {}) const {
-        unsigned const max_line_num_len = compute_max_line_num_len(diag);
+    template <class Config, class Level, style_sheet_for<Level> StyleSheet = PlainTextStyleSheet>
+    void render_diag_with(
+        std::ostream& out,
+        Diag<Level> const& diag,
+        StyleSheet style_sheet = {}
+    ) const {
+        StyledLineWriter writer(out);
+        render_diag<Config>(writer, diag, style_sheet);
+    }
+
+    template <
+        class Config,
+        class Level,
+        class Sink,
+        style_sheet_for<Level> StyleSheet = PlainTextStyleSheet>
+        requires output_sink<Sink>
+    void render_diag_with(Sink& sink, Diag<Level> const& diag, StyleSheet style_sheet = {}) const {
+        StyledLineWriter writer(sink, /*use_escape_sequences=*/true);
+        render_diag<Config>(writer, diag, style_sheet);
+    }
+
+    template <class Config, detail::diag_range Diags>
+    auto render_batch_with(Diags const& diags, unsigned thread_count = 0) const
+        -> std::vector<StyledString> {
+        auto const first = std::ranges::begin(diags);
+        std::vector<StyledString> results(static_cast<std::size_t>(std::ranges::distance(diags)));
+
+        detail::parallel_for(
+            results.size(),
+            thread_count,
+            [&](std::size_t index, std::pmr::memory_resource* scratch) {
+                HumanRenderer renderer = *this;
+                renderer.scratch_memory_resource = scratch;
+                results[index] =
+                    renderer.render_diag_with<Config>(first[static_cast<std::ptrdiff_t>(index)]);
+            }
+        );
+
+        return results;
+    }
+
+    template <
+        class Config,
+        class Sink,
+        detail::diag_range Diags,
+        style_sheet_for<detail::diag_range_level_t<Diags>> StyleSheet = PlainTextStyleSheet>
+        requires output_sink<Sink>
+    void render_batch_with(
+        Sink& sink,
+        Diags const& diags,
+        unsigned thread_count = 0,
+        StyleSheet style_sheet = {}
+    ) const {
+        auto const first = std::ranges::begin(diags);
+        std::vector<std::string> results(static_cast<std::size_t>(std::ranges::distance(diags)));
+
+        detail::parallel_for(
+            results.size(),
+            thread_count,
+            [&](std::size_t index, std::pmr::memory_resource* scratch) {
+                HumanRenderer renderer = *this;
+                renderer.scratch_memory_resource = scratch;
+                StringSink result_sink(results[index]);
+                renderer.render_diag_with<Config>(
+                    result_sink,
+                    first[static_cast<std::ptrdiff_t>(index)],
+                    style_sheet
+                );
+            }
+        );
+
+        for (std::string const& result : results) {
+            sink.write(result);
+        }
+    }
+
+    template <class Config, class Level, class Derived>
+    void render_diag_entry_with(
+        StyledString& render_target,
+        detail::DiagEntryImpl<Level, Derived> const& diag_entry,
+        unsigned max_line_num_len,
+        bool is_secondary
+    ) const {
+        detail::OutputBudget budget {
+            .measured_size = render_target.content().size(),
+            .pending_annotation_num = count_annotations(diag_entry.associated_sources()),
+        };
+        render_diag_entry<Config>(
+            render_target,
+            diag_entry,
+            max_line_num_len,
+            is_secondary,
+            budget,
+            {}
+        );
+    }
+
+    template <class Config, class Level, class Derived, style_sheet_for<Level> StyleSheet>
+    void render_diag_entry_with(
+        std::ostream& out,
+        detail::DiagEntryImpl<Level, Derived> const& diag_entry,
+        unsigned max_line_num_len,
+        bool is_secondary,
+        StyleSheet const& style_sheet
+    ) const {
+        StyledLineWriter writer(out);
+        detail::OutputBudget budget {
+            .pending_annotation_num = count_annotations(diag_entry.associated_sources()),
+        };
+        render_diag_entry<Config>(
+            writer,
+            diag_entry,
+            max_line_num_len,
+            is_secondary,
+            budget,
+            style_sheet
+        );
+    }
+
+    template <
+        class Config,
+        class Level,
+        class Derived,
+        output_sink Sink,
+        style_sheet_for<Level> StyleSheet>
+    void render_diag_entry_with(
+        Sink& sink,
+        detail::DiagEntryImpl<Level, Derived> const& diag_entry,
+        unsigned max_line_num_len,
+        bool is_secondary,
+        StyleSheet const& style_sheet
+    ) const {
+        StyledLineWriter writer(sink, /*use_escape_sequences=*/true);
+        detail::OutputBudget budget {
+            .pending_annotation_num = count_annotations(diag_entry.associated_sources()),
+        };
+        render_diag_entry<Config>(
+            writer,
+            diag_entry,
+            max_line_num_len,
+            is_secondary,
+            budget,
+            style_sheet
+        );
+    }
+
+private:
+    /// Renders `diag` with `writer`.
+    template <class Config, class Level, style_sheet_for<Level> StyleSheet>
+    void render_diag(
+        StyledLineWriter& writer,
+        Diag<Level> const& diag,
+        StyleSheet const& style_sheet
+    ) const {
+        unsigned const max_line_num_len = compute_max_line_num_len<Config>(diag);
+        detail::OutputBudget budget { .pending_annotation_num = count_annotations(diag) };
 
         // Render the primary diagnostic entry.
-        render_diag_entry(
-            out,
+        render_diag_entry<Config>(
+            writer,
             diag.primary_diag_entry(),
             max_line_num_len,
             /*is_secondary=*/false,
+            budget,
             style_sheet
         );
 
-        // Render all secondary diagnostic entries.
-        for (DiagEntry<Level>& entry : diag.secondary_diag_entries()) {
-            render_diag_entry(out, entry, max_line_num_len, /*is_secondary=*/true, style_sheet);
+        // Render all secondary diagnostic entries, unless the output limits have been reached.
+        for (DiagEntry<Level> const& entry : diag.secondary_diag_entries()) {
+            if (budget.exhausted) {
+                break;
+            }
+
+            render_diag_entry<Config>(
+                writer,
+                entry,
+                max_line_num_len,
+                /*is_secondary=*/true,
+                budget,
+                style_sheet
+            );
         }
     }
 
-    /// Appends the rendering of a single `DiagEntry` to the end of a `StyledString`.
-    template <class Level, class Derived>
+    /// Renders a single `DiagEntry` with `writer`, streaming the complete lines. The size of the
+    /// rendering is counted in `budget`.
+    template <class Config, class Level, class Derived, style_sheet_for<Level> StyleSheet>
+    void render_diag_entry(
+        StyledLineWriter& writer,
+        detail::DiagEntryImpl<Level, Derived> const& diag_entry,
+        unsigned max_line_num_len,
+        bool is_secondary,
+        detail::OutputBudget& budget,
+        StyleSheet const& style_sheet
+    ) const {
+        StyledString render_target;
+        budget.measured_size = 0;
+
+        // Without escape sequences (for example, when writing to a file), the rendered text is
+        // written as it is. For plain text style sheets, this is decided at compile time, and the
+        // styled path is not even instantiated.
+        if constexpr (!plain_text_style_sheet<StyleSheet>) {
+            if (writer.is_colored()) {
+                render_styled_diag_entry<Config>(
+                    writer,
+                    render_target,
+                    diag_entry,
+                    max_line_num_len,
+                    is_secondary,
+                    budget,
+                    style_sheet
+                );
+                return;
+            }
+        }
+
+        render_diag_entry<Config>(
+            render_target,
+            diag_entry,
+            max_line_num_len,
+            is_secondary,
+            budget,
+            [&](StyledString& rendered) { flush_complete_plain_lines(writer, rendered); }
+        );
+
+        // Write the remaining lines, each of which is terminated by a newline character.
+        if (!render_target.content().empty()) {
+            if (render_target.content().back() != '\n') {
+                render_target.append_newline();
+            }
+            writer.write_plain_lines(render_target.content());
+        }
+    }
+
+    /// Renders a single `DiagEntry` to `render_target` as `render_diag_entry()` does, and writes
+    /// the completed lines with `writer`, rendering their styles with `style_sheet`.
+    template <class Config, class Level, class Derived, style_sheet_for<Level> StyleSheet>
+    void render_styled_diag_entry(
+        StyledLineWriter& writer,
+        StyledString& render_target,
+        detail::DiagEntryImpl<Level, Derived> const& diag_entry,
+        unsigned max_line_num_len,
+        bool is_secondary,
+        detail::OutputBudget& budget,
+        StyleSheet const& style_sheet
+    ) const {
+        Level const& level = diag_entry.level();
+
+        // Since the level is the same for the whole entry, the `StyleSpec` of each style only needs
+        // to be resolved through the style sheet once. `Style::value()` fits in a `std::int8_t`, so
+        // the resolved specs are cached in a table indexed by its bit pattern.
+        std::array<StyleSpec, 1u << CHAR_BIT> resolved_specs {};
+        std::bitset<1u << CHAR_BIT> is_resolved;
+        auto const resolve_spec = [&](Style style) -> StyleSpec {
+            // For `Style::Default`, the default style is always used.
+            if (style == Style::Default) {
+                return {};
+            }
+
+            auto const index = static_cast<std::uint8_t>(style.value());
+            if (!is_resolved[index]) {
+                resolved_specs[index] =
+                    static_cast<StyleSpec>(std::invoke(style_sheet, style, level));
+                is_resolved[index] = true;
+            }
+            return resolved_specs[index];
+        };
+
+        // Render the diagnostic entry to `render_target`, writing the completed lines to the
+        // output stream whenever the renderer reaches a point where they will not change anymore.
+        render_diag_entry<Config>(
+            render_target,
+            diag_entry,
+            max_line_num_len,
+            is_secondary,
+            budget,
+            [&](StyledString& rendered) { flush_complete_lines(writer, rendered, resolve_spec); }
+        );
+
+        // Render the remaining lines to the output stream.
+        for (StyledLine const& line : render_target.styled_lines()) {
+            render_styled_line(writer, line, resolve_spec);
+        }
+    }
+
+    /// Implements the rendering of a single `DiagEntry` into `render_target`, whose size is counted
+    /// in `budget`. If `flush_lines` is not empty, it is called with `render_target` whenever all
+    /// the lines in `render_target` except possibly the last one are complete, so that they can be
+    /// consumed and removed.
+    template <class Config, class Level, class Derived>
     void render_diag_entry(
         StyledString& render_target,
-        detail::DiagEntryImpl<Level, Derived>& diag_entry,
+        detail::DiagEntryImpl<Level, Derived> const& diag_entry,
         unsigned max_line_num_len,
-        bool is_secondary
+        bool is_secondary,
+        detail::OutputBudget& budget,
+        std::function<void(StyledString&)> const& flush_lines
     ) const {
         // If all associated source codes of the current diagnostic entry have no annotations, or if
         // it is not associated with any source code (if `diag_entry.associated_source()` is empty,
@@ -198,16 +757,30 @@ public:
 
         // For short messages, we first need to render the file name and line/column numbers of the
         // diagnostic information.
-        if (short_message) {
+        if constexpr (std::same_as<Config, RuntimeConfig>) {
+            if (short_message) {
+                title_message_indentation = render_file_line_col_short_message(
+                    render_target,
+                    diag_entry.associated_sources()
+                );
+            }
+        } else if constexpr (Config::short_message) {
             title_message_indentation =
                 render_file_line_col_short_message(render_target, diag_entry.associated_sources());
         }
 
+        // A deferred message is only produced now that the entry is rendered.
+        StyledString deferred_message;
+        if (diag_entry.deferred_diag_message()) {
+            deferred_message = diag_entry.deferred_diag_message()();
+        }
+
         render_title_message(
             render_target,
             detail::level_display_string(diag_entry.level()),
             diag_entry.error_code(),
-            diag_entry.diag_message(),
+            diag_entry.deferred_diag_message() ? deferred_message.view()
+                                               : diag_entry.diag_message(),
             max_line_num_len,
             title_message_indentation,
             is_secondary,
@@ -217,54 +790,118 @@ public:
         );
 
         // For short messages, we have now completed the rendering.
-        if (short_message) {
+        if constexpr (std::same_as<Config, RuntimeConfig>) {
+            if (short_message) {
+                return;
+            }
+
+            render_annotated_sources(
+                render_target,
+                diag_entry.associated_sources(),
+                max_line_num_len,
+                budget,
+                flush_lines
+            );
+        } else if constexpr (Config::short_message) {
             return;
+        } else {
+            SpecializedRenderer<
+                Config::label_position,
+                Config::line_num_alignment,
+                Config::display_tab_width != 0>::
+                render_annotated_sources(
+                    *this,
+                    render_target,
+                    diag_entry.associated_sources(),
+                    max_line_num_len,
+                    budget,
+                    flush_lines
+                );
+        }
+        budget.measure(render_target);
+    }
+
+    /// Renders a single line of styled parts with `writer`, followed by a newline character.
+    /// `resolve_spec` maps the style of each part to the `StyleSpec` used to render it.
+    template <class ResolveSpec>
+    static void render_styled_line(
+        StyledLineWriter& writer,
+        StyledLine const& line,
+        ResolveSpec const& resolve_spec
+    ) {
+        for (StyledStringViewPart const part : line) {
+            writer.append(part.content, resolve_spec(part.style));
         }
 
-        render_annotated_sources(render_target, diag_entry.associated_sources(), max_line_num_len);
+        writer.end_line();
     }
 
-    /// Renders a single `DiagEntry` to the output stream associated with `out`. The rendering style
-    /// is specified by `style_sheet`.
-    template <class Level, class Derived, style_sheet_for<Level> StyleSheet>
-    void render_diag_entry(
-        std::ostream& out,
-        detail::DiagEntryImpl<Level, Derived>& diag_entry,
-        unsigned max_line_num_len,
-        bool is_secondary,
-        StyleSheet const& style_sheet
-    ) const {
-        StyledString render_target;
-        // Render the diagnostic entry to `render_target`.
-        render_diag_entry(render_target, diag_entry, max_line_num_len, is_secondary);
-
-        // Render the styled string to the output stream.
-        for (std::vector<StyledStringViewPart> const& line : render_target.styled_line_parts()) {
-            for (StyledStringViewPart const& part : line) {
-                // The style used to render `part`. For `Style::Default`, the default style is
-                // always used.
-                StyleSpec const spec = part.style == Style::Default
-                    ? StyleSpec()
-                    : static_cast<StyleSpec>(
-                          std::invoke(style_sheet, part.style, diag_entry.level())
-                      );
-
-                spec.render_string(out, part.content);
+    /// Renders the complete lines of `render_target` (i.e. all characters up to and including the
+    /// last newline character) with `writer`, and removes them from `render_target`. The incomplete
+    /// last line, if any, is kept in `render_target`.
+    template <class ResolveSpec>
+    static void flush_complete_lines(
+        StyledLineWriter& writer,
+        StyledString& render_target,
+        ResolveSpec const& resolve_spec
+    ) {
+        std::size_t const last_newline = render_target.content().rfind('\n');
+        if (last_newline == std::string::npos) {
+            return;
+        }
+
+        // `styled_lines()` yields the complete lines first. It yields one more line only if there
+        // are characters after the last newline character, which we stop before.
+        for (StyledLine const& line : render_target.styled_lines()) {
+            if (line.content().data() > render_target.content().data() + last_newline) {
+                break;
             }
+            render_styled_line(writer, line, resolve_spec);
+        }
 
-            out << '\n';
+        render_target.remove_prefix(last_newline + 1);
+    }
+
+    /// Writes the complete lines of `render_target` with `writer` as plain text in a single call,
+    /// and removes them from `render_target`, as `flush_complete_lines()` does for styled text.
+    static void flush_complete_plain_lines(StyledLineWriter& writer, StyledString& render_target) {
+        std::size_t const last_newline = render_target.content().rfind('\n');
+        if (last_newline == std::string::npos) {
+            return;
         }
+
+        writer.write_plain_lines(
+            std::string_view(render_target.content()).substr(0, last_newline + 1)
+        );
+        render_target.remove_prefix(last_newline + 1);
+    }
+
+    /// Counts the annotations of all annotated sources in `sources`.
+    static auto count_annotations(std::vector<AnnotatedSource> const& sources) -> std::size_t;
+
+    /// Counts the annotations of all annotated sources of all diagnostic entries of `diag`.
+    template <class Level>
+    static auto count_annotations(Diag<Level> const& diag) -> std::size_t {
+        std::size_t result = count_annotations(diag.primary_diag_entry().associated_sources());
+        for (DiagEntry<Level> const& entry : diag.secondary_diag_entries()) {
+            result += count_annotations(entry.associated_sources());
+        }
+        return result;
     }
 
-private:
     /// Calculates the maximum space required to display all annotated line numbers contained in
     /// `source`.
     auto compute_max_line_num_len(AnnotatedSource const& source) const -> unsigned;
 
-    /// Calculates the maximum space required to display the line numbers for rendering `diag`.
-    template <class Level>
+    /// Calculates the maximum space required to display the line numbers for rendering `diag`
+    /// with `Config`.
+    template <class Config, class Level>
     auto compute_max_line_num_len(Diag<Level> const& diag) const -> unsigned {
-        if (ui_testing) {
+        if constexpr (std::same_as<Config, RuntimeConfig>) {
+            if (ui_testing) {
+                return anonymized_line_num.size();
+            }
+        } else if constexpr (Config::ui_testing) {
             return anonymized_line_num.size();
         }
 
@@ -335,11 +972,146 @@ private:
         std::vector<AnnotatedSource> const& sources
     ) -> unsigned;
 
+    /// Renders all annotated sources in `sources`, until the output limits tracked by `budget` are
+    /// reached. If `flush_lines` is not empty, it is called with `render_target` after each
+    /// rendered line of source code and its annotations.
+    ///
+    /// The rendering is delegated to the specialization of `SpecializedRenderer` for the options of
+    /// the renderer.
     void render_annotated_sources(
         StyledString& render_target,
-        std::vector<AnnotatedSource>& sources,
-        unsigned max_line_num_len
+        std::vector<AnnotatedSource> const& sources,
+        unsigned max_line_num_len,
+        detail::OutputBudget& budget,
+        std::function<void(StyledString&)> const& flush_lines
     ) const;
+
+    /// Renders annotated sources as `render_annotated_sources()` does, with the layout and the
+    /// rendering of the lines specialized on the label position, the line number alignment and
+    /// whether tabs are expanded (i.e. `display_tab_width` is not 0). The corresponding members of
+    /// `renderer` are ignored. All specializations are explicitly instantiated in the source file.
+    template <LabelPosition label_position, LineNumAlignment line_num_alignment, bool expands_tabs>
+    struct SpecializedRenderer {
+        static void render_annotated_sources(
+            HumanRenderer const& renderer,
+            StyledString& render_target,
+            std::vector<AnnotatedSource> const& sources,
+            unsigned max_line_num_len,
+            detail::OutputBudget& budget,
+            std::function<void(StyledString&)> const& flush_lines
+        );
+    };
+};
+
+/// The default configuration of `BasicHumanRenderer`, which fixes the options to the default
+/// values of `HumanRenderer`. A configuration can derive from it and redefine only the options that
+/// differ.
+struct DefaultHumanRendererConfig {
+    static constexpr bool short_message = false;
+    static constexpr bool ui_testing = false;
+    static constexpr std::uint8_t display_tab_width = 4;
+    static constexpr HumanRenderer::LabelPosition label_position = HumanRenderer::Left;
+    static constexpr HumanRenderer::LineNumAlignment line_num_alignment = HumanRenderer::AlignRight;
+};
+
+/// Specifies that `Config` fixes the options of `BasicHumanRenderer` with constants.
+template <class Config>
+concept human_renderer_config = requires {
+    { std::bool_constant<Config::short_message>() };
+    { std::bool_constant<Config::ui_testing>() };
+    { std::integral_constant<std::uint8_t, Config::display_tab_width>() };
+    { std::integral_constant<HumanRenderer::LabelPosition, Config::label_position>() };
+    { std::integral_constant<HumanRenderer::LineNumAlignment, Config::line_num_alignment>() };
+};
+
+/// A `HumanRenderer` whose `short_message`, `ui_testing`, `display_tab_width`, `label_position` and
+/// `line_num_alignment` options are fixed at compile time by `Config`, for programs that use one
+/// configuration. These options are `static constexpr` members, while all the other options and
+/// the rendering functions are the same as those of `HumanRenderer`, which remains the renderer
+/// whose options are all configurable at run time.
+///
+/// The rendering functions are instantiated for the options of `Config`: the branches on
+/// `short_message` and `ui_testing` are resolved at compile time, and the annotated sources are
+/// rendered by the specialization of the layout and the rendering of the lines for
+/// `label_position`, `line_num_alignment` and whether tabs are expanded, without selecting it at
+/// run time. The other options, such as the output limits, are still checked at run time.
+///
+/// ```
+/// struct Config : ants::DefaultHumanRendererConfig {
+///     static constexpr auto label_position = ants::HumanRenderer::Right;
+/// };
+/// ants::BasicHumanRenderer<Config> const renderer;
+/// ```
+template <human_renderer_config Config = DefaultHumanRendererConfig>
+class BasicHumanRenderer : private HumanRenderer {
+public:
+    using config_type = Config;
+
+    using LabelPosition = HumanRenderer::LabelPosition;
+    using LabelPlacement = HumanRenderer::LabelPlacement;
+    using LineNumAlignment = HumanRenderer::LineNumAlignment;
+    using enum HumanRenderer::LabelPosition;
+    using enum HumanRenderer::LabelPlacement;
+    using enum HumanRenderer::LineNumAlignment;
+
+    static constexpr bool short_message = Config::short_message;
+    static constexpr bool ui_testing = Config::ui_testing;
+    static constexpr std::uint8_t display_tab_width = Config::display_tab_width;
+    static constexpr LabelPosition label_position = Config::label_position;
+    static constexpr LineNumAlignment line_num_alignment = Config::line_num_alignment;
+
+    BasicHumanRenderer() {
+        HumanRenderer::short_message = short_message;
+        HumanRenderer::ui_testing = ui_testing;
+        HumanRenderer::display_tab_width = display_tab_width;
+        HumanRenderer::label_position = label_position;
+        HumanRenderer::line_num_alignment = line_num_alignment;
+    }
+
+    using HumanRenderer::default_column_width;
+
+    using HumanRenderer::anonymized_line_num;
+    using HumanRenderer::diagnostic_width;
+    using HumanRenderer::label_placement;
+    using HumanRenderer::max_annotations_per_line;
+    using HumanRenderer::max_multiline_annotation_line_num;
+    using HumanRenderer::max_output_bytes;
+    using HumanRenderer::max_output_lines;
+    using HumanRenderer::max_unannotated_line_num;
+    using HumanRenderer::parallel_source_thread_count;
+    using HumanRenderer::parallel_source_threshold;
+    using HumanRenderer::primary_underline;
+    using HumanRenderer::render_cache;
+    using HumanRenderer::render_observer;
+    using HumanRenderer::scratch_memory_resource;
+    using HumanRenderer::secondary_underline;
+
+    /// Returns the renderer as a `HumanRenderer`, e.g. to pass it to code that accepts any
+    /// renderer. The fixed options cannot be changed through the result.
+    auto as_human_renderer() const -> HumanRenderer const& {
+        return *this;
+    }
+
+    /// Same as `HumanRenderer::render_diag()`.
+    template <class... Args>
+    auto render_diag(Args&&... args) const
+        -> decltype(this->template render_diag_with<Config>(std::forward<Args>(args)...)) {
+        return this->template render_diag_with<Config>(std::forward<Args>(args)...);
+    }
+
+    /// Same as `HumanRenderer::render_batch()`.
+    template <class... Args>
+    auto render_batch(Args&&... args) const
+        -> decltype(this->template render_batch_with<Config>(std::forward<Args>(args)...)) {
+        return this->template render_batch_with<Config>(std::forward<Args>(args)...);
+    }
+
+    /// Same as `HumanRenderer::render_diag_entry()`.
+    template <class... Args>
+    auto render_diag_entry(Args&&... args) const
+        -> decltype(this->template render_diag_entry_with<Config>(std::forward<Args>(args)...)) {
+        return this->template render_diag_entry_with<Config>(std::forward<Args>(args)...);
+    }
 };
 }  // namespace ants
 
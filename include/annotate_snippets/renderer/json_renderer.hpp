@@ -0,0 +1,168 @@
+#ifndef ANNOTATE_SNIPPETS_RENDERER_JSON_RENDERER_HPP
+#define ANNOTATE_SNIPPETS_RENDERER_JSON_RENDERER_HPP
+
+#include "annotate_snippets/annotated_source.hpp"
+#include "annotate_snippets/detail/diag/diag_entry_impl.hpp"
+#include "annotate_snippets/detail/diag/level.hpp"
+#include "annotate_snippets/detail/styled_string_impl.hpp"
+#include "annotate_snippets/diag.hpp"
+#include "annotate_snippets/output_sink.hpp"
+#include "annotate_snippets/style.hpp"
+#include "annotate_snippets/styled_string.hpp"
+#include "annotate_snippets/styled_string_view.hpp"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace ants {
+namespace detail {
+/// Writes the pieces of a JSON document to an output sink as they are produced, without building
+/// the document in memory.
+class JsonWriter {
+public:
+    /// Creates a writer for `sink`. The writer refers to `sink`, so `sink` must outlive the writer.
+    template <output_sink Sink>
+    explicit JsonWriter(Sink& sink) :
+        sink_(&sink), write_([](void* sink, std::string_view str) {
+            static_cast<Sink*>(sink)->write(str);
+        }) { }
+
+    /// Writes `str` as it is.
+    void write_raw(std::string_view str) {
+        write_(sink_, str);
+    }
+
+    /// Writes `str` as a JSON string. The quotation marks, backslashes and control characters are
+    /// escaped, and the other characters (including valid UTF-8 sequences of non-ASCII characters)
+    /// are written as they are. Since `str` may come from arbitrary source files, each invalid
+    /// UTF-8 sequence (e.g. a truncated one, or a byte of another encoding) is replaced by
+    /// "\ufffd", so the output is always valid UTF-8.
+    void write_string(std::string_view str);
+
+    void write_number(std::size_t number);
+
+    /// Writes the text `content`, whose lines are `lines`, as an object with the members "text"
+    /// and, if `writes_styles` is `true`, "styles". "styles" is an array of the ranges of `content`
+    /// that are not in style `Style::Auto`, each as an object `{"beg":...,"end":...,"style":...}`
+    /// with byte offsets into `content`. Adjacent ranges with the same style are merged, even
+    /// across line breaks.
+    void write_styled_text(std::string_view content, StyledLineRange lines, bool writes_styles);
+
+    /// Writes `style` as a JSON value: the snake case name of a predefined style, or the number of
+    /// a user-defined style.
+    void write_style(Style style);
+
+private:
+    void* sink_;
+    void (*write_)(void*, std::string_view);
+};
+}  // namespace detail
+
+/// Renders diagnostics as JSON for tools such as IDEs and CI systems, which would otherwise parse
+/// the output of `HumanRenderer`.
+///
+/// The members of the diagnostics are written to the sink in a single pass as they are visited,
+/// without laying out the annotations or building any `StyledString` (except for deferred messages
+/// and labels, which are produced when they are reached). Each diagnostic is rendered as one line
+/// (JSON Lines), which is an object of the form
+///
+///     {"level":"error","code":"E0308","message":{"text":"mismatched types","styles":[]},
+///      "sources":[{"origin":"main.cpp","spans":[
+///         {"primary":true,"byte_beg":5,"byte_end":10,"line_beg":1,"col_beg":6,"line_end":1,
+///          "col_end":11,"label":{"text":"expected here","styles":[]}}]}],
+///      "children":[{"level":"note","code":null,"message":{...},"sources":[]}]}
+///
+/// where "code" is `null` if the entry has no error code, "children" holds the secondary diagnostic
+/// entries, and "label" is `null` if the span has no label. The primary spans of each source come
+/// before its secondary spans. Byte offsets are 0-based offsets into the code of the annotated
+/// source, and the end of a span is exclusive. Line numbers are counted from the first line number
+/// of the source, and columns are 1-based byte columns, as in the location rendered by
+/// `HumanRenderer`. See `detail::JsonWriter::write_styled_text()` for the format of texts.
+class JsonRenderer {
+public:
+    /// Indicates whether the styles of messages and labels are rendered. If `false`, the "styles"
+    /// members are omitted.
+    bool renders_styles = true;
+
+    /// Renders `diag` to a string and returns it. `diag` is left untouched, as with
+    /// `HumanRenderer::render_diag()`.
+    template <class Level>
+    auto render_diag(Diag<Level> const& diag) const -> std::string {
+        std::string result;
+        StringSink sink(result);
+        render_diag(sink, diag);
+        return result;
+    }
+
+    /// Renders `diag` to `sink`, followed by a newline character. The rendering is written in many
+    /// small pieces, so the sink should buffer its output (as `FdSink` and `StringSink` do).
+    template <class Level, output_sink Sink>
+    void render_diag(Sink& sink, Diag<Level> const& diag) const {
+        detail::JsonWriter writer(sink);
+        render_diag_entry(writer, diag.primary_diag_entry());
+        // The closing brace of the primary entry is written after its children.
+        writer.write_raw(",\"children\":[");
+        for (bool is_first = true; DiagEntry<Level> const& entry : diag.secondary_diag_entries()) {
+            if (!std::exchange(is_first, false)) {
+                writer.write_raw(",");
+            }
+            render_diag_entry(writer, entry);
+            writer.write_raw("}");
+        }
+        writer.write_raw("]}\n");
+    }
+
+private:
+    /// Writes `entry` as a JSON object, without the closing brace.
+    template <class Level, class Derived>
+    void render_diag_entry(
+        detail::JsonWriter& writer,
+        detail::DiagEntryImpl<Level, Derived> const& entry
+    ) const {
+        writer.write_raw("{\"level\":");
+        writer.write_string(detail::level_display_string(entry.level()));
+
+        writer.write_raw(",\"code\":");
+        if (entry.error_code().empty()) {
+            writer.write_raw("null");
+        } else {
+            writer.write_string(entry.error_code());
+        }
+
+        writer.write_raw(",\"message\":");
+        if (entry.deferred_diag_message()) {
+            StyledString const message = entry.deferred_diag_message()();
+            writer.write_styled_text(message.content(), message.styled_lines(), renders_styles);
+        } else {
+            StyledStringView const& message = entry.diag_message();
+            writer.write_styled_text(message.content(), message.styled_lines(), renders_styles);
+        }
+
+        writer.write_raw(",\"sources\":[");
+        for (bool is_first = true; AnnotatedSource const& source : entry.associated_sources()) {
+            if (!std::exchange(is_first, false)) {
+                writer.write_raw(",");
+            }
+            render_annotated_source(writer, source);
+        }
+        writer.write_raw("]");
+    }
+
+    /// Writes `source` as a JSON object.
+    void render_annotated_source(detail::JsonWriter& writer, AnnotatedSource const& source) const;
+
+    /// Writes `span` of `source` as a JSON object. The lines of `source` are located with
+    /// `line_offset_memo`, which is shared by all spans of `source`.
+    void render_labeled_span(
+        detail::JsonWriter& writer,
+        AnnotatedSource const& source,
+        AnnotatedSource::LineOffsetMemo& line_offset_memo,
+        LabeledSpan const& span,
+        bool is_primary
+    ) const;
+};
+}  // namespace ants
+
+#endif  // ANNOTATE_SNIPPETS_RENDERER_JSON_RENDERER_HPP
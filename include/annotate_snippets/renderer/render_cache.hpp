@@ -0,0 +1,86 @@
+#ifndef ANNOTATE_SNIPPETS_RENDERER_RENDER_CACHE_HPP
+#define ANNOTATE_SNIPPETS_RENDERER_RENDER_CACHE_HPP
+
+#include "annotate_snippets/styled_string.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace ants {
+/// A bounded cache of rendered annotated sources, which can be shared by several `HumanRenderer`s
+/// (see `HumanRenderer::render_cache`).
+///
+/// Each entry maps a key to the rendered block of an annotated source, i.e. its source lines and
+/// annotations without the preceding file name line. The key is built by the renderer from
+/// everything the block depends on: the content of the annotated lines (and the lines between
+/// them), the spans with their labels and styles, the line numbers, and the renderer options that
+/// affect the layout. So a diagnostic that reports the same spans on the same region of a file as
+/// an earlier one is rendered by copying the cached block, without laying out the annotations
+/// again.
+///
+/// When the cache is full, the least recently used entry is evicted. All member functions are
+/// thread-safe.
+class RenderCache {
+public:
+    /// Creates a cache that holds at most `capacity` entries. If `capacity` is 0, nothing is
+    /// stored.
+    explicit RenderCache(std::size_t capacity) : capacity_(capacity) { }
+
+    RenderCache(RenderCache const&) = delete;
+    auto operator=(RenderCache const&) -> RenderCache& = delete;
+
+    auto capacity() const -> std::size_t {
+        return capacity_;
+    }
+
+    /// Returns the number of entries currently stored in the cache.
+    auto size() const -> std::size_t;
+
+    /// Returns the number of calls to `find()` with a key that was in the cache.
+    auto hit_count() const -> std::size_t {
+        return hit_count_.load(std::memory_order_relaxed);
+    }
+
+    /// Returns the number of calls to `find()` with a key that was not in the cache.
+    auto miss_count() const -> std::size_t {
+        return miss_count_.load(std::memory_order_relaxed);
+    }
+
+    /// Returns the block stored with `key` and marks it as the most recently used entry, or
+    /// `nullptr` if there is no such entry.
+    auto find(std::string_view key) -> std::shared_ptr<StyledString const>;
+
+    /// Stores `block` with `key` as the most recently used entry, evicting the least recently used
+    /// entry if the cache is full, and returns the stored block. If there is already an entry with
+    /// `key` (for example, because another thread has rendered the same block at the same time),
+    /// the existing block is kept and returned instead.
+    auto insert(std::string key, StyledString block) -> std::shared_ptr<StyledString const>;
+
+    /// Removes all entries. The hit and miss counts are not reset.
+    void clear();
+
+private:
+    struct Entry {
+        std::string key;
+        std::shared_ptr<StyledString const> block;
+    };
+
+    std::size_t capacity_;
+    mutable std::mutex mutex_;
+    /// The entries, ordered from the most recently used to the least recently used one.
+    std::list<Entry> entries_;
+    /// Maps the keys to the entries in `entries_`. The keys refer to the strings in `entries_`,
+    /// which are never relocated by `std::list`.
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index_;
+    std::atomic<std::size_t> hit_count_ = 0;
+    std::atomic<std::size_t> miss_count_ = 0;
+};
+}  // namespace ants
+
+#endif  // ANNOTATE_SNIPPETS_RENDERER_RENDER_CACHE_HPP
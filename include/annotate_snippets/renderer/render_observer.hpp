@@ -0,0 +1,93 @@
+#ifndef ANNOTATE_SNIPPETS_RENDERER_RENDER_OBSERVER_HPP
+#define ANNOTATE_SNIPPETS_RENDERER_RENDER_OBSERVER_HPP
+
+#include "annotate_snippets/annotated_source.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace ants {
+/// The phases in which `HumanRenderer` lays out and renders the annotations of an annotated
+/// source, in the order in which they run.
+enum class RenderPhase : std::uint8_t {
+    /// Assigns the spans to the lines they start on.
+    AddSpans,
+    /// Assigns depths to the multi-line annotations, and splits them into the lines they cover.
+    HandleMultilineSpans,
+    /// Decides which lines without annotations are rendered.
+    HandleUnannotatedLines,
+    /// Decides which lines of the multi-line annotations are omitted.
+    FoldMultilineAnnotations,
+    /// Computes the display columns of the source code lines and the annotations.
+    ComputeDisplayColumns,
+    /// Places the labels of the annotations of one line. Runs once for each rendered line.
+    ComputeLabelLinePositions,
+    /// Draws one line of source code with its annotations. Runs once for each rendered line.
+    RenderLine,
+};
+
+/// The counters of the rendering of an annotated source, reported by
+/// `RenderObserver::on_source_rendered()`.
+struct RenderStats {
+    /// The number of primary and secondary spans of the annotated source.
+    std::size_t span_num = 0;
+    /// The number of lines of source code that have at least one annotation.
+    std::size_t annotated_line_num = 0;
+    /// The number of depths assigned to the multi-line annotations.
+    unsigned multiline_depth_num = 0;
+    /// The total number of edges of the graphs built to place the labels. The edges are never
+    /// built with `HumanRenderer::SweepPlacement`, so the number is 0 in that case.
+    std::size_t graph_edge_num = 0;
+    /// The number of bytes of the source code lines that are laid out. Omitted lines and the parts
+    /// of long lines cut off by `HumanRenderer::diagnostic_width` are not counted.
+    std::size_t scanned_byte_num = 0;
+    /// The number of bytes (excluding the escape sequences of styles) rendered for the annotated
+    /// lines of the source, including the "... N more annotations omitted" line.
+    std::size_t emitted_byte_num = 0;
+};
+
+/// Receives the timestamps of the phases and the counters of the layout of each annotated source,
+/// so that slow renderings can be traced (see `HumanRenderer::render_observer`). All member
+/// functions do nothing by default.
+///
+/// The functions are called on the rendering thread. If the sources or the diagnostics are
+/// rendered in parallel, they are called concurrently from several threads, and the observer must
+/// synchronize itself. The hooks are only compiled into the library if the CMake option
+/// `ANNOTATE_SNIPPETS_ENABLE_TRACING` is on (it is off by default). Otherwise, the observer is
+/// never called.
+class RenderObserver {
+public:
+    using clock = std::chrono::steady_clock;
+
+    RenderObserver() = default;
+    RenderObserver(RenderObserver const&) = default;
+    RenderObserver(RenderObserver&&) = default;
+    auto operator=(RenderObserver const&) -> RenderObserver& = default;
+    auto operator=(RenderObserver&&) -> RenderObserver& = default;
+    virtual ~RenderObserver() = default;
+
+    /// Called when `phase` of the rendering of `source` begins at `time`.
+    virtual void on_phase_begin(
+        [[maybe_unused]] AnnotatedSource const& source,
+        [[maybe_unused]] RenderPhase phase,
+        [[maybe_unused]] clock::time_point time
+    ) { }
+
+    /// Called when `phase` of the rendering of `source` ends at `time`.
+    virtual void on_phase_end(
+        [[maybe_unused]] AnnotatedSource const& source,
+        [[maybe_unused]] RenderPhase phase,
+        [[maybe_unused]] clock::time_point time
+    ) { }
+
+    /// Called with the counters of the rendering of `source` after it has been rendered. Sources
+    /// found in `HumanRenderer::render_cache` are not laid out, so no function is called for them.
+    virtual void on_source_rendered(
+        [[maybe_unused]] AnnotatedSource const& source,
+        [[maybe_unused]] RenderStats const& stats
+    ) { }
+};
+}  // namespace ants
+
+#endif  // ANNOTATE_SNIPPETS_RENDERER_RENDER_OBSERVER_HPP
@@ -0,0 +1,168 @@
+#ifndef ANNOTATE_SNIPPETS_SOURCE_FILE_HPP
+#define ANNOTATE_SNIPPETS_SOURCE_FILE_HPP
+
+#include "annotate_snippets/line_index.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace ants {
+namespace detail {
+/// A read-only memory mapping of a whole file, which is unmapped when the object is destroyed.
+class FileMapping {
+public:
+    /// Creates an empty mapping, which is used for empty files since they cannot be mapped.
+    FileMapping() = default;
+
+    /// Takes over the mapping of `size` bytes starting at `address`.
+    explicit FileMapping(void const* address, std::size_t size) : address_(address), size_(size) { }
+
+    FileMapping(FileMapping&& other) noexcept :
+        address_(std::exchange(other.address_, nullptr)), size_(std::exchange(other.size_, 0)) { }
+
+    FileMapping(FileMapping const&) = delete;
+    auto operator=(FileMapping const&) -> FileMapping& = delete;
+
+    /// Exchanges the mappings of the two objects, so that the previous mapping of this object is
+    /// released by `other`.
+    auto operator=(FileMapping&& other) noexcept -> FileMapping& {
+        std::swap(address_, other.address_);
+        std::swap(size_, other.size_);
+        return *this;
+    }
+
+    ~FileMapping();
+
+    /// Maps the whole file at `path`. Returns `false` if the file cannot be opened or mapped, or if
+    /// it is not a regular file, in which case `mapping` is left unchanged.
+    static auto map(std::string const& path, FileMapping& mapping) -> bool;
+
+    auto content() const -> std::string_view {
+        return { static_cast<char const*>(address_), size_ };
+    }
+
+private:
+    void const* address_ = nullptr;
+    std::size_t size_ = 0;
+};
+}  // namespace detail
+
+/// Represents a source file that is shared by many annotated sources, possibly across many
+/// diagnostics.
+///
+/// A `SourceFile` either owns its source code and origin, refers to them (in which case they must
+/// outlive the `SourceFile`), or maps the file it is read from into memory. It is always handled
+/// by `std::shared_ptr`, so that every `AnnotatedSource` created from it keeps it alive. The
+/// source code of a `SourceFile` never changes, so the dense index of its lines (see `LineIndex`)
+/// is built at most once, when it is first needed, and then reused by all annotated sources of the
+/// file.
+///
+/// All member functions of `SourceFile` are thread-safe, and so is rendering the annotated sources
+/// of a file from several threads, whether or not they use its line index, since the renderers
+/// only read the file.
+class SourceFile {
+    /// Used to make the constructors inaccessible to the users while still allowing
+    /// `std::make_shared()` to call them.
+    struct PrivateTag { };
+
+public:
+    /// Creates a `SourceFile` that refers to the source code `source` without owning it.
+    static auto view(std::string_view source) -> std::shared_ptr<SourceFile const> {
+        return std::make_shared<SourceFile const>(PrivateTag(), source, std::string_view());
+    }
+
+    /// Creates a `SourceFile` that refers to the source code `source` and its origin `origin`
+    /// without owning them.
+    static auto view(std::string_view source, std::string_view origin)
+        -> std::shared_ptr<SourceFile const> {
+        return std::make_shared<SourceFile const>(PrivateTag(), source, origin);
+    }
+
+    /// Creates a `SourceFile` that owns the source code `source`.
+    static auto owned(std::string source) -> std::shared_ptr<SourceFile const> {
+        return std::make_shared<SourceFile const>(PrivateTag(), std::move(source), std::string());
+    }
+
+    /// Creates a `SourceFile` that owns the source code `source` and its origin `origin`.
+    static auto owned(std::string source, std::string origin) -> std::shared_ptr<SourceFile const> {
+        return std::make_shared<SourceFile const>(
+            PrivateTag(),
+            std::move(source),
+            std::move(origin)
+        );
+    }
+
+    /// Creates a `SourceFile` whose source code is the content of the file at `path`, which is
+    /// mapped into memory (with `mmap()`, or `MapViewOfFile()` on Windows) instead of being read.
+    /// The origin of the source code is `path`. Returns `nullptr` if the file cannot be mapped.
+    ///
+    /// The mapping is released when the `SourceFile` is destroyed, and the file must not be
+    /// modified until then. The operating system only reads the pages of the file that are
+    /// accessed, so annotated sources of the file do not use its line index by default (see
+    /// `uses_line_index()`): they locate the lines by scanning the source code from the beginning,
+    /// which stops at the last annotated line. The lines found while rendering are memoized by the
+    /// renderer rather than by the annotated source (see
+    /// `AnnotatedSource::line_offset(unsigned, LineOffsetMemo&)`), so the file can be shared by
+    /// annotated sources rendered on different threads.
+    static auto mapped(std::string path) -> std::shared_ptr<SourceFile const>;
+
+    explicit SourceFile(PrivateTag /*unused*/, std::string_view source, std::string_view origin) :
+        source_(source), origin_(origin) { }
+
+    explicit SourceFile(PrivateTag /*unused*/, std::string source, std::string origin) :
+        owned_source_(std::move(source)), owned_origin_(std::move(origin)),
+        source_(owned_source_), origin_(owned_origin_) { }
+
+    explicit SourceFile(PrivateTag /*unused*/, detail::FileMapping mapping, std::string origin) :
+        owned_origin_(std::move(origin)), mapping_(std::move(mapping)),
+        source_(mapping_.content()), origin_(owned_origin_), uses_line_index_(false) { }
+
+    // `source_` and `origin_` may refer to the strings owned by the object itself.
+    SourceFile(SourceFile const&) = delete;
+    auto operator=(SourceFile const&) -> SourceFile& = delete;
+
+    auto source() const -> std::string_view {
+        return source_;
+    }
+
+    auto origin() const -> std::string_view {
+        return origin_;
+    }
+
+    /// Indicates whether the annotated sources of this file locate lines with the line index of the
+    /// file (see `AnnotatedSource::line_index()`) without calling `build_line_index()` first. This
+    /// is `false` only for files created by `mapped()`, since building the index reads the whole
+    /// file.
+    auto uses_line_index() const -> bool {
+        return uses_line_index_;
+    }
+
+    /// Returns the dense index of the lines of the source code. The index is built on the first
+    /// call, even if several threads call this function at the same time.
+    auto line_index() const -> LineIndex const&;
+
+private:
+    /// The source code owned by this object, if it is created by `owned()`.
+    std::string owned_source_;
+    /// The origin owned by this object, if it is created by `owned()`.
+    std::string owned_origin_;
+    /// The memory mapping of the file, if this object is created by `mapped()`.
+    detail::FileMapping mapping_;
+    /// The source code of the file (the file content).
+    std::string_view source_;
+    /// The origin of the source code (the file name).
+    std::string_view origin_;
+    /// See `uses_line_index()`.
+    bool uses_line_index_ = true;
+    /// The index of the lines in `source_`, which is built lazily by `line_index()`.
+    mutable LineIndex line_index_;
+    /// Guards the construction of `line_index_`.
+    mutable std::once_flag line_index_flag_;
+};
+}  // namespace ants
+
+#endif  // ANNOTATE_SNIPPETS_SOURCE_FILE_HPP
@@ -1,16 +1,59 @@
 #ifndef ANNOTATE_SNIPPETS_STYLE_SPEC_HPP
 #define ANNOTATE_SNIPPETS_STYLE_SPEC_HPP
 
+#include "annotate_snippets/output_sink.hpp"
+
+#include <array>
 #include <climits>
 #include <concepts>
+#include <cstddef>
 #include <cstdint>
 #include <ostream>
+#include <string>
 #include <string_view>
 #include <type_traits>
 
 namespace ants {
 class Style;
 
+/// A short string of fixed capacity holding an ANSI escape sequence. It allows escape sequences to
+/// be computed (even at compile time) without allocating memory.
+class AnsiEscapeSequence {
+public:
+    /// The maximum length of an escape sequence. The longest sequence produced by `StyleSpec`,
+    /// which enables all text styles and bright colors, has 23 characters.
+    static constexpr std::size_t capacity = 32;
+
+    constexpr auto view() const -> std::string_view {
+        return { data_.data(), size_ };
+    }
+
+    constexpr auto empty() const -> bool {
+        return size_ == 0;
+    }
+
+    constexpr void append(std::string_view str) {
+        for (char const ch : str) {
+            data_[size_++] = ch;
+        }
+    }
+
+    /// Appends the decimal representation of `code`, which is a parameter of an escape sequence.
+    constexpr void append_code(unsigned code) {
+        if (code >= 100) {
+            data_[size_++] = static_cast<char>('0' + code / 100);
+        }
+        if (code >= 10) {
+            data_[size_++] = static_cast<char>('0' + code / 10 % 10);
+        }
+        data_[size_++] = static_cast<char>('0' + code % 10);
+    }
+
+private:
+    std::array<char, capacity> data_ {};
+    std::uint8_t size_ = 0;
+};
+
 /// Represents a `Style` rendering specification, including the text color, background color, and
 /// text styles (e.g., bold, italic, underline) when printed to the console.
 class StyleSpec {
@@ -69,6 +112,57 @@ public:
     /// current style.
     void render_string(std::ostream& out, std::string_view content) const;
 
+    /// Writes the string `content` to `sink`, rendered with the current style by ANSI escape
+    /// sequences. Unlike the overload above, the escape sequences are written unconditionally.
+    template <output_sink Sink>
+    void render_string(Sink& sink, std::string_view content) const {
+        if (*this == StyleSpec()) {
+            sink.write(content);
+        } else {
+            sink.write(ansi_escape_sequence().view());
+            sink.write(content);
+            sink.write(ansi_reset_sequence);
+        }
+    }
+
+    /// The escape sequence that resets the console to the default style.
+    static constexpr std::string_view ansi_reset_sequence = "\033[0m";
+
+    /// Returns the ANSI escape sequence that switches the console from the default style to the
+    /// current style. All colors and text styles are combined into a single SGR sequence, such as
+    /// "\033[1;91m". For the default style, returns an empty sequence.
+    constexpr auto ansi_escape_sequence() const -> AnsiEscapeSequence {
+        AnsiEscapeSequence result;
+        if (*this == StyleSpec()) {
+            return result;
+        }
+
+        bool first_code = true;
+        auto const append_code = [&](unsigned code) {
+            result.append(first_code ? "\033[" : ";");
+            result.append_code(code);
+            first_code = false;
+        };
+
+        // The SGR parameters of the text styles, in the order of the bits of `TextStyle`.
+        constexpr std::array<unsigned, 7> text_style_codes { 1, 2, 3, 4, 7, 8, 9 };
+        for (std::size_t bit = 0; bit != text_style_codes.size(); ++bit) {
+            if ((text_styles_ & (1u << bit)) != 0) {
+                append_code(text_style_codes[bit]);
+            }
+        }
+
+        if (foreground_ != PredefinedColor::Default) {
+            append_code(ansi_color_code(foreground_, /*base=*/30, /*bright_base=*/90));
+        }
+        if (background_ != PredefinedColor::Default) {
+            append_code(ansi_color_code(background_, /*base=*/40, /*bright_base=*/100));
+        }
+
+        result.append("m");
+        return result;
+    }
+
     constexpr auto foreground_color() const -> PredefinedColor {
         return foreground_;
     }
@@ -149,6 +243,18 @@ public:
     friend constexpr auto operator==(StyleSpec const&, StyleSpec const&) -> bool = default;
 
 private:
+    /// Returns the SGR parameter of the non-default color `color`, where `base` and `bright_base`
+    /// are the parameters of `Black` and `BrightBlack` respectively.
+    static constexpr auto ansi_color_code(
+        PredefinedColor color,
+        unsigned base,
+        unsigned bright_base
+    ) -> unsigned {
+        return color >= PredefinedColor::BrightBlack
+            ? bright_base + static_cast<unsigned>(color - PredefinedColor::BrightBlack)
+            : base + static_cast<unsigned>(color - PredefinedColor::Black);
+    }
+
     /// Specified text styles (`TextStyle` and its combinations). We avoid using `std::bitset`
     /// because its alignment requirements are too strict, which would make the size of `StyleSpec`
     /// too large.
@@ -179,6 +285,71 @@ constexpr auto operator~(StyleSpec::TextStyle style) -> StyleSpec::TextStyle {
     return static_cast<StyleSpec::TextStyle>(~static_cast<std::uint8_t>(style));
 }
 
+/// Writes text rendered with `StyleSpec`s to an output stream or an output sink line by line.
+///
+/// Compared with calling `StyleSpec::render_string()` for each string, the writer decides only once
+/// whether escape sequences should be emitted, skips them between adjacent strings of the same
+/// style, and writes each line to the destination in a single call.
+class StyledLineWriter {
+public:
+    /// Creates a writer for the output stream associated with `out`. Escape sequences are emitted
+    /// under the same conditions as `rang`, based on its control mode and whether `out` refers to
+    /// a terminal.
+    explicit StyledLineWriter(std::ostream& out);
+    /// Creates a writer for the output stream associated with `out`, which emits ANSI escape
+    /// sequences iff `use_escape_sequences` is `true`, regardless of the settings of `rang`.
+    StyledLineWriter(std::ostream& out, bool use_escape_sequences) :
+        StyledLineWriter(out, use_escape_sequences ? Ansi : Plain) { }
+    /// Creates a writer for `sink`, which emits ANSI escape sequences iff `use_escape_sequences` is
+    /// `true`. The writer refers to `sink`, so `sink` must outlive the writer.
+    template <output_sink Sink>
+    StyledLineWriter(Sink& sink, bool use_escape_sequences) :
+        sink_(&sink), write_line_([](void* sink, std::string_view line) {
+            static_cast<Sink*>(sink)->write(line);
+        }),
+        mode_(use_escape_sequences ? Ansi : Plain) { }
+
+    /// Returns whether the writer emits escape sequences.
+    auto is_colored() const -> bool {
+        return mode_ != Plain;
+    }
+
+    /// Appends `content` rendered with style `spec` to the current line.
+    void append(std::string_view content, StyleSpec spec);
+
+    /// Ends the current line: resets the style, appends a newline character, and writes the line to
+    /// the output stream.
+    void end_line();
+
+    /// Writes `lines`, which consists of complete lines of plain text terminated by newline
+    /// characters, to the output stream in a single call. The current line must be empty.
+    void write_plain_lines(std::string_view lines);
+
+private:
+    enum Mode : std::uint8_t {
+        /// No escape sequences are emitted.
+        Plain,
+        /// ANSI escape sequences are emitted.
+        Ansi,
+        /// The styles are set by `rang`, which may use the console API instead of escape sequences
+        /// (on Windows). Strings are written through `StyleSpec::render_string()` directly.
+        Native,
+    };
+
+    StyledLineWriter(std::ostream& out, Mode mode);
+
+    /// The destination of the lines, and the function writing a line to it.
+    void* sink_;
+    void (*write_line_)(void*, std::string_view);
+    /// The stream used by `Native` mode, or `nullptr` if the writer is not created from a stream.
+    std::ostream* native_out_ = nullptr;
+    Mode mode_;
+    /// The style of the end of the current line.
+    StyleSpec current_spec_;
+    /// The content of the current line, including escape sequences.
+    std::string line_buffer_;
+};
+
 /// Checks if a callable type `StyleSheet` can be used as a style sheet for `HumanRenderer`.
 ///
 /// The style sheet must be a callable object that accepts `Style` and `Level` as parameters. It
@@ -196,11 +367,22 @@ concept style_sheet_for =
 
 /// Represents a style sheet that renders every `Style` in plain text format.
 struct PlainTextStyleSheet {
+    /// Marks the style sheet as a plain text style sheet, see `plain_text_style_sheet`.
+    static constexpr bool is_plain_text = true;
+
     template <class Level>
     constexpr auto operator()(Style const& /*unused*/, Level&& /*unused*/) const -> StyleSpec {
         return {};
     }
 };
+
+/// Checks whether the style sheet `StyleSheet` renders every `Style` in the default style, so that
+/// styles need not be looked up at all. A style sheet is checked as such by defining a `static
+/// constexpr bool is_plain_text = true;` member, as `PlainTextStyleSheet` does.
+template <class StyleSheet>
+concept plain_text_style_sheet = requires {
+    requires std::remove_cvref_t<StyleSheet>::is_plain_text;
+};
 }  // namespace ants
 
 #endif  // ANNOTATE_SNIPPETS_STYLE_SPEC_HPP
@@ -8,6 +8,7 @@
 #include <algorithm>
 #include <concepts>
 #include <cstddef>
+#include <functional>
 #include <iterator>
 #include <string>
 #include <string_view>
@@ -83,6 +84,22 @@ public:
         return content_.empty();
     }
 
+    /// Returns a `StyledStringView` referring to the content of this string, with the same styles.
+    /// The view becomes invalid once the string is modified or destroyed.
+    auto view() const -> StyledStringView {
+        StyledStringView result(content_);
+        result.styled_parts_ = styled_parts_;
+        return result;
+    }
+
+    /// Reserves storage for at least `content_capacity` characters and `part_capacity` styled
+    /// parts, so that strings whose final size can be estimated are built without reallocations.
+    /// A string of uniformly styled runs needs one part per run, plus one.
+    void reserve(std::size_t content_capacity, std::size_t part_capacity) {
+        content_.reserve(content_capacity);
+        styled_parts_.reserve(part_capacity);
+    }
+
     using Base::set_style;
 
     /// Sets the style of the substring starting at `start_index` and ending at the end of the whole
@@ -94,11 +111,10 @@ public:
     /// Sets the style of the whole string.
     void set_style(Style style) {
         // clang-format off
-        std::vector<StyledPart> {
+        styled_parts_ = {
             { .start_index = 0, .style = style },
             { .start_index = content_.size(), .style {} },
-        }
-            .swap(styled_parts_);
+        };
         // clang-format on
     }
 
@@ -163,6 +179,23 @@ public:
         }
     }
 
+    /// Appends the styled parts of `line` to the end of the current `StyledString`. This method is
+    /// typically used to add a `StyledStringView` or `StyledString` line by line to the current
+    /// string.
+    void append(StyledLine const& line) {
+        for (StyledStringViewPart const part : line) {
+            append(part.content, part.style);
+        }
+    }
+
+    /// Appends the styled parts of `line` to the end of the current `StyledString`. If the style of
+    /// any part is `Style::Auto`, it is replaced with `auto_replacement`.
+    void append(StyledLine const& line, Style auto_replacement) {
+        for (StyledStringViewPart const part : line) {
+            append(part.content, part.style, auto_replacement);
+        }
+    }
+
     /// Appends the sequence of styled strings specified by `parts` to the end of the current
     /// `StyledString`. If the style of any part is `Style::Auto`, it is replaced with
     /// `auto_replacement`. This method is typically used to add a `StyledStringView` or
@@ -173,6 +206,40 @@ public:
         }
     }
 
+    /// Appends `other` to the end of the current `StyledString`, keeping the styles of all its
+    /// characters. Existing parts of the `StyledString` remain unaffected.
+    void append(StyledString const& other) {
+        if (other.content_.empty()) {
+            return;
+        }
+
+        std::size_t const offset = content_.size();
+        content_.append(other.content_);
+
+        // Remove the parts starting at the end of the current string, which are all empty. This
+        // includes the sentinel part, which is replaced by the one of `other`.
+        while (!styled_parts_.empty() && styled_parts_.back().start_index == offset) {
+            styled_parts_.pop_back();
+        }
+        for (StyledPart const& part : other.styled_parts_) {
+            styled_parts_.push_back(
+                StyledPart { .start_index = part.start_index + offset, .style = part.style }
+            );
+        }
+    }
+
+    /// Appends the string `content` to the end of the current `StyledString` with the specified
+    /// `style`, replacing each tab character in `content` with `tab_width` spaces. The tabs are
+    /// expanded while appending, without creating an intermediate string.
+    void append_expanding_tabs(std::string_view content, std::size_t tab_width, Style style) {
+        for (std::size_t pos; (pos = content.find('\t')) != std::string_view::npos;) {
+            content_.append(content.substr(0, pos)).append(tab_width, ' ');
+            content.remove_prefix(pos + 1);
+        }
+        content_.append(content);
+        append_styled_part_impl(style);
+    }
+
     /// Appends a newline character at the end of the string to ensure that subsequent additions
     /// begin on a new line.
     void append_newline() {
@@ -193,6 +260,13 @@ public:
         }
     }
 
+    /// Removes the first `count` characters of the string. The remaining characters keep their
+    /// styles. If `count` is not less than the length of the string, the string becomes empty.
+    void remove_prefix(std::size_t count) {
+        remove_styled_parts_prefix(count);
+        content_.erase(0, count);
+    }
+
     /// Uses the string `content` to overwrite characters starting from `position`, and sets the
     /// style of the newly replaced characters to `style`.
     ///
@@ -309,6 +383,13 @@ public:
         return Base::styled_line_parts(content_);
     }
 
+    /// Returns the lines of the string as a lazy range of `StyledLine`s, which yields the same
+    /// lines and parts as `styled_line_parts()` but computes them on demand without allocating
+    /// memory. The range becomes invalid once the string is modified or destroyed.
+    auto styled_lines() const -> StyledLineRange {
+        return Base::styled_lines(content_);
+    }
+
 private:
     std::string content_;
 
@@ -329,6 +410,89 @@ private:
         styled_parts_.push_back(StyledPart { .start_index = content_.size(), .style {} });
     }
 };
+
+/// Builds a `StyledString` by overwriting its content in place, like
+/// `StyledString::set_styled_content()`. The characters are written immediately, but the styles of
+/// the written ranges are collected as `StyleEdit`s and applied in `build()` with a single call to
+/// `StyledString::set_styles()`. This avoids shifting the styled parts of the string for each
+/// write, which makes painting many small overlapping regions (such as the underlines, connectors
+/// and labels of an annotation line) quadratic in the number of parts.
+///
+/// The resulting string is the same as if each write had been done directly on a `StyledString`.
+class StyledStringBuilder {
+public:
+    StyledStringBuilder() = default;
+
+    /// Reserves storage for at least `content_capacity` characters and `write_capacity` writes.
+    void reserve(std::size_t content_capacity, std::size_t write_capacity) {
+        // Each write produces at most two parts.
+        result_.reserve(content_capacity, 2 * write_capacity + 2);
+        edits_.reserve(write_capacity);
+    }
+
+    /// Returns the content written so far.
+    auto content() const -> std::string const& {
+        return result_.content();
+    }
+
+    /// Sets the style of the substring in range `[start_index, end_index)`, which must be within
+    /// the content written so far.
+    void set_style(Style style, std::size_t start_index, std::size_t end_index) {
+        edits_.push_back({ .start_index = start_index, .end_index = end_index, .style = style });
+    }
+
+    /// Same as `StyledString::set_styled_content()`.
+    void set_styled_content(std::size_t position, std::string_view content, Style style) {
+        std::string& target = result_.content();
+        if (target.size() < position + content.size()) {
+            // The appended spaces are unstyled. Since they are beyond the ranges of all earlier
+            // writes, they are styled right away.
+            result_.append_spaces(position + content.size() - target.size());
+        }
+
+        std::ranges::copy(content, std::ranges::next(target.begin(), static_cast<int>(position)));
+        set_style(style, position, position + content.size());
+    }
+
+    /// Same as `StyledString::set_styled_content()`.
+    void set_styled_content(
+        std::size_t position,
+        std::string_view content,
+        Style style,
+        Style auto_replacement
+    ) {
+        set_styled_content(position, content, style.is_auto_style() ? auto_replacement : style);
+    }
+
+    /// Same as `StyledString::set_styled_content()`.
+    void set_styled_content(
+        std::size_t position,
+        std::vector<StyledStringViewPart> const& styled_content,
+        Style auto_replacement
+    ) {
+        for (auto const& [content, style] : styled_content) {
+            set_styled_content(position, content, style, auto_replacement);
+            position += content.size();
+        }
+    }
+
+    /// Applies the collected styles and returns the built string. The builder is left empty.
+    auto build() -> StyledString {
+        result_.set_styles(edits_);
+        edits_.clear();
+        return std::exchange(result_, StyledString());
+    }
+
+private:
+    StyledString result_;
+    std::vector<StyleEdit> edits_;
+};
+
+/// Produces a `StyledString` on demand. It is used to defer the formatting of the messages and
+/// labels of diagnostics until the renderer reaches them (see `LabeledSpan::deferred_label` and
+/// `DiagEntry::set_deferred_diag_message()`), so that the text of diagnostics which are not
+/// rendered (for example, because of the output limits of the renderer) is never built.
+using DeferredStyledString = std::function<StyledString()>;
 }  // namespace ants
 
 #endif  // ANNOTATE_SNIPPETS_STYLED_STRING_HPP
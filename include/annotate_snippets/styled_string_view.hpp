@@ -78,11 +78,10 @@ public:
     /// Sets the style of the whole string.
     void set_style(Style style) {
         // clang-format off
-        std::vector<StyledPart> {
+        styled_parts_ = {
             { .start_index = 0, .style = style },
             { .start_index = content_.size(), .style {} },
-        }
-            .swap(styled_parts_);
+        };
         // clang-format on
     }
 
@@ -147,6 +146,13 @@ public:
         return Base::styled_line_parts(content_);
     }
 
+    /// Returns the lines of the string as a lazy range of `StyledLine`s, which yields the same
+    /// lines and parts as `styled_line_parts()` but computes them on demand without allocating
+    /// memory. The range becomes invalid once the string is modified or destroyed.
+    auto styled_lines() const -> StyledLineRange {
+        return Base::styled_lines(content_);
+    }
+
 private:
     std::string_view content_;
 
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Generates src/detail/unicode_display_width_table.cpp, the lookup table of the display widths of
+all the code points used by `ants::detail::code_point_display_width()`.
+
+Run it from the root of the repository after changing the ranges below:
+
+    python3 scripts/generate_unicode_width_table.py
+"""
+
+from pathlib import Path
+
+# The code points that occupy two columns, i.e. the characters whose East Asian Width property is
+# Wide (W) or Fullwidth (F) in Unicode 15. The ranges are inclusive.
+WIDE_CODE_POINTS = [
+    (0x1100, 0x115f), (0x231a, 0x231b), (0x2329, 0x232a), (0x23e9, 0x23ec), (0x23f0, 0x23f0),
+    (0x23f3, 0x23f3), (0x25fd, 0x25fe), (0x2614, 0x2615), (0x2648, 0x2653), (0x267f, 0x267f),
+    (0x2693, 0x2693), (0x26a1, 0x26a1), (0x26aa, 0x26ab), (0x26bd, 0x26be), (0x26c4, 0x26c5),
+    (0x26ce, 0x26ce), (0x26d4, 0x26d4), (0x26ea, 0x26ea), (0x26f2, 0x26f3), (0x26f5, 0x26f5),
+    (0x26fa, 0x26fa), (0x26fd, 0x26fd), (0x2705, 0x2705), (0x270a, 0x270b), (0x2728, 0x2728),
+    (0x274c, 0x274c), (0x274e, 0x274e), (0x2753, 0x2755), (0x2757, 0x2757), (0x2795, 0x2797),
+    (0x27b0, 0x27b0), (0x27bf, 0x27bf), (0x2b1b, 0x2b1c), (0x2b50, 0x2b50), (0x2b55, 0x2b55),
+    (0x2e80, 0x2e99), (0x2e9b, 0x2ef3), (0x2f00, 0x2fd5), (0x2ff0, 0x2ffb), (0x3000, 0x303e),
+    (0x3041, 0x3096), (0x3099, 0x30ff), (0x3105, 0x312f), (0x3131, 0x318e), (0x3190, 0x31e3),
+    (0x31f0, 0x321e), (0x3220, 0x3247), (0x3250, 0x4dbf), (0x4e00, 0xa48c), (0xa490, 0xa4c6),
+    (0xa960, 0xa97c), (0xac00, 0xd7a3), (0xf900, 0xfaff), (0xfe10, 0xfe19), (0xfe30, 0xfe52),
+    (0xfe54, 0xfe66), (0xfe68, 0xfe6b), (0xff01, 0xff60), (0xffe0, 0xffe6), (0x16fe0, 0x16fe4),
+    (0x16ff0, 0x16ff1), (0x17000, 0x187f7), (0x18800, 0x18cd5), (0x18d00, 0x18d08),
+    (0x1aff0, 0x1aff3), (0x1aff5, 0x1affb), (0x1affd, 0x1affe), (0x1b000, 0x1b122),
+    (0x1b132, 0x1b132), (0x1b150, 0x1b152), (0x1b155, 0x1b155), (0x1b164, 0x1b167),
+    (0x1b170, 0x1b2fb), (0x1f004, 0x1f004), (0x1f0cf, 0x1f0cf), (0x1f18e, 0x1f18e),
+    (0x1f191, 0x1f19a), (0x1f200, 0x1f202), (0x1f210, 0x1f23b), (0x1f240, 0x1f248),
+    (0x1f250, 0x1f251), (0x1f260, 0x1f265), (0x1f300, 0x1f320), (0x1f32d, 0x1f335),
+    (0x1f337, 0x1f37c), (0x1f37e, 0x1f393), (0x1f3a0, 0x1f3ca), (0x1f3cf, 0x1f3d3),
+    (0x1f3e0, 0x1f3f0), (0x1f3f4, 0x1f3f4), (0x1f3f8, 0x1f43e), (0x1f440, 0x1f440),
+    (0x1f442, 0x1f4fc), (0x1f4ff, 0x1f53d), (0x1f54b, 0x1f54e), (0x1f550, 0x1f567),
+    (0x1f57a, 0x1f57a), (0x1f595, 0x1f596), (0x1f5a4, 0x1f5a4), (0x1f5fb, 0x1f64f),
+    (0x1f680, 0x1f6c5), (0x1f6cc, 0x1f6cc), (0x1f6d0, 0x1f6d2), (0x1f6d5, 0x1f6d7),
+    (0x1f6dc, 0x1f6df), (0x1f6eb, 0x1f6ec), (0x1f6f4, 0x1f6fc), (0x1f7e0, 0x1f7eb),
+    (0x1f7f0, 0x1f7f0), (0x1f90c, 0x1f93a), (0x1f93c, 0x1f945), (0x1f947, 0x1f9ff),
+    (0x1fa70, 0x1fa7c), (0x1fa80, 0x1fa88), (0x1fa90, 0x1fabd), (0x1fabf, 0x1fac5),
+    (0x1face, 0x1fadb), (0x1fae0, 0x1fae8), (0x1faf0, 0x1faf8), (0x20000, 0x2fffd),
+    (0x30000, 0x3fffd),
+]
+
+# The code points that occupy no column: combining marks, the medial vowels and final consonants of
+# Hangul Jamo, zero-width spaces, joiners and format characters, and variation selectors. They take
+# precedence over `WIDE_CODE_POINTS`.
+ZERO_WIDTH_CODE_POINTS = [
+    (0x0300, 0x036f), (0x0483, 0x0489), (0x0591, 0x05bd), (0x05bf, 0x05bf), (0x05c1, 0x05c2),
+    (0x05c4, 0x05c5), (0x05c7, 0x05c7), (0x0610, 0x061a), (0x064b, 0x065f), (0x0670, 0x0670),
+    (0x06d6, 0x06dc), (0x06df, 0x06e4), (0x06e7, 0x06e8), (0x06ea, 0x06ed), (0x0711, 0x0711),
+    (0x0730, 0x074a), (0x07a6, 0x07b0), (0x07eb, 0x07f3), (0x0816, 0x0819), (0x081b, 0x0823),
+    (0x0825, 0x0827), (0x0829, 0x082d), (0x0859, 0x085b), (0x08d3, 0x08e1), (0x08e3, 0x0902),
+    (0x093a, 0x093a), (0x093c, 0x093c), (0x0941, 0x0948), (0x094d, 0x094d), (0x0951, 0x0957),
+    (0x0962, 0x0963), (0x0981, 0x0981), (0x09bc, 0x09bc), (0x09c1, 0x09c4), (0x09cd, 0x09cd),
+    (0x09e2, 0x09e3), (0x0a01, 0x0a02), (0x0a3c, 0x0a3c), (0x0a41, 0x0a42), (0x0a47, 0x0a48),
+    (0x0a4b, 0x0a4d), (0x0a70, 0x0a71), (0x0e31, 0x0e31), (0x0e34, 0x0e3a), (0x0e47, 0x0e4e),
+    (0x0eb1, 0x0eb1), (0x0eb4, 0x0ebc), (0x0ec8, 0x0ecd), (0x0f18, 0x0f19), (0x0f35, 0x0f35),
+    (0x0f37, 0x0f37), (0x0f39, 0x0f39), (0x0f71, 0x0f7e), (0x0f80, 0x0f84), (0x0f86, 0x0f87),
+    (0x0f8d, 0x0fbc), (0x102d, 0x1030), (0x1032, 0x1037), (0x1039, 0x103a), (0x1160, 0x11ff),
+    (0x135d, 0x135f), (0x1712, 0x1714), (0x17b4, 0x17b5), (0x17b7, 0x17bd), (0x17c6, 0x17c6),
+    (0x17c9, 0x17d3), (0x17dd, 0x17dd), (0x180b, 0x180f), (0x1ab0, 0x1ace), (0x1dc0, 0x1dff),
+    (0x200b, 0x200f), (0x202a, 0x202e), (0x2060, 0x2064), (0x20d0, 0x20f0), (0x2cef, 0x2cf1),
+    (0x2de0, 0x2dff), (0x302a, 0x302d), (0x3099, 0x309a), (0xa66f, 0xa672), (0xa674, 0xa67d),
+    (0xa69e, 0xa69f), (0xa6f0, 0xa6f1), (0xfe00, 0xfe0f), (0xfe20, 0xfe2f), (0xfeff, 0xfeff),
+    (0x101fd, 0x101fd), (0x1d167, 0x1d169), (0x1d17b, 0x1d182), (0x1d185, 0x1d18b),
+    (0x1d1aa, 0x1d1ad), (0xe0001, 0xe0001), (0xe0020, 0xe007f), (0xe0100, 0xe01ef),
+]
+
+# Must match `code_point_width_block_size` in unicode_display_width.hpp.
+BLOCK_SIZE = 256
+CODE_POINT_COUNT = 0x110000
+
+ROOT = Path(__file__).resolve().parent.parent
+OUTPUT = ROOT / "src" / "detail" / "unicode_display_width_table.cpp"
+
+HEADER = (
+    "// This file is generated by scripts/generate_unicode_width_table.py. "
+    "Do not edit it manually."
+)
+
+
+def build_blocks():
+    widths = bytearray([1]) * CODE_POINT_COUNT
+    for first, last in WIDE_CODE_POINTS:
+        widths[first : last + 1] = bytes([2]) * (last - first + 1)
+    for first, last in ZERO_WIDTH_CODE_POINTS:
+        widths[first : last + 1] = bytes([0]) * (last - first + 1)
+
+    # Packs the widths of 4 code points into a byte, the first code point in the lowest bits.
+    packed = bytes(
+        widths[cp] | widths[cp + 1] << 2 | widths[cp + 2] << 4 | widths[cp + 3] << 6
+        for cp in range(0, CODE_POINT_COUNT, 4)
+    )
+
+    packed_block_size = BLOCK_SIZE // 4
+    block_index = []
+    blocks = []
+    distinct = {}
+    for beg in range(0, len(packed), packed_block_size):
+        block = packed[beg : beg + packed_block_size]
+        if block not in distinct:
+            distinct[block] = len(blocks)
+            blocks.append(block)
+        block_index.append(distinct[block])
+    assert len(blocks) <= 256
+    return block_index, blocks
+
+
+def format_bytes(values, indent):
+    lines = []
+    line = indent
+    for value in values:
+        item = f"0x{value:02x},"
+        if len(line) + 1 + len(item) > 100:
+            lines.append(line)
+            line = indent
+        line += (" " if line != indent else "") + item
+    lines.append(line)
+    return "\n".join(lines)
+
+
+def main():
+    block_index, blocks = build_blocks()
+    block_lines = "\n".join(
+        "    { {\n" + format_bytes(block, "        ") + "\n    } },"
+        for block in blocks
+    )
+    OUTPUT.write_text(
+        f"""{HEADER}
+
+#include "annotate_snippets/detail/unicode_display_width.hpp"
+
+#include <array>
+#include <cstdint>
+
+namespace ants::detail {{
+std::array<uint8_t, code_point_width_block_count> const code_point_width_block_index {{
+{format_bytes(block_index, "    ")}
+}};
+
+CodePointWidthBlock const code_point_width_blocks[] = {{
+{block_lines}
+}};
+}}  // namespace ants::detail
+"""
+    )
+
+
+if __name__ == "__main__":
+    main()
@@ -1,56 +1,69 @@
 #include "annotate_snippets/annotated_source.hpp"
 
+#include "annotate_snippets/line_index.hpp"
+#include "annotate_snippets/source_file.hpp"
+
 #include <algorithm>
 #include <cstddef>
 #include <functional>
 #include <iterator>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <stdexcept>
 #include <string_view>
 #include <utility>
+#include <vector>
 
 namespace ants {
 namespace {
-/// Calculates and returns the position of the first byte of line `target_line` in the source code
-/// `source`. This function assumes that this position is not stored in the cache
-/// `line_offset_cache` and will add the result to the cache. This function also utilizes existing
-/// information in the cache to reduce the range of characters that need to be traversed. If
-/// `target_line` exceeds the actual number of lines in `source`, it returns `source.size()`, and
-/// this result is not added to the cache.
+/// Calculates the position of the first byte of line `target_line` in the source code `source`.
+/// This function assumes that this position is not stored in any of the caches
+/// `line_offset_caches`, and utilizes the lines known by them to reduce the range of characters
+/// that need to be traversed. The caches themselves are not modified.
+///
+/// Returns the entry to be added to a cache by the caller, whose value is the result: the line
+/// `target_line` and its position, or, if `target_line` exceeds the actual number of lines in
+/// `source`, the line immediately following the actual last line and `source.size()`.
+template <class... LineOffsetMaps>
 auto compute_line_offset(
-    std::map<unsigned, std::size_t>& line_offset_cache,
     unsigned target_line,
-    std::string_view source
-) -> std::size_t {
+    std::string_view source,
+    LineOffsetMaps const&... line_offset_caches
+) -> std::pair<unsigned, std::size_t> {
     // Searches forward from the starting position `start_offset` of `start_line` to find the
     // position of the target line `target_line`. If `target_line` exceeds the actual number of
-    // lines, returns `source.size()` and adds the line immediately following the actual last line
-    // to the cache.
-    auto const find_forward = [&](unsigned start_line, std::size_t start_offset) -> std::size_t {
+    // lines, returns `source.size()` along with the line immediately following the actual last
+    // line.
+    auto const find_forward =
+        [&](unsigned start_line, std::size_t start_offset) -> std::pair<unsigned, std::size_t> {
         for (unsigned cur_line = start_line; cur_line != target_line; ++cur_line) {
             std::size_t const pos = source.find('\n', start_offset);
             if (pos == std::string_view::npos) {
                 // There are not enough lines, indicating that `target_line` exceeds the actual
                 // number of lines. At this point, `cur_line` is the line number of the last line,
-                // and we store the line immediately following the last line in the cache.
+                // and the line immediately following the last line is to be cached.
                 //
                 // Special case: If `source` ends with '\n', then the actual last line is empty,
                 // which causes the last line and the line following the last line to have the same
-                // starting position. In this case, we do not add the hypothetical end line.
+                // starting position. In this case, we do not cache the hypothetical end line.
                 unsigned const line = start_offset == source.size() ? cur_line : cur_line + 1;
-                line_offset_cache[line] = source.size();
-                return source.size();
+                return { line, source.size() };
             }
             // FIXME: Should we also cache the information about the lines we pass through during
             // traversal?
             start_offset = pos + 1;
         }
 
-        line_offset_cache[target_line] = start_offset;
-        return start_offset;
+        return { target_line, start_offset };
     };
 
     // Finds the index of the first byte of `target_line` by searching backwards from `start_line`.
-    auto const find_backward = [&](unsigned start_line, std::size_t start_offset) -> std::size_t {
+    auto const find_backward =
+        [&](unsigned start_line, std::size_t start_offset) -> std::pair<unsigned, std::size_t> {
         // Now `start_offset` is the start position of line `start_line`, and we need to move
         // `start_offset` to the end of the previous line. We assume `start_line` cannot be 0 (as we
         // do not search backward from line 0), so `start_offset` will not be 0.
@@ -76,35 +89,45 @@ auto compute_line_offset(
 
         // If `rfind()` returns `npos`, then since `npos` is defined as `size_type(-1)`, `npos + 1`
         // will yield 0, which is what we expect.
-        line_offset_cache[target_line] = start_offset + 1;
-        return start_offset + 1;
+        return { target_line, start_offset + 1 };
     };
 
-    // Points to the line closest to and immediately following the target line.
-    auto const closest_next_iter = line_offset_cache.upper_bound(target_line);
-
-    // Points to the line closest to and immediately preceding the target line.
-    auto const closest_prev_iter =
-        std::ranges::prev(closest_next_iter, 1, line_offset_cache.begin());
+    // The lines closest to and immediately preceding and following the target line, among the
+    // lines known by any of the caches.
+    std::optional<std::pair<unsigned, std::size_t>> closest_prev;
+    std::optional<std::pair<unsigned, std::size_t>> closest_next;
+    auto const find_closest = [&](auto const& line_offset_cache) {
+        auto const next_iter = line_offset_cache.upper_bound(target_line);
+        if (next_iter != line_offset_cache.end()
+            && (!closest_next || next_iter->first < closest_next->first)) {
+            closest_next = *next_iter;
+        }
+        if (next_iter != line_offset_cache.begin()) {
+            auto const prev_iter = std::ranges::prev(next_iter);
+            if (!closest_prev || prev_iter->first > closest_prev->first) {
+                closest_prev = *prev_iter;
+            }
+        }
+    };
+    (find_closest(line_offset_caches), ...);
 
-    if (closest_next_iter != line_offset_cache.end()
-        && closest_prev_iter != line_offset_cache.end()) {
+    if (closest_next && closest_prev) {
         // If there are calculated lines before and after `target_line`, we traverse from the
         // closest one.
-        if (closest_next_iter->first - target_line < target_line - closest_prev_iter->first) {
-            return find_backward(closest_next_iter->first, closest_next_iter->second);
+        if (closest_next->first - target_line < target_line - closest_prev->first) {
+            return find_backward(closest_next->first, closest_next->second);
         } else {
-            return find_forward(closest_prev_iter->first, closest_prev_iter->second);
+            return find_forward(closest_prev->first, closest_prev->second);
         }
-    } else if (closest_prev_iter != line_offset_cache.end()) {
+    } else if (closest_prev) {
         // Only the line closest to and preceding the target line have been calculated, so we start
         // calculating from this line.
-        return find_forward(closest_prev_iter->first, closest_prev_iter->second);
-    } else if (closest_next_iter != line_offset_cache.end()) {
+        return find_forward(closest_prev->first, closest_prev->second);
+    } else if (closest_next) {
         // Only the line closest to and following the target line have been calculated. But since we
         // can always start computing from line 0, we check if line 0 is closer.
-        if (closest_next_iter->first - target_line < target_line) {
-            return find_backward(closest_next_iter->first, closest_next_iter->second);
+        if (closest_next->first - target_line < target_line) {
+            return find_backward(closest_next->first, closest_next->second);
         } else {
             return find_forward(0, 0);
         }
@@ -115,10 +138,11 @@ auto compute_line_offset(
 }
 
 /// Calculates the line on which the byte at `byte_offset` is located, returns the line number and
-/// the offset of the first byte of that line. This function also adds this line to the cache. It
-/// attempts to use the existing cache `line_offset_cache` to compute the result more quickly.
+/// the offset of the first byte of that line, which the caller may add to the cache. It attempts to
+/// use the existing cache `line_offset_cache` to compute the result more quickly, but does not
+/// modify it.
 auto byte_offset_to_line(
-    std::map<unsigned, std::size_t>& line_offset_cache,
+    std::map<unsigned, std::size_t> const& line_offset_cache,
     std::size_t byte_offset,
     std::string_view source
 ) -> std::pair<unsigned, std::size_t> {
@@ -146,7 +170,7 @@ auto byte_offset_to_line(
     // Searches forward from `start_offset` to determine the line number containing `byte_offset`,
     // returning its line number and the start position of this line. If `byte_offset` exceeds the
     // valid range of `source`, it is considered to be on the line immediately following the actual
-    // last line. This function does not modify the cache.
+    // last line.
     auto const find_forward = [&](unsigned start_line, std::size_t start_offset) {
         // Counts the number of newline characters between [start_offset, byte_offset).
         auto lines = static_cast<unsigned>(
@@ -163,16 +187,10 @@ auto byte_offset_to_line(
 
         return std::make_pair(start_line + lines, find_line_start());
     };
-    // Calls `find_forward()` and caches the result.
-    auto const find_forward_and_cache = [&](unsigned start_line, std::size_t start_offset) {
-        auto res = find_forward(start_line, start_offset);
-        line_offset_cache.insert(res);
-        return res;
-    };
 
     // Searches backward from `start_offset` to determine the line number of `byte_offset`,
-    // returning its line number and the start position of this line. The result is cached.
-    auto const find_backward_and_cache = [&](unsigned start_line, std::size_t start_offset) {
+    // returning its line number and the start position of this line.
+    auto const find_backward = [&](unsigned start_line, std::size_t start_offset) {
         // Now `start_offset` is the start position of line `start_line`, and we need to move
         // `start_offset` to the end of the previous line. We assume `start_offset` cannot be 0 (as
         // we do not search backward from the first byte). This allows us to handle actual lines and
@@ -185,9 +203,7 @@ auto byte_offset_to_line(
         );
 
         // Since we skipped a line, we need to decrement by an additional line.
-        std::pair res(start_line - lines - 1, find_line_start());
-        line_offset_cache.insert(res);
-        return res;
+        return std::make_pair(start_line - lines - 1, find_line_start());
     };
 
     // Checks if the cache already contains the starting position of the line near `byte_offset`; if
@@ -215,73 +231,252 @@ auto byte_offset_to_line(
     if (closest_prev_iter != line_offset_cache.end()
         && closest_next_iter != line_offset_cache.end()) {
         // If the lines before and after are adjacent, then we have already found the line
-        // containing the target byte, so we return the result without modifying the cache.
+        // containing the target byte.
         if (closest_prev_iter->first + 1 == closest_next_iter->first) {
             return *closest_prev_iter;
         }
 
         // Otherwise, we start the search from the closest line.
         if (closest_next_iter->second - byte_offset < byte_offset - closest_prev_iter->second) {
-            return find_backward_and_cache(closest_next_iter->first, closest_next_iter->second);
+            return find_backward(closest_next_iter->first, closest_next_iter->second);
         } else {
-            return find_forward_and_cache(closest_prev_iter->first, closest_prev_iter->second);
+            return find_forward(closest_prev_iter->first, closest_prev_iter->second);
         }
     } else if (closest_prev_iter != line_offset_cache.end()) {
         // Only lines before the target position are cached, so we start the search from the nearest
         // line.
-        return find_forward_and_cache(closest_prev_iter->first, closest_prev_iter->second);
+        return find_forward(closest_prev_iter->first, closest_prev_iter->second);
     } else if (closest_next_iter != line_offset_cache.end()) {
         // Only lines after the target position are cached. However, since we can always start from
         // the beginning, we check if starting from the beginning is closer.
         if (closest_next_iter->second - byte_offset < byte_offset) {
-            return find_backward_and_cache(closest_next_iter->first, closest_next_iter->second);
+            return find_backward(closest_next_iter->first, closest_next_iter->second);
         } else {
-            return find_forward_and_cache(0, 0);
+            return find_forward(0, 0);
         }
     } else {
         // No results are in the cache, so we start the search from the beginning.
-        return find_forward_and_cache(0, 0);
+        return find_forward(0, 0);
+    }
+}
+
+/// Converts the byte offsets `byte_offsets` of the source code `source` to line and column numbers
+/// in one forward scan, as `AnnotatedSource::byte_offsets_to_line_cols()` does without the line
+/// index. If `line_offset_cache` is not `nullptr`, the lines containing the offsets are cached.
+void scan_line_cols(
+    std::string_view source,
+    std::span<std::size_t const> byte_offsets,
+    std::span<SourceLocation> locations,
+    std::map<unsigned, std::size_t>* line_offset_cache
+) {
+    // Visits the offsets in ascending order, so that each newline character is scanned only once.
+    std::vector<std::size_t> order(byte_offsets.size());
+    std::iota(order.begin(), order.end(), std::size_t(0));
+    std::ranges::sort(order, std::ranges::less(), [&](std::size_t idx) {
+        return byte_offsets[idx];
+    });
+
+    // The line containing the current offset, the offset of its first byte, and the offset of the
+    // newline character ending it.
+    unsigned line = 0;
+    std::size_t line_start = 0;
+    std::size_t line_end = source.find('\n');
+    for (std::size_t const idx : order) {
+        std::size_t const byte_offset = byte_offsets[idx];
+
+        // Skips the lines that end before `byte_offset`. An offset beyond the end of the source
+        // code skips all lines, and is on the line following the last line, unless the source code
+        // ends with '\n' (in which case that line has already been reached).
+        while (line_end < std::min(byte_offset, source.size())) {
+            ++line;
+            line_start = line_end + 1;
+            line_end = source.find('\n', line_start);
+        }
+        if (byte_offset >= source.size() && line_start != source.size()) {
+            ++line;
+            line_start = source.size();
+        }
+
+        if (line_offset_cache != nullptr) {
+            line_offset_cache->try_emplace(line, line_start);
+        }
+        locations[idx] = {
+            .line = line,
+            .col = static_cast<unsigned>(byte_offset - line_start),
+        };
+    }
+}
+
+/// Returns the content of the line of `source` starting at `line_start`, where `line_end` is the
+/// start of the next line, without the trailing newline character.
+auto line_content_between(std::string_view source, std::size_t line_start, std::size_t line_end)
+    -> std::string_view {
+    if (line_start >= source.size()) {
+        return {};
+    } else {
+        std::string_view result = source.substr(line_start, line_end - line_start);
+
+        // Remove the trailing '\n'.
+        if (!result.empty() && result.back() == '\n') {
+            result = result.substr(0, result.size() - 1);
+
+            // If the end is "\r\n", remove both characters.
+            if (!result.empty() && result.back() == '\r') {
+                result = result.substr(0, result.size() - 1);
+            }
+        }
+
+        return result;
     }
 }
 }  // namespace
 
+AnnotatedSource::AnnotatedSource(std::shared_ptr<SourceFile const> file) : file_(std::move(file)) {
+    if (file_ == nullptr) {
+        throw std::invalid_argument("ants::AnnotatedSource: the source file is null");
+    }
+
+    source_ = file_->source();
+    origin_ = file_->origin();
+}
+
+void AnnotatedSource::build_line_index() {
+    if (file_ != nullptr) {
+        // Shares the index of the file instead of building a new one. The aliasing constructor
+        // keeps the file (which owns the index) alive.
+        line_index_ = std::shared_ptr<LineIndex const>(file_, &file_->line_index());
+    } else {
+        line_index_ = std::make_shared<LineIndex const>(source_);
+    }
+}
+
 auto AnnotatedSource::line_offset(unsigned line) -> std::size_t {
+    if (LineIndex const* const index = line_index(); index != nullptr) {
+        return index->line_offset(line);
+    }
+
     if (auto const cache_iter = line_offsets_.find(line); cache_iter != line_offsets_.end()) {
         // If the result is already cached in the map, returns it directly.
         return cache_iter->second;
     } else {
-        return compute_line_offset(line_offsets_, line, source_);
+        auto const entry = compute_line_offset(line, source_, line_offsets_);
+        line_offsets_.insert(entry);
+        return entry.second;
+    }
+}
+
+auto AnnotatedSource::line_offset(unsigned line) const -> std::size_t {
+    if (LineIndex const* const index = line_index(); index != nullptr) {
+        return index->line_offset(line);
+    }
+
+    if (auto const cache_iter = line_offsets_.find(line); cache_iter != line_offsets_.end()) {
+        return cache_iter->second;
+    } else {
+        return compute_line_offset(line, source_, line_offsets_).second;
     }
 }
 
+auto AnnotatedSource::line_offset(unsigned line, LineOffsetMemo& memo) const -> std::size_t {
+    if (LineIndex const* const index = line_index(); index != nullptr) {
+        return index->line_offset(line);
+    }
+
+    if (auto const cache_iter = line_offsets_.find(line); cache_iter != line_offsets_.end()) {
+        return cache_iter->second;
+    } else if (auto const memo_iter = memo.find(line); memo_iter != memo.end()) {
+        return memo_iter->second;
+    }
+
+    // The search starts from the closest line known by either the cache or the memo, but only the
+    // lines computed here are memoized.
+    auto const entry = compute_line_offset(line, source_, line_offsets_, memo);
+    memo.insert(entry);
+    return entry.second;
+}
+
 auto AnnotatedSource::byte_offset_to_line_col(std::size_t byte_offset) -> SourceLocation {
-    auto const [line, line_start] = byte_offset_to_line(line_offsets_, byte_offset, source_);
+    if (line_index() != nullptr) {
+        return std::as_const(*this).byte_offset_to_line_col(byte_offset);
+    }
+
+    auto const entry = byte_offset_to_line(line_offsets_, byte_offset, source_);
+    line_offsets_.insert(entry);
+    return {
+        .line = entry.first,
+        .col = static_cast<unsigned>(byte_offset - entry.second),
+    };
+}
+
+auto AnnotatedSource::byte_offset_to_line_col(std::size_t byte_offset) const -> SourceLocation {
+    LineIndex const* const index = line_index();
+    auto const [line, line_start] = index != nullptr
+        ? index->byte_offset_to_line(byte_offset)
+        : byte_offset_to_line(line_offsets_, byte_offset, source_);
     return {
         .line = line,
         .col = static_cast<unsigned>(byte_offset - line_start),
     };
 }
 
-auto AnnotatedSource::line_content(unsigned line) -> std::string_view {
-    std::size_t const line_start = line_offset(line);
-    std::size_t const line_end = line_offset(line + 1);
+void AnnotatedSource::byte_offsets_to_line_cols(
+    std::span<std::size_t const> byte_offsets,
+    std::span<SourceLocation> locations
+) {
+    if (line_index() != nullptr) {
+        std::as_const(*this).byte_offsets_to_line_cols(byte_offsets, locations);
+    } else {
+        scan_line_cols(source_, byte_offsets, locations, &line_offsets_);
+    }
+}
 
-    if (line_start >= source_.size()) {
-        return {};
+void AnnotatedSource::byte_offsets_to_line_cols(
+    std::span<std::size_t const> byte_offsets,
+    std::span<SourceLocation> locations
+) const {
+    if (LineIndex const* const index = line_index(); index != nullptr) {
+        for (std::size_t idx = 0; idx != byte_offsets.size(); ++idx) {
+            auto const [line, line_start] = index->byte_offset_to_line(byte_offsets[idx]);
+            locations[idx] = {
+                .line = line,
+                .col = static_cast<unsigned>(byte_offsets[idx] - line_start),
+            };
+        }
     } else {
-        std::string_view result = source_.substr(line_start, line_end - line_start);
+        scan_line_cols(source_, byte_offsets, locations, nullptr);
+    }
+}
 
-        // Remove the trailing '\n'.
-        if (!result.empty() && result.back() == '\n') {
-            result = result.substr(0, result.size() - 1);
+void AnnotatedSource::append_converted_spans(
+    std::vector<LabeledSpan>& target,
+    std::span<LabeledByteSpan const> spans
+) {
+    std::vector<std::size_t> byte_offsets;
+    byte_offsets.reserve(2 * spans.size());
+    for (LabeledByteSpan const& span : spans) {
+        byte_offsets.push_back(span.beg);
+        byte_offsets.push_back(span.end);
+    }
 
-            // If the end is "\r\n", remove both characters.
-            if (!result.empty() && result.back() == '\r') {
-                result = result.substr(0, result.size() - 1);
-            }
-        }
+    std::vector<SourceLocation> locations(byte_offsets.size());
+    byte_offsets_to_line_cols(byte_offsets, locations);
 
-        return result;
+    target.reserve(target.size() + spans.size());
+    for (std::size_t idx = 0; idx != spans.size(); ++idx) {
+        target.push_back(LabeledSpan {
+            .beg = locations[2 * idx],
+            .end = locations[2 * idx + 1],
+            .label = spans[idx].label,
+            .deferred_label {},
+        });
     }
 }
+
+auto AnnotatedSource::line_content(unsigned line) const -> std::string_view {
+    return line_content_between(source_, line_offset(line), line_offset(line + 1));
+}
+
+auto AnnotatedSource::line_content(unsigned line, LineOffsetMemo& memo) const -> std::string_view {
+    return line_content_between(source_, line_offset(line, memo), line_offset(line + 1, memo));
+}
 }  // namespace ants
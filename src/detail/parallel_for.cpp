@@ -0,0 +1,60 @@
+#include "annotate_snippets/detail/parallel_for.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+
+namespace ants::detail {
+void parallel_for(
+    std::size_t count,
+    unsigned thread_count,
+    std::function<void(std::size_t, std::pmr::memory_resource*)> const& body
+) {
+    if (thread_count == 0) {
+        thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    std::size_t const worker_count = std::min<std::size_t>(count, thread_count);
+    if (worker_count == 0) {
+        return;
+    }
+
+    // An exception thrown by `body` stops the worker that called it, and the other workers stop
+    // taking new indices. The first exception of each worker is kept until all workers are joined.
+    std::atomic<std::size_t> next_index = 0;
+    std::vector<std::exception_ptr> exceptions(worker_count);
+    auto const work = [&](std::size_t worker_idx) {
+        try {
+            std::pmr::unsynchronized_pool_resource scratch;
+            std::size_t index = 0;
+            while ((index = next_index.fetch_add(1, std::memory_order_relaxed)) < count) {
+                body(index, &scratch);
+            }
+        } catch (...) {
+            exceptions[worker_idx] = std::current_exception();
+            next_index.store(count, std::memory_order_relaxed);
+        }
+    };
+
+    // The calling thread is one of the workers. The other threads are joined before any exception
+    // is rethrown.
+    {
+        std::vector<std::jthread> workers;
+        workers.reserve(worker_count - 1);
+        for (std::size_t idx = 1; idx != worker_count; ++idx) {
+            workers.emplace_back(work, idx);
+        }
+        work(0);
+    }
+
+    for (std::exception_ptr const& exception : exceptions) {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+}
+}  // namespace ants::detail
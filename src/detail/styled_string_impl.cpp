@@ -6,8 +6,10 @@
 #include <cstddef>
 #include <initializer_list>
 #include <iterator>
+#include <limits>
+#include <ranges>
+#include <span>
 #include <string_view>
-#include <utility>
 #include <vector>
 
 namespace ants::detail {
@@ -54,118 +56,157 @@ void StyledStringImpl::set_style(Style style, std::size_t start_index, std::size
     // clang-format on
 }
 
-auto StyledStringImpl::styled_line_parts(  //
-    std::string_view content
-) const -> std::vector<std::vector<StyledStringViewPart>> {
-    std::vector<std::vector<StyledStringViewPart>> lines;
-    // Find the '\n' and split the content into multiple lines. We don't use std::ranges::split
-    // because we need to preserve the '\n' characters.
-    for (std::size_t start = 0; start != content.size();) {
-        std::size_t const pos = content.find('\n', start);
-        if (pos == std::string_view::npos) {
-            // We cannot find '\n', so we add the rest of the string as a new line to the result and
-            // exit the loop.
-            lines.push_back({
-                { .content = content.substr(start), .style {} }
-            });
-            break;
-        } else {
-            lines.push_back({
-                // Note that the substring contains newline characters here, which will be removed
-                // in subsequent operations.
-                { .content = content.substr(start, pos - start + 1), .style {} }
-            });
-            start = pos + 1;
+void StyledStringImpl::set_styles(std::span<StyleEdit const> edits) {
+    // The positions where the edits start or end, sorted by position.
+    struct Boundary {
+        std::size_t pos;
+        std::size_t edit_idx;
+        bool is_start;
+    };
+
+    std::vector<Boundary> boundaries;
+    boundaries.reserve(2 * edits.size());
+    for (std::size_t idx = 0; idx != edits.size(); ++idx) {
+        // Empty edits modify nothing.
+        StyleEdit const& edit = edits[idx];
+        if (edit.start_index != edit.end_index) {
+            boundaries.push_back({ .pos = edit.start_index, .edit_idx = idx, .is_start = true });
+            boundaries.push_back({ .pos = edit.end_index, .edit_idx = idx, .is_start = false });
         }
     }
+    if (boundaries.empty()) {
+        return;
+    }
+    // NOLINTNEXTLINE(misc-include-cleaner): See the comment in `set_style()`.
+    std::ranges::sort(boundaries, std::ranges::less(), &Boundary::pos);
+
+    // Resolve the edits into a sequence of parts, each of which is covered by the same last edit.
+    // `no_edit` marks the parts not covered by any edit, which keep their existing styles.
+    constexpr std::size_t no_edit = std::numeric_limits<std::size_t>::max();
+    struct EditPart {
+        std::size_t start_index;
+        std::size_t edit_idx;
+    };
+
+    std::vector<EditPart> edit_parts;
+    // A max-heap of the indices of the edits covering the current position. The edits that have
+    // ended are removed lazily once they reach the top.
+    std::vector<std::size_t> active_edits;
+    std::vector<bool> ended(edits.size(), false);
+    for (auto iter = boundaries.begin(); iter != boundaries.end();) {
+        std::size_t const pos = iter->pos;
+        for (; iter != boundaries.end() && iter->pos == pos; ++iter) {
+            if (iter->is_start) {
+                active_edits.push_back(iter->edit_idx);
+                std::ranges::push_heap(active_edits);
+            } else {
+                ended[iter->edit_idx] = true;
+            }
+        }
+        while (!active_edits.empty() && ended[active_edits.front()]) {
+            std::ranges::pop_heap(active_edits);
+            active_edits.pop_back();
+        }
 
-    // Merges parts with the same style within `styled_parts_`.
-    // It is considered easier and safer to merge parts with the same style here rather than
-    // enforcing that modifiers cannot insert parts with the same style.
-    std::vector<StyledPart> merged_parts;
-    merged_parts.reserve(styled_parts_.size());
-    merged_parts.push_back(styled_parts_.front());
-
-    for (std::size_t part_index = 1; part_index != styled_parts_.size() - 1; ++part_index) {
-        if (styled_parts_[part_index].style != styled_parts_[part_index - 1].style) {
-            merged_parts.push_back(styled_parts_[part_index]);
+        std::size_t const edit_idx = active_edits.empty() ? no_edit : active_edits.front();
+        if (edit_parts.empty() || edit_parts.back().edit_idx != edit_idx) {
+            edit_parts.push_back({ .start_index = pos, .edit_idx = edit_idx });
         }
     }
 
-    merged_parts.push_back(styled_parts_.back());
-
-    // Now we need to further split each line into substrings consisting of consecutive characters
-    // of the same style. We process line by line, and for each line, we always set the unprocessed
-    // string at the last element of the vector.
-
-    // The index of the line we are currently processing.
-    std::size_t cur_line_index = 0;
-    for (std::size_t part_index = 0; part_index != merged_parts.size() - 1; ++part_index) {
-        // We must use two adjacent StyledPart objects to determine a substring, as stated in the
-        // documentation comment for the StyledPart class.
-        std::size_t part_beg = merged_parts[part_index].start_index;
-        std::size_t const part_end = merged_parts[part_index + 1].start_index;
-        Style const part_style = merged_parts[part_index].style;
-
-        // The current part covers the entire unprocessed string of this line, so we process the
-        // remaining string and move to the next line.
-        for (; cur_line_index != lines.size()
-             && part_end - part_beg >= lines[cur_line_index].back().content.size();
-             ++cur_line_index) {
-            StyledStringViewPart& unprocessed_part = lines[cur_line_index].back();
-            std::string_view& unprocessed_content = unprocessed_part.content;
-
-            // Update the style of the unprocessed part.
-            unprocessed_part.style = part_style;
-
-            // We must update part_beg here, because we may modify unprocessed_content later.
-            part_beg += unprocessed_content.size();
-
-            // Remove '\n' and '\r\n'.
-            if (!unprocessed_content.empty() && unprocessed_content.back() == '\n') {
-                unprocessed_content = unprocessed_content.substr(0, unprocessed_content.size() - 1);
-
-                if (!unprocessed_content.empty() && unprocessed_content.back() == '\r') {
-                    unprocessed_content =
-                        unprocessed_content.substr(0, unprocessed_content.size() - 1);
-                }
-            }
-
-            // When a style ends at the position of a newline character, an extra empty string may
-            // be generated, which is unexpected.
-            //
-            // Fox example, we have a string "abc\n" of style Style::Auto and set the style of its
-            // substring "abc" as Style::Highlight. During processing, we will pack substring "abc"
-            // and its style Style::Highlight into a single StyledStringPart, and leave the string
-            // "\n" to be processed. When we process "\n", we will insert an empty string with
-            // Style::Auto into the result and generate unexpected result: { { "abc",
-            // Style::Highlight }, { "", Style::Auto } }. So we should remove the empty string here.
-            //
-            // Note that if a line is empty, we keep it. So we remove the unneeded elements at the
-            // end only if lines[cur_line_index].size() > 1 (which means the line is not empty).
-            if (unprocessed_content.empty() && lines[cur_line_index].size() > 1) {
-                lines[cur_line_index].pop_back();
-            }
+    // Merge the resolved edits with the existing parts. The last existing part only marks the end
+    // of the string, so it is kept as is.
+    std::size_t const content_size = styled_parts_.back().start_index;
+    std::size_t const existing_part_num = styled_parts_.size() - 1;
+
+    StyledParts result;
+    result.reserve(existing_part_num + edit_parts.size() + 1);
+    auto const append_part = [&](std::size_t pos, Style style) {
+        // A part starting at the same position is empty, so it is replaced.
+        if (!result.empty() && result.back().start_index == pos) {
+            result.pop_back();
+        }
+        if (result.empty() || result.back().style != style) {
+            result.push_back({ .start_index = pos, .style = style });
+        }
+    };
+
+    std::size_t part_idx = 0;
+    std::size_t edit_part_idx = 0;
+    Style existing_style;
+    std::size_t edit_idx = no_edit;
+    while (true) {
+        std::size_t const pos = std::min(
+            part_idx != existing_part_num ? styled_parts_[part_idx].start_index : content_size,
+            edit_part_idx != edit_parts.size() ? edit_parts[edit_part_idx].start_index
+                                               : content_size
+        );
+        if (pos >= content_size) {
+            break;
         }
 
-        // The current style ends exactly at the end of this line, so we continue to process the
-        // next line.
-        if (part_beg == part_end) {
-            continue;
+        for (; part_idx != existing_part_num && styled_parts_[part_idx].start_index == pos;
+             ++part_idx) {
+            existing_style = styled_parts_[part_idx].style;
+        }
+        for (; edit_part_idx != edit_parts.size() && edit_parts[edit_part_idx].start_index == pos;
+             ++edit_part_idx) {
+            edit_idx = edit_parts[edit_part_idx].edit_idx;
         }
+        append_part(pos, edit_idx == no_edit ? existing_style : edits[edit_idx].style);
+    }
+    result.push_back(styled_parts_.back());
 
-        // The current style ends in the middle of the string to be processed. We split the string
-        // into two parts and insert the latter part as a new unprocessed string into the end of the
-        // container.
-        StyledStringViewPart& old_part = lines[cur_line_index].back();
-        old_part.style = part_style;
-
-        std::string_view const rest_content =
-            std::exchange(old_part.content, old_part.content.substr(0, part_end - part_beg))
-                .substr(part_end - part_beg);
-        lines[cur_line_index].push_back(  //
-            StyledStringViewPart { .content = rest_content, .style {} }
-        );
+    styled_parts_ = std::move(result);
+}
+
+void StyledStringImpl::remove_styled_parts_prefix(std::size_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    // The `start_index` of the last element is the length of the string.
+    if (count >= styled_parts_.back().start_index) {
+        // clang-format off
+        styled_parts_ = {
+            { .start_index = 0, .style {} },
+            { .start_index = 0, .style {} },
+        };
+        // clang-format on
+        return;
+    }
+
+    // Points to the part containing the character at `count`, which will become the first part.
+    // Since `styled_parts_.front().start_index` is 0, `upper_bound()` never returns the first
+    // element, so we can call prev() on it safely.
+    // NOLINTBEGIN(misc-include-cleaner): The include cleaner mistakenly assumes that `<algorithm>`
+    // is not the header for `std::ranges::upper_bound`, resulting in the warning. See
+    // https://github.com/llvm/llvm-project/issues/94459.
+    auto const first_iter = std::ranges::prev(std::ranges::upper_bound(
+        styled_parts_,
+        count,
+        std::ranges::less(),
+        [](StyledPart const& part) { return part.start_index; }
+    ));
+    // NOLINTEND(misc-include-cleaner)
+
+    styled_parts_.erase(styled_parts_.begin(), first_iter);
+
+    styled_parts_.front().start_index = 0;
+    for (StyledPart& part : styled_parts_ | std::views::drop(1)) {
+        part.start_index -= count;
+    }
+}
+
+auto StyledStringImpl::styled_line_parts(  //
+    std::string_view content
+) const -> std::vector<std::vector<StyledStringViewPart>> {
+    std::vector<std::vector<StyledStringViewPart>> lines;
+    for (StyledLine const& line : styled_lines(content)) {
+        std::vector<StyledStringViewPart>& parts = lines.emplace_back();
+        for (StyledStringViewPart const part : line) {
+            parts.push_back(part);
+        }
     }
 
     return lines;
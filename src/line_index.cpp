@@ -0,0 +1,166 @@
+#include "annotate_snippets/line_index.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define ANNOTATE_SNIPPETS_LINE_INDEX_SSE2
+    #include <emmintrin.h>
+    // With GCC and Clang, we can compile an AVX2 version of the scanner without enabling AVX2 for
+    // the whole translation unit, and select it at runtime.
+    #if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        #define ANNOTATE_SNIPPETS_LINE_INDEX_AVX2
+        #include <immintrin.h>
+    #endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+    #define ANNOTATE_SNIPPETS_LINE_INDEX_NEON
+    #include <arm_neon.h>
+#endif
+
+namespace ants {
+namespace {
+/// Appends the start of the line following each newline character in a block of the source code to
+/// `line_starts`. `block_offset` is the offset of the first byte of the block, and the i-th bit of
+/// `mask` is set iff the i-th byte of the block is '\n'.
+template <class Mask>
+void push_line_starts(std::vector<std::size_t>& line_starts, std::size_t block_offset, Mask mask) {
+    while (mask != 0) {
+        line_starts.push_back(block_offset + static_cast<std::size_t>(std::countr_zero(mask)) + 1);
+        mask &= mask - 1;
+    }
+}
+
+// Each of the following functions scans a prefix of `source` whose size is a multiple of the block
+// size, appends the line starts found in it to `line_starts`, and returns the size of the scanned
+// prefix. The remaining bytes are scanned by the caller.
+
+#ifdef ANNOTATE_SNIPPETS_LINE_INDEX_AVX2
+__attribute__((target("avx2"))) auto scan_newlines_avx2(
+    std::string_view source,
+    std::vector<std::size_t>& line_starts
+) -> std::size_t {
+    __m256i const newline = _mm256_set1_epi8('\n');
+
+    std::size_t offset = 0;
+    for (; source.size() - offset >= 32; offset += 32) {
+        __m256i const block =
+            _mm256_loadu_si256(reinterpret_cast<__m256i const*>(source.data() + offset));
+        auto const mask =
+            static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline)));
+        push_line_starts(line_starts, offset, mask);
+    }
+
+    return offset;
+}
+#endif
+
+#ifdef ANNOTATE_SNIPPETS_LINE_INDEX_SSE2
+auto scan_newlines_sse2(
+    std::string_view source,
+    std::vector<std::size_t>& line_starts
+) -> std::size_t {
+    __m128i const newline = _mm_set1_epi8('\n');
+
+    std::size_t offset = 0;
+    for (; source.size() - offset >= 16; offset += 16) {
+        __m128i const block =
+            _mm_loadu_si128(reinterpret_cast<__m128i const*>(source.data() + offset));
+        auto const mask =
+            static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+        push_line_starts(line_starts, offset, mask);
+    }
+
+    return offset;
+}
+#endif
+
+#ifdef ANNOTATE_SNIPPETS_LINE_INDEX_NEON
+auto scan_newlines_neon(
+    std::string_view source,
+    std::vector<std::size_t>& line_starts
+) -> std::size_t {
+    uint8x16_t const newline = vdupq_n_u8('\n');
+
+    std::size_t offset = 0;
+    for (; source.size() - offset >= 16; offset += 16) {
+        uint8x16_t const block =
+            vld1q_u8(reinterpret_cast<std::uint8_t const*>(source.data() + offset));
+        uint8x16_t const matches = vceqq_u8(block, newline);
+        // NEON has no equivalent of `movemask`. Instead, we narrow each byte of the comparison
+        // result to 4 bits, and keep only one bit of each nibble, so that the i-th byte of the
+        // block corresponds to the (4i+3)-th bit of the mask.
+        std::uint64_t mask = vget_lane_u64(
+            vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)),
+            0
+        );
+        mask &= 0x8888'8888'8888'8888;
+
+        while (mask != 0) {
+            auto const byte = static_cast<std::size_t>(std::countr_zero(mask)) / 4;
+            line_starts.push_back(offset + byte + 1);
+            mask &= mask - 1;
+        }
+    }
+
+    return offset;
+}
+#endif
+
+/// Scans as much of `source` as possible with the SIMD instructions available, appending the start
+/// of each line following a newline character to `line_starts`. Returns the size of the scanned
+/// prefix of `source`.
+auto scan_newlines(std::string_view source, std::vector<std::size_t>& line_starts) -> std::size_t {
+#ifdef ANNOTATE_SNIPPETS_LINE_INDEX_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return scan_newlines_avx2(source, line_starts);
+    }
+#endif
+
+#if defined(ANNOTATE_SNIPPETS_LINE_INDEX_SSE2)
+    return scan_newlines_sse2(source, line_starts);
+#elif defined(ANNOTATE_SNIPPETS_LINE_INDEX_NEON)
+    return scan_newlines_neon(source, line_starts);
+#else
+    // No SIMD instructions are available. Everything is scanned by the scalar fallback.
+    static_cast<void>(source);
+    static_cast<void>(line_starts);
+    return 0;
+#endif
+}
+}  // namespace
+
+LineIndex::LineIndex(std::string_view source) : line_starts_ { 0 }, source_size_(source.size()) {
+    // Scans the bytes that cannot fill a complete block (or all bytes if there is no SIMD support).
+    for (std::size_t pos = source.find('\n', scan_newlines(source, line_starts_));
+         pos != std::string_view::npos;
+         pos = source.find('\n', pos + 1)) {
+        line_starts_.push_back(pos + 1);
+    }
+
+    // If `source` does not end with '\n', we add the hypothetical line following the actual last
+    // line. Otherwise the start of the (empty) actual last line has been added above.
+    if (!source.empty() && source.back() != '\n') {
+        line_starts_.push_back(source.size());
+    }
+}
+
+auto LineIndex::byte_offset_to_line(std::size_t byte_offset) const
+    -> std::pair<unsigned, std::size_t> {
+    // Finds the last line starting at or before `byte_offset`. Since `line_starts_[0]` is 0, such a
+    // line always exists. If `byte_offset` exceeds the valid range of the source code, this is the
+    // last line of the index, which starts at the end of the source code.
+    // NOLINTBEGIN(misc-include-cleaner): The include cleaner mistakenly assumes that `<algorithm>`
+    // is not the header for `std::ranges::upper_bound`, resulting in the warning. See
+    // https://github.com/llvm/llvm-project/issues/94459.
+    auto const next_iter = std::ranges::upper_bound(line_starts_, byte_offset);
+    // NOLINTEND(misc-include-cleaner)
+    auto const line = static_cast<unsigned>(next_iter - line_starts_.begin() - 1);
+
+    return { line, line_starts_[line] };
+}
+}  // namespace ants
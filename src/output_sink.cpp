@@ -0,0 +1,64 @@
+#include "annotate_snippets/output_sink.hpp"
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+#ifndef _WIN32
+    #include <sys/types.h>
+    #include <sys/uio.h>
+
+    #include <cerrno>
+#endif
+
+namespace ants {
+#ifndef _WIN32
+void FdSink::write(std::string_view str) {
+    if (buffer_capacity - buffer_size_ >= str.size()) {
+        str.copy(buffer_.data() + buffer_size_, str.size());
+        buffer_size_ += str.size();
+    } else {
+        write_through(str);
+    }
+}
+
+void FdSink::write_through(std::string_view str) {
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-const-cast): `iovec` is also used for `readv()`, so
+    // its pointer is not const-qualified, although `writev()` never modifies the data.
+    std::array<iovec, 2> iov { {
+        { .iov_base = buffer_.data(), .iov_len = buffer_size_ },
+        { .iov_base = const_cast<char*>(str.data()), .iov_len = str.size() },
+    } };
+    // NOLINTEND(cppcoreguidelines-pro-type-const-cast)
+    buffer_size_ = 0;
+
+    iovec* first = iov.data();
+    int count = static_cast<int>(iov.size());
+    while (count != 0) {
+        if (first->iov_len == 0) {
+            ++first;
+            --count;
+            continue;
+        }
+
+        ssize_t const written = ::writev(fd_, first, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        // Skips the written bytes, which may end in the middle of a buffer.
+        auto remaining = static_cast<std::size_t>(written);
+        for (; count != 0 && remaining >= first->iov_len; ++first, --count) {
+            remaining -= first->iov_len;
+        }
+        if (count != 0) {
+            first->iov_base = static_cast<char*>(first->iov_base) + remaining;
+            first->iov_len -= remaining;
+        }
+    }
+}
+#endif
+}  // namespace ants
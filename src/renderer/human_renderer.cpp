@@ -1,19 +1,28 @@
 #include "annotate_snippets/renderer/human_renderer.hpp"
 
 #include "annotate_snippets/annotated_source.hpp"
+#include "annotate_snippets/detail/hash.hpp"
+#include "annotate_snippets/detail/parallel_for.hpp"
 #include "annotate_snippets/detail/styled_string_impl.hpp"
 #include "annotate_snippets/detail/unicode_display_width.hpp"
+#include "annotate_snippets/renderer/render_cache.hpp"
+#include "annotate_snippets/renderer/render_observer.hpp"
 #include "annotate_snippets/style.hpp"
 #include "annotate_snippets/styled_string.hpp"
 #include "annotate_snippets/styled_string_view.hpp"
 
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <climits>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <iterator>
-#include <map>
 #include <memory>
+#include <memory_resource>
+#include <numeric>
 #include <queue>
 #include <ranges>
 #include <span>
@@ -91,9 +100,60 @@ using std::unreachable;
 }
 #endif
 }  // namespace
+
+void OutputBudget::measure(StyledString const& render_target) {
+    std::string_view const unmeasured =
+        std::string_view(render_target.content()).substr(measured_size);
+    line_num += static_cast<std::size_t>(std::ranges::count(unmeasured, '\n'));
+    byte_num += unmeasured.size();
+    measured_size = render_target.content().size();
+}
+
+auto OutputBudget::is_used_up(std::size_t max_lines, std::size_t max_bytes) const -> bool {
+    return (max_lines != 0 && line_num >= max_lines) || (max_bytes != 0 && byte_num >= max_bytes);
+}
 }  // namespace detail
 
 namespace {
+/// Returns the observer notified of the layout of the sources rendered by `renderer`. If the hooks
+/// are compiled out (see `RenderObserver`), this is always `nullptr`, so that all notifications
+/// are removed as dead code.
+auto render_observer_of([[maybe_unused]] HumanRenderer const& renderer) -> RenderObserver* {
+#ifdef ANNOTATE_SNIPPETS_ENABLE_TRACING
+    return renderer.render_observer;
+#else
+    return nullptr;
+#endif
+}
+
+/// Notifies `observer` of the beginning of `phase` of the rendering of `source` when constructed,
+/// and of its end when destroyed. If `observer` is `nullptr`, nothing is done.
+class ScopedRenderPhase {
+public:
+    ScopedRenderPhase(RenderObserver* observer, AnnotatedSource const& source, RenderPhase phase) :
+        observer_(observer), source_(&source), phase_(phase) {
+        if (observer_ != nullptr) {
+            observer_->on_phase_begin(*source_, phase_, RenderObserver::clock::now());
+        }
+    }
+
+    ScopedRenderPhase(ScopedRenderPhase const&) = delete;
+    ScopedRenderPhase(ScopedRenderPhase&&) = delete;
+    auto operator=(ScopedRenderPhase const&) -> ScopedRenderPhase& = delete;
+    auto operator=(ScopedRenderPhase&&) -> ScopedRenderPhase& = delete;
+
+    ~ScopedRenderPhase() {
+        if (observer_ != nullptr) {
+            observer_->on_phase_end(*source_, phase_, RenderObserver::clock::now());
+        }
+    }
+
+private:
+    RenderObserver* observer_;
+    AnnotatedSource const* source_;
+    RenderPhase phase_;
+};
+
 /// Renders a multi-line message `message` with indentation `indentation` onto `render_target`. The
 /// first line of `message` will continue directly from the existing content in `render_target`,
 /// while other lines will be rendered on new lines with the specified `indentation`. Any parts in
@@ -104,7 +164,7 @@ void render_multiline_messages(
     unsigned indentation,
     Style auto_replacement
 ) {
-    std::vector<std::vector<StyledStringViewPart>> const lines = message.styled_line_parts();
+    StyledLineRange const lines = message.styled_lines();
     if (lines.empty()) {
         return;
     }
@@ -113,10 +173,10 @@ void render_multiline_messages(
     render_target.append(lines.front(), auto_replacement);
 
     // Render the subsequent lines. Before rendering each line, insert sufficient indentation.
-    for (std::vector<StyledStringViewPart> const& parts : lines | std::views::drop(1)) {
+    for (StyledLine const& line : lines | std::views::drop(1)) {
         render_target.append_newline();
         render_target.append_spaces(indentation);
-        render_target.append(parts, auto_replacement);
+        render_target.append(line, auto_replacement);
     }
 }
 }  // namespace
@@ -229,29 +289,21 @@ void render_line_number(StyledString& render_target, unsigned max_line_num_len)
 
 /// Renders line numbers according to the specified alignment, along with the vertical bar separator
 /// between the line number and the source code.
-void render_line_number(
-    StyledString& render_target,
-    unsigned max_line_num_len,
-    unsigned line_num,
-    HumanRenderer::LineNumAlignment line_num_alignment
-) {
+template <HumanRenderer::LineNumAlignment line_num_alignment>
+void render_line_number(StyledString& render_target, unsigned max_line_num_len, unsigned line_num) {
     std::string const line_num_str = std::to_string(line_num);
 
-    switch (line_num_alignment) {
-    case HumanRenderer::AlignLeft:
+    if constexpr (line_num_alignment == HumanRenderer::AlignLeft) {
         render_target.append(line_num_str, Style::LineNumber);
         // Adds sufficient spaces to align the separator.
         render_target.append_spaces(max_line_num_len + 1 - line_num_str.size());
-        break;
-    case HumanRenderer::AlignRight:
+    } else {
+        static_assert(line_num_alignment == HumanRenderer::AlignRight);
         // Adds sufficient spaces to ensure the line number text is right-aligned.
         render_target.append_spaces(max_line_num_len - line_num_str.size());
         render_target.append(line_num_str, Style::LineNumber);
         // Adds a single space between the line number and the separator.
         render_target.append_spaces(1);
-        break;
-    default:
-        detail::unreachable();
     }
 
     render_target.append("|", Style::LineNumber);
@@ -262,7 +314,7 @@ void render_line_number(
 /// main.cpp:1:3".
 void render_file_line_col(
     StyledString& render_target,
-    AnnotatedSource& source,
+    AnnotatedSource const& source,
     unsigned max_line_num_len,
     bool is_first_source
 ) {
@@ -297,36 +349,105 @@ void render_file_line_col(
     }
 }
 
-/// Replaces the tab characters in the `source` code with the number of spaces specified by
-/// `display_tab_width`. If `display_tab_width` is 0, the tab characters are not replaced.
-auto normalize_source(std::string_view source, unsigned display_tab_width) -> std::string {
-    if (display_tab_width == 0) {
-        return static_cast<std::string>(source);
+/// Appends the `source` code to `render_target` with style `Style::SourceCode`, replacing the tab
+/// characters with the number of spaces specified by `display_tab_width`. If `expands_tabs` is
+/// `false` (i.e., `display_tab_width` is 0), the tab characters are not replaced.
+template <bool expands_tabs>
+void append_normalized_source(
+    StyledString& render_target,
+    std::string_view source,
+    unsigned display_tab_width
+) {
+    if constexpr (expands_tabs) {
+        render_target.append_expanding_tabs(source, display_tab_width, Style::SourceCode);
     } else {
-        std::string normalized_source;
-        normalized_source.reserve(source.size());
-
-        for (char const ch : source) {
-            switch (ch) {
-            case '\t':
-                // Replace '\t' with the specified number of spaces.
-                normalized_source.append(display_tab_width, ' ');
-                break;
-            default:
-                normalized_source.push_back(ch);
-            }
+        render_target.append(source, Style::SourceCode);
+    }
+}
+
+/// Computes the display width of the `source` code after normalization, i.e. after the tab
+/// characters are replaced as in `append_normalized_source()`, without normalizing it.
+auto normalized_source_display_width(std::string_view source, unsigned display_tab_width)
+    -> unsigned {
+    // If `display_tab_width` is 0, the tab characters are kept, and each of them is displayed as
+    // a single column.
+    return static_cast<unsigned>(
+        detail::display_width(source, display_tab_width == 0 ? 1 : display_tab_width)
+    );
+}
+
+/// The marker rendered at the points where a long source code line is cut. See
+/// `AnnotatedLines::window_source_line()`.
+constexpr std::string_view source_line_ellipsis = "...";
+/// The display width of `source_line_ellipsis`.
+constexpr auto source_line_ellipsis_width = static_cast<unsigned>(source_line_ellipsis.size());
+
+/// The result of `advance_display_columns()` and `retreat_display_columns()`.
+struct DisplayColumnAdvance {
+    /// The byte offset reached.
+    std::size_t byte;
+    /// The display width of the characters passed over.
+    unsigned width;
+};
+
+/// Moves forward from the byte offset `beg` of the `source` code character by character, as long as
+/// the display width of the characters passed over (after normalization) does not exceed
+/// `max_width`. Only the characters passed over are decoded.
+auto advance_display_columns(
+    std::string_view source,
+    std::size_t beg,
+    unsigned max_width,
+    unsigned display_tab_width
+) -> DisplayColumnAdvance {
+    unsigned const tab_width = display_tab_width == 0 ? 1 : display_tab_width;
+
+    DisplayColumnAdvance result { .byte = beg, .width = 0 };
+    detail::for_each_codepoint(source.substr(beg), [&](std::uint32_t cp, std::string_view ch) {
+        unsigned const width =
+            cp == '\t' ? tab_width : static_cast<unsigned>(detail::code_point_display_width(cp));
+        if (result.width + width > max_width) {
+            return false;
         }
 
-        return normalized_source;
-    }
+        result.byte += ch.size();
+        result.width += width;
+        return true;
+    });
+
+    return result;
 }
 
-/// `hash_combine` implementation from Boost.
-template <class T>
-auto hash_combine(std::size_t seed, T const& value) -> std::size_t {
-    std::hash<T> const hasher;
-    seed ^= hasher(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-    return seed;
+/// Moves backward from the byte offset `end` of the `source` code character by character, as long
+/// as the display width of the characters passed over (after normalization) does not exceed
+/// `max_width`. Only the characters passed over are decoded.
+auto retreat_display_columns(
+    std::string_view source,
+    std::size_t end,
+    unsigned max_width,
+    unsigned display_tab_width
+) -> DisplayColumnAdvance {
+    DisplayColumnAdvance result { .byte = end, .width = 0 };
+    while (result.byte != 0) {
+        // Find the first byte of the previous character by skipping the UTF-8 continuation bytes.
+        std::size_t beg = result.byte - 1;
+        while (beg != 0 && result.byte - beg < 4
+               && (static_cast<unsigned char>(source[beg]) & 0xc0) == 0x80) {
+            --beg;
+        }
+
+        unsigned const width = normalized_source_display_width(
+            source.substr(beg, result.byte - beg),
+            display_tab_width
+        );
+        if (result.width + width > max_width) {
+            break;
+        }
+
+        result.byte = beg;
+        result.width += width;
+    }
+
+    return result;
 }
 
 /// Represents a multi-line annotation.
@@ -335,7 +456,16 @@ auto hash_combine(std::size_t seed, T const& value) -> std::size_t {
 /// multi-line annotations differently, it converts all single-line annotations to `Annotation` and
 /// multi-line annotations to `MultilineAnnotation` for processing (i.e., assigning depths to these
 /// annotations). Ultimately, `MultilineAnnotation` will be further converted into `Annotation`.
-struct MultilineAnnotation : public LabeledSpan {
+struct MultilineAnnotation {
+    /// The location of the first byte of the annotation.
+    SourceLocation beg;
+    /// The location right after the last byte of the annotation, after being adjusted by
+    /// `AnnotatedLines::adjusted_span_end()`.
+    SourceLocation end;
+    /// The label attached to this annotation. It refers to the label of the `LabeledSpan` stored
+    /// in the annotated source, since the renderer neither copies nor modifies the spans it
+    /// renders.
+    StyledStringView const* label;
     /// The rendering depth of this multi-line annotation.
     ///
     /// We use depth to control the rendering layers of multi-line annotations to prevent multiple
@@ -356,8 +486,13 @@ struct MultilineAnnotation : public LabeledSpan {
     /// will be passed to `Annotation`.
     bool is_primary;
 
-    MultilineAnnotation(LabeledSpan span, bool is_primary) :
-        LabeledSpan(std::move(span)), is_primary(is_primary) { }
+    MultilineAnnotation(
+        SourceLocation beg,
+        SourceLocation end,
+        StyledStringView const& label,
+        bool is_primary
+    ) :
+        beg(beg), end(end), label(&label), depth(0), is_primary(is_primary) { }
 };
 
 /// Represents annotations attached to a single line.
@@ -462,12 +597,18 @@ struct Annotation {
 
     Annotation() = default;
 
-    /// Constructs an `Annotation` from a single-line annotation specified by `span`.
-    static auto from_single_line_span(LabeledSpan const& span, bool is_primary) -> Annotation {
+    /// Constructs an `Annotation` from a single-line annotation starting at `beg` and ending at
+    /// `end`.
+    static auto from_single_line_span(
+        SourceLocation beg,
+        SourceLocation end,
+        StyledStringView const& label,
+        bool is_primary
+    ) -> Annotation {
         return {
-            /*label=*/span.label,
-            /*col_beg=*/span.beg.col,
-            /*col_end=*/span.end.col,
+            label,
+            /*col_beg=*/beg.col,
+            /*col_end=*/end.col,
             /*type=*/Annotation::SingleLine,
             is_primary,
         };
@@ -491,7 +632,7 @@ struct Annotation {
     /// `annotation`.
     static auto from_multiline_tail(MultilineAnnotation const& annotation) -> Annotation {
         return {
-            /*label=*/annotation.label,
+            /*label=*/*annotation.label,
             /*col_beg=*/annotation.depth,
             /*col_end=*/annotation.end.col,
             /*type=*/Annotation::MultilineTail,
@@ -570,22 +711,19 @@ struct Annotation {
     /// It's worth noting that there is no need to differentiate between single-line and multiline
     /// annotations, as the underline width for multiline annotations is 1, which ensures that the
     /// rendering effect is the same regardless of the `label_position` value.
-    auto label_display_range(  //
-        HumanRenderer::LabelPosition label_position
-    ) const -> std::tuple<unsigned, unsigned> {
+    template <HumanRenderer::LabelPosition label_position>
+    auto label_display_range() const -> std::tuple<unsigned, unsigned> {
         unsigned const label_beg = [&] {
             if (label_line_position == 0) {
                 return col_end.display + 1;
             } else {
                 auto const [underline_beg, underline_end] = underline_display_range();
 
-                switch (label_position) {
-                case HumanRenderer::Left:
+                if constexpr (label_position == HumanRenderer::Left) {
                     return underline_beg;
-                case HumanRenderer::Right:
+                } else {
+                    static_assert(label_position == HumanRenderer::Right);
                     return underline_end - 1;
-                default:
-                    detail::unreachable();
                 }
             }
         }();
@@ -635,11 +773,16 @@ private:
 };
 
 /// Represents an annotated line of source code.
+///
+/// `AnnotatedLine` is allocator-aware, so that the annotations of the lines stored in a
+/// `std::pmr::map` are allocated from the memory resource of the map.
 struct AnnotatedLine {
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
     /// The source code of the line.
     std::string_view source_line;
     /// All annotations associated with the current source line.
-    std::vector<Annotation> annotations;
+    std::pmr::vector<Annotation> annotations;
     /// The display width of the current source line (after normalization).
     unsigned line_display_width;
     /// Indicates that the current line will be omitted (rendered as "..."). If the unannotated
@@ -649,10 +792,42 @@ struct AnnotatedLine {
     /// Note that even if a line is omitted, there might still be some `MultilineBody` annotations
     /// passing through this line.
     bool omitted;
-
-    explicit AnnotatedLine(bool omitted = false) : line_display_width(0), omitted(omitted) { }
-
-    /// Renders this source code line and all its annotations into `render_target`.
+    /// Indicate that `source_line` is only a window of the actual source code line, which has been
+    /// cut at the beginning (`truncated_left`) or at the end (`truncated_right`) because the line
+    /// is too long. The cut points are rendered as "...". See
+    /// `AnnotatedLines::window_source_line()`.
+    bool truncated_left;
+    bool truncated_right;
+    /// The number of single-line annotations of this line that are dropped because of
+    /// `HumanRenderer::max_annotations_per_line`.
+    std::size_t omitted_annotation_num;
+
+    explicit AnnotatedLine(allocator_type allocator) : AnnotatedLine(false, allocator) { }
+
+    AnnotatedLine(bool omitted, allocator_type allocator) :
+        annotations(allocator),
+        line_display_width(0),
+        omitted(omitted),
+        truncated_left(false),
+        truncated_right(false),
+        omitted_annotation_num(0) { }
+
+    AnnotatedLine(AnnotatedLine&& other) noexcept = default;
+    auto operator=(AnnotatedLine&& other) -> AnnotatedLine& = default;
+
+    AnnotatedLine(AnnotatedLine&& other, allocator_type allocator) :
+        source_line(other.source_line),
+        annotations(std::move(other.annotations), allocator),
+        line_display_width(other.line_display_width),
+        omitted(other.omitted),
+        truncated_left(other.truncated_left),
+        truncated_right(other.truncated_right),
+        omitted_annotation_num(other.omitted_annotation_num) { }
+
+    /// Renders this source code line and all its annotations into `render_target`. The options of
+    /// `human_renderer` that are given by `Options` (see `LineRenderOptions`) are not read from
+    /// `human_renderer`, so that the branches on them are resolved at compile time.
+    template <class Options>
     void render(
         StyledString& render_target,
         unsigned max_line_num_len,
@@ -689,8 +864,13 @@ struct AnnotatedLine {
             }
         }();
 
-        // We create a `StyledString` for each line to facilitate later rendering.
-        std::vector<StyledString> annotation_lines(annotation_line_count);
+        // We create a `StyledStringBuilder` for each line to facilitate later rendering. The lines
+        // are painted with many small overlapping writes, whose styles are applied at once when the
+        // lines are built.
+        std::pmr::vector<StyledStringBuilder> annotation_lines(
+            annotation_line_count,
+            annotations.get_allocator()
+        );
 
         // Represents the starting rendering position for the source code line, and all annotations'
         // underlines and labels should start from this position. For example:
@@ -714,6 +894,26 @@ struct AnnotatedLine {
         // indentation for part 3.
         unsigned const source_code_indentation = depth_num == 0 ? 0 : depth_num + 1;
 
+        // No annotation line extends beyond the rightmost underline or label, and the width of a
+        // line in display columns is a close estimate of its size in bytes. Each annotation writes
+        // at most a few times to each line.
+        if (!annotation_lines.empty()) {
+            unsigned const annotation_line_width = std::ranges::max(
+                annotations | std::views::transform([](Annotation const& annotation) {
+                    return std::ranges::max(
+                        std::get<1>(annotation.underline_display_range()),
+                        std::get<1>(annotation.label_display_range<Options::label_position>())
+                    );
+                })
+            );
+            for (StyledStringBuilder& line : annotation_lines) {
+                line.reserve(
+                    annotation_line_width + source_code_indentation,
+                    2 * annotations.size()
+                );
+            }
+        }
+
         // We first render the vertical and horizontal lines that connect labels and underlines.
         //
         // We want all vertical connection lines to be rendered above the horizontal connection
@@ -736,14 +936,10 @@ struct AnnotatedLine {
         render_horizontal_lines(annotation_lines, source_code_indentation);
 
         // Next, we render the vertical connection lines in the required order.
-        render_vertical_lines(
-            annotation_lines,
-            source_code_indentation,
-            human_renderer.label_position
-        );
+        render_vertical_lines<Options::label_position>(annotation_lines, source_code_indentation);
 
         // Render all labels.
-        render_labels(annotation_lines, source_code_indentation, human_renderer.label_position);
+        render_labels<Options::label_position>(annotation_lines, source_code_indentation);
 
         // Render all underlines for the annotations.
         render_underlines(
@@ -757,17 +953,17 @@ struct AnnotatedLine {
         // render target.
 
         // Render the source code line.
-        StyledString const source_code_line = render_source_line(
+        StyledString const source_code_line = render_source_line<Options>(
             max_line_num_len,
             line_num,
             depth_num,
-            human_renderer.line_num_alignment,
             human_renderer.display_tab_width
         );
-        render_target.append(source_code_line.styled_line_parts().front());
+        render_target.append(source_code_line.styled_lines().front());
 
         // Render the annotations.
-        for (StyledString const& line : annotation_lines) {
+        for (StyledStringBuilder& line_builder : annotation_lines) {
+            StyledString const line = line_builder.build();
             render_target.append_newline();
 
             // Render the line number and separator for each line. For annotation lines, these lines
@@ -776,7 +972,7 @@ struct AnnotatedLine {
             // There is always one space between the line number separator and the actual code line.
             render_target.append_spaces(1);
 
-            render_target.append(line.styled_line_parts().front());
+            render_target.append(line.styled_lines().front());
         }
     }
 
@@ -788,7 +984,7 @@ private:
     ///   |          ^
     ///   |  ________|      <-- Render this horizontal connection line.
     void render_horizontal_lines(
-        std::span<StyledString> annotation_lines,
+        std::span<StyledStringBuilder> annotation_lines,
         unsigned source_code_indentation
     ) const {
         for (Annotation const& annotation : annotations) {
@@ -838,10 +1034,10 @@ private:
     /// 1 |      func(args)
     ///   |  ________^
     ///   | |               <-- Render this vertical line
+    template <HumanRenderer::LabelPosition label_position>
     void render_vertical_lines(
-        std::span<StyledString> annotation_lines,
-        unsigned source_code_indentation,
-        HumanRenderer::LabelPosition label_position
+        std::span<StyledStringBuilder> annotation_lines,
+        unsigned source_code_indentation
     ) {
         // We render from back to front according to the order of the lines where the labels are
         // located, to ensure the correct overlap relationship.
@@ -860,10 +1056,10 @@ private:
             if (annotation.label_line_position != 0) {
                 // Position of the connecting line.
                 unsigned const connector_position =
-                    std::get<0>(annotation.label_display_range(label_position))
+                    std::get<0>(annotation.label_display_range<label_position>())
                     + source_code_indentation;
 
-                for (StyledString& line :
+                for (StyledStringBuilder& line :
                      annotation_lines.subspan(1, annotation.label_line_position - 1)) {
                     line.set_styled_content(connector_position, "|", connector_style);
                 }
@@ -911,11 +1107,11 @@ private:
                     // For the body of multiline annotations, it should traverse all lines.
                     return annotation_lines;
                 default:
-                    return std::span<StyledString>();
+                    return std::span<StyledStringBuilder>();
                 }
             }();
 
-            for (StyledString& line : body_lines) {
+            for (StyledStringBuilder& line : body_lines) {
                 line.set_styled_content(annotation.col_beg.display, "|", connector_style);
             }
         }
@@ -925,23 +1121,23 @@ private:
     ///
     /// 1 |     func(args)
     ///   |          ^^^^ label     <-- Render the label
+    template <HumanRenderer::LabelPosition label_position>
     void render_labels(
-        std::span<StyledString> annotation_lines,
-        unsigned source_code_indentation,
-        HumanRenderer::LabelPosition label_position
+        std::span<StyledStringBuilder> annotation_lines,
+        unsigned source_code_indentation
     ) const {
         for (Annotation const& annotation : annotations) {
             if (!annotation.label.empty()) {
                 // The starting column for rendering the label.
                 unsigned const label_col_beg =
-                    std::get<0>(annotation.label_display_range(label_position))
+                    std::get<0>(annotation.label_display_range<label_position>())
                     + source_code_indentation;
 
                 // Render the label line by line.
                 for (unsigned const line_idx :
                      std::views::iota(0u, static_cast<unsigned>(annotation.label.size()))) {
                     // The target for the `line_idx` line of the label.
-                    StyledString& target_line =
+                    StyledStringBuilder& target_line =
                         annotation_lines[annotation.label_line_position + line_idx];
                     // The content of the `line_idx` line of the label.
                     //
@@ -998,7 +1194,7 @@ private:
     ///     func(args)
     ///         ^^^^^^
     void render_underlines(
-        std::span<StyledString> annotation_lines,
+        std::span<StyledStringBuilder> annotation_lines,
         unsigned source_code_indentation,
         char primary_underline,
         char secondary_underline
@@ -1079,11 +1275,11 @@ private:
     /// |    Body of a multiline annotation (vertical line connecting the start and end of the
     /// |    multiline annotation)
     /// Line number and its separator
+    template <class Options>
     auto render_source_line(
         unsigned max_line_num_len,
         unsigned line_num,
         unsigned depth_num,
-        HumanRenderer::LineNumAlignment line_num_alignment,
         unsigned display_tab_width
     ) const -> StyledString {
         // Determine where to draw the vertical line "|" indicating the body of a multiline
@@ -1149,12 +1345,16 @@ private:
                 // Insert `vertical_line_content`.
                 //
                 // Since `vertical_line_content` is not empty, the return value of
-                // `styled_line_parts()` is also not empty.
-                render_target.append(vertical_line_content.styled_line_parts().front());
+                // `styled_lines()` is also not empty.
+                render_target.append(vertical_line_content.styled_lines().front());
             }
         } else {
             // To fully render the code line, we need to render the line number.
-            render_line_number(render_target, max_line_num_len, line_num, line_num_alignment);
+            render_line_number<Options::line_num_alignment>(
+                render_target,
+                max_line_num_len,
+                line_num
+            );
 
             if (!vertical_line_content.empty()) {
                 // Insert a space between the line number separator and the body of the multiline
@@ -1163,23 +1363,85 @@ private:
                 // Insert `vertical_line_content`.
                 //
                 // Since `vertical_line_content` is not empty, the return value of
-                // `styled_line_parts()` is also not empty.
-                render_target.append(vertical_line_content.styled_line_parts().front());
+                // `styled_lines()` is also not empty.
+                render_target.append(vertical_line_content.styled_lines().front());
             }
 
             // Insert the source code line. Note that we always insert a space before the source
             // code line.
             render_target.append_spaces(1);
-            render_target.append(  //
-                normalize_source(source_line, display_tab_width),
-                Style::SourceCode
+
+            if (truncated_left) {
+                render_target.append(source_line_ellipsis, Style::LineNumber);
+            }
+            append_normalized_source<Options::expands_tabs>(
+                render_target,
+                source_line,
+                display_tab_width
             );
+            if (truncated_right) {
+                render_target.append(source_line_ellipsis, Style::LineNumber);
+            }
         }
 
         return render_target;
     }
 };
 
+/// The labels of the spans of an annotated source. The deferred labels (see
+/// `LabeledSpan::deferred_label`) are produced when this object is constructed, right before the
+/// source is rendered, and are owned by this object, which must outlive the rendering.
+class SpanLabels {
+public:
+    explicit SpanLabels(AnnotatedSource const& source) :
+        primary_(source.primary_spans()), secondary_(source.secondary_spans()) { }
+
+    /// Returns the label of the `idx`-th primary (or secondary) span of the source.
+    auto label(bool is_primary, std::size_t idx) const -> StyledStringView const& {
+        return (is_primary ? primary_ : secondary_).label(idx);
+    }
+
+private:
+    /// The labels of the primary or the secondary spans.
+    class Labels {
+    public:
+        explicit Labels(std::vector<LabeledSpan> const& spans) : spans_(&spans) {
+            // Most sources have no deferred labels, whose labels are then used as they are.
+            if (std::ranges::none_of(spans, [](LabeledSpan const& span) {
+                    return static_cast<bool>(span.deferred_label);
+                })) {
+                return;
+            }
+
+            // The views refer to the produced strings, so the strings are all produced before the
+            // views are taken, and never moved afterwards.
+            produced_.reserve(spans.size());
+            for (LabeledSpan const& span : spans) {
+                produced_.push_back(span.deferred_label ? span.deferred_label() : StyledString());
+            }
+
+            views_.reserve(spans.size());
+            for (std::size_t idx = 0; idx != spans.size(); ++idx) {
+                LabeledSpan const& span = spans[idx];
+                views_.push_back(span.deferred_label ? produced_[idx].view() : span.label);
+            }
+        }
+
+        auto label(std::size_t idx) const -> StyledStringView const& {
+            return views_.empty() ? (*spans_)[idx].label : views_[idx];
+        }
+
+    private:
+        std::vector<LabeledSpan> const* spans_;
+        std::vector<StyledString> produced_;
+        /// The labels of all spans if any of them is deferred, or empty otherwise.
+        std::vector<StyledStringView> views_;
+    };
+
+    Labels primary_;
+    Labels secondary_;
+};
+
 class AnnotatedLines {
 public:
     /// Constructs an `AnnotatedLines` object from the source code `source`.
@@ -1190,7 +1452,7 @@ public:
     ///
     /// Additionally, this function organizes annotations, which includes:
     /// 1. Appropriately adjusting annotation ranges, such as modifying empty spans to annotate a
-    ///    single character (implemented by `adjust_span()`).
+    ///    single character (implemented by `adjusted_span_end()`).
     /// 2. Assigns a depth to each multi-line annotation to reduce the potential for overlap during
     ///    rendering.
     /// 3. Determines the rendering approach for unannotated lines, whether to render fully or to
@@ -1199,44 +1461,92 @@ public:
     ///    Implemented by `fold_multiline_annotations()`.
     /// 5. Calculates the display width of annotations and source code lines. Implemented by
     ///    `compute_display_columns()`.
-    /// 6. Calculates the lines on which labels are placed to minimize overlaps. Implemented by
-    ///    `compute_label_line_positions()`.
-    static auto from_source(  //
-        AnnotatedSource& source,
-        HumanRenderer const& renderer
+    /// 6. Drops the single-line annotations beyond `HumanRenderer::max_annotations_per_line` on
+    ///    each line. Implemented by `limit_annotations_per_line()`.
+    ///
+    /// The lines on which the labels are placed are not calculated here, but by `layout_line()`
+    /// right before each line is rendered, so that the lines which are not rendered because of the
+    /// output limits of `HumanRenderer` are never laid out.
+    ///
+    /// `source` is not modified, so it can be rendered again. The lines of `source` are located
+    /// with the memo `line_offset_memo_` of the returned object. The labels of its spans are taken
+    /// from `labels`, which must outlive the returned object. All the intermediate state is
+    /// allocated from `resource`. `max_line_num_len` is the width of
+    /// the line numbers, which is needed to fit the source code lines in
+    /// `HumanRenderer::diagnostic_width`.
+    static auto from_source(
+        AnnotatedSource const& source,
+        SpanLabels const& labels,
+        HumanRenderer const& renderer,
+        unsigned max_line_num_len,
+        std::pmr::memory_resource* resource
     ) -> AnnotatedLines {
-        AnnotatedLines result;
-
-        for (LabeledSpan& span : source.primary_spans()) {
-            adjust_span(source, span);
-            result.add_span(std::move(span), /*is_primary=*/true);
+        AnnotatedLines result(resource);
+        RenderObserver* const observer = render_observer_of(renderer);
+
+        {
+            ScopedRenderPhase const phase(observer, source, RenderPhase::AddSpans);
+            for (bool const is_primary : { true, false }) {
+                std::vector<LabeledSpan> const& spans =
+                    is_primary ? source.primary_spans() : source.secondary_spans();
+                for (std::size_t idx = 0; idx != spans.size(); ++idx) {
+                    result.add_span(
+                        spans[idx],
+                        result.adjusted_span_end(source, spans[idx]),
+                        labels.label(is_primary, idx),
+                        is_primary
+                    );
+                }
+            }
         }
 
-        for (LabeledSpan& span : source.secondary_spans()) {
-            adjust_span(source, span);
-            result.add_span(std::move(span), /*is_primary=*/false);
+        {
+            ScopedRenderPhase const phase(observer, source, RenderPhase::HandleMultilineSpans);
+            result.handle_multiline_spans();
+            result.limit_annotations_per_line(renderer.max_annotations_per_line);
         }
 
-        result.handle_multiline_spans();
-
-        result.handle_unannotated_lines(renderer.max_unannotated_line_num);
-        result.fold_multiline_annotations(renderer.max_multiline_annotation_line_num);
+        {
+            ScopedRenderPhase const phase(observer, source, RenderPhase::HandleUnannotatedLines);
+            result.handle_unannotated_lines(renderer.max_unannotated_line_num);
+        }
 
-        result.compute_display_columns(source, renderer.display_tab_width);
+        {
+            ScopedRenderPhase const phase(observer, source, RenderPhase::FoldMultilineAnnotations);
+            result.fold_multiline_annotations(renderer.max_multiline_annotation_line_num);
+        }
 
-        for (auto& [line_no, line] : result.lines_) {
-            AnnotatedLines::compute_label_line_positions(renderer.label_position, line);
-            (void) line_no;
+        // The source code lines are rendered after the line numbers, the line number separator, the
+        // bodies of the multiline annotations and a space. See `AnnotatedLine::render()`.
+        unsigned const source_code_indentation = max_line_num_len + 3
+            + (result.depth_num_ == 0 ? 0 : result.depth_num_ + 1);
+        unsigned const max_source_width = renderer.diagnostic_width > source_code_indentation
+            ? renderer.diagnostic_width - source_code_indentation
+            : 0;
+
+        {
+            ScopedRenderPhase const phase(observer, source, RenderPhase::ComputeDisplayColumns);
+            result.compute_display_columns(source, renderer.display_tab_width, max_source_width);
         }
 
         return result;
     };
 
-    auto annotated_lines() -> std::map<unsigned, AnnotatedLine>& {
+    /// Calculates the lines on which the labels of the annotations of `line` are placed to minimize
+    /// overlaps, where the labels are placed at `label_position`. Implemented by
+    /// `compute_label_line_positions()`.
+    ///
+    /// @return The number of edges of the graph built to place the labels.
+    template <HumanRenderer::LabelPosition label_position>
+    static auto layout_line(HumanRenderer const& renderer, AnnotatedLine& line) -> std::size_t {
+        return compute_label_line_positions<label_position>(renderer.label_placement, line);
+    }
+
+    auto annotated_lines() -> std::pmr::vector<std::pair<unsigned, AnnotatedLine>>& {
         return lines_;
     }
 
-    auto annotated_lines() const -> std::map<unsigned, AnnotatedLine> const& {
+    auto annotated_lines() const -> std::pmr::vector<std::pair<unsigned, AnnotatedLine>> const& {
         return lines_;
     }
 
@@ -1244,16 +1554,39 @@ public:
         return depth_num_;
     }
 
+    auto scanned_byte_num() const -> std::size_t {
+        return scanned_byte_num_;
+    }
+
 private:
-    /// Stores the line numbers and their associated annotations. We use an ordered associative
-    /// container to ensure sequential traversal of all annotated lines.
-    std::map<unsigned, AnnotatedLine> lines_;
+    explicit AnnotatedLines(std::pmr::memory_resource* resource) :
+        lines_(resource),
+        line_annotations_(resource),
+        multiline_annotations_(resource),
+        line_offset_memo_(resource),
+        depth_num_(0),
+        scanned_byte_num_(0) { }
+
+    /// Stores the line numbers and their associated annotations, sorted by line number. The lines
+    /// are only traversed sequentially after construction, so we keep them in contiguous storage
+    /// instead of an ordered associative container.
+    std::pmr::vector<std::pair<unsigned, AnnotatedLine>> lines_;
+    /// Stores all annotations along with the numbers of the lines they are attached to, in the
+    /// order in which they are created. Once all annotations have been created, they are grouped
+    /// by line into `lines_` by `group_annotations_by_line()`.
+    ///
+    /// This member is only used for storing intermediate results.
+    std::pmr::vector<std::pair<unsigned, Annotation>> line_annotations_;
     /// Stores all multi-line annotations, as we need to handle them with different logic. For
     /// example, we need to assign depths to all multi-line annotations.
     ///
     /// This member is only used for storing intermediate results. Once `AnnotatedLines` is fully
     /// constructed, this member serves no further purpose.
-    std::vector<MultilineAnnotation> multiline_annotations_;
+    std::pmr::vector<MultilineAnnotation> multiline_annotations_;
+    /// Memoizes the offsets of the lines of the source code located while the object is
+    /// constructed, since the `const` source does not cache them (see
+    /// `AnnotatedSource::line_offset(unsigned, LineOffsetMemo&)`).
+    AnnotatedSource::LineOffsetMemo line_offset_memo_;
     /// The number of different depths in all multi-line annotations associated with the current
     /// source code. As the algorithm allocates depths starting from 0 and assigns them
     /// sequentially, this value actually represents the highest allocated depth value plus one.
@@ -1261,14 +1594,22 @@ private:
     /// For example, if the algorithm allocates depths of 0, 1, 2, 0 for 4 multi-line annotations,
     /// then `depth_num_` would be 3.
     unsigned depth_num_;
+    /// The number of bytes of the source code lines laid out by `compute_display_columns()`, i.e.,
+    /// the windows of the unomitted lines. Reported by `RenderStats::scanned_byte_num`.
+    std::size_t scanned_byte_num_;
+
+    /// Returns the end location of `span` after adjusting it as described below. `span` itself is
+    /// left untouched.
+    auto adjusted_span_end(AnnotatedSource const& source, LabeledSpan const& span)
+        -> SourceLocation {
+        SourceLocation end = span.end;
 
-    static void adjust_span(AnnotatedSource& source, LabeledSpan& span) {
         // We handle empty annotation ranges specially. In some cases, a user may want to annotate a
         // single character but provides an empty range (i.e., `span.beg` and `span.end` are equal),
         // for example, when attempting to annotate EOF, the front end may not provide a position
         // like `EOF + 1`. Therefore, we modify empty ranges here to annotate a single character.
-        if (span.beg == span.end) {
-            ++span.end.col;
+        if (span.beg == end) {
+            ++end.col;
         }
 
         // Sometimes we will extend the annotation to the end of a line. In the user interface,
@@ -1286,38 +1627,47 @@ private:
         // affect the rendering result but allows us to correctly determine the properties of the
         // annotation, such as preventing us from incorrectly judging a single-line annotation as a
         // multi-line annotation.
-        if (span.end.col == 0) {
+        if (end.col == 0) {
             // To get the end position of the previous line, we calculate the offsets of the first
-            // characters of the previous line and the current line respectively. This may involve
-            // caching, but it does not introduce unnecessary calculations, as our results will also
-            // be used again when rendering actual code lines.
-            std::size_t const prev_line_start = source.line_offset(span.end.line - 1);
-            std::size_t const cur_line_start = source.line_offset(span.end.line);
-
-            span.end.col = static_cast<unsigned>(cur_line_start - prev_line_start);
-            --span.end.line;
+            // characters of the previous line and the current line respectively. They are
+            // memoized, but it does not introduce unnecessary calculations, as our results will
+            // also be used again when rendering actual code lines.
+            std::size_t const prev_line_start = source.line_offset(end.line - 1, line_offset_memo_);
+            std::size_t const cur_line_start = source.line_offset(end.line, line_offset_memo_);
+
+            end.col = static_cast<unsigned>(cur_line_start - prev_line_start);
+            --end.line;
         }
+
+        return end;
     }
 
-    /// Constructs `Annotation` or `MultilineAnnotation` based on `LabeledSpan`. Single-line
-    /// annotations are added to `lines_`, while multi-line annotations are added to
-    /// `multiline_annotations_`.
+    /// Constructs `Annotation` or `MultilineAnnotation` based on `LabeledSpan`, whose end location
+    /// is replaced by `end`. Single-line annotations are added to `line_annotations_`, while
+    /// multi-line annotations are added to `multiline_annotations_`.
     ///
-    /// Since this function consumes `span`, the parameter passed to it should not be used after the
-    /// function ends.
-    void add_span(LabeledSpan&& span, bool is_primary) {
-        if (span.beg.line == span.end.line) {
-            lines_[span.beg.line].annotations.push_back(
-                Annotation::from_single_line_span(span, is_primary)
+    /// The label of `span` is given by `label`. Multi-line annotations refer to `label`, so it must
+    /// outlive this object.
+    void add_span(
+        LabeledSpan const& span,
+        SourceLocation end,
+        StyledStringView const& label,
+        bool is_primary
+    ) {
+        if (span.beg.line == end.line) {
+            line_annotations_.emplace_back(
+                span.beg.line,
+                Annotation::from_single_line_span(span.beg, end, label, is_primary)
             );
         } else {
-            multiline_annotations_.emplace_back(std::move(span), is_primary);
+            multiline_annotations_.emplace_back(span.beg, end, label, is_primary);
         }
     }
 
     /// Handles all multi-line annotations separately. We need to assign depths to all multi-line
     /// annotations and count how many different depths have been allocated. Once processing is
-    /// complete, we convert all multi-line annotations into `Annotation`.
+    /// complete, we convert all multi-line annotations into `Annotation`, and group all annotations
+    /// by line.
     void handle_multiline_spans() {
         assign_multiline_depth();
 
@@ -1336,10 +1686,12 @@ private:
         // Convert `MultilineAnnotation` into `Annotation`.
         for (MultilineAnnotation const& annotation : multiline_annotations_) {
             // We need to split the `MultilineAnnotation` into 3 parts.
-            lines_[annotation.beg.line].annotations.push_back(
+            line_annotations_.emplace_back(
+                annotation.beg.line,
                 Annotation::from_multiline_head(annotation)
             );
-            lines_[annotation.end.line].annotations.push_back(
+            line_annotations_.emplace_back(
+                annotation.end.line,
                 Annotation::from_multiline_tail(annotation)
             );
 
@@ -1351,21 +1703,73 @@ private:
             // here we can safely add 1 here.
             for (unsigned const line :
                  std::views::iota(annotation.beg.line + 1, annotation.end.line)) {
-                lines_[line].annotations.push_back(Annotation::from_multiline_body(annotation));
+                line_annotations_.emplace_back(line, Annotation::from_multiline_body(annotation));
             }
         }
+
+        group_annotations_by_line();
+    }
+
+    /// Drops the single-line annotations of each line beyond the first `max_annotation_num` ones,
+    /// and records their number in `AnnotatedLine::omitted_annotation_num`. Since the annotations
+    /// of each line are in the order in which they were created, the primary annotations are kept
+    /// first. If `max_annotation_num` is 0, no annotation is dropped.
+    void limit_annotations_per_line(unsigned max_annotation_num) {
+        if (max_annotation_num == 0) {
+            return;
+        }
+
+        for (AnnotatedLine& line : lines_ | std::views::values) {
+            auto kept_end = line.annotations.begin();
+            unsigned singleline_num = 0;
+            for (auto iter = line.annotations.begin(); iter != line.annotations.end(); ++iter) {
+                bool const is_dropped = iter->type == Annotation::SingleLine
+                    && singleline_num++ >= max_annotation_num;
+                if (is_dropped) {
+                    continue;
+                }
+                if (kept_end != iter) {
+                    *kept_end = std::move(*iter);
+                }
+                ++kept_end;
+            }
+
+            line.omitted_annotation_num =
+                static_cast<std::size_t>(line.annotations.end() - kept_end);
+            line.annotations.erase(kept_end, line.annotations.end());
+        }
+    }
+
+    /// Moves the annotations in `line_annotations_` to the lines they are attached to in `lines_`.
+    /// The annotations of each line keep the order in which they were created.
+    void group_annotations_by_line() {
+        std::ranges::stable_sort(
+            line_annotations_,
+            std::ranges::less(),
+            &std::pair<unsigned, Annotation>::first
+        );
+
+        for (auto& [line_no, annotation] : line_annotations_) {
+            if (lines_.empty() || lines_.back().first != line_no) {
+                lines_.emplace_back(line_no, AnnotatedLine(lines_.get_allocator()));
+            }
+            lines_.back().second.annotations.push_back(std::move(annotation));
+        }
+
+        line_annotations_.clear();
     }
 
     /// Assigns a depth to each multi-line annotation in `multiline_annotations_` to reduce the
     /// potential for overlap during rendering.
     ///
-    /// In implementation, we convert all multi-line annotations into an [interval
-    /// graph](https://en.wikipedia.org/wiki/Interval_graph). Specifically, we treat the interval
-    /// formed by the start and end lines of each multi-line annotation as vertices of the graph. If
-    /// two intervals overlap, an edge is added between them. We then color the vertices and assign
-    /// depths to the multi-line annotations based on the coloring results. Since vertices of the
-    /// same edge will not have the same color, we ensure that overlapping multi-line annotations do
-    /// not share the same depth.
+    /// In implementation, we treat the interval formed by the start and end lines of each
+    /// multi-line annotation as a vertex of an [interval
+    /// graph](https://en.wikipedia.org/wiki/Interval_graph), where overlapping intervals are
+    /// connected, and greedily color the vertices in the sorted order. The edges are never built:
+    /// the colored neighbors of a vertex are exactly the previous intervals that have not ended, so
+    /// we sweep over the intervals and keep the active intervals and the reusable depths in two
+    /// heaps, which takes `O(n log n)` time. Since vertices of the same edge will not have the same
+    /// color, we ensure that overlapping multi-line annotations do not share the same depth.
     void assign_multiline_depth() {
         // Sort `multiline_annotations_` to produce as visually appealing and intersection-free a
         // rendering result as possible. We dictate that the smaller the depth, the closer the
@@ -1418,9 +1822,9 @@ private:
         // number of depths. By controlling the order of annotations in `multiline_annotations`, we
         // can influence the distribution of depths to some extent but not decisively.
         //
-        // Additionally, all members of `LabeledSpan`'s `beg` and `end` participate in sorting,
-        // ensuring annotations with the same range are contiguous: we need to assign the same depth
-        // to the same multi-line annotations because we want to avoid outcomes like:
+        // Additionally, all members of `beg` and `end` participate in sorting, ensuring annotations
+        // with the same range are contiguous: we need to assign the same depth to the same
+        // multi-line annotations because we want to avoid outcomes like:
         //
         //     x |    foo(x1,
         //       |  ______^
@@ -1448,39 +1852,24 @@ private:
             }
         );
 
-        /// Represents the vertices of the interval graph.
-        struct Vertex {
-            /// All multi-line annotations bound to the current vertex. They will have the same
-            /// depth.
-            std::span<MultilineAnnotation> annotation_range;
-            std::vector<Vertex*> neighbors;
-            /// The depth value associated with the current vertex plus 1. If `depth` is 0, it
-            /// indicates no depth has been assigned yet.
-            unsigned depth = 0;
+        std::pmr::memory_resource* const resource =
+            multiline_annotations_.get_allocator().resource();
 
-            Vertex() = default;
-            explicit Vertex(std::span<MultilineAnnotation> range) : annotation_range(range) { }
-
-            /// Determines whether the intervals represented by two `Vertex` overlap.
-            auto overlap(Vertex const& other) const -> bool {
-                // We assume that the `annotation_range` in both vertices is non-empty, and that all
-                // elements in an `annotation_range` of a `Vertex` have the same line range.
-                unsigned const self_line_beg = annotation_range.front().beg.line;
-                unsigned const self_line_end = annotation_range.front().end.line;
-                unsigned const other_line_beg = other.annotation_range.front().beg.line;
-                unsigned const other_line_end = other.annotation_range.front().end.line;
-
-                // Note that for line numbers, the interval (e.g., [`self_line_beg`,
-                // `self_line_end`]) is inclusive on both ends.
-                return (self_line_beg <= other_line_beg && other_line_beg <= self_line_end)
-                    || (other_line_beg <= self_line_beg && self_line_beg <= other_line_end);
-            }
+        /// A group of annotations with the same line range, whose depth is in use until the end
+        /// line of the range.
+        struct ActiveGroup {
+            unsigned end_line;
+            unsigned depth;
         };
 
-        std::vector<Vertex> interval_graph;
-        interval_graph.reserve(multiline_annotations_.size());
+        // A min-heap of the groups that overlap the group being processed, ordered by their end
+        // lines.
+        std::pmr::vector<ActiveGroup> active_groups(resource);
+        // A min-heap of the depths that have been assigned but are no longer in use.
+        std::pmr::vector<unsigned> free_depths(resource);
+        unsigned depth_num = 0;
 
-        // We combine annotations with the same range into one `Vertex`, so they will have the same
+        // We combine annotations with the same range into one group, so they will have the same
         // depth.
         for (auto iter = multiline_annotations_.begin(); iter != multiline_annotations_.end();) {
             // `end_iter` points to the first annotation that does not have the same range as the
@@ -1493,52 +1882,44 @@ private:
                 }
             );
 
-            // Bind the range formed by `iter` and `end_iter` to a vertex.
-            interval_graph.emplace_back(std::span(iter, end_iter));
-
-            iter = end_iter;
-        }
-
-        // Build neighbor relationships between `Vertex` instances: we need to add an edge for each
-        // pair of overlapping intervals.
-        for (auto cur_iter = interval_graph.begin(); cur_iter != interval_graph.end(); ++cur_iter) {
-            for (auto neighbor_iter = std::ranges::next(cur_iter);
-                 neighbor_iter != interval_graph.end();
-                 ++neighbor_iter) {
-                if (cur_iter->overlap(*neighbor_iter)) {
-                    cur_iter->neighbors.push_back(std::to_address(neighbor_iter));
-                    neighbor_iter->neighbors.push_back(std::to_address(cur_iter));
-                } else {
-                    // Since we have sorted `multiline_annotations`, overlapping intervals are
-                    // contiguous.
-                    break;
-                }
+            // Since the groups are processed in the order of their start lines, a previous group
+            // overlaps the current one if and only if it ends at or after the start line of the
+            // current group (the line ranges are inclusive on both ends). The depths of the other
+            // previous groups can be reused.
+            while (!active_groups.empty() && active_groups.front().end_line < iter->beg.line) {
+                free_depths.push_back(active_groups.front().depth);
+                std::ranges::push_heap(free_depths, std::ranges::greater());
+                std::ranges::pop_heap(
+                    active_groups,
+                    std::ranges::greater(),
+                    &ActiveGroup::end_line
+                );
+                active_groups.pop_back();
             }
-        }
 
-        // Assign depths to each `Vertex`.
-        for (Vertex& vertex : interval_graph) {
-            // Number of states: in the worst case, we need to assign an unique depth to each
-            // vertex. Additionally, we reserve 0 to indicate the "unassigned" state.
-            std::vector<std::uint8_t> depth_bucket(interval_graph.size() + 1);
-            for (Vertex* const neighbor : vertex.neighbors) {
-                depth_bucket[neighbor->depth] = 1;
+            // Assign the smallest depth that is not used by any overlapping group, which is the
+            // same depth as the greedy coloring of the interval graph would assign.
+            unsigned depth = depth_num;
+            if (free_depths.empty()) {
+                ++depth_num;
+            } else {
+                depth = free_depths.front();
+                std::ranges::pop_heap(free_depths, std::ranges::greater());
+                free_depths.pop_back();
             }
 
-            // Find the first unused depth and assign it to `vertex`. Note that we need to ignore
-            // the first element of `depth_bucket` because we need to ignore all vertices that have
-            // not been assigned a depth.
-            auto const first_unused = std::ranges::find(depth_bucket | std::views::drop(1), 0);
-            vertex.depth =
-                static_cast<unsigned>(std::ranges::distance(depth_bucket.begin(), first_unused));
-        }
+            active_groups.push_back({ .end_line = iter->end.line, .depth = depth });
+            std::ranges::push_heap(
+                active_groups,
+                std::ranges::greater(),
+                &ActiveGroup::end_line
+            );
 
-        // Convert `Vertex`'s `depth` to the depths assigned to each multi-line annotation.
-        for (Vertex const& vertex : interval_graph) {
-            for (MultilineAnnotation& annotation : vertex.annotation_range) {
-                // Since `vertex.depth` starts from 1, we need to subtract 1 additionally.
-                annotation.depth = vertex.depth - 1;
+            for (MultilineAnnotation& annotation : std::ranges::subrange(iter, end_iter)) {
+                annotation.depth = depth;
             }
+
+            iter = end_iter;
         }
     }
 
@@ -1550,34 +1931,42 @@ private:
             return;
         }
 
-        // In the loop below, we need to insert elements into `lines_` while iterating through it.
-        // However, since inserting elements does not invalidate any iterators of `std::map`, we can
-        // safely use the original iterators after inserting elements. Moreover, since we always
-        // insert elements forward, this ensures that we do not access elements we just inserted.
-        for (auto prev_iter = lines_.begin(), cur_iter = std::ranges::next(prev_iter);
-             cur_iter != lines_.end();
-             prev_iter = cur_iter++) {
-            unsigned const prev_line_no = prev_iter->first;
-            unsigned const cur_line_no = cur_iter->first;
-            if (cur_line_no - prev_line_no - 1 > max_unannotated_line_num) {
-                // Insert a line that is marked as omitted.
-                if (cur_line_no - prev_line_no != 1) {
-                    // Since the omitted line does not display a line number, the line number here
-                    // has no significance.
-                    lines_.emplace(prev_line_no + 1, AnnotatedLine(/*omitted=*/true));
+        // Inserting elements in the middle of `lines_` would shift all subsequent lines, so we
+        // build the new sequence of lines in a single pass instead: each annotated line is moved
+        // to `result`, preceded by the lines inserted between it and the previous annotated line.
+        std::pmr::vector<std::pair<unsigned, AnnotatedLine>> result(lines_.get_allocator());
+        result.reserve(lines_.size());
+
+        for (std::pair<unsigned, AnnotatedLine>& cur_line : lines_) {
+            if (!result.empty()) {
+                // The last element of `result` is always the previous annotated line.
+                unsigned const prev_line_no = result.back().first;
+                unsigned const cur_line_no = cur_line.first;
+                if (cur_line_no - prev_line_no - 1 > max_unannotated_line_num) {
+                    // Insert a line that is marked as omitted.
+                    if (cur_line_no - prev_line_no != 1) {
+                        // Since the omitted line does not display a line number, the line number
+                        // here has no significance.
+                        result.emplace_back(
+                            prev_line_no + 1,
+                            AnnotatedLine(/*omitted=*/true, lines_.get_allocator())
+                        );
+                    }
+                } else {
+                    // Fully display unannotated lines.
+                    for (unsigned const line : std::views::iota(prev_line_no + 1, cur_line_no)) {
+                        result.emplace_back(
+                            line,
+                            AnnotatedLine(/*omitted=*/false, lines_.get_allocator())
+                        );
+                    }
                 }
-            } else {
-                // Fully display unannotated lines.
-                // clang-format off
-                auto rng = std::views::iota(prev_line_no + 1, cur_line_no)
-                    | std::views::transform([](unsigned line) {
-                          return std::make_pair(line, AnnotatedLine(/*omitted=*/false));
-                      })
-                    | std::views::common;
-                // clang-format on
-                lines_.insert(std::ranges::begin(rng), std::ranges::end(rng));
             }
+
+            result.push_back(std::move(cur_line));
         }
+
+        lines_ = std::move(result);
     }
 
     /// Handles the body parts of multi-line annotations. If there are consecutive lines containing
@@ -1595,6 +1984,11 @@ private:
         // `MultilineHead` and `MultilineTail` from these counts.
         max_multiline_annotation_line_num -= 2;
 
+        // The ranges [beg, end) of line numbers of the lines to be removed, in ascending order.
+        std::pmr::vector<std::pair<unsigned, unsigned>> removed_ranges(
+            lines_.get_allocator().resource()
+        );
+
         // This function attempts to fold several lines within the foldable area formed by
         // [line_beg, line_end) so that the number of remaining lines does not exceed
         // `max_multiline_annotation_line_num`.
@@ -1620,17 +2014,17 @@ private:
                     line_beg + max_multiline_annotation_line_num / 2 + folded_lines_num
                 );
 
-                lines_[folded_range.front()].omitted = true;
-                for (unsigned const line : folded_range | std::views::drop(1)) {
-                    // Note that we are modifying `lines_` here, and this function will be called in
-                    // the loop below, where we iterate over `lines_`. However, this is safe because
-                    // deleting elements from a `std::map` does not invalidate other iterators, and
-                    // we are not deleting the element currently being accessed in the loop.
-                    lines_.erase(line);
+                find_line(folded_range.front()).omitted = true;
+                if (folded_range.size() > 1) {
+                    // Note that this function is called in the loop below, where we iterate over
+                    // `lines_`, so the lines cannot be removed here. They are removed together
+                    // after the loop.
+                    removed_ranges.emplace_back(folded_range[1], folded_range.back() + 1);
                 }
             }
         };
 
+
         // Start of the current foldable area.
         unsigned foldable_area_beg = 0;
         // End of the current foldable area.
@@ -1663,6 +2057,181 @@ private:
 
         // Don't forget to handle the last foldable area.
         fold_lines(foldable_area_beg, foldable_area_end + 1);
+
+        if (!removed_ranges.empty()) {
+            std::erase_if(lines_, [&](std::pair<unsigned, AnnotatedLine> const& line) {
+                // Find the last range starting at or before the line.
+                auto const next_range = std::ranges::upper_bound(
+                    removed_ranges,
+                    line.first,
+                    std::ranges::less(),
+                    &std::pair<unsigned, unsigned>::first
+                );
+                return next_range != removed_ranges.begin()
+                    && line.first < std::ranges::prev(next_range)->second;
+            });
+        }
+    }
+
+    /// Returns the line numbered `line_no` in `lines_`, which must exist.
+    auto find_line(unsigned line_no) -> AnnotatedLine& {
+        auto const iter = std::ranges::lower_bound(
+            lines_,
+            line_no,
+            std::ranges::less(),
+            &std::pair<unsigned, AnnotatedLine>::first
+        );
+        return iter->second;
+    }
+
+    /// Cuts the source code line of `annotated_line` to a window around its annotations if its
+    /// display width exceeds `max_width`, similar to what rustc does. For example:
+    ///
+    ///     1 | ...value, other_value, annotated_value, another_value, and_another_v...
+    ///       |                        ^^^^^^^^^^^^^^^ label
+    ///
+    /// The window starts a few columns before the leftmost annotated column, and leaves room for
+    /// the labels after the annotations when possible. The byte columns of the annotations are
+    /// adjusted to be relative to the window, and the columns outside the window are moved to its
+    /// ends.
+    ///
+    /// Only the characters near the window are measured, so that the cost does not depend on the
+    /// length of the line. This matters for very long lines, such as minified sources.
+    static void window_source_line(
+        AnnotatedLine& annotated_line,
+        unsigned max_width,
+        unsigned display_tab_width
+    ) {
+        unsigned const ellipsis_width = source_line_ellipsis_width;
+        std::string_view const line = annotated_line.source_line;
+
+        // If there is no room for anything between two ellipses, we do not cut the line.
+        if (max_width <= 2 * ellipsis_width) {
+            return;
+        }
+
+        // Every column is occupied by at most 4 bytes (except for zero-width characters), so a line
+        // longer than `4 * max_width` bytes does not fit and need not be measured.
+        if (line.size() <= std::size_t { 4 } * max_width
+            && normalized_source_display_width(line, display_tab_width) <= max_width) {
+            return;
+        }
+
+        // Find the range of the annotated bytes, and the space needed by the labels.
+        std::size_t annotated_beg = line.size();
+        std::size_t annotated_end = 0;
+        unsigned label_width = 0;
+        for (Annotation const& annotation : annotated_line.annotations) {
+            switch (annotation.type) {
+            case Annotation::SingleLine:
+                annotated_beg = std::min<std::size_t>(annotated_beg, annotation.col_beg.byte);
+                break;
+            case Annotation::MultilineHead:
+            case Annotation::MultilineTail:
+                // Only the last annotated byte of the head and the tail is underlined.
+                annotated_beg =
+                    std::min<std::size_t>(annotated_beg, annotation.col_end.byte - 1);
+                break;
+            default:
+                continue;
+            }
+            annotated_end = std::max<std::size_t>(annotated_end, annotation.col_end.byte);
+
+            if (annotation.label_display_width != 0) {
+                label_width = std::ranges::max(label_width, annotation.label_display_width + 1);
+            }
+        }
+
+        if (annotated_beg > annotated_end) {
+            // No annotation refers to the source code of this line, so we show its beginning.
+            annotated_beg = annotated_end = 0;
+        }
+        annotated_beg = std::ranges::min(annotated_beg, line.size());
+
+        // The display width of the annotated range. The annotated bytes beyond the end of the line
+        // are treated as spaces, as in `compute_display_columns()`.
+        unsigned const annotated_width = std::ranges::min(
+            max_width,
+            advance_display_columns(
+                line.substr(0, std::ranges::min(annotated_end, line.size())),
+                annotated_beg,
+                max_width,
+                display_tab_width
+            ).width
+                + static_cast<unsigned>(
+                    annotated_end > line.size() ? annotated_end - line.size() : 0
+                )
+        );
+        label_width = std::ranges::min(label_width, max_width / 2);
+
+        // The remaining width is split evenly between the context before the annotations and the
+        // context after the labels.
+        unsigned const used_width = 2 * ellipsis_width + annotated_width + label_width;
+        unsigned const left_context_width =
+            used_width < max_width ? (max_width - used_width) / 2 : 0;
+
+        // If the context before the annotations and the ellipsis would cover the beginning of the
+        // line, we show the beginning instead.
+        DisplayColumnAdvance const left_context = retreat_display_columns(
+            line,
+            annotated_beg,
+            left_context_width + ellipsis_width,
+            display_tab_width
+        );
+        bool const truncated_left = left_context.byte != 0;
+        std::size_t window_beg = truncated_left
+            ? retreat_display_columns(line, annotated_beg, left_context_width, display_tab_width)
+                  .byte
+            : 0;
+
+        // Fill the rest of the width with the source code after `window_beg`, reserving the space
+        // of the ellipsis at the end if the line does not end within the width.
+        unsigned const window_width = max_width - (truncated_left ? ellipsis_width : 0);
+        DisplayColumnAdvance window_end =
+            advance_display_columns(line, window_beg, window_width, display_tab_width);
+        bool const truncated_right = window_end.byte != line.size();
+        if (truncated_right) {
+            window_end = advance_display_columns(
+                line,
+                window_beg,
+                window_width - ellipsis_width,
+                display_tab_width
+            );
+        } else {
+            // The annotations are near the end of the line, so the unused width is given to the
+            // context before them.
+            window_beg =
+                retreat_display_columns(line, line.size(), window_width, display_tab_width).byte;
+        }
+
+        annotated_line.source_line = line.substr(window_beg, window_end.byte - window_beg);
+        annotated_line.truncated_left = truncated_left;
+        annotated_line.truncated_right = truncated_right;
+
+        // Make the byte column `byte` relative to the window.
+        auto const to_window_column = [&](unsigned& byte) {
+            std::size_t const clamped =
+                truncated_right ? std::min<std::size_t>(byte, window_end.byte) : byte;
+            byte = static_cast<unsigned>(std::ranges::max(clamped, window_beg) - window_beg);
+        };
+
+        for (Annotation& annotation : annotated_line.annotations) {
+            switch (annotation.type) {
+            case Annotation::SingleLine:
+                to_window_column(annotation.col_beg.byte);
+                to_window_column(annotation.col_end.byte);
+                break;
+            case Annotation::MultilineHead:
+            case Annotation::MultilineTail:
+                // `col_beg` stores the depth of the multiline annotation. `col_end` must still
+                // follow at least one byte, since the byte before it is underlined.
+                to_window_column(annotation.col_end.byte);
+                annotation.col_end.byte = std::ranges::max(annotation.col_end.byte, 1u);
+                break;
+            default:
+                break;
+            }
+        }
     }
 
     /// Calculates the display offsets (i.e., the `display` member values) for all column
@@ -1670,8 +2239,27 @@ private:
     ///
     /// Additionally, this function assigns source code lines to all unomitted annotations
     /// (`AnnotatedLine::source_line`) and calculates the display width of the source code lines
-    /// (`AnnotatedLine::line_display_width`).
-    void compute_display_columns(AnnotatedSource& source, unsigned display_tab_width) {
+    /// (`AnnotatedLine::line_display_width`). The source code lines wider than `max_source_width`
+    /// are cut by `window_source_line()`.
+    void compute_display_columns(
+        AnnotatedSource const& source,
+        unsigned display_tab_width,
+        unsigned max_source_width
+    ) {
+        // Stores the byte offsets of the columns to be processed in ascending order, and the
+        // display offset of each of them. We aim to process these columns in order to reduce the
+        // number of string traversals. The storage is reused by all lines.
+        std::pmr::vector<unsigned> col_bytes(lines_.get_allocator().resource());
+        std::pmr::vector<unsigned> col_displays(lines_.get_allocator().resource());
+
+        // Returns the display offset of the column at byte offset `byte`, which must have been
+        // added to `col_bytes`.
+        auto const col_display = [&](unsigned byte) -> unsigned {
+            return col_displays[static_cast<std::size_t>(
+                std::ranges::lower_bound(col_bytes, byte) - col_bytes.begin()
+            )];
+        };
+
         for (auto& [line_no, annotated_line] : lines_) {
             if (annotated_line.omitted) {
                 // Since we do not render source code for omitted lines, there is no need to
@@ -1680,7 +2268,9 @@ private:
             }
 
             // Assigns the source code line.
-            annotated_line.source_line = source.line_content(line_no);
+            annotated_line.source_line = source.line_content(line_no, line_offset_memo_);
+            window_source_line(annotated_line, max_source_width, display_tab_width);
+            scanned_byte_num_ += annotated_line.source_line.size();
 
             // Collect all columns to be processed.
             //
@@ -1689,25 +2279,30 @@ private:
             // treat them as such to simplify the code. These columns will be skipped when the
             // calculation results are written into `annotations`.
 
-            // Stores the mapping from column byte offset to display offset. We aim to process these
-            // columns in order to reduce the number of string traversals.
-            std::map<unsigned, unsigned> col_display;
+            col_bytes.clear();
             for (Annotation const& annotation : annotated_line.annotations) {
-                col_display.emplace(annotation.col_beg.byte, 0);
-                col_display.emplace(annotation.col_end.byte, 0);
+                col_bytes.push_back(annotation.col_beg.byte);
+                col_bytes.push_back(annotation.col_end.byte);
             }
 
-            // We also need to include the length of the source line in `col_display` so that we can
+            // We also need to include the length of the source line in `col_bytes` so that we can
             // calculate the display width of the source line simultaneously.
-            col_display.emplace(static_cast<unsigned>(annotated_line.source_line.size()), 0u);
+            col_bytes.push_back(static_cast<unsigned>(annotated_line.source_line.size()));
+
+            std::ranges::sort(col_bytes);
+            col_bytes.erase(std::ranges::unique(col_bytes).begin(), col_bytes.end());
+            col_displays.resize(col_bytes.size());
 
-            for (unsigned display_width = 0, chunk_begin = 0; auto& [byte, display] : col_display) {
-                std::string const normalized_source_chunk = normalize_source(
+            // If the beginning of the line is cut, the source code is displayed after the ellipsis.
+            unsigned display_width = annotated_line.truncated_left ? source_line_ellipsis_width : 0;
+            unsigned chunk_begin = 0;
+            for (std::size_t idx = 0; idx != col_bytes.size(); ++idx) {
+                unsigned const byte = col_bytes[idx];
+
+                display_width += normalized_source_display_width(
                     annotated_line.source_line.substr(chunk_begin, byte - chunk_begin),
                     display_tab_width
                 );
-                display_width +=
-                    static_cast<unsigned>(detail::display_width(normalized_source_chunk));
 
                 if (byte > annotated_line.source_line.size()) {
                     // If `byte` exceeds the length of `annotated_line.source_line`, the user is
@@ -1721,7 +2316,7 @@ private:
                     chunk_begin = byte;
                 }
 
-                display = display_width;
+                col_displays[idx] = display_width;
             }
 
             // Finally, we write the results back to `annotated_line.annotations`.
@@ -1730,13 +2325,13 @@ private:
                 case Annotation::SingleLine:
                     // For `SingleLine`, both `col_beg` and `col_end` refer to the source code, so
                     // both need to be set.
-                    annotation.col_beg.display = col_display.find(annotation.col_beg.byte)->second;
+                    annotation.col_beg.display = col_display(annotation.col_beg.byte);
                     [[fallthrough]];
                 case Annotation::MultilineHead:
                 case Annotation::MultilineTail:
                     // For `MultilineHead` and `MultilineTail`, only `col_end` refers to the source
                     // code, while `col_beg` stores the depth of the multiline annotation.
-                    annotation.col_end.display = col_display.find(annotation.col_end.byte)->second;
+                    annotation.col_end.display = col_display(annotation.col_end.byte);
                     [[fallthrough]];
                 default:
                     // For other categories, neither `col_beg` nor `col_end` refer to the source
@@ -1747,7 +2342,8 @@ private:
 
             // Calculate the display width of the source line.
             annotated_line.line_display_width =
-                col_display.find(static_cast<unsigned>(annotated_line.source_line.size()))->second;
+                col_display(static_cast<unsigned>(annotated_line.source_line.size()))
+                + (annotated_line.truncated_right ? source_line_ellipsis_width : 0);
         }
     }
 
@@ -1768,7 +2364,10 @@ private:
     /// xx | |     func(args)
     ///    | |_________^ label1
     ///    |             label2
-    static auto merge_annotations(std::vector<Annotation> annotations) -> std::vector<Annotation> {
+    static auto merge_annotations(std::pmr::vector<Annotation> annotations)
+        -> std::pmr::vector<Annotation> {
+        std::pmr::memory_resource* const resource = annotations.get_allocator().resource();
+
         // We use `std::unordered_set` to eliminate duplicates in `annotations`, but not all members
         // participate in equality comparison. We only merge annotations that have the same range.
         //
@@ -1806,9 +2405,9 @@ private:
         // because here we only deal with part of the `Annotation` members.
         auto const annotation_hasher = [](Annotation const& annotation) {
             std::size_t seed = 0;
-            seed = hash_combine(seed, annotation.col_beg.display);
-            seed = hash_combine(seed, annotation.col_end.display);
-            seed = hash_combine(seed, annotation.type);
+            seed = detail::hash_combine(seed, annotation.col_beg.display);
+            seed = detail::hash_combine(seed, annotation.col_end.display);
+            seed = detail::hash_combine(seed, annotation.type);
             return seed;
         };
 
@@ -1819,8 +2418,8 @@ private:
                 == std::tie(rhs.col_beg.display, rhs.col_end.display, rhs.type);
         };
 
-        std::unordered_set<Annotation, decltype(annotation_hasher), decltype(annotation_eq)>
-            merged_annotations;
+        std::pmr::unordered_set<Annotation, decltype(annotation_hasher), decltype(annotation_eq)>
+            merged_annotations(/*bucket_count=*/0, annotation_hasher, annotation_eq, resource);
 
         for (Annotation& annotation : annotations) {
             auto const [target, inserted] = merged_annotations.insert(std::move(annotation));
@@ -1856,7 +2455,7 @@ private:
             }
         }
 
-        std::vector<Annotation> result;
+        std::pmr::vector<Annotation> result(resource);
         result.reserve(merged_annotations.size());
 
         for (auto iter = merged_annotations.begin(); iter != merged_annotations.end();) {
@@ -1866,14 +2465,82 @@ private:
         return result;
     }
 
+    /// Checks whether the label of `self` should be placed above the label of `other`, where the
+    /// display ranges of both labels start at the same position and end at `self_end` and
+    /// `other_end` respectively. This implements the conditions of Rule 2 described in
+    /// `compute_label_line_positions()`.
+    static auto is_label_placed_above(
+        Annotation const& self,
+        unsigned self_end,
+        Annotation const& other,
+        unsigned other_end
+    ) -> bool {
+        if (self_end != other_end) {
+            // Condition (1): The shorter label is placed above.
+            return self_end < other_end;
+        } else if (self.type != other.type) {
+            // Conditions (2) and (3): Order as Single-line annotation, Multiline tail, and
+            // Multiline head. We assign an integer value to each type of annotation for sorting
+            // purposes.
+            auto const compute_type_value = [](Annotation::AnnotationType annotation_type) {
+                switch (annotation_type) {
+                case Annotation::SingleLine:
+                    return 0;
+                case Annotation::MultilineTail:
+                    return 1;
+                case Annotation::MultilineHead:
+                    return 2;
+                default:
+                    detail::unreachable();
+                }
+            };
+
+            return compute_type_value(self.type) < compute_type_value(other.type);
+        } else {
+            switch (self.type) {
+            case Annotation::SingleLine: {
+                auto const [self_underline_beg, self_underline_end] =
+                    self.underline_display_range();
+                auto const [other_underline_beg, other_underline_end] =
+                    other.underline_display_range();
+                // Condition (4): For single-line annotations, the one with the shorter underline is
+                // placed above.
+                return self_underline_end - self_underline_beg
+                    < other_underline_end - other_underline_beg;
+            }
+            case Annotation::MultilineHead:
+                // Condition (5): For the heads of multiline annotations, the one with the smaller
+                // `depth` is placed above.
+                return self.col_beg.byte < other.col_beg.byte;
+            case Annotation::MultilineTail:
+                // Condition (6): For the tails of multiline annotations, the one with the greater
+                // `depth` is placed above.
+                return other.col_beg.byte < self.col_beg.byte;
+            default:
+                detail::unreachable();
+            };
+        }
+    }
+
     /// Calculates the position of the first line of the annotation's label, i.e., the value of the
-    /// `Annotation::label_line_position` member.
-    static void compute_label_line_positions(
-        HumanRenderer::LabelPosition label_position,
+    /// `Annotation::label_line_position` member. With `HumanRenderer::SweepPlacement`, the same
+    /// positions are calculated by `sweep_label_line_positions()`.
+    ///
+    /// @return The number of edges of the graph built to place the labels, which is 0 with
+    /// `HumanRenderer::SweepPlacement`.
+    template <HumanRenderer::LabelPosition label_position>
+    static auto compute_label_line_positions(
+        HumanRenderer::LabelPlacement label_placement,
         AnnotatedLine& line
-    ) {
+    ) -> std::size_t {
         // Merges annotations with the same range.
-        std::vector<Annotation> annotations = merge_annotations(std::move(line.annotations));
+        std::pmr::vector<Annotation> annotations = merge_annotations(std::move(line.annotations));
+
+        if (label_placement == HumanRenderer::SweepPlacement) {
+            sweep_label_line_positions<label_position>(annotations);
+            line.annotations = std::move(annotations);
+            return 0;
+        }
 
         // Now, we need to identify all annotations that can be rendered inline. For annotations
         // that can be rendered inline, set their `label_line_position` to 0, otherwise set it to 1.
@@ -2139,7 +2806,7 @@ private:
             Annotation* annotation;
             // All successor neighbor vertices of this vertex, each associated with a weight
             // representing the weight of the directed edge from this vertex to the neighbor.
-            std::vector<std::pair<Vertex*, unsigned>> neighbors;
+            std::pmr::vector<std::pair<Vertex*, unsigned>> neighbors;
 
             // The following two members maintain a disjoint set union for the vertices.
 
@@ -2153,10 +2820,11 @@ private:
             unsigned indegree;
 
             Vertex() = default;
-            explicit Vertex(Annotation& annotation, HumanRenderer::LabelPosition label_position) :
+            explicit Vertex(Annotation& annotation, std::pmr::memory_resource* resource) :
                 annotation(&annotation),
+                neighbors(resource),
                 parent(this),
-                rightmost(std::get<1>(annotation.label_display_range(label_position))),
+                rightmost(std::get<1>(annotation.label_display_range<label_position>())),
                 indegree(0) { }
 
             /// Since the member `parent` might point to the object itself, we manually implement
@@ -2236,11 +2904,10 @@ private:
         public:
             // clang-format off
             AnnotationGraph(
-                std::vector<Annotation>& annotations,
-                HumanRenderer::LabelPosition label_position,
+                std::pmr::vector<Annotation>& annotations,
                 unsigned first_line_height
             ) :
-                label_position_(label_position)
+                vertices_(annotations.get_allocator())
             // clang-format on
             {
                 vertices_.reserve(annotations.size());
@@ -2292,7 +2959,7 @@ private:
                         } else {
                             annotation.label_line_position = singleline_beg;
                         }
-                        vertices_.emplace_back(annotation, label_position);
+                        vertices_.emplace_back(annotation, vertices_.get_allocator().resource());
                     }
                 }
 
@@ -2302,7 +2969,9 @@ private:
             /// Assign label line positions to annotations associated with vertices via topological
             /// sorting.
             void assign_label_line_positions() const {
-                std::queue<Vertex const*> vertex_queue;
+                std::queue<Vertex const*, std::pmr::deque<Vertex const*>> vertex_queue(
+                    std::pmr::deque<Vertex const*>(vertices_.get_allocator())
+                );
                 // Add all vertices with an indegree of 0 to the queue.
                 for (Vertex const& vertex : vertices_) {
                     if (vertex.indegree == 0) {
@@ -2347,9 +3016,17 @@ private:
                 }
             }
 
+            /// Returns the number of edges of the graph.
+            auto edge_num() const -> std::size_t {
+                std::size_t result = 0;
+                for (Vertex const& vertex : vertices_) {
+                    result += vertex.neighbors.size();
+                }
+                return result;
+            }
+
         private:
-            std::vector<Vertex> vertices_;
-            HumanRenderer::LabelPosition label_position_;
+            std::pmr::vector<Vertex> vertices_;
 
             static void add_edge(Vertex& from, Vertex& to, unsigned weight) {
                 from.neighbors.emplace_back(&to, weight);
@@ -2363,11 +3040,11 @@ private:
                 // We first check Rules 1 and 2, and build the DSU alongside constructing the graph.
                 for (Vertex& self : vertices_) {
                     auto const [self_beg, self_end] =
-                        self.annotation->label_display_range(label_position_);
+                        self.annotation->template label_display_range<label_position>();
 
                     for (Vertex& other : vertices_) {
                         auto const [other_beg, other_end] =
-                            other.annotation->label_display_range(label_position_);
+                            other.annotation->template label_display_range<label_position>();
 
                         // Rule 1: If a1 < b1 <= a2, then the first line of A's label should be
                         // after B's label.
@@ -2390,57 +3067,12 @@ private:
                         if (self_beg == other_beg) {
                             // Determine whether an edge from `self` to `other` should be added
                             // according to a series of conditions described in Rule 2 .
-                            bool const should_add_edge = [&] {
-                                if (self_end != other_end) {
-                                    // Condition (1): The shorter label is placed above.
-                                    return self_end < other_end;
-                                } else if (self.annotation->type != other.annotation->type) {
-                                    // Conditions (2) and (3): Order as Single-line annotation,
-                                    // Multiline tail, and Multiline head. We assign an integer
-                                    // value to each type of annotation for sorting purposes.
-                                    auto const compute_type_value =
-                                        [](Annotation::AnnotationType annotation_type) {
-                                            switch (annotation_type) {
-                                            case Annotation::SingleLine:
-                                                return 0;
-                                            case Annotation::MultilineTail:
-                                                return 1;
-                                            case Annotation::MultilineHead:
-                                                return 2;
-                                            default:
-                                                detail::unreachable();
-                                            }
-                                        };
-
-                                    return compute_type_value(self.annotation->type)
-                                        < compute_type_value(other.annotation->type);
-                                } else {
-                                    switch (self.annotation->type) {
-                                    case Annotation::SingleLine: {
-                                        auto const [self_underline_beg, self_underline_end] =
-                                            self.annotation->underline_display_range();
-                                        auto const [other_underline_beg, other_underline_end] =
-                                            other.annotation->underline_display_range();
-                                        // Condition (4): For single-line annotations, the one with
-                                        // the shorter underline is placed above.
-                                        return self_underline_end - self_underline_beg
-                                            < other_underline_end - other_underline_beg;
-                                    }
-                                    case Annotation::MultilineHead:
-                                        // Condition (5): For the heads of multiline annotations,
-                                        // the one with the smaller `depth` is placed above.
-                                        return self.annotation->col_beg.byte
-                                            < other.annotation->col_beg.byte;
-                                    case Annotation::MultilineTail:
-                                        // Condition (6): For the tails of multiline annotations,
-                                        // the one with the greater `depth` is placed above.
-                                        return other.annotation->col_beg.byte
-                                            < self.annotation->col_beg.byte;
-                                    default:
-                                        detail::unreachable();
-                                    };
-                                }
-                            }();
+                            bool const should_add_edge = is_label_placed_above(
+                                *self.annotation,
+                                self_end,
+                                *other.annotation,
+                                other_end
+                            );
 
                             if (should_add_edge) {
                                 add_edge(self, other, /*weight=*/0);
@@ -2453,8 +3085,9 @@ private:
                 // 2, and constructed the DSU. Now we check Rule 3, and with the help of the DSU,
                 // determine if Rule 3 can be applied.
                 for (Vertex& self : vertices_) {
-                    unsigned const self_beg =
-                        std::get<0>(self.annotation->label_display_range(label_position_));
+                    unsigned const self_beg = std::get<0>(
+                        self.annotation->template label_display_range<label_position>()
+                    );
 
                     for (Vertex& other : vertices_) {
                         // Rule 3: If b2 < a1 and A is a multiline annotation, then A's horizontal
@@ -2472,58 +3105,801 @@ private:
             }
         };
 
-        AnnotationGraph const annotation_graph(annotations, label_position, first_line_height);
+        AnnotationGraph const annotation_graph(annotations, first_line_height);
         // Assign label positions to all annotations that cannot be rendered inline. Since
         // `AnnotationGraph` does not own the `Annotation` objects, the results are directly written
         // back to the original `Annotation` objects.
         annotation_graph.assign_label_line_positions();
 
         line.annotations = std::move(annotations);
+        return annotation_graph.edge_num();
+    }
+
+    /// Computes the same label positions as the topological sort in
+    /// `compute_label_line_positions()` without building the graph, whose number of edges can grow
+    /// quadratically with the number of annotations. All steps take O(n log n) time.
+    ///
+    /// Whether an annotation can be rendered inline is checked with binary searches over the
+    /// underlines sorted by their starts. The other annotations (the vertices of the graph) are
+    /// then placed one by one in an order in which every edge of the graph goes forward:
+    ///
+    /// 1. The vertices are sorted by the rightmost ends of their sets in the DSU. An edge of Rule 1
+    ///    connects two vertices of the same set, or goes from a label contained in another label,
+    ///    whose set cannot reach further than the set of the containing label. The same holds for
+    ///    Rule 2, where the shorter label goes first. An edge of Rule 3 goes from a set ending
+    ///    before the label of a vertex to the set of the vertex, which ends after that label.
+    /// 2. Vertices whose sets end at the same position are sorted by the starts of their labels
+    ///    in descending order, as required by Rule 1, and then by the order of Rule 2.
+    ///
+    /// The predecessors of a vertex by Rules 1 and 2 are then exactly the placed vertices whose
+    /// labels start in the range of its label, which are looked up in segment trees indexed by the
+    /// starts of the labels. The predecessors by Rule 3 are the placed vertices whose sets end
+    /// before its label, which form a prefix of the order. The check of Rule 4 is equivalent to
+    /// placing a multiline label at least one line after the multiline labels it depends on.
+    ///
+    /// The sets of the DSU are built in a sweep over the ends of the labels, where a label joins
+    /// the sets of the open labels ending inside it. The open labels of each set are contiguous
+    /// in the order of their ends, so the sets are kept in a stack, and the sets joining a label
+    /// are always on the top of the stack.
+    template <HumanRenderer::LabelPosition label_position>
+    static void sweep_label_line_positions(std::pmr::vector<Annotation>& annotations) {
+        std::pmr::memory_resource* const resource = annotations.get_allocator().resource();
+
+        // The non-empty underlines sorted by their starts, and the greatest end of the underlines
+        // in each prefix of them.
+        std::pmr::vector<std::pair<unsigned, unsigned>> underlines(resource);
+        for (Annotation const& annotation : annotations) {
+            auto const [underline_beg, underline_end] = annotation.underline_display_range();
+            if (underline_beg != underline_end) {
+                underlines.emplace_back(underline_beg, underline_end);
+            }
+        }
+        std::ranges::sort(underlines);
+
+        std::pmr::vector<unsigned> prefix_max_end(resource);
+        prefix_max_end.reserve(underlines.size() + 1);
+        prefix_max_end.push_back(0);
+        for (auto const& [underline_beg, underline_end] : underlines) {
+            prefix_max_end.push_back(std::ranges::max(prefix_max_end.back(), underline_end));
+        }
+
+        // Returns the number of non-empty underlines which start before `pos`.
+        auto const count_underlines_before = [&](unsigned pos) {
+            return static_cast<std::size_t>(
+                std::ranges::lower_bound(underlines, pos, {}, &std::pair<unsigned, unsigned>::first)
+                - underlines.begin()
+            );
+        };
+
+        // Identify the annotations that can be rendered inline, with the same conditions as in
+        // `compute_label_line_positions()`.
+        unsigned first_line_height = 1;
+        for (Annotation& self : annotations) {
+            bool const self_is_multiline =
+                self.type == Annotation::MultilineHead || self.type == Annotation::MultilineTail;
+            if (!self_is_multiline && self.label.empty()) {
+                continue;
+            }
+
+            unsigned const label_beg = self.col_end.display;
+            unsigned const label_end = label_beg + self.label_display_width + 2;
+            auto const [underline_beg, underline_end] = self.underline_display_range();
+
+            // Condition 1: an underline starting before the end of the label ends after its start.
+            std::size_t const label_overlaps = count_underlines_before(label_end);
+            // Condition 2: an underline starting before an end of the underline of `self` covers
+            // that end.
+            std::size_t const beg_covers = count_underlines_before(underline_beg);
+            std::size_t const end_covers = count_underlines_before(underline_end + 1);
+            // Condition 3: an underline other than the one of `self` starts at or before the start
+            // of the underline of `self`.
+            std::size_t const left_underlines = count_underlines_before(underline_beg + 1);
+
+            if (prefix_max_end[label_overlaps] > label_beg
+                || (beg_covers != 0 && prefix_max_end[beg_covers] >= underline_beg)
+                || prefix_max_end[end_covers] > underline_end
+                || (self_is_multiline && left_underlines > 1)) {
+                self.label_line_position = 1;
+            } else {
+                first_line_height =
+                    std::ranges::max(first_line_height, static_cast<unsigned>(self.label.size()));
+            }
+        }
+
+        // Collect the vertices, starting from the same lines as in `AnnotationGraph`.
+        unsigned const singleline_beg = std::ranges::max(first_line_height, 2u);
+        unsigned const multiline_beg = first_line_height + 1;
+
+        std::pmr::vector<Annotation*> vertices(resource);
+        for (Annotation& annotation : annotations) {
+            if (annotation.label_line_position != 0) {
+                annotation.label_line_position =
+                    annotation.type == Annotation::SingleLine ? singleline_beg : multiline_beg;
+                vertices.push_back(&annotation);
+            }
+        }
+
+        std::size_t const vertex_num = vertices.size();
+        if (vertex_num == 0) {
+            return;
+        }
+
+        auto const is_multiline = [&](std::size_t vertex) {
+            return vertices[vertex]->type != Annotation::SingleLine;
+        };
+
+        std::pmr::vector<unsigned> label_begs(vertex_num, resource);
+        std::pmr::vector<unsigned> label_ends(vertex_num, resource);
+        for (std::size_t vertex = 0; vertex != vertex_num; ++vertex) {
+            std::tie(label_begs[vertex], label_ends[vertex]) =
+                vertices[vertex]->label_display_range<label_position>();
+        }
+
+        // The DSU of the vertices, and the rightmost ends of the labels in each set.
+        std::pmr::vector<std::size_t> parents(vertex_num, resource);
+        std::iota(parents.begin(), parents.end(), std::size_t(0));
+        std::pmr::vector<unsigned> rightmost(label_ends, resource);
+
+        auto const find_root = [&](std::size_t vertex) {
+            while (parents[vertex] != vertex) {
+                vertex = parents[vertex] = parents[parents[vertex]];
+            }
+            return vertex;
+        };
+
+        // The labels are opened in the order of their starts, and closed in the order of their
+        // ends. A label ends after it starts, even if the label is empty, since two labels overlap
+        // when one starts at the end of the other. Labels starting at the same position do not
+        // overlap, so the longer one is opened first, whereas among labels ending at the same
+        // position, the one opened last is closed first.
+        std::pmr::vector<std::size_t> open_order(vertex_num, resource);
+        std::iota(open_order.begin(), open_order.end(), std::size_t(0));
+        std::ranges::sort(open_order, [&](std::size_t lhs, std::size_t rhs) {
+            return std::tuple(label_begs[lhs], label_ends[rhs], lhs)
+                < std::tuple(label_begs[rhs], label_ends[lhs], rhs);
+        });
+
+        std::pmr::vector<std::size_t> open_ranks(vertex_num, resource);
+        for (std::size_t rank = 0; rank != vertex_num; ++rank) {
+            open_ranks[open_order[rank]] = rank;
+        }
+
+        std::pmr::vector<std::size_t> close_order(open_order, resource);
+        std::ranges::sort(close_order, [&](std::size_t lhs, std::size_t rhs) {
+            return std::tuple(label_ends[lhs], open_ranks[rhs])
+                < std::tuple(label_ends[rhs], open_ranks[lhs]);
+        });
+
+        /// A set of the DSU with open labels.
+        struct OpenSet {
+            /// The root of the set.
+            std::size_t root;
+            /// The smallest end of the open labels of the set.
+            unsigned min_end;
+            /// The number of open labels of the set.
+            std::size_t open_num;
+        };
+
+        // The sets with open labels. The open labels of each set are contiguous in the order of
+        // their ends, and the sets on the top of the stack contain the earlier ends.
+        std::pmr::vector<OpenSet> open_sets(resource);
+        // A min-heap of the ends of the open labels.
+        std::pmr::vector<unsigned> open_ends(resource);
+
+        for (std::size_t open_idx = 0, close_idx = 0; close_idx != vertex_num;) {
+            if (open_idx != vertex_num
+                && label_begs[open_order[open_idx]] <= label_ends[close_order[close_idx]]) {
+                std::size_t const vertex = open_order[open_idx++];
+                OpenSet joined { .root = vertex, .min_end = label_ends[vertex], .open_num = 1 };
+
+                // The open labels ending before the end of the new label started before it and
+                // end inside it, so their sets are merged with the new label.
+                while (!open_sets.empty() && open_sets.back().min_end < label_ends[vertex]) {
+                    OpenSet const& top = open_sets.back();
+                    parents[top.root] = joined.root;
+                    rightmost[joined.root] =
+                        std::ranges::max(rightmost[joined.root], rightmost[top.root]);
+                    joined.min_end = std::ranges::min(joined.min_end, top.min_end);
+                    joined.open_num += top.open_num;
+                    open_sets.pop_back();
+                }
+
+                open_sets.push_back(joined);
+                open_ends.push_back(label_ends[vertex]);
+                std::ranges::push_heap(open_ends, std::ranges::greater());
+            } else {
+                // The label to be closed has the smallest end, so it is in the set on the top.
+                ++close_idx;
+                std::ranges::pop_heap(open_ends, std::ranges::greater());
+                open_ends.pop_back();
+
+                if (--open_sets.back().open_num == 0) {
+                    open_sets.pop_back();
+                } else {
+                    open_sets.back().min_end = open_ends.front();
+                }
+            }
+        }
+
+        std::pmr::vector<unsigned> set_rightmost(vertex_num, resource);
+        for (std::size_t vertex = 0; vertex != vertex_num; ++vertex) {
+            set_rightmost[vertex] = rightmost[find_root(vertex)];
+        }
+
+        // Sort the vertices into the order described above.
+        std::pmr::vector<std::size_t> order(open_order, resource);
+        std::ranges::sort(order, [&](std::size_t lhs, std::size_t rhs) {
+            if (set_rightmost[lhs] != set_rightmost[rhs]) {
+                return set_rightmost[lhs] < set_rightmost[rhs];
+            } else if (label_begs[lhs] != label_begs[rhs]) {
+                return label_begs[lhs] > label_begs[rhs];
+            } else if (is_label_placed_above(
+                           *vertices[lhs],
+                           label_ends[lhs],
+                           *vertices[rhs],
+                           label_ends[rhs]
+                       )) {
+                return true;
+            } else if (is_label_placed_above(
+                           *vertices[rhs],
+                           label_ends[rhs],
+                           *vertices[lhs],
+                           label_ends[lhs]
+                       )) {
+                return false;
+            } else {
+                return lhs < rhs;
+            }
+        });
+
+        // The distinct starts of the labels, which index the segment trees.
+        std::pmr::vector<unsigned> distinct_begs(label_begs, resource);
+        std::ranges::sort(distinct_begs);
+        distinct_begs.erase(std::ranges::unique(distinct_begs).begin(), distinct_begs.end());
+        auto const beg_index = [&](unsigned pos) {
+            return static_cast<std::size_t>(
+                std::ranges::lower_bound(distinct_begs, pos) - distinct_begs.begin()
+            );
+        };
+
+        /// Maintains the maximum of the values at each range of positions.
+        class MaxSegmentTree {
+        public:
+            MaxSegmentTree(std::size_t size, std::pmr::memory_resource* resource) :
+                size_(size), nodes_(2 * size, 0u, resource) { }
+
+            /// Raises the value at `pos` to at least `value`.
+            void raise(std::size_t pos, unsigned value) {
+                for (pos += size_; pos != 0; pos /= 2) {
+                    nodes_[pos] = std::ranges::max(nodes_[pos], value);
+                }
+            }
+
+            /// Returns the maximum of the values in `[first, last)`, or 0 if the range is empty.
+            auto query(std::size_t first, std::size_t last) const -> unsigned {
+                unsigned result = 0;
+                for (first += size_, last += size_; first < last; first /= 2, last /= 2) {
+                    if (first % 2 == 1) {
+                        result = std::ranges::max(result, nodes_[first++]);
+                    }
+                    if (last % 2 == 1) {
+                        result = std::ranges::max(result, nodes_[--last]);
+                    }
+                }
+                return result;
+            }
+
+        private:
+            std::size_t size_;
+            std::pmr::vector<unsigned> nodes_;
+        };
+
+        // The ends of the labels of all placed vertices, and of the placed multiline annotations
+        // with the adjustment of Rule 4, indexed by the starts of the labels.
+        MaxSegmentTree label_end_positions(distinct_begs.size(), resource);
+        MaxSegmentTree multiline_label_end_positions(distinct_begs.size(), resource);
+        // The greatest position required by Rule 3 for each prefix of the order.
+        std::pmr::vector<unsigned> prefix_max_rule3_positions(resource);
+        prefix_max_rule3_positions.reserve(vertex_num + 1);
+        prefix_max_rule3_positions.push_back(0);
+        // The rightmost ends of the sets of the vertices in the order.
+        std::pmr::vector<unsigned> ordered_set_rightmost(resource);
+        ordered_set_rightmost.reserve(vertex_num);
+
+        for (std::size_t const vertex : order) {
+            Annotation& annotation = *vertices[vertex];
+            std::size_t const first = beg_index(label_begs[vertex]);
+            std::size_t const last = static_cast<std::size_t>(
+                std::ranges::upper_bound(distinct_begs, label_ends[vertex]) - distinct_begs.begin()
+            );
+
+            unsigned position = std::ranges::max(
+                annotation.label_line_position,
+                label_end_positions.query(first, last)
+            );
+            if (is_multiline(vertex)) {
+                std::size_t const left_num = static_cast<std::size_t>(
+                    std::ranges::lower_bound(ordered_set_rightmost, label_begs[vertex])
+                    - ordered_set_rightmost.begin()
+                );
+                position = std::ranges::max({
+                    position,
+                    multiline_label_end_positions.query(first, last),
+                    prefix_max_rule3_positions[left_num],
+                });
+            }
+            annotation.label_line_position = position;
+
+            auto const label_height = static_cast<unsigned>(annotation.label.size());
+            label_end_positions.raise(first, position + label_height);
+            if (is_multiline(vertex)) {
+                multiline_label_end_positions.raise(
+                    first,
+                    position + std::ranges::max(label_height, 1u)
+                );
+            }
+
+            prefix_max_rule3_positions.push_back(
+                std::ranges::max(prefix_max_rule3_positions.back(), position + label_height + 1)
+            );
+            ordered_set_rightmost.push_back(set_rightmost[vertex]);
+        }
     }
 };
 
-void render_annotated_source(
+/// Renders the line reporting that `omitted_annotation_num` annotations are not rendered.
+void render_omitted_annotations(StyledString& render_target, std::size_t omitted_annotation_num) {
+    render_target.append_newline();
+    render_target.append("...", Style::LineNumber);
+    render_target.append(" ", Style::Default);
+    render_target.append(std::to_string(omitted_annotation_num), Style::Default);
+    render_target.append(
+        omitted_annotation_num == 1 ? " more annotation omitted" : " more annotations omitted",
+        Style::Default
+    );
+}
+
+/// The options of `HumanRenderer` on which the rendering of the annotated sources is specialized
+/// (see `HumanRenderer::SpecializedRenderer`), down to `AnnotatedLine::render()` and the layout of
+/// the labels. The branches on these options are removed from the rendering of the lines.
+template <
+    HumanRenderer::LabelPosition label_position_value,
+    HumanRenderer::LineNumAlignment line_num_alignment_value,
+    bool expands_tabs_value>
+struct LineRenderOptions {
+    static constexpr HumanRenderer::LabelPosition label_position = label_position_value;
+    static constexpr HumanRenderer::LineNumAlignment line_num_alignment = line_num_alignment_value;
+    /// Whether the tab characters are replaced with spaces, i.e., `display_tab_width` is not 0.
+    static constexpr bool expands_tabs = expands_tabs_value;
+};
+
+/// Renders the annotated lines of `source`, whose span labels are given by `labels`. If
+/// `flush_lines` is not empty, it is called with `render_target` after each annotated line has been
+/// rendered.
+///
+/// If `budget` is not `nullptr`, the output limits of `renderer` are checked before each line is
+/// rendered. Once they are reached, the remaining lines are skipped, and the number of annotations
+/// that are not rendered, including those of the annotated sources that have not been rendered yet,
+/// is reported.
+///
+/// The phases of the layout and the counters of the rendering are reported to the
+/// `RenderObserver` of `renderer`, if any. The options of `renderer` given by `Options` (see
+/// `LineRenderOptions`) are ignored.
+template <class Options>
+void render_annotated_lines(
     StyledString& render_target,
-    AnnotatedSource& source,
+    AnnotatedSource const& source,
+    SpanLabels const& labels,
     HumanRenderer const& renderer,
-    unsigned max_line_num_len
+    unsigned max_line_num_len,
+    detail::OutputBudget* budget,
+    std::function<void(StyledString&)> const& flush_lines
 ) {
     // Add an empty line between the (filename:line number:column number) tuple and the rendered
     // source code to separate them.
     render_line_number(render_target, max_line_num_len);
 
-    AnnotatedLines annotated_lines = AnnotatedLines::from_source(source, renderer);
-    for (auto& [line_num, line] : annotated_lines.annotated_lines()) {
+    // All the scratch state of rendering `source` is allocated from this arena, and released at
+    // once when the rendering is complete. The initial buffer is large enough for small sources
+    // with a few annotations, which then do not allocate any scratch memory from the heap.
+    alignas(std::max_align_t) std::array<std::byte, 4096> initial_buffer;
+    std::pmr::monotonic_buffer_resource arena(
+        initial_buffer.data(),
+        initial_buffer.size(),
+        renderer.scratch_memory_resource != nullptr ? renderer.scratch_memory_resource
+                                                    : std::pmr::get_default_resource()
+    );
+
+    AnnotatedLines annotated_lines =
+        AnnotatedLines::from_source(source, labels, renderer, max_line_num_len, &arena);
+    auto& lines = annotated_lines.annotated_lines();
+
+    RenderObserver* const observer = render_observer_of(renderer);
+    RenderStats stats;
+    if (observer != nullptr) {
+        stats.span_num = source.primary_spans().size() + source.secondary_spans().size();
+        stats.multiline_depth_num = annotated_lines.depth_num();
+        stats.scanned_byte_num = annotated_lines.scanned_byte_num();
+        for (AnnotatedLine const& line : lines | std::views::values) {
+            stats.annotated_line_num += line.annotations.empty() ? 0 : 1;
+        }
+    }
+
+    std::size_t omitted_annotation_num = 0;
+    for (auto iter = lines.begin(); iter != lines.end(); ++iter) {
+        auto& [line_num, line] = *iter;
+
+        if (budget != nullptr) {
+            budget->measure(render_target);
+            if (budget->is_used_up(renderer.max_output_lines, renderer.max_output_bytes)) {
+                // Every annotation of the remaining lines ends on a line with either its only
+                // part or its tail.
+                for (AnnotatedLine const& rest : std::ranges::subrange(iter, lines.end())
+                         | std::views::values) {
+                    omitted_annotation_num += rest.omitted_annotation_num;
+                    omitted_annotation_num += static_cast<std::size_t>(
+                        std::ranges::count_if(rest.annotations, [](Annotation const& annotation) {
+                            return annotation.type == Annotation::SingleLine
+                                || annotation.type == Annotation::MultilineTail;
+                        })
+                    );
+                }
+
+                omitted_annotation_num += budget->pending_annotation_num;
+                budget->exhausted = true;
+                break;
+            }
+        }
+
+        std::size_t const line_beg = render_target.content().size();
         render_target.append_newline();
 
-        line.render(
+        {
+            ScopedRenderPhase const phase(observer, source, RenderPhase::ComputeLabelLinePositions);
+            stats.graph_edge_num +=
+                AnnotatedLines::layout_line<Options::label_position>(renderer, line);
+        }
+
+        {
+            ScopedRenderPhase const phase(observer, source, RenderPhase::RenderLine);
+            line.render<Options>(
+                render_target,
+                max_line_num_len,
+                line_num + source.first_line_number(),
+                annotated_lines.depth_num(),
+                renderer
+            );
+        }
+        omitted_annotation_num += line.omitted_annotation_num;
+        stats.emitted_byte_num += render_target.content().size() - line_beg;
+
+        if (flush_lines) {
+            flush_lines(render_target);
+        }
+    }
+
+    if (omitted_annotation_num != 0) {
+        std::size_t const line_beg = render_target.content().size();
+        render_omitted_annotations(render_target, omitted_annotation_num);
+        stats.emitted_byte_num += render_target.content().size() - line_beg;
+    }
+
+    if (observer != nullptr) {
+        observer->on_source_rendered(source, stats);
+    }
+}
+
+/// Appends the object representation of the integer or enumeration `value` to `key`.
+template <class T>
+void append_key_field(std::string& key, T value) {
+    auto const bytes = std::bit_cast<std::array<char, sizeof(T)>>(value);
+    key.append(bytes.data(), bytes.size());
+}
+
+/// Appends `str` to `key`, preceded by its size so that adjacent strings cannot be confused.
+void append_key_field(std::string& key, std::string_view str) {
+    append_key_field(key, str.size());
+    key.append(str);
+}
+
+/// Appends the content of `label` and the positions and styles of all its parts to `key`.
+void append_key_field(std::string& key, StyledStringView const& label) {
+    append_key_field(key, label.content());
+    for (StyledLine const& line : label.styled_lines()) {
+        for (StyledStringViewPart const part : line) {
+            auto const offset =
+                static_cast<std::size_t>(part.content.data() - label.content().data());
+            append_key_field(key, offset);
+            append_key_field(key, part.content.size());
+            append_key_field(key, part.style.value());
+        }
+    }
+}
+
+/// Builds the key identifying the rendered block of `source` in `RenderCache`, which consists of
+/// everything that `render_annotated_lines()` depends on: the renderer options that affect the
+/// layout, the lines from the first to the last annotated line, and the spans relative to the first
+/// annotated line. Lines outside this range are never rendered, so two sources that differ only in
+/// those lines (or in their origins) share the same key.
+auto render_cache_key(
+    AnnotatedSource const& source,
+    SpanLabels const& labels,
+    HumanRenderer const& renderer,
+    unsigned max_line_num_len
+) -> std::string {
+    std::string key;
+
+    append_key_field(key, max_line_num_len);
+    append_key_field(key, renderer.diagnostic_width);
+    append_key_field(key, renderer.primary_underline);
+    append_key_field(key, renderer.secondary_underline);
+    append_key_field(key, renderer.ui_testing);
+    append_key_field(key, renderer.anonymized_line_num);
+    append_key_field(key, renderer.display_tab_width);
+    append_key_field(key, renderer.max_unannotated_line_num);
+    append_key_field(key, renderer.max_multiline_annotation_line_num);
+    append_key_field(key, renderer.label_position);
+    append_key_field(key, renderer.label_placement);
+    append_key_field(key, renderer.line_num_alignment);
+    append_key_field(key, renderer.max_annotations_per_line);
+
+    auto const all_spans = {
+        std::cref(source.primary_spans()),
+        std::cref(source.secondary_spans()),
+    };
+    unsigned first_line = UINT_MAX;
+    unsigned last_line = 0;
+    for (std::vector<LabeledSpan> const& spans : all_spans) {
+        for (LabeledSpan const& span : spans) {
+            first_line = std::min(first_line, span.beg.line);
+            last_line = std::max(last_line, span.end.line);
+        }
+    }
+
+    append_key_field(key, first_line + source.first_line_number());
+    for (bool const is_primary : { true, false }) {
+        std::vector<LabeledSpan> const& spans =
+            is_primary ? source.primary_spans() : source.secondary_spans();
+        append_key_field(key, spans.size());
+        for (std::size_t idx = 0; idx != spans.size(); ++idx) {
+            LabeledSpan const& span = spans[idx];
+            append_key_field(key, span.beg.line - first_line);
+            append_key_field(key, span.beg.col);
+            append_key_field(key, span.end.line - first_line);
+            append_key_field(key, span.end.col);
+            append_key_field(key, labels.label(is_primary, idx));
+        }
+    }
+
+    // Each line is located from the previous one, whose end is memoized.
+    AnnotatedSource::LineOffsetMemo line_offset_memo;
+    for (unsigned line = first_line; line <= last_line; ++line) {
+        append_key_field(key, source.line_content(line, line_offset_memo));
+    }
+
+    return key;
+}
+
+/// Renders the annotated lines of `source` as `render_annotated_lines()` does. If the renderer has
+/// a `RenderCache`, the rendered lines are looked up in the cache first, and stored in the cache
+/// if they are not found. In that case, `flush_lines` is only called after all lines are appended,
+/// and the output limits are not checked, since the cached lines must not depend on them.
+template <class Options>
+void render_annotated_source(
+    StyledString& render_target,
+    AnnotatedSource const& source,
+    HumanRenderer const& renderer,
+    unsigned max_line_num_len,
+    detail::OutputBudget* budget,
+    std::function<void(StyledString&)> const& flush_lines
+) {
+    // The deferred labels of the source are produced here, as the source is going to be rendered.
+    SpanLabels const labels(source);
+
+    if (renderer.render_cache == nullptr) {
+        render_annotated_lines<Options>(
             render_target,
+            source,
+            labels,
+            renderer,
             max_line_num_len,
-            line_num + source.first_line_number(),
-            annotated_lines.depth_num(),
-            renderer
+            budget,
+            flush_lines
         );
+        return;
+    }
+
+    std::string key = render_cache_key(source, labels, renderer, max_line_num_len);
+    std::shared_ptr<StyledString const> block = renderer.render_cache->find(key);
+    if (block == nullptr) {
+        StyledString rendered;
+        render_annotated_lines<Options>(
+            rendered,
+            source,
+            labels,
+            renderer,
+            max_line_num_len,
+            nullptr,
+            {}
+        );
+        block = renderer.render_cache->insert(std::move(key), std::move(rendered));
+    }
+
+    render_target.append(*block);
+    if (flush_lines) {
+        flush_lines(render_target);
     }
 }
 }  // namespace
 
-void HumanRenderer::render_annotated_sources(
-    StyledString& render_target,
-    std::vector<AnnotatedSource>& sources,
-    unsigned max_line_num_len
-) const {
-    for (unsigned source_idx = 0; AnnotatedSource & source : sources) {
-        if (source.primary_spans().empty() && source.secondary_spans().empty()) {
+auto HumanRenderer::count_annotations(std::vector<AnnotatedSource> const& sources) -> std::size_t {
+    std::size_t result = 0;
+    for (AnnotatedSource const& source : sources) {
+        result += source.primary_spans().size() + source.secondary_spans().size();
+    }
+    return result;
+}
+
+template <
+    HumanRenderer::LabelPosition label_position,
+    HumanRenderer::LineNumAlignment line_num_alignment,
+    bool expands_tabs>
+void HumanRenderer::SpecializedRenderer<label_position, line_num_alignment, expands_tabs>::
+    render_annotated_sources(
+        HumanRenderer const& renderer,
+        StyledString& render_target,
+        std::vector<AnnotatedSource> const& sources,
+        unsigned max_line_num_len,
+        detail::OutputBudget& budget,
+        std::function<void(StyledString&)> const& flush_lines
+    ) {
+    using Options = LineRenderOptions<label_position, line_num_alignment, expands_tabs>;
+
+    auto const has_annotation = [](AnnotatedSource const& source) {
+        return !source.primary_spans().empty() || !source.secondary_spans().empty();
+    };
+
+    bool const has_output_limit = renderer.max_output_lines != 0 || renderer.max_output_bytes != 0;
+    auto const annotated_source_num =
+        static_cast<std::size_t>(std::ranges::count_if(sources, has_annotation));
+    if (!has_output_limit && renderer.parallel_source_threshold != 0
+        && annotated_source_num >= renderer.parallel_source_threshold) {
+        std::vector<AnnotatedSource const*> annotated_sources;
+        annotated_sources.reserve(annotated_source_num);
+        for (AnnotatedSource const& source : sources | std::views::filter(has_annotation)) {
+            annotated_sources.push_back(&source);
+        }
+
+        // Render each source into its own fragment, which starts with the file name line of the
+        // source, exactly as it is rendered by the sequential loop below.
+        std::vector<StyledString> fragments(annotated_source_num);
+        detail::parallel_for(
+            annotated_source_num,
+            renderer.parallel_source_thread_count,
+            [&](std::size_t source_idx, std::pmr::memory_resource* scratch) {
+                HumanRenderer source_renderer = renderer;
+                source_renderer.scratch_memory_resource = scratch;
+
+                AnnotatedSource const& source = *annotated_sources[source_idx];
+                StyledString& fragment = fragments[source_idx];
+                render_file_line_col(fragment, source, max_line_num_len, source_idx == 0);
+
+                fragment.append_newline();
+                render_annotated_source<Options>(
+                    fragment,
+                    source,
+                    source_renderer,
+                    max_line_num_len,
+                    nullptr,
+                    {}
+                );
+            }
+        );
+
+        for (StyledString const& fragment : fragments) {
+            render_target.append_newline();
+            render_target.append(fragment);
+
+            if (flush_lines) {
+                flush_lines(render_target);
+            }
+        }
+        return;
+    }
+
+    // The lines consumed by `flush_lines` are removed from `render_target`, so they are counted
+    // right before, if the output size is limited.
+    std::function<void(StyledString&)> budgeted_flush_lines;
+    if (has_output_limit && flush_lines) {
+        budgeted_flush_lines = [&](StyledString& rendered) {
+            budget.measure(rendered);
+            flush_lines(rendered);
+            budget.measured_size = rendered.content().size();
+        };
+    }
+
+    for (unsigned source_idx = 0; AnnotatedSource const& source : sources) {
+        if (!has_annotation(source)) {
             continue;
         }
 
+        if (has_output_limit) {
+            budget.measure(render_target);
+            if (budget.is_used_up(renderer.max_output_lines, renderer.max_output_bytes)) {
+                render_omitted_annotations(render_target, budget.pending_annotation_num);
+                budget.exhausted = true;
+                return;
+            }
+            budget.pending_annotation_num -=
+                source.primary_spans().size() + source.secondary_spans().size();
+        }
+
         render_target.append_newline();
         render_file_line_col(render_target, source, max_line_num_len, source_idx == 0);
 
         render_target.append_newline();
-        render_annotated_source(render_target, source, *this, max_line_num_len);
+        render_annotated_source<Options>(
+            render_target,
+            source,
+            renderer,
+            max_line_num_len,
+            has_output_limit ? &budget : nullptr,
+            has_output_limit ? budgeted_flush_lines : flush_lines
+        );
+        if (budget.exhausted) {
+            return;
+        }
 
         ++source_idx;
     }
 }
+
+template struct HumanRenderer::
+    SpecializedRenderer<HumanRenderer::Left, HumanRenderer::AlignLeft, false>;
+template struct HumanRenderer::
+    SpecializedRenderer<HumanRenderer::Left, HumanRenderer::AlignLeft, true>;
+template struct HumanRenderer::
+    SpecializedRenderer<HumanRenderer::Left, HumanRenderer::AlignRight, false>;
+template struct HumanRenderer::
+    SpecializedRenderer<HumanRenderer::Left, HumanRenderer::AlignRight, true>;
+template struct HumanRenderer::
+    SpecializedRenderer<HumanRenderer::Right, HumanRenderer::AlignLeft, false>;
+template struct HumanRenderer::
+    SpecializedRenderer<HumanRenderer::Right, HumanRenderer::AlignLeft, true>;
+template struct HumanRenderer::
+    SpecializedRenderer<HumanRenderer::Right, HumanRenderer::AlignRight, false>;
+template struct HumanRenderer::
+    SpecializedRenderer<HumanRenderer::Right, HumanRenderer::AlignRight, true>;
+
+void HumanRenderer::render_annotated_sources(
+    StyledString& render_target,
+    std::vector<AnnotatedSource> const& sources,
+    unsigned max_line_num_len,
+    detail::OutputBudget& budget,
+    std::function<void(StyledString&)> const& flush_lines
+) const {
+    // The specialization for the options is selected once for all sources.
+    auto const select = [&]<LabelPosition label_position, LineNumAlignment line_num_alignment>() {
+        return display_tab_width == 0
+            ? &SpecializedRenderer<label_position, line_num_alignment, false>::
+                  render_annotated_sources
+            : &SpecializedRenderer<label_position, line_num_alignment, true>::
+                  render_annotated_sources;
+    };
+
+    auto const render_sources = [&] {
+        switch (label_position) {
+        case Left:
+            return line_num_alignment == AlignLeft ? select.template operator()<Left, AlignLeft>()
+                                                   : select.template operator()<Left, AlignRight>();
+        case Right:
+            return line_num_alignment == AlignLeft
+                ? select.template operator()<Right, AlignLeft>()
+                : select.template operator()<Right, AlignRight>();
+        default:
+            detail::unreachable();
+        }
+    }();
+    render_sources(*this, render_target, sources, max_line_num_len, budget, flush_lines);
+}
 }  // namespace ants
@@ -0,0 +1,293 @@
+#include "annotate_snippets/renderer/json_renderer.hpp"
+
+#include "annotate_snippets/annotated_source.hpp"
+#include "annotate_snippets/detail/styled_string_impl.hpp"
+#include "annotate_snippets/style.hpp"
+#include "annotate_snippets/styled_string.hpp"
+#include "annotate_snippets/styled_string_view.hpp"
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ants {
+namespace detail {
+namespace {
+/// The result of `scan_utf8_sequence()`.
+struct Utf8Sequence {
+    std::size_t length;
+    bool is_valid;
+};
+
+/// Scans the UTF-8 sequence at the beginning of `str`, whose first byte is not ASCII. If the
+/// sequence is valid, returns its length. Otherwise, returns the length of its longest prefix that
+/// can begin a valid sequence (at least 1 byte), which is replaced by a single U+FFFD as
+/// recommended by the Unicode Standard. Overlong encodings, surrogates and code points above
+/// U+10FFFF are invalid.
+auto scan_utf8_sequence(std::string_view str) -> Utf8Sequence {
+    auto const lead = static_cast<unsigned char>(str[0]);
+
+    // The range of the second byte depends on the lead byte, and the other bytes are in
+    // [0x80, 0xBF].
+    std::size_t length = 0;
+    unsigned char second_min = 0x80;
+    unsigned char second_max = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        if (lead == 0xE0) {
+            second_min = 0xA0;
+        } else if (lead == 0xED) {
+            second_max = 0x9F;
+        }
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        if (lead == 0xF0) {
+            second_min = 0x90;
+        } else if (lead == 0xF4) {
+            second_max = 0x8F;
+        }
+    } else {
+        return { .length = 1, .is_valid = false };
+    }
+
+    for (std::size_t idx = 1; idx != length; ++idx) {
+        if (idx == str.size()) {
+            return { .length = idx, .is_valid = false };
+        }
+
+        auto const ch = static_cast<unsigned char>(str[idx]);
+        unsigned char const min = idx == 1 ? second_min : 0x80;
+        unsigned char const max = idx == 1 ? second_max : 0xBF;
+        if (ch < min || ch > max) {
+            return { .length = idx, .is_valid = false };
+        }
+    }
+    return { .length = length, .is_valid = true };
+}
+}  // namespace
+
+void JsonWriter::write_string(std::string_view str) {
+    write_raw("\"");
+
+    // Write the runs of characters that need no escaping directly from `str`.
+    std::size_t run_beg = 0;
+    for (std::size_t idx = 0; idx != str.size();) {
+        auto const ch = static_cast<unsigned char>(str[idx]);
+        if (ch >= 0x80) {
+            // Valid UTF-8 sequences are written as they are, and invalid ones are replaced, so that
+            // the output is always valid UTF-8.
+            Utf8Sequence const sequence = scan_utf8_sequence(str.substr(idx));
+            if (!sequence.is_valid) {
+                write_raw(str.substr(run_beg, idx - run_beg));
+                write_raw("\\ufffd");
+                run_beg = idx + sequence.length;
+            }
+            idx += sequence.length;
+            continue;
+        }
+        if (ch >= 0x20 && ch != '"' && ch != '\\') {
+            ++idx;
+            continue;
+        }
+
+        write_raw(str.substr(run_beg, idx - run_beg));
+        run_beg = idx + 1;
+        ++idx;
+
+        switch (ch) {
+        case '"':
+            write_raw("\\\"");
+            break;
+        case '\\':
+            write_raw("\\\\");
+            break;
+        case '\n':
+            write_raw("\\n");
+            break;
+        case '\r':
+            write_raw("\\r");
+            break;
+        case '\t':
+            write_raw("\\t");
+            break;
+        default: {
+            constexpr std::string_view hex_digits = "0123456789abcdef";
+            std::array<char, 6> const escaped { '\\', 'u', '0', '0', hex_digits[ch >> 4],
+                                                hex_digits[ch & 0xF] };
+            write_raw(std::string_view(escaped.data(), escaped.size()));
+            break;
+        }
+        }
+    }
+    write_raw(str.substr(run_beg));
+
+    write_raw("\"");
+}
+
+void JsonWriter::write_number(std::size_t number) {
+    std::array<char, 24> buffer;
+    auto const result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), number);
+    write_raw(std::string_view(buffer.data(), result.ptr));
+}
+
+void JsonWriter::write_styled_text(
+    std::string_view content,
+    StyledLineRange lines,
+    bool writes_styles
+) {
+    write_raw("{\"text\":");
+    write_string(content);
+
+    if (writes_styles) {
+        write_raw(",\"styles\":[");
+
+        struct StyledRange {
+            std::size_t beg;
+            std::size_t end;
+            Style style;
+        };
+
+        bool is_first = true;
+        auto const write_range = [&](StyledRange const& range) {
+            if (!std::exchange(is_first, false)) {
+                write_raw(",");
+            }
+            write_raw("{\"beg\":");
+            write_number(range.beg);
+            write_raw(",\"end\":");
+            write_number(range.end);
+            write_raw(",\"style\":");
+            write_style(range.style);
+            write_raw("}");
+        };
+
+        // The range being extended, which is written when a range of another style is found.
+        std::optional<StyledRange> pending;
+        for (StyledLine const& line : lines) {
+            for (StyledStringViewPart const& part : line) {
+                if (part.content.empty() || part.style.is_auto_style()) {
+                    continue;
+                }
+
+                auto const beg = static_cast<std::size_t>(part.content.data() - content.data());
+                std::size_t const end = beg + part.content.size();
+                // The parts of adjacent lines are separated by the line break only.
+                if (pending && pending->style == part.style
+                    && (pending->end == beg
+                        || (pending->end + 1 == beg && content[pending->end] == '\n'))) {
+                    pending->end = end;
+                    continue;
+                }
+
+                if (pending) {
+                    write_range(*pending);
+                }
+                pending = StyledRange { .beg = beg, .end = end, .style = part.style };
+            }
+        }
+        if (pending) {
+            write_range(*pending);
+        }
+
+        write_raw("]");
+    }
+
+    write_raw("}");
+}
+
+void JsonWriter::write_style(Style style) {
+    if (style.is_user_defined_style()) {
+        write_number(static_cast<std::size_t>(style.value()));
+        return;
+    }
+
+    // Indexed by `Style::PredefinedStyle`.
+    constexpr std::array<std::string_view, 16> predefined_style_names {
+        "auto",
+        "default",
+        "primary_title",
+        "secondary_title",
+        "primary_message",
+        "secondary_message",
+        "origin_and_location",
+        "line_number",
+        "source_code",
+        "primary_underline",
+        "secondary_underline",
+        "primary_label",
+        "secondary_label",
+        "highlight",
+        "addition",
+        "removal",
+    };
+
+    auto const idx = static_cast<std::size_t>(style.as_predefined_style());
+    write_string(idx < predefined_style_names.size() ? predefined_style_names[idx] : "unknown");
+}
+}  // namespace detail
+
+void JsonRenderer::render_annotated_source(
+    detail::JsonWriter& writer,
+    AnnotatedSource const& source
+) const {
+    writer.write_raw("{\"origin\":");
+    writer.write_string(source.origin());
+
+    writer.write_raw(",\"spans\":[");
+    AnnotatedSource::LineOffsetMemo line_offset_memo;
+    bool is_first = true;
+    auto const render_spans = [&](std::vector<LabeledSpan> const& spans, bool is_primary) {
+        for (LabeledSpan const& span : spans) {
+            if (!std::exchange(is_first, false)) {
+                writer.write_raw(",");
+            }
+            render_labeled_span(writer, source, line_offset_memo, span, is_primary);
+        }
+    };
+    render_spans(source.primary_spans(), /*is_primary=*/true);
+    render_spans(source.secondary_spans(), /*is_primary=*/false);
+    writer.write_raw("]}");
+}
+
+void JsonRenderer::render_labeled_span(
+    detail::JsonWriter& writer,
+    AnnotatedSource const& source,
+    AnnotatedSource::LineOffsetMemo& line_offset_memo,
+    LabeledSpan const& span,
+    bool is_primary
+) const {
+    writer.write_raw(is_primary ? "{\"primary\":true" : "{\"primary\":false");
+
+    writer.write_raw(",\"byte_beg\":");
+    writer.write_number(source.line_offset(span.beg.line, line_offset_memo) + span.beg.col);
+    writer.write_raw(",\"byte_end\":");
+    writer.write_number(source.line_offset(span.end.line, line_offset_memo) + span.end.col);
+
+    writer.write_raw(",\"line_beg\":");
+    writer.write_number(std::size_t { span.beg.line } + source.first_line_number());
+    writer.write_raw(",\"col_beg\":");
+    writer.write_number(std::size_t { span.beg.col } + 1);
+    writer.write_raw(",\"line_end\":");
+    writer.write_number(std::size_t { span.end.line } + source.first_line_number());
+    writer.write_raw(",\"col_end\":");
+    writer.write_number(std::size_t { span.end.col } + 1);
+
+    writer.write_raw(",\"label\":");
+    if (span.deferred_label) {
+        StyledString const label = span.deferred_label();
+        writer.write_styled_text(label.content(), label.styled_lines(), renders_styles);
+    } else if (span.label.empty()) {
+        writer.write_raw("null");
+    } else {
+        writer.write_styled_text(span.label.content(), span.label.styled_lines(), renders_styles);
+    }
+
+    writer.write_raw("}");
+}
+}  // namespace ants
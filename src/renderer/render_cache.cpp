@@ -0,0 +1,62 @@
+#include "annotate_snippets/renderer/render_cache.hpp"
+
+#include "annotate_snippets/styled_string.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace ants {
+auto RenderCache::size() const -> std::size_t {
+    std::lock_guard const lock(mutex_);
+    return entries_.size();
+}
+
+auto RenderCache::find(std::string_view key) -> std::shared_ptr<StyledString const> {
+    std::lock_guard const lock(mutex_);
+
+    auto const iter = index_.find(key);
+    if (iter == index_.end()) {
+        miss_count_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    hit_count_.fetch_add(1, std::memory_order_relaxed);
+    entries_.splice(entries_.begin(), entries_, iter->second);
+    return iter->second->block;
+}
+
+auto RenderCache::insert(std::string key, StyledString block)
+    -> std::shared_ptr<StyledString const> {
+    auto stored = std::make_shared<StyledString const>(std::move(block));
+    if (capacity_ == 0) {
+        return stored;
+    }
+
+    std::lock_guard const lock(mutex_);
+
+    if (auto const iter = index_.find(key); iter != index_.end()) {
+        entries_.splice(entries_.begin(), entries_, iter->second);
+        return iter->second->block;
+    }
+
+    if (entries_.size() == capacity_) {
+        index_.erase(entries_.back().key);
+        entries_.pop_back();
+    }
+
+    entries_.push_front(Entry { .key = std::move(key), .block = std::move(stored) });
+    index_.emplace(entries_.front().key, entries_.begin());
+    return entries_.front().block;
+}
+
+void RenderCache::clear() {
+    std::lock_guard const lock(mutex_);
+    index_.clear();
+    entries_.clear();
+}
+}  // namespace ants
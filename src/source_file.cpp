@@ -0,0 +1,128 @@
+#include "annotate_snippets/source_file.hpp"
+
+#include "annotate_snippets/line_index.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace ants {
+namespace detail {
+#ifdef _WIN32
+FileMapping::~FileMapping() {
+    if (address_ != nullptr) {
+        ::UnmapViewOfFile(address_);
+    }
+}
+
+auto FileMapping::map(std::string const& path, FileMapping& mapping) -> bool {
+    HANDLE const file = ::CreateFileA(
+        path.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr
+    );
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (::GetFileType(file) != FILE_TYPE_DISK || !::GetFileSizeEx(file, &size)) {
+        ::CloseHandle(file);
+        return false;
+    }
+    if (size.QuadPart == 0) {
+        // Empty files cannot be mapped.
+        ::CloseHandle(file);
+        mapping = FileMapping();
+        return true;
+    }
+
+    // The view keeps the file mapping object alive, so the handles can be closed right away.
+    HANDLE const file_mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    ::CloseHandle(file);
+    if (file_mapping == nullptr) {
+        return false;
+    }
+
+    void const* const address = ::MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0);
+    ::CloseHandle(file_mapping);
+    if (address == nullptr) {
+        return false;
+    }
+
+    mapping = FileMapping(address, static_cast<std::size_t>(size.QuadPart));
+    return true;
+}
+#else
+FileMapping::~FileMapping() {
+    if (address_ != nullptr) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast): The mapping is read-only.
+        ::munmap(const_cast<void*>(address_), size_);
+    }
+}
+
+auto FileMapping::map(std::string const& path, FileMapping& mapping) -> bool {
+    int const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat status { };
+    if (::fstat(fd, &status) != 0 || !S_ISREG(status.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+
+    auto const size = static_cast<std::size_t>(status.st_size);
+    void* address = nullptr;
+    if (size != 0) {
+        // The mapping stays valid after the file descriptor is closed. Empty files cannot be
+        // mapped, and are represented by an empty mapping.
+        address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+
+    mapping = FileMapping(address, size);
+    return true;
+}
+#endif
+}  // namespace detail
+
+auto SourceFile::mapped(std::string path) -> std::shared_ptr<SourceFile const> {
+    detail::FileMapping mapping;
+    if (!detail::FileMapping::map(path, mapping)) {
+        return nullptr;
+    }
+
+    return std::make_shared<SourceFile const>(PrivateTag(), std::move(mapping), std::move(path));
+}
+
+auto SourceFile::line_index() const -> LineIndex const& {
+    std::call_once(line_index_flag_, [this] { line_index_ = LineIndex(source_); });
+    return line_index_;
+}
+}  // namespace ants
@@ -6,7 +6,102 @@
 #include <string_view>
 
 namespace ants {
+namespace {
+/// Checks whether `rang` would emit styles to the output stream associated with `out`.
+auto is_colored_stream(std::ostream const& out) -> bool {
+    switch (rang::rang_implementation::controlMode().load()) {
+    case rang::control::Force:
+        return true;
+    case rang::control::Auto:
+        return rang::rang_implementation::supportsColor()
+            && rang::rang_implementation::isTerminal(out.rdbuf());
+    default:
+        return false;
+    }
+}
+}  // namespace
+
+StyledLineWriter::StyledLineWriter(std::ostream& out) :
+    StyledLineWriter(
+        out,
+#ifdef _WIN32
+        // `rang` may set the styles through the console API instead of escape sequences.
+        is_colored_stream(out) ? Native : Plain
+#else
+        is_colored_stream(out) ? Ansi : Plain
+#endif
+    ) { }
+
+StyledLineWriter::StyledLineWriter(std::ostream& out, Mode mode) :
+    sink_(&out),
+    write_line_([](void* sink, std::string_view line) {
+        static_cast<std::ostream*>(sink)->write(
+            line.data(),
+            static_cast<std::streamsize>(line.size())
+        );
+    }),
+    native_out_(&out), mode_(mode) { }
+
+void StyledLineWriter::append(std::string_view content, StyleSpec spec) {
+    switch (mode_) {
+    case Plain:
+        line_buffer_.append(content);
+        break;
+    case Ansi:
+        // Adjacent strings of the same style share a single pair of escape sequences. An empty
+        // string never changes the style.
+        if (spec != current_spec_ && !content.empty()) {
+            if (current_spec_ != StyleSpec()) {
+                line_buffer_.append(StyleSpec::ansi_reset_sequence);
+            }
+            line_buffer_.append(spec.ansi_escape_sequence().view());
+            current_spec_ = spec;
+        }
+        line_buffer_.append(content);
+        break;
+    case Native:
+        spec.render_string(*native_out_, content);
+        break;
+    }
+}
+
+void StyledLineWriter::end_line() {
+    if (mode_ == Native) {
+        *native_out_ << '\n';
+        return;
+    }
+
+    if (current_spec_ != StyleSpec()) {
+        line_buffer_.append(StyleSpec::ansi_reset_sequence);
+        current_spec_ = StyleSpec();
+    }
+    line_buffer_.push_back('\n');
+
+    write_line_(sink_, line_buffer_);
+    line_buffer_.clear();
+}
+
+void StyledLineWriter::write_plain_lines(std::string_view lines) {
+    if (mode_ == Native) {
+        native_out_->write(lines.data(), static_cast<std::streamsize>(lines.size()));
+        return;
+    }
+
+    write_line_(sink_, lines);
+}
+
 void StyleSpec::render_string(std::ostream& out, std::string_view content) const {
+#ifndef _WIN32
+    // Outside Windows, `rang` always uses escape sequences, so we can emit the precomputed sequence
+    // directly instead of one sequence for each color and text style.
+    if (!is_colored_stream(out)) {
+        out << content;
+    } else if (*this == StyleSpec()) {
+        out << ansi_reset_sequence << content;
+    } else {
+        out << ansi_escape_sequence().view() << content << ansi_reset_sequence;
+    }
+#else
 #define COLOR_SWITCH_BODY(ns) COLOR_CASES(ns) BRIGHT_COLOR_CASES(ns) DEFAULT_CASE(ns)
 
 #define COLOR_CASES(ns) COLOR_CASES_IMPL(ns, EMPTY)
@@ -62,5 +157,6 @@ void StyleSpec::render_string(std::ostream& out, std::string_view content) const
 #undef BRIGHT_COLOR_CASES
 #undef COLOR_CASES
 #undef COLOR_SWITCH_BODY
+#endif
 }
 }  // namespace ants
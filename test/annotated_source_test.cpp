@@ -2,7 +2,10 @@
 
 #include "gtest/gtest.h"
 
+#include <algorithm>
 #include <cstddef>
+#include <ranges>
+#include <string_view>
 #include <type_traits>
 #include <vector>
 
@@ -479,4 +482,111 @@ TEST(AnnotatedSourceTest, LineContent) {
         EXPECT_EQ(source.line_content(7), "");
     }
 }
+
+TEST(AnnotatedSourceTest, LineIndex) {
+    const char* const source = "ab\ncd\r\ne\nf";
+
+    ants::AnnotatedSource as(source);
+    EXPECT_EQ(as.line_index(), nullptr);
+
+    as.build_line_index();
+    ASSERT_NE(as.line_index(), nullptr);
+    EXPECT_EQ(as.line_index()->line_starts(), (std::vector<std::size_t> { 0, 3, 7, 9, 10 }));
+
+    EXPECT_EQ(as.line_offset(2), 7);
+    EXPECT_EQ(as.line_offset(4), 10);
+    EXPECT_EQ(as.line_offset(100), 10);
+
+    EXPECT_EQ(as.byte_offset_to_line_col(0), (ants::SourceLocation { 0, 0 }));
+    EXPECT_EQ(as.byte_offset_to_line_col(6), (ants::SourceLocation { 1, 3 }));
+    EXPECT_EQ(as.byte_offset_to_line_col(9), (ants::SourceLocation { 3, 0 }));
+    EXPECT_EQ(as.byte_offset_to_line_col(14), (ants::SourceLocation { 4, 4 }));
+
+    EXPECT_EQ(as.line_content(0), "ab");
+    EXPECT_EQ(as.line_content(1), "cd");
+    EXPECT_EQ(as.line_content(3), "f");
+    EXPECT_EQ(as.line_content(4), "");
+
+    // The cache is not used when the line index is available.
+    EXPECT_TRUE(as.line_offsets_cache().empty());
+
+    // Copies share the same index.
+    ants::AnnotatedSource const copy = as;
+    EXPECT_EQ(copy.line_index(), as.line_index());
+}
+
+TEST(AnnotatedSourceTest, ByteOffsetsToLineCols) {
+    for (std::string_view const source : { "ab\ncd\r\ne\nf", "ab\ncd\n", "\n\n", "abc", "" }) {
+        // Offsets in an arbitrary order, including repeated offsets and offsets beyond the end.
+        std::vector<std::size_t> offsets;
+        for (std::size_t offset = 0; offset <= source.size() + 3; ++offset) {
+            offsets.push_back((offset * 7) % (source.size() + 4));
+        }
+        offsets.push_back(1);
+
+        ants::AnnotatedSource expected_source(source);
+        std::vector<ants::SourceLocation> expected;
+        for (std::size_t const offset : offsets) {
+            expected.push_back(expected_source.byte_offset_to_line_col(offset));
+        }
+
+        ants::AnnotatedSource as(source);
+        std::vector<ants::SourceLocation> locations(offsets.size());
+        as.byte_offsets_to_line_cols(offsets, locations);
+        EXPECT_EQ(locations, expected) << source;
+        // The lines containing the offsets are cached.
+        EXPECT_EQ(as.line_offsets_cache(), expected_source.line_offsets_cache()) << source;
+
+        // The line index is used if available.
+        as.build_line_index();
+        std::ranges::fill(locations, ants::SourceLocation { 0, 0 });
+        as.byte_offsets_to_line_cols(offsets, locations);
+        EXPECT_EQ(locations, expected) << source;
+    }
+}
+
+TEST(AnnotatedSourceTest, BulkAnnotations) {
+    std::string_view const source = "let a = 1;\nlet b = a + 2;\nlet c = b;\n";
+
+    std::vector<ants::LabeledByteSpan> const spans {
+        { .beg = 35, .end = 36, .label = ants::StyledStringView::inferred("third") },
+        { .beg = 4, .end = 5, .label = ants::StyledStringView::inferred("first") },
+        { .beg = 19, .end = 24, .label = {} },
+        { .beg = 8, .end = 30, .label = ants::StyledStringView::inferred("multi-line") },
+    };
+
+    ants::AnnotatedSource expected(source);
+    for (ants::LabeledByteSpan const& span : spans) {
+        expected.add_primary_annotation(span.beg, span.end, span.label);
+        expected.add_secondary_annotation(span.beg, span.end, span.label);
+    }
+
+    auto const compare_spans = [](std::vector<ants::LabeledSpan> const& lhs,
+                                  std::vector<ants::LabeledSpan> const& rhs) {
+        ASSERT_EQ(lhs.size(), rhs.size());
+        for (std::size_t idx = 0; idx != lhs.size(); ++idx) {
+            EXPECT_EQ(lhs[idx].beg, rhs[idx].beg);
+            EXPECT_EQ(lhs[idx].end, rhs[idx].end);
+            EXPECT_EQ(lhs[idx].label.content(), rhs[idx].label.content());
+        }
+    };
+
+    // The spans are added in order, from a contiguous range and from a view.
+    ants::AnnotatedSource const as = ants::AnnotatedSource(source)
+                                         .with_annotations(spans)
+                                         .with_secondary_annotations(spans | std::views::all);
+    compare_spans(as.primary_spans(), expected.primary_spans());
+    compare_spans(as.secondary_spans(), expected.secondary_spans());
+
+    ants::AnnotatedSource other(source);
+    other.add_primary_annotations(
+        std::views::iota(0, 3) | std::views::transform([](int idx) {
+            auto const beg = static_cast<std::size_t>(idx) * 11;
+            return ants::LabeledByteSpan { .beg = beg, .end = beg + 3, .label = {} };
+        })
+    );
+    ASSERT_EQ(other.primary_spans().size(), 3);
+    EXPECT_EQ(other.primary_spans()[2].beg, (ants::SourceLocation { 1, 11 }));
+    EXPECT_EQ(other.primary_spans()[2].end, (ants::SourceLocation { 1, 14 }));
+}
 }  // namespace
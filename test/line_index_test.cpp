@@ -0,0 +1,101 @@
+#include "annotate_snippets/line_index.hpp"
+
+#include "annotate_snippets/annotated_source.hpp"
+
+#include "gtest/gtest.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+TEST(LineIndexTest, LineStarts) {
+#define TEST_CASE(source, ...)                                                                     \
+    EXPECT_EQ(ants::LineIndex(source).line_starts(), (std::vector<std::size_t> { __VA_ARGS__ }))
+
+    TEST_CASE("", 0);
+    TEST_CASE("abc", 0, 3);
+    TEST_CASE("abc\n", 0, 4);
+    TEST_CASE("abc\r\n", 0, 5);
+    TEST_CASE("\n", 0, 1);
+    TEST_CASE("\n\n", 0, 1, 2);
+    TEST_CASE("ab\ncd\ne\nf", 0, 3, 6, 8, 9);
+    TEST_CASE("\r\n1\n2\n\n\n", 0, 2, 4, 6, 7, 8);
+
+#undef TEST_CASE
+
+    EXPECT_EQ(ants::LineIndex().line_starts(), std::vector<std::size_t> { 0 });
+}
+
+TEST(LineIndexTest, LongSource) {
+    // Newline characters around the boundaries of the blocks scanned by SIMD instructions.
+    for (std::size_t const size : { 15, 16, 17, 31, 32, 33, 63, 64, 65, 100 }) {
+        for (std::size_t const newline_pos : { 0, 1, 14, 15, 16, 17, 30, 31, 32, 33, 62, 63, 64 }) {
+            if (newline_pos >= size) {
+                continue;
+            }
+
+            std::string source(size, 'a');
+            source[newline_pos] = '\n';
+
+            std::vector<std::size_t> expected { 0, newline_pos + 1 };
+            if (newline_pos + 1 != size) {
+                expected.push_back(size);
+            }
+
+            EXPECT_EQ(ants::LineIndex(source).line_starts(), expected)
+                << "size: " << size << ", newline: " << newline_pos;
+        }
+    }
+
+    {
+        std::string source;
+        std::vector<std::size_t> expected { 0 };
+        for (unsigned idx = 0; idx != 1000; ++idx) {
+            source.append(idx % 37, 'x').append(idx % 5 == 0 ? "\r\n" : "\n");
+            expected.push_back(source.size());
+        }
+
+        ants::LineIndex const index(source);
+        EXPECT_EQ(index.line_starts(), expected);
+        EXPECT_EQ(index.line_count(), 1001);
+    }
+}
+
+TEST(LineIndexTest, MatchesLineOffsetCache) {
+    std::string long_source;
+    for (unsigned idx = 0; idx != 50; ++idx) {
+        long_source.append(idx % 7 * 9, '-').append("\n");
+    }
+    long_source.append("trailing");
+
+    for (std::string_view const source :
+         { std::string_view(""),
+           std::string_view("abc"),
+           std::string_view("abc\n"),
+           std::string_view("\r\n"),
+           std::string_view("ab\ncd\ne\nf"),
+           std::string_view("\r\n1\n2\n\n\n"),
+           std::string_view(long_source) }) {
+        ants::LineIndex const index(source);
+
+        for (unsigned line = 0; line != index.line_count() + 3; ++line) {
+            ants::AnnotatedSource as(source);
+            EXPECT_EQ(index.line_offset(line), as.line_offset(line))
+                << "source: " << source << ", line: " << line;
+        }
+
+        for (std::size_t byte = 0; byte != source.size() + 3; ++byte) {
+            ants::AnnotatedSource as(source);
+            auto const [line, line_start] = index.byte_offset_to_line(byte);
+            EXPECT_EQ(
+                (ants::SourceLocation { line, static_cast<unsigned>(byte - line_start) }),
+                as.byte_offset_to_line_col(byte)
+            ) << "source: "
+              << source << ", byte: " << byte;
+        }
+    }
+}
+}  // namespace
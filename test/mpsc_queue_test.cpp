@@ -0,0 +1,70 @@
+#include "annotate_snippets/detail/mpsc_queue.hpp"
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+using Queue = ants::detail::MpscQueue<std::unique_ptr<int>>;
+
+TEST(MpscQueueTest, PopAll) {
+    Queue queue;
+    EXPECT_TRUE(queue.empty());
+
+    std::vector<std::unique_ptr<int>> batch;
+    EXPECT_EQ(queue.pop_all(batch), 0);
+
+    queue.push(std::make_unique<int>(1));
+    queue.push(std::make_unique<int>(2));
+    EXPECT_FALSE(queue.empty());
+    batch.push_back(std::make_unique<int>(0));
+
+    // The values are appended in the order in which they are pushed.
+    EXPECT_EQ(queue.pop_all(batch), 2);
+    ASSERT_EQ(batch.size(), 3);
+    EXPECT_EQ(*batch[1], 1);
+    EXPECT_EQ(*batch[2], 2);
+    EXPECT_TRUE(queue.empty());
+
+    // The remaining values are destroyed with the queue.
+    queue.push(std::make_unique<int>(3));
+}
+
+TEST(MpscQueueTest, ConcurrentPush) {
+    constexpr std::size_t producer_num = 4;
+    constexpr int value_num = 10000;
+
+    ants::detail::MpscQueue<std::pair<std::size_t, int>> queue;
+    std::atomic<std::size_t> finished_num = 0;
+    std::vector<std::pair<std::size_t, int>> values;
+    {
+        std::vector<std::jthread> producers;
+        for (std::size_t producer = 0; producer != producer_num; ++producer) {
+            producers.emplace_back([&, producer] {
+                for (int value = 0; value != value_num; ++value) {
+                    queue.push({ producer, value });
+                }
+                finished_num.fetch_add(1);
+            });
+        }
+
+        // Consume the values while they are pushed.
+        while (finished_num.load() != producer_num) {
+            queue.pop_all(values);
+        }
+    }
+    queue.pop_all(values);
+
+    // Every value is taken exactly once, and the values of each producer are in order.
+    ASSERT_EQ(values.size(), producer_num * value_num);
+    std::vector<int> next_values(producer_num, 0);
+    for (auto const& [producer, value] : values) {
+        EXPECT_EQ(value, next_values[producer]++);
+    }
+}
+}  // namespace
@@ -0,0 +1,132 @@
+#include "annotate_snippets/output_sink.hpp"
+#include "annotate_snippets/style_spec.hpp"
+
+#include "gtest/gtest.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#ifndef _WIN32
+    #include <unistd.h>
+#endif
+
+namespace {
+static_assert(ants::output_sink<ants::StringSink>);
+static_assert(ants::output_sink<ants::FileSink>);
+static_assert(ants::output_sink<ants::OStreamSink>);
+static_assert(!ants::output_sink<std::ostream>);
+static_assert(!ants::output_sink<std::string>);
+
+TEST(OutputSinkTest, StringSink) {
+    std::string target = "abc";
+    ants::StringSink sink(target);
+    sink.write("def");
+    sink.write("");
+    sink.write("\n");
+    EXPECT_EQ(target, "abcdef\n");
+    EXPECT_EQ(&sink.target(), &target);
+}
+
+TEST(OutputSinkTest, OStreamSink) {
+    std::ostringstream out;
+    ants::OStreamSink sink(out);
+    sink.write("abc");
+    sink.write(std::string_view("d\0e", 3));
+    EXPECT_EQ(out.str(), std::string("abcd\0e", 6));
+}
+
+TEST(OutputSinkTest, FileSink) {
+    std::FILE* const file = std::tmpfile();
+    ASSERT_NE(file, nullptr);
+
+    ants::FileSink sink(file);
+    sink.write("abc");
+    sink.write("def\n");
+
+    std::rewind(file);
+    std::array<char, 16> buffer {};
+    std::size_t const size = std::fread(buffer.data(), 1, buffer.size(), file);
+    EXPECT_EQ(std::string_view(buffer.data(), size), "abcdef\n");
+
+    std::fclose(file);
+}
+
+#ifndef _WIN32
+/// Reads everything available from the read end of a pipe whose write end has been closed.
+auto read_all(int fd) -> std::string {
+    std::string result;
+    std::array<char, 4096> buffer {};
+    for (ssize_t size; (size = ::read(fd, buffer.data(), buffer.size())) > 0;) {
+        result.append(buffer.data(), static_cast<std::size_t>(size));
+    }
+    return result;
+}
+
+TEST(OutputSinkTest, FdSink) {
+    std::array<int, 2> fds {};
+    ASSERT_EQ(::pipe(fds.data()), 0);
+
+    // The total size is kept below the capacity of a pipe, so that the writes never block.
+    std::string const long_string(ants::FdSink::buffer_capacity + 100, 'x');
+    std::string expected;
+    {
+        ants::FdSink sink(fds[1]);
+        EXPECT_EQ(sink.fd(), fds[1]);
+
+        sink.write("abc");
+        sink.write("def\n");
+        expected.append("abcdef\n");
+
+        // A string that does not fit in the buffer is written together with the buffered text.
+        sink.write(long_string);
+        expected.append(long_string);
+
+        sink.write("tail");
+        sink.flush();
+        sink.flush();
+        expected.append("tail");
+
+        // The remaining text is written when the sink is destroyed.
+        sink.write("end\n");
+        expected.append("end\n");
+    }
+
+    ::close(fds[1]);
+    EXPECT_EQ(read_all(fds[0]), expected);
+    ::close(fds[0]);
+}
+#endif
+
+TEST(OutputSinkTest, RenderStringToSink) {
+    std::string target;
+    ants::StringSink sink(target);
+
+    ants::StyleSpec().render_string(sink, "plain ");
+    (ants::StyleSpec::Red + ants::StyleSpec::Bold).render_string(sink, "red");
+    EXPECT_EQ(target, "plain \033[1;31mred\033[0m");
+}
+
+TEST(OutputSinkTest, StyledLineWriter) {
+    std::string target;
+    ants::StringSink sink(target);
+
+    ants::StyledLineWriter writer(sink, /*use_escape_sequences=*/true);
+    writer.append("error", ants::StyleSpec::Red);
+    EXPECT_EQ(target, "");
+    writer.end_line();
+    EXPECT_EQ(target, "\033[31merror\033[0m\n");
+
+    ants::StyledLineWriter plain_writer(sink, /*use_escape_sequences=*/false);
+    plain_writer.append("error", ants::StyleSpec::Red);
+    plain_writer.end_line();
+    EXPECT_EQ(target, "\033[31merror\033[0m\nerror\n");
+
+    // Complete plain lines are passed to the sink as they are.
+    target.clear();
+    writer.write_plain_lines("first\nsecond\n");
+    EXPECT_EQ(target, "first\nsecond\n");
+}
+}  // namespace
@@ -0,0 +1,116 @@
+#include "annotate_snippets/annotated_source.hpp"
+#include "annotate_snippets/diag.hpp"
+#include "annotate_snippets/output_sink.hpp"
+#include "annotate_snippets/renderer/human_renderer.hpp"
+#include "annotate_snippets/styled_string.hpp"
+#include "annotate_snippets/styled_string_view.hpp"
+#include "level_for_test.hpp"
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+struct RightAlignedConfig : ants::DefaultHumanRendererConfig {
+    static constexpr auto label_position = ants::HumanRenderer::Right;
+    static constexpr auto line_num_alignment = ants::HumanRenderer::AlignLeft;
+    static constexpr std::uint8_t display_tab_width = 0;
+};
+
+struct ShortMessageConfig : ants::DefaultHumanRendererConfig {
+    static constexpr bool short_message = true;
+};
+
+struct UiTestingConfig : ants::DefaultHumanRendererConfig {
+    static constexpr bool ui_testing = true;
+};
+
+static_assert(ants::human_renderer_config<ants::DefaultHumanRendererConfig>);
+static_assert(!ants::human_renderer_config<int>);
+static_assert(
+    ants::BasicHumanRenderer<RightAlignedConfig>::label_position == ants::HumanRenderer::Right
+);
+static_assert(!ants::BasicHumanRenderer<>::short_message);
+
+template <class Renderer>
+concept has_mutable_short_message = requires(Renderer renderer) { renderer.short_message = true; };
+
+template <class Renderer>
+concept has_mutable_diagnostic_width =
+    requires(Renderer renderer) { renderer.diagnostic_width = 80; };
+
+// The fixed options cannot be changed.
+static_assert(has_mutable_short_message<ants::HumanRenderer>);
+static_assert(!has_mutable_short_message<ants::BasicHumanRenderer<>>);
+static_assert(has_mutable_diagnostic_width<ants::BasicHumanRenderer<>>);
+
+auto make_diag() -> ants::Diag<Level> {
+    std::string_view const source = "int main() {\n\treturn value + other;\n}\n";
+    return ants::Diag(Level::Error, ants::StyledStringView::inferred("mismatched types"))
+        .with_source(
+            ants::AnnotatedSource(source, "main.cpp")
+                .with_annotation(21, 26, ants::StyledStringView::inferred("value"))
+                .with_secondary_annotation(29, 34, ants::StyledStringView::inferred("other"))
+                .with_secondary_annotation(14, 20, ants::StyledStringView::inferred("returned"))
+        );
+}
+
+TEST(BasicHumanRendererTest, SameAsHumanRenderer) {
+    auto const diag = make_diag();
+
+    ants::HumanRenderer runtime_renderer;
+    runtime_renderer.label_position = ants::HumanRenderer::Right;
+    runtime_renderer.line_num_alignment = ants::HumanRenderer::AlignLeft;
+    runtime_renderer.display_tab_width = 0;
+    runtime_renderer.diagnostic_width = 60;
+
+    ants::BasicHumanRenderer<RightAlignedConfig> renderer;
+    renderer.diagnostic_width = 60;
+    EXPECT_EQ(
+        renderer.render_diag(diag).content(),
+        runtime_renderer.render_diag(diag).content()
+    );
+    EXPECT_EQ(
+        renderer.as_human_renderer().render_diag(diag).content(),
+        runtime_renderer.render_diag(diag).content()
+    );
+
+    ants::BasicHumanRenderer<> const default_renderer;
+    EXPECT_EQ(
+        default_renderer.render_diag(diag).content(),
+        ants::HumanRenderer().render_diag(diag).content()
+    );
+
+    ants::HumanRenderer short_renderer;
+    short_renderer.short_message = true;
+    EXPECT_EQ(
+        ants::BasicHumanRenderer<ShortMessageConfig>().render_diag(diag).content(),
+        short_renderer.render_diag(diag).content()
+    );
+}
+
+TEST(BasicHumanRendererTest, OutputTargets) {
+    auto const diag = make_diag();
+
+    ants::HumanRenderer runtime_renderer;
+    runtime_renderer.ui_testing = true;
+    std::string expected;
+    ants::StringSink expected_sink(expected);
+    runtime_renderer.render_diag(expected_sink, diag);
+
+    // The rendering functions for other output targets are specialized as well.
+    ants::BasicHumanRenderer<UiTestingConfig> const renderer;
+    std::string output;
+    ants::StringSink sink(output);
+    renderer.render_diag(sink, diag);
+    EXPECT_EQ(output, expected);
+
+    std::vector<ants::Diag<Level>> const diags { diag, make_diag() };
+    std::vector<ants::StyledString> const results = renderer.render_batch(diags, 2);
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_EQ(results[1].content(), runtime_renderer.render_diag(diag).content());
+}
+}  // namespace
@@ -0,0 +1,125 @@
+#include "annotate_snippets/annotated_source.hpp"
+#include "annotate_snippets/diag.hpp"
+#include "annotate_snippets/renderer/human_renderer.hpp"
+#include "annotate_snippets/style.hpp"
+#include "annotate_snippets/styled_string.hpp"
+#include "annotate_snippets/styled_string_view.hpp"
+#include "level_for_test.hpp"
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace {
+/// Returns a function producing `text`, which counts its calls in `call_count`.
+auto counted(std::string text, unsigned& call_count) -> ants::DeferredStyledString {
+    return [text = std::move(text), &call_count] {
+        ++call_count;
+        return ants::StyledString::inferred(text).with_style(ants::Style::Highlight, 0, 1);
+    };
+}
+
+/// The label produced by `counted()`, as a view of `text`.
+auto eager(std::string_view text) -> ants::StyledStringView {
+    return ants::StyledStringView::inferred(text).with_style(ants::Style::Highlight, 0, 1);
+}
+
+TEST(HumanRendererDeferredTextTest, SameAsEagerText) {
+    std::string_view const source = "auto value = compute(first,\n    second);\nreturn value;\n";
+
+    unsigned call_count = 0;
+    auto const deferred =
+        ants::Diag<Level>(Level::Error)
+            .with_deferred_diag_message(counted("mismatched types", call_count))
+            .with_source(
+                ants::AnnotatedSource(source, "main.cpp")
+                    .with_primary_deferred_annotation(5, 10, counted("declared here", call_count))
+                    .with_secondary_deferred_annotation(13, 39, counted("call", call_count))
+                    .with_secondary_annotation(48, 53, ants::StyledStringView::inferred("used"))
+            )
+            .with_sub_diag_entry(
+                ants::DiagEntry<Level>(Level::Note)
+                    .with_deferred_diag_message(counted("first\nsecond", call_count))
+            );
+
+    auto const expected =
+        ants::Diag(Level::Error, eager("mismatched types"))
+            .with_source(
+                ants::AnnotatedSource(source, "main.cpp")
+                    .with_primary_annotation(5, 10, eager("declared here"))
+                    .with_secondary_annotation(13, 39, eager("call"))
+                    .with_secondary_annotation(48, 53, ants::StyledStringView::inferred("used"))
+            )
+            .with_sub_diag_entry(ants::DiagEntry(Level::Note, eager("first\nsecond")));
+
+    ants::HumanRenderer const renderer;
+    ants::StyledString const rendered = renderer.render_diag(deferred);
+    EXPECT_EQ(renderer.render_diag(expected).content(), rendered.content());
+    EXPECT_EQ(rendered.styled_line_parts(), renderer.render_diag(expected).styled_line_parts());
+    EXPECT_EQ(call_count, 4u);
+
+    // The functions are called again for each rendering.
+    renderer.render_diag(deferred);
+    EXPECT_EQ(call_count, 8u);
+
+    // Setting an eager message discards the deferred one.
+    ants::Diag<Level> changed = deferred;
+    changed.set_diag_message(ants::StyledStringView::inferred("message"));
+    EXPECT_FALSE(changed.deferred_diag_message());
+    EXPECT_EQ(changed.diag_message().content(), "message");
+}
+
+TEST(HumanRendererDeferredTextTest, NotRendered) {
+    std::string source;
+    for (int idx = 0; idx != 10; ++idx) {
+        source.append("value_").append(std::to_string(idx)).append(";\n");
+    }
+
+    unsigned rendered_count = 0;
+    unsigned omitted_count = 0;
+    auto const diag =
+        ants::Diag<Level>(Level::Error)
+            .with_deferred_diag_message(counted("unused values", rendered_count))
+            .with_source(
+                ants::AnnotatedSource(source, "values.cpp")
+                    .with_primary_deferred_annotation(0, 7, counted("here", rendered_count))
+                    .with_primary_deferred_annotation(27, 34, counted("here", rendered_count))
+            )
+            .with_source(
+                ants::AnnotatedSource(source, "other.cpp")
+                    .with_primary_deferred_annotation(0, 7, counted("here", omitted_count))
+            )
+            .with_sub_diag_entry(
+                ants::DiagEntry<Level>(Level::Note)
+                    .with_deferred_diag_message(counted("also unused", omitted_count))
+            );
+
+    // The second source and the secondary entry are not reached.
+    ants::HumanRenderer renderer;
+    renderer.max_output_lines = 4;
+    EXPECT_EQ(
+        renderer.render_diag(diag).content(),
+        R"(error: unused values
+ --> values.cpp:1:1
+  |
+1 | value_0;
+  | ^^^^^^^ here
+... 2 more annotations omitted)"
+    );
+    EXPECT_EQ(rendered_count, 3u);
+    EXPECT_EQ(omitted_count, 0u);
+
+    // Labels are not rendered in short messages.
+    rendered_count = 0;
+    renderer.max_output_lines = 0;
+    renderer.short_message = true;
+    EXPECT_EQ(
+        renderer.render_diag(diag).content(),
+        "values.cpp:1:1: \nother.cpp:1:1: error: unused values\nnote: also unused"
+    );
+    EXPECT_EQ(rendered_count, 1u);
+    EXPECT_EQ(omitted_count, 1u);
+}
+}  // namespace
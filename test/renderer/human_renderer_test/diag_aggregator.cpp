@@ -0,0 +1,157 @@
+#include "annotate_snippets/annotated_source.hpp"
+#include "annotate_snippets/diag.hpp"
+#include "annotate_snippets/diag_aggregator.hpp"
+#include "annotate_snippets/renderer/human_renderer.hpp"
+#include "annotate_snippets/styled_string.hpp"
+#include "annotate_snippets/styled_string_view.hpp"
+#include "level_for_test.hpp"
+
+#include "gtest/gtest.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+constexpr std::string_view source = "auto value = compute(first,\n    second);\n";
+
+auto make_diag(
+    std::string_view message,
+    std::string_view error_code = "E0308",
+    std::string_view origin = "main.cpp",
+    std::size_t annotation_beg = 5
+) -> ants::Diag<Level> {
+    return ants::Diag(Level::Error, ants::StyledStringView::inferred(message), error_code)
+        .with_source(
+            ants::AnnotatedSource(source, origin)
+                .with_annotation(
+                    annotation_beg,
+                    10,
+                    ants::StyledStringView::inferred("declared here")
+                )
+                .with_secondary_annotation(13, 39, ants::StyledStringView::inferred("call"))
+        )
+        .with_sub_diag_entry(
+            ants::DiagEntry(Level::Note, ants::StyledStringView::inferred("required here"))
+        );
+}
+
+TEST(DiagAggregatorTest, MergeDuplicates) {
+    ants::DiagAggregator<Level> aggregator;
+    EXPECT_TRUE(aggregator.add(make_diag("mismatched types")));
+    EXPECT_FALSE(aggregator.add(make_diag("mismatched types")));
+    EXPECT_TRUE(aggregator.add(make_diag("unused variable")));
+    EXPECT_FALSE(aggregator.add(make_diag("mismatched types")));
+    // The source code itself is not compared.
+    {
+        ants::Diag<Level> diag = make_diag("unused variable");
+        diag.associated_sources()[0] =
+            ants::AnnotatedSource("auto other = compute(first,\n    second);\n", "main.cpp")
+                .with_annotation(5, 10, ants::StyledStringView::inferred("declared here"))
+                .with_secondary_annotation(13, 39, ants::StyledStringView::inferred("call"));
+        EXPECT_FALSE(aggregator.add(std::move(diag)));
+    }
+    EXPECT_EQ(aggregator.size(), 2);
+
+    std::vector<ants::AggregatedDiag<Level>> const result = aggregator.take();
+    ASSERT_EQ(result.size(), 2);
+    EXPECT_EQ(result[0].diag.diag_message().content(), "mismatched types");
+    EXPECT_EQ(result[0].occurrence_num, 3);
+    EXPECT_EQ(result[1].diag.diag_message().content(), "unused variable");
+    EXPECT_EQ(result[1].occurrence_num, 2);
+
+    EXPECT_EQ(aggregator.size(), 0);
+    EXPECT_TRUE(aggregator.take().empty());
+}
+
+TEST(DiagAggregatorTest, KeepDistinct) {
+    ants::DiagAggregator<Level> aggregator(1);
+    EXPECT_TRUE(aggregator.add(make_diag("mismatched types")));
+    EXPECT_TRUE(aggregator.add(make_diag("mismatched types", "E0309")));
+    EXPECT_TRUE(aggregator.add(make_diag("mismatched types", "E0308", "other.cpp")));
+    EXPECT_TRUE(aggregator.add(make_diag("mismatched types", "E0308", "main.cpp", 6)));
+    {
+        ants::Diag<Level> diag = make_diag("mismatched types");
+        diag.set_level(Level::Warning);
+        EXPECT_TRUE(aggregator.add(std::move(diag)));
+    }
+    {
+        ants::Diag<Level> diag = make_diag("mismatched types");
+        diag.add_sub_diag_entry(Level::Help, ants::StyledStringView::inferred("consider this"));
+        EXPECT_TRUE(aggregator.add(std::move(diag)));
+    }
+    // Diagnostics with deferred text are never merged.
+    for (int idx = 0; idx != 2; ++idx) {
+        ants::Diag<Level> diag = make_diag("");
+        diag.set_deferred_diag_message([] {
+            return ants::StyledString::inferred("mismatched types");
+        });
+        EXPECT_TRUE(aggregator.add(std::move(diag)));
+    }
+    // Nor are plain diagnostics merged into them, even if their text looks the same before the
+    // deferred text is produced.
+    EXPECT_TRUE(aggregator.add(make_diag("")));
+    {
+        ants::Diag<Level> diag = make_diag("mismatched types");
+        diag.associated_sources()[0].add_primary_deferred_annotation(0, 4, [] {
+            return ants::StyledString::inferred("deferred");
+        });
+        EXPECT_TRUE(aggregator.add(std::move(diag)));
+    }
+    {
+        ants::Diag<Level> diag = make_diag("mismatched types");
+        diag.associated_sources()[0].add_annotation(0, 4, ants::StyledStringView());
+        EXPECT_TRUE(aggregator.add(std::move(diag)));
+    }
+    EXPECT_EQ(aggregator.size(), 11);
+}
+
+TEST(DiagAggregatorTest, Concurrent) {
+    std::vector<std::string> messages;
+    for (std::size_t idx = 0; idx != 50; ++idx) {
+        messages.push_back("message " + std::to_string(idx));
+    }
+
+    constexpr unsigned thread_num = 4;
+    ants::DiagAggregator<Level> aggregator(4);
+    std::vector<std::jthread> threads;
+    for (unsigned thread_idx = 0; thread_idx != thread_num; ++thread_idx) {
+        threads.emplace_back([&] {
+            for (std::string const& message : messages) {
+                aggregator.add(make_diag(message));
+            }
+        });
+    }
+    threads.clear();
+
+    std::vector<ants::AggregatedDiag<Level>> const result = aggregator.take();
+    ASSERT_EQ(result.size(), messages.size());
+    for (ants::AggregatedDiag<Level> const& aggregated : result) {
+        EXPECT_EQ(aggregated.occurrence_num, thread_num);
+    }
+}
+
+TEST(DiagAggregatorTest, Summarized) {
+    ants::DiagAggregator<Level> aggregator;
+    for (int idx = 0; idx != 3; ++idx) {
+        aggregator.add(make_diag("mismatched types"));
+    }
+    aggregator.add(make_diag("unused variable"));
+
+    std::vector<ants::Diag<Level>> const result = aggregator.take_summarized();
+    ASSERT_EQ(result.size(), 2);
+
+    ants::HumanRenderer const renderer;
+    EXPECT_EQ(
+        renderer.render_diag(result[0]).content(),
+        renderer.render_diag(make_diag("mismatched types (3 occurrences)")).content()
+    );
+    EXPECT_EQ(
+        renderer.render_diag(result[1]).content(),
+        renderer.render_diag(make_diag("unused variable")).content()
+    );
+}
+}  // namespace
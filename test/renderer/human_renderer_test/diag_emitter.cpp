@@ -0,0 +1,196 @@
+#include "annotate_snippets/annotated_source.hpp"
+#include "annotate_snippets/diag.hpp"
+#include "annotate_snippets/output_sink.hpp"
+#include "annotate_snippets/renderer/diag_emitter.hpp"
+#include "annotate_snippets/renderer/human_renderer.hpp"
+#include "annotate_snippets/styled_string.hpp"
+#include "annotate_snippets/styled_string_view.hpp"
+#include "level_for_test.hpp"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr std::string_view source = "auto value = compute(first,\n    second);\n";
+
+/// The distinct messages of the diagnostics, which keep the strings alive.
+auto make_messages(std::size_t num) -> std::vector<std::string> {
+    std::vector<std::string> messages;
+    for (std::size_t idx = 0; idx != num; ++idx) {
+        messages.push_back("message " + std::to_string(idx));
+    }
+    return messages;
+}
+
+auto make_diag(std::string const& message) -> ants::Diag<Level> {
+    return ants::Diag(Level::Error, ants::StyledStringView::inferred(message))
+        .with_source(
+            ants::AnnotatedSource(source, "main.cpp")
+                .with_annotation(5, 10, ants::StyledStringView::inferred("declared here"))
+                .with_secondary_annotation(13, 39, ants::StyledStringView::inferred("call"))
+        );
+}
+
+/// A sink that counts the calls to `flush()`.
+struct FlushCountingSink {
+    std::string target;
+    unsigned flush_count = 0;
+
+    void write(std::string_view str) {
+        target.append(str);
+    }
+
+    void flush() {
+        ++flush_count;
+    }
+};
+
+TEST(DiagEmitterTest, SameAsRenderDiag) {
+    std::vector<std::string> const messages = make_messages(200);
+    ants::HumanRenderer renderer;
+    renderer.diagnostic_width = 40;
+
+    std::string expected;
+    ants::StringSink expected_sink(expected);
+    for (std::string const& message : messages) {
+        renderer.render_diag(expected_sink, make_diag(message));
+    }
+
+    // The order of emission is preserved by default, regardless of the number of threads.
+    for (unsigned const thread_count : { 1u, 4u }) {
+        FlushCountingSink sink;
+        ants::DiagEmitter<Level> emitter(sink, renderer, {}, { .thread_count = thread_count });
+        for (std::string const& message : messages) {
+            emitter.emit(make_diag(message));
+        }
+
+        emitter.flush();
+        EXPECT_EQ(emitter.emitted_count(), messages.size());
+        EXPECT_EQ(emitter.written_count(), messages.size());
+        EXPECT_EQ(sink.target, expected);
+        EXPECT_EQ(sink.flush_count, 1);
+    }
+
+    // The remaining diagnostics are written when the emitter is destroyed.
+    std::string output;
+    {
+        ants::StringSink sink(output);
+        ants::DiagEmitter<Level> emitter(sink, renderer);
+        for (std::string const& message : messages) {
+            emitter.emit(make_diag(message));
+        }
+    }
+    EXPECT_EQ(output, expected);
+}
+
+TEST(DiagEmitterTest, ConcurrentProducers) {
+    constexpr std::size_t producer_num = 4;
+    constexpr std::size_t diag_num = 100;
+    std::vector<std::string> const messages = make_messages(producer_num * diag_num);
+
+    ants::HumanRenderer const renderer;
+    auto const rendering_of = [&](std::string const& message) {
+        std::string result;
+        ants::StringSink sink(result);
+        renderer.render_diag(sink, make_diag(message));
+        return result;
+    };
+
+    for (bool const preserves_order : { true, false }) {
+        std::string output;
+        ants::StringSink sink(output);
+        ants::DiagEmitter<Level> emitter(
+            sink,
+            renderer,
+            {},
+            { .thread_count = 3, .preserves_order = preserves_order }
+        );
+
+        {
+            std::vector<std::jthread> producers;
+            for (std::size_t producer = 0; producer != producer_num; ++producer) {
+                producers.emplace_back([&, producer] {
+                    for (std::size_t idx = 0; idx != diag_num; ++idx) {
+                        emitter.emit(make_diag(messages[producer * diag_num + idx]));
+                    }
+                });
+            }
+        }
+        emitter.flush();
+
+        // Every diagnostic is written exactly once, in one piece. When the order is preserved, the
+        // diagnostics of each producer are written in the order in which they are emitted.
+        std::vector<std::size_t> positions;
+        for (std::string const& message : messages) {
+            std::string const rendering = rendering_of(message);
+            std::size_t const pos = output.find(rendering);
+            ASSERT_NE(pos, std::string::npos);
+            EXPECT_EQ(output.find(rendering, pos + 1), std::string::npos);
+            positions.push_back(pos);
+        }
+        EXPECT_EQ(output.size(), [&] {
+            std::size_t size = 0;
+            for (std::string const& message : messages) {
+                size += rendering_of(message).size();
+            }
+            return size;
+        }());
+
+        if (preserves_order) {
+            for (std::size_t producer = 0; producer != producer_num; ++producer) {
+                auto const first =
+                    positions.begin() + static_cast<std::ptrdiff_t>(producer * diag_num);
+                EXPECT_TRUE(std::is_sorted(first, first + diag_num));
+            }
+        }
+    }
+}
+TEST(DiagEmitterTest, RenderingException) {
+    std::vector<std::string> const messages = make_messages(20);
+    ants::HumanRenderer const renderer;
+
+    // Every fifth diagnostic has a label whose producer throws, and is not written.
+    auto const make_emitted_diag = [&](std::size_t idx) {
+        ants::Diag<Level> diag = make_diag(messages[idx]);
+        if (idx % 5 == 2) {
+            diag.associated_sources()[0].add_primary_deferred_annotation(
+                0,
+                4,
+                []() -> ants::StyledString { throw std::runtime_error("producer failed"); }
+            );
+        }
+        return diag;
+    };
+
+    std::string expected;
+    ants::StringSink expected_sink(expected);
+    for (std::size_t idx = 0; idx != messages.size(); ++idx) {
+        if (idx % 5 != 2) {
+            renderer.render_diag(expected_sink, make_emitted_diag(idx));
+        }
+    }
+
+    for (unsigned const thread_count : { 1u, 4u }) {
+        std::string output;
+        ants::StringSink sink(output);
+        ants::DiagEmitter<Level> emitter(sink, renderer, {}, { .thread_count = thread_count });
+        for (std::size_t idx = 0; idx != messages.size(); ++idx) {
+            emitter.emit(make_emitted_diag(idx));
+        }
+
+        EXPECT_THROW(emitter.flush(), std::runtime_error);
+        EXPECT_EQ(emitter.written_count(), messages.size());
+        EXPECT_EQ(output, expected);
+
+        // The exception is only rethrown once.
+        emitter.flush();
+    }
+}
+}  // namespace
@@ -0,0 +1,138 @@
+#include "annotate_snippets/annotated_source.hpp"
+#include "annotate_snippets/diag.hpp"
+#include "annotate_snippets/renderer/human_renderer.hpp"
+#include "annotate_snippets/renderer/render_observer.hpp"
+#include "annotate_snippets/styled_string_view.hpp"
+#include "level_for_test.hpp"
+
+#include "gtest/gtest.h"
+
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace {
+/// Renders `diag` with `label_position`, placing the labels with `label_placement`.
+auto render_with(
+    ants::Diag<Level> const& diag,
+    ants::HumanRenderer::LabelPosition label_position,
+    ants::HumanRenderer::LabelPlacement label_placement
+) -> std::string {
+    ants::HumanRenderer renderer;
+    renderer.label_position = label_position;
+    renderer.label_placement = label_placement;
+    return renderer.render_diag(diag).content();
+}
+
+TEST(HumanRendererLabelPlacementTest, SameAsGraphPlacement) {
+    std::string_view const source = R"(auto value = call(first_argument, second, third_one);
+    another(line, of, code) + more(code, here);
+    and_the_last(line);
+)";
+    std::array<std::string_view, 6> const labels {
+        "", "a", "label", "a longer label", "two\nlines", "three\nlines\nlabel",
+    };
+
+    std::mt19937 engine(20'241'014);
+    auto const random = [&](std::size_t bound) {
+        return std::uniform_int_distribution<std::size_t>(0, bound - 1)(engine);
+    };
+
+    for (unsigned iteration = 0; iteration != 1'000; ++iteration) {
+        ants::AnnotatedSource annotated(source, "main.cpp");
+
+        std::size_t const annotation_num = 1 + random(12);
+        for (std::size_t idx = 0; idx != annotation_num; ++idx) {
+            // Most annotations are single-line annotations on the first line, while some cross the
+            // lines to produce the heads and tails of multi-line annotations.
+            std::size_t const beg = random(50);
+            std::size_t const end = random(4) == 0 ? beg + 50 + random(40) : beg + random(8);
+            auto const label = ants::StyledStringView::inferred(labels[random(labels.size())]);
+            if (random(2) == 0) {
+                annotated.add_annotation(beg, end, label);
+            } else {
+                annotated.add_secondary_annotation(beg, end, label);
+            }
+        }
+
+        auto const diag = ants::Diag(Level::Error, ants::StyledStringView::inferred("error"))
+                              .with_source(std::move(annotated));
+        for (auto const label_position :
+             { ants::HumanRenderer::Left, ants::HumanRenderer::Right }) {
+            EXPECT_EQ(
+                render_with(diag, label_position, ants::HumanRenderer::SweepPlacement),
+                render_with(diag, label_position, ants::HumanRenderer::GraphPlacement)
+            ) << "iteration " << iteration;
+        }
+    }
+}
+
+/// Counts the edges of the graphs built to place the labels.
+class EdgeCountingObserver : public ants::RenderObserver {
+public:
+    std::size_t graph_edge_num = 0;
+
+    void on_source_rendered(
+        [[maybe_unused]] ants::AnnotatedSource const& source,
+        ants::RenderStats const& stats
+    ) override {
+        graph_edge_num += stats.graph_edge_num;
+    }
+};
+
+/// Renders a line with `annotation_num` annotations, whose labels are so long that each of them
+/// overlaps all the following underlines and labels, and returns the number of edges of the graphs
+/// built to place the labels. The rendering is also checked against the graph placement.
+auto count_edges_of_overlapping_labels(
+    std::size_t annotation_num,
+    ants::HumanRenderer::LabelPlacement label_placement
+) -> std::size_t {
+    std::string source;
+    for (std::size_t idx = 0; idx != annotation_num; ++idx) {
+        source.append("aa        ");
+    }
+    std::string const label(source.size(), 'x');
+
+    ants::AnnotatedSource annotated(source, "generated.cpp");
+    for (std::size_t idx = 0; idx != annotation_num; ++idx) {
+        annotated.add_annotation(idx * 10, idx * 10 + 2, ants::StyledStringView::inferred(label));
+    }
+    auto const diag = ants::Diag(Level::Warning, ants::StyledStringView::inferred("lint"))
+                          .with_source(std::move(annotated));
+
+    EdgeCountingObserver observer;
+    ants::HumanRenderer renderer;
+    renderer.diagnostic_width = std::numeric_limits<unsigned>::max();
+    renderer.label_placement = label_placement;
+    renderer.render_observer = &observer;
+
+    ants::HumanRenderer graph_renderer = renderer;
+    graph_renderer.label_placement = ants::HumanRenderer::GraphPlacement;
+    graph_renderer.render_observer = nullptr;
+    EXPECT_EQ(renderer.render_diag(diag).content(), graph_renderer.render_diag(diag).content());
+    return observer.graph_edge_num;
+}
+
+TEST(HumanRendererLabelPlacementTest, SweepPlacementScaling) {
+#ifndef ANNOTATE_SNIPPETS_ENABLE_TRACING
+    GTEST_SKIP() << "the render observer hooks are compiled out";
+#endif
+
+    // The label of the last annotation is rendered inline, and every pair of the other labels
+    // overlaps, so the graph placement adds an edge for each such pair, and the size of the graph
+    // grows quadratically with the number of annotations. The sweep builds no graph at all. The
+    // time spent on both is compared by the benchmarks in bench/.
+    constexpr std::size_t annotation_num = 64;
+    for (std::size_t const num : { annotation_num, 2 * annotation_num }) {
+        EXPECT_EQ(
+            count_edges_of_overlapping_labels(num, ants::HumanRenderer::GraphPlacement),
+            (num - 1) * (num - 2) / 2
+        );
+        EXPECT_EQ(count_edges_of_overlapping_labels(num, ants::HumanRenderer::SweepPlacement), 0);
+    }
+}
+}  // namespace
@@ -0,0 +1,134 @@
+#include "annotate_snippets/annotated_source.hpp"
+#include "annotate_snippets/diag.hpp"
+#include "annotate_snippets/output_sink.hpp"
+#include "annotate_snippets/renderer/human_renderer.hpp"
+#include "annotate_snippets/styled_string_view.hpp"
+#include "level_for_test.hpp"
+
+#include "gtest/gtest.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace {
+TEST(HumanRendererOutputLimitsTest, MaxAnnotationsPerLine) {
+    std::string_view const source = "call(first, second, third, fourth);\nreturn;\n";
+
+    auto const diag =
+        ants::Diag(Level::Error, ants::StyledStringView::inferred("bad arguments"))
+            .with_source(
+                ants::AnnotatedSource(source, "main.cpp")
+                    .with_secondary_annotation(5, 10, ants::StyledStringView::inferred("a"))
+                    .with_secondary_annotation(12, 18, ants::StyledStringView::inferred("b"))
+                    .with_annotation(20, 25, ants::StyledStringView::inferred("c"))
+                    .with_secondary_annotation(27, 33, ants::StyledStringView::inferred("d"))
+                    .with_annotation(36, 42, ants::StyledStringView::inferred("e"))
+            );
+
+    ants::HumanRenderer renderer;
+    renderer.max_annotations_per_line = 2;
+
+    // The primary annotation is kept before the secondary ones.
+    EXPECT_EQ(
+        renderer.render_diag(diag).content(),
+        R"(error: bad arguments
+ --> main.cpp:1:21
+  |
+1 | call(first, second, third, fourth);
+  |      ----- a        ^^^^^ c
+2 | return;
+  | ^^^^^^ e
+... 2 more annotations omitted)"
+    );
+
+    renderer.max_annotations_per_line = 3;
+    EXPECT_EQ(
+        renderer.render_diag(diag).content(),
+        R"(error: bad arguments
+ --> main.cpp:1:21
+  |
+1 | call(first, second, third, fourth);
+  |      -----  ------  ^^^^^ c
+  |      |      |
+  |      a      b
+2 | return;
+  | ^^^^^^ e
+... 1 more annotation omitted)"
+    );
+}
+
+TEST(HumanRendererOutputLimitsTest, MaxOutputSize) {
+    std::string source;
+    for (int idx = 0; idx != 10; ++idx) {
+        source.append("value_").append(std::to_string(idx)).append(";\n");
+    }
+
+    ants::AnnotatedSource annotated(source, "values.cpp");
+    for (std::size_t pos = 0; (pos = source.find("value_", pos)) != std::string::npos; pos += 7) {
+        annotated.add_annotation(pos, pos + 7, ants::StyledStringView::inferred("here"));
+    }
+
+    auto const diag =
+        ants::Diag(Level::Error, ants::StyledStringView::inferred("unused values"))
+            .with_source(std::move(annotated))
+            .with_sub_diag_entry(
+                ants::DiagEntry(Level::Note, ants::StyledStringView::inferred("also unused"))
+                    .with_source(  //
+                        ants::AnnotatedSource(source, "other.cpp")
+                            .with_annotation(0, 7, ants::StyledStringView::inferred("here"))
+                    )
+            );
+
+    ants::HumanRenderer renderer;
+    renderer.max_output_lines = 8;
+
+    // The remaining annotations of the first entry and the annotation of the second entry are not
+    // rendered.
+    std::string const expected = R"(error: unused values
+  --> values.cpp:1:1
+   |
+ 1 | value_0;
+   | ^^^^^^^ here
+ 2 | value_1;
+   | ^^^^^^^ here
+ 3 | value_2;
+   | ^^^^^^^ here
+... 8 more annotations omitted)";
+    EXPECT_EQ(renderer.render_diag(diag).content(), expected);
+
+    // The limits are the same when the lines are streamed.
+    std::string streamed;
+    ants::StringSink sink(streamed);
+    renderer.render_diag(sink, diag);
+    EXPECT_EQ(streamed, expected + "\n");
+
+    renderer.max_output_lines = 0;
+    renderer.max_output_bytes = 200;
+    EXPECT_EQ(
+        renderer.render_diag(diag).content(),
+        R"(error: unused values
+  --> values.cpp:1:1
+   |
+ 1 | value_0;
+   | ^^^^^^^ here
+ 2 | value_1;
+   | ^^^^^^^ here
+ 3 | value_2;
+   | ^^^^^^^ here
+ 4 | value_3;
+   | ^^^^^^^ here
+ 5 | value_4;
+   | ^^^^^^^ here
+... 6 more annotations omitted)"
+    );
+
+    // When the limit is reached between two sources, the second source is not rendered.
+    renderer.max_output_lines = 23;
+    renderer.max_output_bytes = 0;
+    std::string const rendered = renderer.render_diag(diag).content();
+    EXPECT_TRUE(rendered.ends_with("10 | value_9;\n   | ^^^^^^^ here\nnote: also unused\n"
+                                   "... 1 more annotation omitted"));
+}
+}  // namespace
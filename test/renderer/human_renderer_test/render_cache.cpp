@@ -0,0 +1,156 @@
+#include "annotate_snippets/annotated_source.hpp"
+#include "annotate_snippets/diag.hpp"
+#include "annotate_snippets/renderer/human_renderer.hpp"
+#include "annotate_snippets/renderer/render_cache.hpp"
+#include "annotate_snippets/styled_string.hpp"
+#include "annotate_snippets/styled_string_view.hpp"
+#include "level_for_test.hpp"
+
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+TEST(RenderCacheTest, LeastRecentlyUsed) {
+    ants::RenderCache cache(2);
+    EXPECT_EQ(cache.capacity(), 2);
+    EXPECT_EQ(cache.find("a"), nullptr);
+
+    std::shared_ptr<ants::StyledString const> const a =
+        cache.insert("a", ants::StyledString::inferred("block a"));
+    EXPECT_EQ(a->content(), "block a");
+    cache.insert("b", ants::StyledString::inferred("block b"));
+    EXPECT_EQ(cache.size(), 2);
+
+    // Inserting an existing key keeps the existing block.
+    EXPECT_EQ(cache.insert("a", ants::StyledString::inferred("other")), a);
+
+    // "a" has been used more recently than "b", so "b" is evicted.
+    cache.insert("c", ants::StyledString::inferred("block c"));
+    EXPECT_EQ(cache.size(), 2);
+    EXPECT_EQ(cache.find("b"), nullptr);
+    EXPECT_EQ(cache.find("a"), a);
+    EXPECT_EQ(cache.find("c")->content(), "block c");
+
+    EXPECT_EQ(cache.hit_count(), 2);
+    EXPECT_EQ(cache.miss_count(), 2);
+
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0);
+    EXPECT_EQ(cache.find("a"), nullptr);
+    EXPECT_EQ(cache.miss_count(), 3);
+
+    // A cache without capacity stores nothing.
+    ants::RenderCache empty_cache(0);
+    auto const block = empty_cache.insert("a", ants::StyledString::inferred("block a"));
+    EXPECT_EQ(block->content(), "block a");
+    EXPECT_EQ(empty_cache.size(), 0);
+    EXPECT_EQ(empty_cache.find("a"), nullptr);
+}
+
+/// Creates a diagnostic reporting the same spans on the given region of `source` from several
+/// origins, as in a backtrace of template instantiations. `AnnotatedSource` only refers to the
+/// names in `origins`, so they must outlive the diagnostic.
+auto make_backtrace_diag(std::string_view source, std::vector<std::string> const& origins)
+    -> ants::Diag<Level> {
+    auto diag = ants::Diag(Level::Error, ants::StyledStringView::inferred("no matching function"));
+    for (std::string const& origin : origins) {
+        diag.add_sub_diag_entry(
+            ants::DiagEntry(Level::Note, ants::StyledStringView::inferred("in instantiation"))
+                .with_source(
+                    ants::AnnotatedSource(source, origin)
+                        .with_annotation(22, 26, ants::StyledStringView::inferred("called here"))
+                        .with_secondary_annotation(
+                            20,
+                            29,
+                            ants::StyledStringView::styled("body", ants::Style::Highlight)
+                        )
+                )
+        );
+    }
+    return diag;
+}
+
+TEST(HumanRendererRenderCacheTest, ReuseRenderedSources) {
+    std::string_view const source = "template <\nvoid f() { g(1);\n}\n";
+    std::vector<std::string> const origins { "a.hpp", "b.hpp", "c.hpp", "d.hpp" };
+    ants::Diag<Level> const diag = make_backtrace_diag(source, origins);
+
+    ants::HumanRenderer const renderer;
+    ants::StyledString const expected = renderer.render_diag(diag);
+
+    ants::RenderCache cache(16);
+    ants::HumanRenderer cached_renderer;
+    cached_renderer.render_cache = &cache;
+
+    // The sources only differ in their origins, so all of them but the first are cache hits.
+    EXPECT_EQ(
+        cached_renderer.render_diag(diag).styled_line_parts(),
+        expected.styled_line_parts()
+    );
+    EXPECT_EQ(cache.size(), 1);
+    EXPECT_EQ(cache.miss_count(), 1);
+    EXPECT_EQ(cache.hit_count(), origins.size() - 1);
+
+    std::ostringstream expected_out;
+    renderer.render_diag(expected_out, diag);
+    std::ostringstream out;
+    cached_renderer.render_diag(out, diag);
+    EXPECT_EQ(out.str(), expected_out.str());
+    EXPECT_EQ(cache.miss_count(), 1);
+
+    // The same spans on lines with different content are rendered again.
+    std::string_view const other_source = "template <\nvoid f() { h(1);\n}\n";
+    ants::Diag<Level> const other_diag = make_backtrace_diag(other_source, origins);
+    EXPECT_EQ(
+        cached_renderer.render_diag(other_diag).content(),
+        renderer.render_diag(other_diag).content()
+    );
+    EXPECT_EQ(cache.miss_count(), 2);
+
+    // Lines after the last annotated line are never rendered, so they do not affect the key.
+    std::string const longer_source = std::string(source) + "// trailer\n";
+    ants::Diag<Level> const longer_diag = make_backtrace_diag(longer_source, origins);
+    std::size_t const hits_before = cache.hit_count();
+    EXPECT_EQ(
+        cached_renderer.render_diag(longer_diag).content(),
+        renderer.render_diag(longer_diag).content()
+    );
+    EXPECT_EQ(cache.miss_count(), 2);
+    EXPECT_EQ(cache.hit_count(), hits_before + origins.size());
+
+    // Options that affect the layout are part of the key.
+    cached_renderer.label_position = ants::HumanRenderer::Right;
+    ants::HumanRenderer right_renderer;
+    right_renderer.label_position = ants::HumanRenderer::Right;
+    EXPECT_EQ(
+        cached_renderer.render_diag(diag).content(),
+        right_renderer.render_diag(diag).content()
+    );
+    EXPECT_EQ(cache.miss_count(), 3);
+}
+
+TEST(HumanRendererRenderCacheTest, ConcurrentRendering) {
+    std::string_view const source = "template <\nvoid f() { g(1);\n}\n";
+    std::vector<std::string> const origins { "a.hpp", "b.hpp" };
+    std::vector<ants::Diag<Level>> diags;
+    for (unsigned idx = 0; idx != 32; ++idx) {
+        diags.push_back(make_backtrace_diag(source, origins));
+    }
+
+    ants::RenderCache cache(4);
+    ants::HumanRenderer renderer;
+    renderer.render_cache = &cache;
+
+    std::string const expected = ants::HumanRenderer().render_diag(diags.front()).content();
+    for (ants::StyledString const& result : renderer.render_batch(diags, /*thread_count=*/4)) {
+        EXPECT_EQ(result.content(), expected);
+    }
+    EXPECT_EQ(cache.size(), 1);
+    EXPECT_EQ(cache.hit_count() + cache.miss_count(), 2 * diags.size());
+}
+}  // namespace
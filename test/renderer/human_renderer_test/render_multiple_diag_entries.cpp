@@ -1,12 +1,21 @@
 #include "annotate_snippets/annotated_source.hpp"
 #include "annotate_snippets/diag.hpp"
+#include "annotate_snippets/output_sink.hpp"
 #include "annotate_snippets/renderer/human_renderer.hpp"
 #include "annotate_snippets/styled_string_view.hpp"
 #include "level_for_test.hpp"
 
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <memory_resource>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 #include <string_view>
+#include <thread>
+#include <vector>
 
 namespace {
 TEST(HumanRendererMultipleDiagTest, MultipleSources) {
@@ -315,4 +324,414 @@ note: note something
   |                ^^^ type)"
     );
 }
+
+TEST(HumanRendererMultipleDiagTest, RenderConstDiag) {
+    std::string_view const source = "auto add(int v1,\n         int v2) -> int {\n}\n";
+
+    // The spans include an empty span and a span ending at the start of a line, which are adjusted
+    // by the renderer.
+    ants::Diag<Level> const diag =
+        ants::Diag(Level::Error, ants::StyledStringView::inferred("message"))
+            .with_source(
+                ants::AnnotatedSource(source, "add.cpp")
+                    .with_annotation(8, 33, ants::StyledStringView::inferred("parameters"))
+                    .with_secondary_annotation(5, 5, ants::StyledStringView::inferred("name"))
+                    .with_secondary_annotation(34, 43, ants::StyledStringView::inferred("body"))
+            );
+    std::vector<ants::LabeledSpan> const primary_spans =
+        diag.primary_diag_entry().associated_sources()[0].primary_spans();
+    std::vector<ants::LabeledSpan> const secondary_spans =
+        diag.primary_diag_entry().associated_sources()[0].secondary_spans();
+
+    ants::HumanRenderer const renderer;
+    std::string_view const expected = R"(error: message
+ --> add.cpp:1:9
+  |
+1 |   auto add(int v1,
+  |        -  ^
+  |  ______|__|
+  | |      name
+2 | |          int v2) -> int {
+  | |                ^ --------- body
+  | |________________|
+  |                  parameters)";
+
+    EXPECT_EQ(renderer.render_diag(diag).content(), expected);
+    // Rendering does not consume the diagnostic, so it can be rendered again.
+    EXPECT_EQ(renderer.render_diag(diag).content(), expected);
+
+    std::ostringstream out;
+    renderer.render_diag(out, diag);
+    EXPECT_EQ(out.str(), std::string(expected) + '\n');
+
+    auto const span_eq = [](ants::LabeledSpan const& lhs, ants::LabeledSpan const& rhs) {
+        return lhs.beg == rhs.beg && lhs.end == rhs.end
+            && lhs.label.content() == rhs.label.content();
+    };
+    EXPECT_TRUE(std::ranges::equal(
+        diag.primary_diag_entry().associated_sources()[0].primary_spans(),
+        primary_spans,
+        span_eq
+    ));
+    EXPECT_TRUE(std::ranges::equal(
+        diag.primary_diag_entry().associated_sources()[0].secondary_spans(),
+        secondary_spans,
+        span_eq
+    ));
+}
+
+TEST(HumanRendererMultipleDiagTest, StreamedOutput) {
+    std::string source;
+    for (unsigned idx = 0; idx != 30; ++idx) {
+        source.append("call(").append(std::to_string(idx)).append(");\n");
+    }
+
+    ants::AnnotatedSource annotated(source, "main.cpp");
+    for (std::size_t pos = 0; (pos = source.find("call", pos)) != std::string::npos; pos += 12) {
+        annotated.add_annotation(pos, pos + 4, ants::StyledStringView::inferred("first"));
+        annotated.add_secondary_annotation(pos + 1, pos + 4, ants::StyledStringView::inferred("b"));
+    }
+    annotated.add_secondary_annotation(2, 40, ants::StyledStringView::inferred("multi-line"));
+
+    ants::Diag<Level> const diag =
+        ants::Diag(Level::Error, ants::StyledStringView::inferred("message"))
+            .with_source(annotated)
+            .with_source(annotated)
+            .with_sub_diag_entry(Level::Note, ants::StyledStringView::inferred("note"))
+            .with_sub_diag_entry(
+                ants::DiagEntry(Level::Help, ants::StyledStringView::inferred("help"))
+                    .with_source(std::move(annotated))
+            );
+
+    // The streamed output is the same as rendering to a `StyledString` first.
+    ants::HumanRenderer short_message_renderer;
+    short_message_renderer.short_message = true;
+
+    for (ants::HumanRenderer const& renderer : { ants::HumanRenderer(), short_message_renderer }) {
+        std::ostringstream out;
+        renderer.render_diag(out, diag);
+        EXPECT_EQ(out.str(), renderer.render_diag(diag).content() + '\n');
+    }
+}
+
+TEST(HumanRendererMultipleDiagTest, RenderToSink) {
+    std::string_view const source = "let x = 1;\nlet y = x;\n";
+
+    ants::AnnotatedSource annotated(source, "main.rs");
+    annotated.add_annotation(4, 5, ants::StyledStringView::inferred("defined here"));
+    annotated.add_secondary_annotation(19, 20, ants::StyledStringView::inferred("used here"));
+
+    ants::Diag<Level> const diag =
+        ants::Diag(Level::Warning, ants::StyledStringView::inferred("unused variable"))
+            .with_source(std::move(annotated))
+            .with_sub_diag_entry(Level::Note, ants::StyledStringView::inferred("note"));
+
+    ants::HumanRenderer const renderer;
+
+    // With the plain text style sheet, the sink receives the same text as an output stream.
+    std::ostringstream out;
+    renderer.render_diag(out, diag);
+
+    std::string target = "existing content\n";
+    ants::StringSink sink(target);
+    renderer.render_diag(sink, diag);
+    EXPECT_EQ(target, "existing content\n" + out.str());
+
+    // With other style sheets, the styles are rendered with escape sequences.
+    target.clear();
+    renderer.render_diag(sink, diag, [](ants::Style style, Level /*level*/) -> ants::StyleSpec {
+        return style == ants::Style::LineNumber ? ants::StyleSpec::Blue : ants::StyleSpec();
+    });
+    EXPECT_NE(target.find("\033[34m"), std::string::npos);
+}
+
+/// A style sheet marked as a plain text style sheet, which must never be invoked.
+struct CountingPlainStyleSheet {
+    static constexpr bool is_plain_text = true;
+
+    unsigned* call_count;
+
+    auto operator()(ants::Style /*style*/, Level /*level*/) const -> ants::StyleSpec {
+        ++*call_count;
+        return ants::StyleSpec::Red;
+    }
+};
+
+static_assert(ants::plain_text_style_sheet<ants::PlainTextStyleSheet>);
+static_assert(ants::plain_text_style_sheet<CountingPlainStyleSheet const&>);
+static_assert(!ants::plain_text_style_sheet<ants::StyleSpec (*)(ants::Style, Level)>);
+
+TEST(HumanRendererMultipleDiagTest, RenderPlainText) {
+    std::string_view const source = "let x = 1;\nlet y = x;\nlet z = y;\n";
+
+    ants::AnnotatedSource annotated(source, "main.rs");
+    annotated.add_annotation(4, 5, ants::StyledStringView::inferred("defined here"));
+    annotated.add_secondary_annotation(19, 20, ants::StyledStringView::inferred("used here"));
+    annotated.add_secondary_annotation(2, 25, ants::StyledStringView::inferred("multi-line"));
+
+    ants::Diag<Level> const diag =
+        ants::Diag(Level::Warning, ants::StyledStringView::inferred("unused variable"))
+            .with_source(std::move(annotated))
+            .with_sub_diag_entry(Level::Note, ants::StyledStringView::inferred("note"));
+
+    ants::HumanRenderer const renderer;
+    std::string const expected = renderer.render_diag(diag).content() + '\n';
+
+    // The style sheet of a plain text style sheet is never invoked.
+    unsigned call_count = 0;
+    std::string target;
+    ants::StringSink sink(target);
+    renderer.render_diag(sink, diag, CountingPlainStyleSheet { &call_count });
+    EXPECT_EQ(target, expected);
+    EXPECT_EQ(call_count, 0u);
+
+    // An output stream that is not a terminal receives plain text, whatever the style sheet is.
+    std::ostringstream out;
+    renderer.render_diag(out, diag, [](ants::Style /*style*/, Level /*level*/) {
+        return ants::StyleSpec::Blue;
+    });
+    EXPECT_EQ(out.str(), expected);
+}
+
+/// A memory resource that counts the allocations and forwards them to the default resource.
+class CountingMemoryResource : public std::pmr::memory_resource {
+public:
+    std::size_t allocation_count = 0;
+    std::size_t outstanding_bytes = 0;
+
+private:
+    auto do_allocate(std::size_t bytes, std::size_t alignment) -> void* override {
+        ++allocation_count;
+        outstanding_bytes += bytes;
+        return std::pmr::get_default_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override {
+        outstanding_bytes -= bytes;
+        std::pmr::get_default_resource()->deallocate(ptr, bytes, alignment);
+    }
+
+    auto do_is_equal(std::pmr::memory_resource const& other) const noexcept -> bool override {
+        return this == &other;
+    }
+};
+
+TEST(HumanRendererMultipleDiagTest, ScratchMemoryResource) {
+    std::string source;
+    for (unsigned idx = 0; idx != 200; ++idx) {
+        source.append("call(").append(std::to_string(idx)).append(");\n");
+    }
+
+    ants::AnnotatedSource annotated(source, "main.cpp");
+    for (std::size_t pos = 0; (pos = source.find("call", pos)) != std::string::npos; pos += 4) {
+        annotated.add_annotation(pos, pos + 4, ants::StyledStringView::inferred("first"));
+        annotated.add_secondary_annotation(pos + 5, pos + 6, ants::StyledStringView::inferred("b"));
+    }
+    annotated.add_secondary_annotation(2, 400, ants::StyledStringView::inferred("multi-line"));
+
+    ants::Diag<Level> const diag =
+        ants::Diag(Level::Error, ants::StyledStringView::inferred("message"))
+            .with_source(std::move(annotated));
+
+    CountingMemoryResource resource;
+    ants::HumanRenderer renderer;
+    renderer.scratch_memory_resource = &resource;
+
+    // The scratch state exceeds the initial buffer of the arena, so the arena obtains memory from
+    // `resource`, and returns all of it after rendering. The rendering result is not affected.
+    std::string const result = renderer.render_diag(diag).content();
+    EXPECT_NE(resource.allocation_count, 0u);
+    EXPECT_EQ(resource.outstanding_bytes, 0u);
+    EXPECT_EQ(result, ants::HumanRenderer().render_diag(diag).content());
+}
+
+TEST(HumanRendererMultipleDiagTest, RenderBatch) {
+    std::string source;
+    for (unsigned idx = 0; idx != 50; ++idx) {
+        source.append("value_").append(std::to_string(idx)).append(" = compute();\n");
+    }
+
+    // Each diagnostic annotates a different number of lines, so that the rendering costs differ.
+    std::vector<ants::Diag<Level>> diags;
+    for (unsigned idx = 0; idx != 40; ++idx) {
+        ants::AnnotatedSource annotated(source, "main.cpp");
+        std::size_t pos = 0;
+        for (unsigned line = 0; line <= idx; ++line) {
+            pos = source.find("compute", pos);
+            annotated.add_annotation(pos, pos + 7, ants::StyledStringView::inferred("called here"));
+            pos += 7;
+        }
+
+        diags.push_back(
+            ants::Diag(Level::Error, ants::StyledStringView::inferred("message"))
+                .with_source(std::move(annotated))
+        );
+    }
+
+    ants::HumanRenderer renderer;
+    renderer.diagnostic_width = 40;
+
+    std::vector<std::string> expected;
+    std::string expected_output;
+    for (ants::Diag<Level> const& diag : diags) {
+        expected.push_back(renderer.render_diag(diag).content());
+
+        ants::StringSink sink(expected_output);
+        renderer.render_diag(sink, diag);
+    }
+
+    // The results are in the order of the diagnostics, regardless of the number of threads.
+    for (unsigned const thread_count : { 1u, 4u, 0u }) {
+        std::vector<ants::StyledString> const results = renderer.render_batch(diags, thread_count);
+        ASSERT_EQ(results.size(), expected.size());
+        for (std::size_t idx = 0; idx != results.size(); ++idx) {
+            EXPECT_EQ(results[idx].content(), expected[idx]);
+        }
+
+        std::string output;
+        ants::StringSink sink(output);
+        renderer.render_batch(sink, diags, thread_count);
+        EXPECT_EQ(output, expected_output);
+    }
+
+    // An empty range renders nothing.
+    std::vector<ants::Diag<Level>> const no_diags;
+    EXPECT_TRUE(renderer.render_batch(no_diags).empty());
+}
+
+TEST(HumanRendererMultipleDiagTest, SharedDiag) {
+    std::string source;
+    for (unsigned idx = 0; idx != 50; ++idx) {
+        source.append("value_").append(std::to_string(idx)).append(" = compute();\n");
+    }
+
+    // The spans are given by line and column numbers, so no line offset is cached, and the source
+    // has no line index.
+    auto const diag = ants::Diag(Level::Error, ants::StyledStringView::inferred("message"))
+                          .with_source(
+                              ants::AnnotatedSource(source, "main.cpp")
+                                  .with_annotation(
+                                      ants::SourceLocation { 10, 11 },
+                                      ants::SourceLocation { 30, 0 },
+                                      ants::StyledStringView::inferred("range")
+                                  )
+                                  .with_secondary_annotation(
+                                      ants::SourceLocation { 45, 0 },
+                                      ants::SourceLocation { 45, 8 },
+                                      ants::StyledStringView::inferred("value")
+                                  )
+                          );
+
+    ants::HumanRenderer const renderer;
+    std::string const expected = renderer.render_diag(diag).content();
+
+    // The same diagnostic can be rendered by several threads at once, since rendering does not
+    // modify it.
+    std::vector<std::string> results(4);
+    {
+        std::vector<std::jthread> threads;
+        for (std::string& result : results) {
+            threads.emplace_back([&] { result = renderer.render_diag(diag).content(); });
+        }
+    }
+    for (std::string const& result : results) {
+        EXPECT_EQ(result, expected);
+    }
+    EXPECT_TRUE(diag.associated_sources()[0].line_offsets_cache().empty());
+}
+
+TEST(HumanRendererMultipleDiagTest, ParallelSources) {
+    std::string_view const source = "auto value = compute(first,\n    second);\n";
+
+    // `AnnotatedSource` only refers to the names of the sources.
+    std::vector<std::string> origins;
+    for (unsigned idx = 0; idx != 30; ++idx) {
+        origins.push_back("module_" + std::to_string(idx) + ".cpp");
+    }
+
+    // A diagnostic with many sources, some of which have no annotations and are not rendered.
+    auto diag =
+        ants::Diag(Level::Error, ants::StyledStringView::inferred("conflicting definitions"));
+    for (unsigned idx = 0; idx != origins.size(); ++idx) {
+        ants::AnnotatedSource annotated(source, origins[idx]);
+        if (idx % 7 != 3) {
+            annotated.add_annotation(5, 10, ants::StyledStringView::inferred("defined here"));
+            annotated.add_secondary_annotation(13, 40, ants::StyledStringView::inferred("call"));
+        }
+        diag.add_source(std::move(annotated));
+    }
+    diag.add_sub_diag_entry(
+        ants::DiagEntry(Level::Note, ants::StyledStringView::inferred("previous definitions"))
+            .with_source(ants::AnnotatedSource(source, "main.cpp").with_annotation(0, 4))
+    );
+
+    ants::HumanRenderer const sequential;
+    std::ostringstream expected_out;
+    sequential.render_diag(expected_out, diag);
+
+    for (unsigned const thread_count : { 1u, 4u, 0u }) {
+        ants::HumanRenderer parallel;
+        parallel.parallel_source_threshold = 2;
+        parallel.parallel_source_thread_count = thread_count;
+
+        EXPECT_EQ(
+            parallel.render_diag(diag).styled_line_parts(),
+            sequential.render_diag(diag).styled_line_parts()
+        );
+
+        std::ostringstream out;
+        parallel.render_diag(out, diag);
+        EXPECT_EQ(out.str(), expected_out.str());
+    }
+
+    // Below the threshold, the sources are rendered sequentially.
+    ants::HumanRenderer below_threshold;
+    below_threshold.parallel_source_threshold = 100;
+    EXPECT_EQ(
+        below_threshold.render_diag(diag).styled_line_parts(),
+        sequential.render_diag(diag).styled_line_parts()
+    );
+}
+TEST(HumanRendererMultipleDiagTest, ParallelException) {
+    std::string_view const source = "auto value = compute(first,\n    second);\n";
+
+    // Every fourth diagnostic has a label whose producer throws.
+    std::vector<ants::Diag<Level>> diags;
+    for (unsigned idx = 0; idx != 20; ++idx) {
+        ants::AnnotatedSource annotated(source, "main.cpp");
+        if (idx % 4 == 3) {
+            annotated.add_primary_deferred_annotation(5, 10, []() -> ants::StyledString {
+                throw std::runtime_error("producer failed");
+            });
+        } else {
+            annotated.add_annotation(5, 10, ants::StyledStringView::inferred("declared here"));
+        }
+        diags.push_back(
+            ants::Diag(Level::Error, ants::StyledStringView::inferred("message"))
+                .with_source(std::move(annotated))
+        );
+    }
+
+    // The exception is rethrown on the calling thread, as with sequential rendering.
+    ants::HumanRenderer const renderer;
+    EXPECT_THROW(renderer.render_diag(diags[3]), std::runtime_error);
+    for (unsigned const thread_count : { 1u, 4u }) {
+        EXPECT_THROW(renderer.render_batch(diags, thread_count), std::runtime_error);
+
+        std::string output;
+        ants::StringSink sink(output);
+        EXPECT_THROW(renderer.render_batch(sink, diags, thread_count), std::runtime_error);
+        EXPECT_TRUE(output.empty());
+    }
+
+    // The same holds for the sources of a diagnostic rendered in parallel.
+    auto diag = ants::Diag(Level::Error, ants::StyledStringView::inferred("message"));
+    for (ants::Diag<Level> const& other : diags) {
+        diag.add_source(other.associated_sources()[0]);
+    }
+    ants::HumanRenderer parallel;
+    parallel.parallel_source_threshold = 1;
+    parallel.parallel_source_thread_count = 4;
+    EXPECT_THROW(parallel.render_diag(diag), std::runtime_error);
+}
 }  // namespace
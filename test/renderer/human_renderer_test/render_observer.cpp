@@ -0,0 +1,164 @@
+#include "annotate_snippets/annotated_source.hpp"
+#include "annotate_snippets/diag.hpp"
+#include "annotate_snippets/renderer/human_renderer.hpp"
+#include "annotate_snippets/renderer/render_observer.hpp"
+#include "annotate_snippets/styled_string_view.hpp"
+#include "level_for_test.hpp"
+
+#include "gtest/gtest.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+/// Records the notifications of the renderer.
+class RecordingObserver : public ants::RenderObserver {
+public:
+    struct Event {
+        ants::RenderPhase phase;
+        bool is_begin;
+        clock::time_point time;
+    };
+
+    std::vector<Event> events;
+    std::vector<ants::RenderStats> stats;
+    std::vector<std::string_view> rendered_sources;
+
+    void on_phase_begin(
+        [[maybe_unused]] ants::AnnotatedSource const& source,
+        ants::RenderPhase phase,
+        clock::time_point time
+    ) override {
+        events.push_back({ .phase = phase, .is_begin = true, .time = time });
+    }
+
+    void on_phase_end(
+        [[maybe_unused]] ants::AnnotatedSource const& source,
+        ants::RenderPhase phase,
+        clock::time_point time
+    ) override {
+        events.push_back({ .phase = phase, .is_begin = false, .time = time });
+    }
+
+    void on_source_rendered(ants::AnnotatedSource const& source, ants::RenderStats const& stats)
+        override {
+        this->stats.push_back(stats);
+        rendered_sources.push_back(source.origin());
+    }
+};
+
+TEST(HumanRendererObserverTest, Phases) {
+#ifndef ANNOTATE_SNIPPETS_ENABLE_TRACING
+    GTEST_SKIP() << "the render observer hooks are compiled out";
+#endif
+
+    std::string_view const source = R"(auto main() -> int {
+    std::cout << "Hello";
+    return 0;
+})";
+
+    auto const diag = ants::Diag(Level::Error, ants::StyledStringView::inferred("message"))
+                          .with_source(
+                              ants::AnnotatedSource(source, "main.cpp")
+                                  .with_annotation(
+                                      ants::SourceLocation { 0, 19 },
+                                      ants::SourceLocation { 3, 1 },
+                                      ants::StyledStringView::inferred("body")
+                                  )
+                                  .with_annotation(
+                                      ants::SourceLocation { 1, 4 },
+                                      ants::SourceLocation { 1, 7 },
+                                      ants::StyledStringView::inferred("namespace")
+                                  )
+                                  .with_secondary_annotation(
+                                      ants::SourceLocation { 1, 9 },
+                                      ants::SourceLocation { 1, 13 },
+                                      ants::StyledStringView::inferred("stream")
+                                  )
+                                  .with_secondary_annotation(
+                                      ants::SourceLocation { 1, 17 },
+                                      ants::SourceLocation { 1, 24 },
+                                      ants::StyledStringView::inferred("literal")
+                                  )
+                          );
+
+    RecordingObserver observer;
+    ants::HumanRenderer renderer;
+    renderer.render_observer = &observer;
+    std::string const rendered = renderer.render_diag(diag).content();
+
+    // The rendering result is not affected by the observer.
+    renderer.render_observer = nullptr;
+    EXPECT_EQ(rendered, renderer.render_diag(diag).content());
+
+    ASSERT_EQ(observer.rendered_sources, std::vector<std::string_view> { "main.cpp" });
+
+    // All lines are annotated by the multi-line annotation.
+    std::vector<ants::RenderPhase> expected_phases {
+        ants::RenderPhase::AddSpans,
+        ants::RenderPhase::HandleMultilineSpans,
+        ants::RenderPhase::HandleUnannotatedLines,
+        ants::RenderPhase::FoldMultilineAnnotations,
+        ants::RenderPhase::ComputeDisplayColumns,
+    };
+    for (unsigned line = 0; line != 4; ++line) {
+        expected_phases.push_back(ants::RenderPhase::ComputeLabelLinePositions);
+        expected_phases.push_back(ants::RenderPhase::RenderLine);
+    }
+
+    ASSERT_EQ(observer.events.size(), 2 * expected_phases.size());
+    for (std::size_t idx = 0; idx != expected_phases.size(); ++idx) {
+        RecordingObserver::Event const& begin = observer.events[2 * idx];
+        RecordingObserver::Event const& end = observer.events[2 * idx + 1];
+        EXPECT_EQ(begin.phase, expected_phases[idx]);
+        EXPECT_TRUE(begin.is_begin);
+        EXPECT_EQ(end.phase, expected_phases[idx]);
+        EXPECT_FALSE(end.is_begin);
+        EXPECT_LE(begin.time, end.time);
+    }
+
+    ants::RenderStats const stats = observer.stats.front();
+    EXPECT_EQ(stats.span_num, 4);
+    EXPECT_EQ(stats.annotated_line_num, 4);
+    EXPECT_EQ(stats.multiline_depth_num, 1);
+    EXPECT_EQ(stats.scanned_byte_num, source.size() - 3);
+    // The label of "namespace" is placed below the label of "stream".
+    EXPECT_EQ(stats.graph_edge_num, 1);
+    // The annotated lines are rendered after the line number separator following the file name.
+    EXPECT_EQ(stats.emitted_byte_num, rendered.size() - rendered.find("\n1 |"));
+
+    // No graph is built by the sweep.
+    renderer.render_observer = &observer;
+    renderer.label_placement = ants::HumanRenderer::SweepPlacement;
+    EXPECT_EQ(renderer.render_diag(diag).content(), rendered);
+    ASSERT_EQ(observer.stats.size(), 2);
+    EXPECT_EQ(observer.stats.back().graph_edge_num, 0);
+    EXPECT_EQ(observer.stats.back().emitted_byte_num, stats.emitted_byte_num);
+}
+
+TEST(HumanRendererObserverTest, ScannedBytes) {
+#ifndef ANNOTATE_SNIPPETS_ENABLE_TRACING
+    GTEST_SKIP() << "the render observer hooks are compiled out";
+#endif
+
+    // Only the window of the long line around the annotation is laid out.
+    std::string const source = std::string(200, 'a') + "value" + std::string(200, 'b');
+    auto const diag = ants::Diag(Level::Error, ants::StyledStringView::inferred("message"))
+                          .with_source(
+                              ants::AnnotatedSource(source, "main.cpp")
+                                  .with_annotation(200, 205, ants::StyledStringView())
+                          );
+
+    RecordingObserver observer;
+    ants::HumanRenderer renderer;
+    renderer.render_observer = &observer;
+    renderer.diagnostic_width = 40;
+    renderer.render_diag(diag);
+
+    ASSERT_EQ(observer.stats.size(), 1);
+    EXPECT_GT(observer.stats.front().scanned_byte_num, 5);
+    EXPECT_LT(observer.stats.front().scanned_byte_num, 40);
+}
+}  // namespace
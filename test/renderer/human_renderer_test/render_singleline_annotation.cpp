@@ -5,6 +5,7 @@
 
 #include "gtest/gtest.h"
 
+#include <cstddef>
 #include <string>
 #include <string_view>
 
@@ -1128,3 +1129,77 @@ TEST(HumanRendererSinglelineAnnotationTest, SourceNormalization) {
     );
 }
 }  // namespace
+
+TEST(HumanRendererSinglelineAnnotationTest, LongLineWindow) {
+    std::string source;
+    for (unsigned idx = 0; idx != 20; ++idx) {
+        source.append("value_").append(std::to_string(idx)).append(idx == 19 ? ";\n" : ", ");
+    }
+    source.append("\tshort();");
+
+    ants::HumanRenderer renderer;
+    renderer.diagnostic_width = 50;
+
+    std::size_t const pos = source.find("value_10");
+    EXPECT_EQ(
+        renderer
+            .render_diag(  //
+                ants::Diag(Level::Error, ants::StyledStringView::inferred("message"))
+                    .with_source(  //
+                        ants::AnnotatedSource(source, "main.cpp")
+                            .with_annotation(
+                                pos,
+                                pos + 8,
+                                ants::StyledStringView::inferred("label")
+                            )
+                            .with_secondary_annotation(source.size() - 8, source.size() - 1)
+                    )
+            )
+            .content(),
+        R"(error: message
+ --> main.cpp:1:91
+  |
+1 | ..._8, value_9, value_10, value_11, value_1...
+  |                 ^^^^^^^^ label
+2 |     short();
+  |     -------)"
+    );
+
+    EXPECT_EQ(
+        renderer
+            .render_diag(  //
+                ants::Diag(Level::Error, ants::StyledStringView::inferred("message"))
+                    .with_source(  //
+                        ants::AnnotatedSource(source, "main.cpp").with_annotation(2, 5)
+                    )
+            )
+            .content(),
+        R"(error: message
+ --> main.cpp:1:3
+  |
+1 | value_0, value_1, value_2, value_3, value_4...
+  |   ^^^)"
+    );
+
+    std::size_t const last = source.find("value_19");
+    EXPECT_EQ(
+        renderer
+            .render_diag(  //
+                ants::Diag(Level::Error, ants::StyledStringView::inferred("message"))
+                    .with_source(  //
+                        ants::AnnotatedSource(source, "main.cpp")
+                            .with_annotation(
+                                last,
+                                last + 8,
+                                ants::StyledStringView::inferred("label")
+                            )
+                    )
+            )
+            .content(),
+        R"(error: message
+ --> main.cpp:1:181
+  |
+1 | ...15, value_16, value_17, value_18, value_19;
+  |                                      ^^^^^^^^ label)"
+    );
+}
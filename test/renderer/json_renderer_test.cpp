@@ -0,0 +1,140 @@
+#include "annotate_snippets/renderer/json_renderer.hpp"
+
+#include "annotate_snippets/annotated_source.hpp"
+#include "annotate_snippets/diag.hpp"
+#include "annotate_snippets/output_sink.hpp"
+#include "annotate_snippets/style.hpp"
+#include "annotate_snippets/styled_string.hpp"
+#include "annotate_snippets/styled_string_view.hpp"
+#include "human_renderer_test/level_for_test.hpp"
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <string_view>
+
+namespace {
+constexpr std::string_view source = "auto value = compute(first,\n    second);\n";
+
+TEST(JsonRendererTest, Diag) {
+    auto const diag =
+        ants::Diag(Level::Error, ants::StyledStringView::inferred("mismatched types"), "E0308")
+            .with_source(
+                ants::AnnotatedSource(source, "main.cpp")
+                    .with_first_line_number(10)
+                    .with_secondary_annotation(13, 39, ants::StyledStringView::inferred("call"))
+                    .with_annotation(5, 10, ants::StyledStringView::inferred("declared here"))
+                    .with_annotation(21, 26, ants::StyledStringView())
+            )
+            .with_sub_diag_entry(
+                ants::DiagEntry(Level::Note, ants::StyledStringView::inferred("required here"))
+            );
+
+    EXPECT_EQ(
+        ants::JsonRenderer().render_diag(diag),
+        R"({"level":"error","code":"E0308",)"
+        R"("message":{"text":"mismatched types","styles":[]},)"
+        R"("sources":[{"origin":"main.cpp","spans":[)"
+        R"({"primary":true,"byte_beg":5,"byte_end":10,"line_beg":10,"col_beg":6,"line_end":10,)"
+        R"("col_end":11,"label":{"text":"declared here","styles":[]}},)"
+        R"({"primary":true,"byte_beg":21,"byte_end":26,"line_beg":10,"col_beg":22,"line_end":10,)"
+        R"("col_end":27,"label":null},)"
+        R"({"primary":false,"byte_beg":13,"byte_end":39,"line_beg":10,"col_beg":14,"line_end":11,)"
+        R"("col_end":12,"label":{"text":"call","styles":[]}}]}],)"
+        R"("children":[{"level":"note","code":null,)"
+        R"("message":{"text":"required here","styles":[]},"sources":[]}]})"
+        "\n"
+    );
+}
+
+TEST(JsonRendererTest, Escape) {
+    auto const diag = ants::Diag(
+        Level::Warning,
+        ants::StyledStringView::inferred("\"quoted\"\\path\tx\x01 \xE4\xB8\xAD")
+    );
+
+    EXPECT_EQ(
+        ants::JsonRenderer { .renders_styles = false }.render_diag(diag),
+        R"({"level":"warning","code":null,)"
+        R"("message":{"text":"\"quoted\"\\path\tx\u0001 )"
+        "\xE4\xB8\xAD"
+        R"("},"sources":[],"children":[]})"
+        "\n"
+    );
+}
+
+TEST(JsonRendererTest, InvalidUtf8) {
+    // A truncated multibyte sequence, a lone continuation byte, a byte of Latin-1, an overlong
+    // encoding and a surrogate are each replaced by U+FFFD, while the valid sequences are kept.
+    auto const diag = ants::Diag(
+        Level::Error,
+        ants::StyledStringView::inferred(
+            "a\xE4\xB8 b\x80 caf\xE9 "
+            "\xC0\xAF \xED\xA0\x80 \xE4\xB8\xAD\xE4"
+        )
+    );
+
+    EXPECT_EQ(
+        ants::JsonRenderer { .renders_styles = false }.render_diag(diag),
+        R"({"level":"error","code":null,)"
+        R"("message":{"text":"a\ufffd b\ufffd caf\ufffd \ufffd\ufffd \ufffd\ufffd\ufffd )"
+        "\xE4\xB8\xAD"
+        R"(\ufffd"},"sources":[],"children":[]})"
+        "\n"
+    );
+}
+
+TEST(JsonRendererTest, Styles) {
+    // The highlighted ranges on both lines are merged, since only the line break separates them.
+    auto const message = ants::StyledStringView::inferred("expected `int`\nfound `long`")
+                             .with_style(ants::Style::Highlight, 9, 20)
+                             .with_style(ants::Style::custom(3), 21, 25);
+    auto const diag = ants::Diag(Level::Error, message);
+
+    EXPECT_EQ(
+        ants::JsonRenderer().render_diag(diag),
+        R"({"level":"error","code":null,)"
+        R"("message":{"text":"expected `int`\nfound `long`","styles":[)"
+        R"({"beg":9,"end":20,"style":"highlight"},{"beg":21,"end":25,"style":3}]},)"
+        R"("sources":[],"children":[]})"
+        "\n"
+    );
+}
+
+TEST(JsonRendererTest, DeferredText) {
+    auto const diag =
+        ants::Diag<Level>(Level::Error)
+            .with_deferred_diag_message([] {
+                return ants::StyledString::inferred("mismatched types")
+                    .with_style(ants::Style::Highlight, 0, 10);
+            })
+            .with_source(ants::AnnotatedSource(source, "main.cpp").with_primary_deferred_annotation(
+                5,
+                10,
+                [] { return ants::StyledString::inferred("declared here"); }
+            ));
+
+    EXPECT_EQ(
+        ants::JsonRenderer().render_diag(diag),
+        R"({"level":"error","code":null,"message":{"text":"mismatched types","styles":[)"
+        R"({"beg":0,"end":10,"style":"highlight"}]},)"
+        R"("sources":[{"origin":"main.cpp","spans":[)"
+        R"({"primary":true,"byte_beg":5,"byte_end":10,"line_beg":1,"col_beg":6,"line_end":1,)"
+        R"("col_end":11,"label":{"text":"declared here","styles":[]}}]}],"children":[]})"
+        "\n"
+    );
+}
+
+TEST(JsonRendererTest, Sink) {
+    auto const diag = ants::Diag(Level::Error, ants::StyledStringView::inferred("first"));
+    auto const other = ants::Diag(Level::Error, ants::StyledStringView::inferred("second"));
+    ants::JsonRenderer const renderer;
+
+    // Each diagnostic is rendered as one line.
+    std::string output;
+    ants::StringSink sink(output);
+    renderer.render_diag(sink, diag);
+    renderer.render_diag(sink, other);
+    EXPECT_EQ(output, renderer.render_diag(diag) + renderer.render_diag(other));
+}
+}  // namespace
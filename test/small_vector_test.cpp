@@ -0,0 +1,92 @@
+#include "annotate_snippets/detail/small_vector.hpp"
+
+#include "gtest/gtest.h"
+
+#include <utility>
+#include <vector>
+
+namespace {
+using Vector = ants::detail::SmallVector<int, 4>;
+
+auto to_vector(Vector const& vec) -> std::vector<int> {
+    return { vec.begin(), vec.end() };
+}
+
+TEST(SmallVectorTest, InlineStorage) {
+    Vector vec { 1, 2 };
+    EXPECT_TRUE(vec.is_inline());
+    EXPECT_EQ(vec.size(), 2);
+    EXPECT_EQ(vec.capacity(), 4);
+
+    vec.push_back(3);
+    vec.push_back(4);
+    EXPECT_TRUE(vec.is_inline());
+    EXPECT_EQ(to_vector(vec), (std::vector { 1, 2, 3, 4 }));
+    EXPECT_EQ(vec.front(), 1);
+    EXPECT_EQ(vec.back(), 4);
+
+    vec.resize(1);
+    EXPECT_EQ(to_vector(vec), (std::vector { 1 }));
+    vec.resize(3);
+    EXPECT_EQ(to_vector(vec), (std::vector { 1, 0, 0 }));
+}
+
+TEST(SmallVectorTest, HeapStorage) {
+    Vector vec { 1, 2, 3, 4 };
+    vec.push_back(vec.front());
+    EXPECT_FALSE(vec.is_inline());
+    EXPECT_EQ(to_vector(vec), (std::vector { 1, 2, 3, 4, 1 }));
+
+    vec = { 5, 6 };
+    EXPECT_EQ(to_vector(vec), (std::vector { 5, 6 }));
+
+    Vector large { 1, 2, 3, 4, 5, 6 };
+    EXPECT_FALSE(large.is_inline());
+    EXPECT_EQ(large.size(), 6);
+}
+
+TEST(SmallVectorTest, InsertErase) {
+    Vector vec { 1, 4 };
+    auto pos = vec.insert(vec.begin() + 1, { 2, 3 });
+    EXPECT_EQ(pos, vec.begin() + 1);
+    EXPECT_EQ(to_vector(vec), (std::vector { 1, 2, 3, 4 }));
+
+    pos = vec.insert(vec.end(), { 5, 6 });
+    EXPECT_EQ(pos, vec.begin() + 4);
+    EXPECT_EQ(to_vector(vec), (std::vector { 1, 2, 3, 4, 5, 6 }));
+
+    pos = vec.erase(vec.begin() + 1, vec.begin() + 5);
+    EXPECT_EQ(pos, vec.begin() + 1);
+    EXPECT_EQ(to_vector(vec), (std::vector { 1, 6 }));
+
+    vec.pop_back();
+    EXPECT_EQ(to_vector(vec), (std::vector { 1 }));
+
+    vec.erase(vec.begin(), vec.end());
+    EXPECT_TRUE(vec.empty());
+}
+
+TEST(SmallVectorTest, CopyMove) {
+    Vector const small { 1, 2 };
+    Vector const large { 1, 2, 3, 4, 5 };
+
+    Vector copy = small;
+    EXPECT_EQ(copy, small);
+    copy = large;
+    EXPECT_EQ(copy, large);
+    EXPECT_FALSE(copy.is_inline());
+
+    Vector moved = std::move(copy);
+    EXPECT_EQ(moved, large);
+    EXPECT_FALSE(moved.is_inline());
+    // NOLINTBEGIN(bugprone-use-after-move): A moved-from vector is empty.
+    EXPECT_TRUE(copy.empty());
+    EXPECT_TRUE(copy.is_inline());
+    // NOLINTEND(bugprone-use-after-move)
+
+    Vector other = small;
+    moved = std::move(other);
+    EXPECT_EQ(moved, small);
+    EXPECT_TRUE(moved.is_inline());
+}
+}  // namespace
@@ -0,0 +1,196 @@
+#include "annotate_snippets/source_file.hpp"
+
+#include "annotate_snippets/annotated_source.hpp"
+#include "annotate_snippets/line_index.hpp"
+
+#include "gtest/gtest.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+TEST(SourceFileTest, ViewAndOwned) {
+    {
+        std::string const source = "ab\ncd";
+        auto const file = ants::SourceFile::view(source, "main.cpp");
+        EXPECT_EQ(file->source().data(), source.data());
+        EXPECT_EQ(file->origin(), "main.cpp");
+    }
+
+    {
+        auto const file = ants::SourceFile::view("ab\ncd");
+        EXPECT_EQ(file->source(), "ab\ncd");
+        EXPECT_EQ(file->origin(), "");
+    }
+
+    {
+        std::string source = "short";
+        auto const file = ants::SourceFile::owned(source, "main.cpp");
+        source = "changed";
+        EXPECT_EQ(file->source(), "short");
+        EXPECT_EQ(file->origin(), "main.cpp");
+    }
+
+    {
+        auto const file = ants::SourceFile::owned("ab\ncd");
+        EXPECT_EQ(file->source(), "ab\ncd");
+        EXPECT_EQ(file->origin(), "");
+    }
+}
+
+TEST(SourceFileTest, LineIndex) {
+    auto const file = ants::SourceFile::owned("ab\ncd\ne\nf");
+
+    ants::LineIndex const& index = file->line_index();
+    EXPECT_EQ(index.line_starts(), (std::vector<std::size_t> { 0, 3, 6, 8, 9 }));
+    // The index is built only once.
+    EXPECT_EQ(&file->line_index(), &index);
+}
+
+TEST(SourceFileTest, ConcurrentLineIndex) {
+    std::string source;
+    for (unsigned idx = 0; idx != 10'000; ++idx) {
+        source.append(idx % 13, 'x').append("\n");
+    }
+    auto const file = ants::SourceFile::view(source);
+
+    std::vector<ants::LineIndex const*> results(8);
+    std::vector<std::thread> threads;
+    for (ants::LineIndex const*& result : results) {
+        threads.emplace_back([&] { result = &file->line_index(); });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (ants::LineIndex const* const result : results) {
+        EXPECT_EQ(result, &file->line_index());
+    }
+    EXPECT_EQ(file->line_index().line_count(), 10'001);
+}
+
+TEST(SourceFileTest, AnnotatedSource) {
+    auto const file = ants::SourceFile::owned("ab\ncd\r\ne\nf", "main.cpp");
+
+    ants::AnnotatedSource first(file);
+    EXPECT_EQ(first.source().data(), file->source().data());
+    EXPECT_EQ(first.origin(), "main.cpp");
+    EXPECT_EQ(first.source_file(), file);
+    EXPECT_EQ(first.line_index(), &file->line_index());
+
+    first.add_annotation(4, 6);
+    EXPECT_EQ(first.primary_spans()[0].beg, (ants::SourceLocation { 1, 1 }));
+    EXPECT_EQ(first.primary_spans()[0].end, (ants::SourceLocation { 1, 3 }));
+    EXPECT_EQ(first.line_content(1), "cd");
+    EXPECT_TRUE(first.line_offsets_cache().empty());
+
+    // Building the line index explicitly reuses the index of the file.
+    ants::AnnotatedSource second(file);
+    second.build_line_index();
+    EXPECT_EQ(second.line_index(), &file->line_index());
+
+    // The file outlives the handle it is created from.
+    std::weak_ptr<ants::SourceFile const> weak_file;
+    {
+        auto temp_file = ants::SourceFile::owned("temporary\nfile");
+        weak_file = temp_file;
+
+        ants::AnnotatedSource third(std::move(temp_file));
+        third.build_line_index();
+        ants::AnnotatedSource const copy = third;
+
+        third = ants::AnnotatedSource();
+        EXPECT_FALSE(weak_file.expired());
+        EXPECT_EQ(copy.source(), "temporary\nfile");
+    }
+    EXPECT_TRUE(weak_file.expired());
+}
+
+/// Creates a file with the given content in the temporary directory and returns its path.
+auto write_temp_file(std::string const& name, std::string_view content) -> std::string {
+    std::filesystem::path const path = std::filesystem::temp_directory_path() / name;
+    std::ofstream(path, std::ios::binary) << content;
+    return path.string();
+}
+
+TEST(SourceFileTest, Mapped) {
+    std::string const path = write_temp_file("annotate_snippets_mapped.cpp", "ab\ncd\r\ne\nf");
+    {
+        auto const file = ants::SourceFile::mapped(path);
+        ASSERT_NE(file, nullptr);
+        EXPECT_EQ(file->source(), "ab\ncd\r\ne\nf");
+        EXPECT_EQ(file->origin(), path);
+        EXPECT_FALSE(file->uses_line_index());
+
+        // Annotated sources of the file locate lines lazily, until the line index is built.
+        ants::AnnotatedSource annotated(file);
+        EXPECT_EQ(annotated.source().data(), file->source().data());
+        EXPECT_EQ(annotated.line_index(), nullptr);
+        annotated.add_annotation(4, 6);
+        EXPECT_EQ(annotated.primary_spans()[0].beg, (ants::SourceLocation { 1, 1 }));
+        EXPECT_EQ(annotated.line_content(1), "cd");
+        EXPECT_FALSE(annotated.line_offsets_cache().empty());
+
+        annotated.build_line_index();
+        EXPECT_EQ(annotated.line_index(), &file->line_index());
+        EXPECT_EQ(annotated.line_content(2), "e");
+    }
+    std::filesystem::remove(path);
+
+    // Empty files cannot be mapped by the operating system, but are supported.
+    std::string const empty_path = write_temp_file("annotate_snippets_empty.cpp", "");
+    auto const empty_file = ants::SourceFile::mapped(empty_path);
+    ASSERT_NE(empty_file, nullptr);
+    EXPECT_EQ(empty_file->source(), "");
+    std::filesystem::remove(empty_path);
+
+    // Missing files and directories cannot be mapped.
+    EXPECT_EQ(ants::SourceFile::mapped(path), nullptr);
+    EXPECT_EQ(ants::SourceFile::mapped(std::filesystem::temp_directory_path().string()), nullptr);
+    EXPECT_THROW(ants::AnnotatedSource(ants::SourceFile::mapped(path)), std::invalid_argument);
+}
+
+TEST(SourceFileTest, ConcurrentMappedLookups) {
+    std::string source;
+    for (unsigned idx = 0; idx != 1'000; ++idx) {
+        source.append(idx % 13, 'x').append("\n");
+    }
+    std::string const path = write_temp_file("annotate_snippets_shared.cpp", source);
+    {
+        auto const file = ants::SourceFile::mapped(path);
+        ASSERT_NE(file, nullptr);
+
+        // The `const` lookups of an annotated source of the file do not use the line index and do
+        // not modify the source, so they can run on several threads at once.
+        ants::AnnotatedSource const annotated(file);
+        std::vector<std::size_t> mismatch_nums(4);
+        std::vector<std::thread> threads;
+        for (std::size_t& mismatch_num : mismatch_nums) {
+            threads.emplace_back([&] {
+                ants::AnnotatedSource::LineOffsetMemo memo;
+                for (unsigned line = 0; line != 1'000; ++line) {
+                    mismatch_num += annotated.line_content(line, memo).size() != line % 13 ? 1 : 0;
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+
+        for (std::size_t const mismatch_num : mismatch_nums) {
+            EXPECT_EQ(mismatch_num, 0);
+        }
+        EXPECT_EQ(annotated.line_index(), nullptr);
+        EXPECT_TRUE(annotated.line_offsets_cache().empty());
+    }
+    std::filesystem::remove(path);
+}
+}  // namespace
@@ -2,6 +2,8 @@
 
 #include "gtest/gtest.h"
 
+#include <sstream>
+
 namespace {
 TEST(StyleSpecTest, Constructor) {
     {
@@ -142,4 +144,71 @@ TEST(StyleSpecTest, Operator) {
         == ants::StyleSpec(ants::StyleSpec::Red) + ants::StyleSpec::Underline
     );
 }
+
+TEST(StyleSpecTest, AnsiEscapeSequence) {
+    static_assert(ants::StyleSpec().ansi_escape_sequence().empty());
+    constexpr ants::StyleSpec red = ants::StyleSpec::Red;
+    static_assert(red.ansi_escape_sequence().view() == "\033[31m");
+
+    constexpr ants::StyleSpec gray_background(ants::StyleSpec::Default, ants::StyleSpec::Gray);
+    static_assert(gray_background.ansi_escape_sequence().view() == "\033[47m");
+    static_assert(
+        (ants::StyleSpec::BrightRed + ants::StyleSpec::Bold).ansi_escape_sequence().view()
+        == "\033[1;91m"
+    );
+    static_assert(
+        ants::StyleSpec(
+            ants::StyleSpec::BrightGray,
+            ants::StyleSpec::BrightGray,
+            ants::StyleSpec::Bold | ants::StyleSpec::Dim | ants::StyleSpec::Italic
+                | ants::StyleSpec::Underline | ants::StyleSpec::Reversed
+                | ants::StyleSpec::Conceal | ants::StyleSpec::Crossed
+        )
+            .ansi_escape_sequence()
+            .view()
+        == "\033[1;2;3;4;7;8;9;97;107m"
+    );
+}
+
+TEST(StyledLineWriterTest, Plain) {
+    std::ostringstream out;
+    ants::StyledLineWriter writer(out, /*use_escape_sequences=*/false);
+    EXPECT_FALSE(writer.is_colored());
+
+    writer.append("error", ants::StyleSpec::BrightRed + ants::StyleSpec::Bold);
+    writer.append(": ", {});
+    writer.append("message", ants::StyleSpec::Default + ants::StyleSpec::Bold);
+    EXPECT_EQ(out.str(), "");
+
+    writer.end_line();
+    EXPECT_EQ(out.str(), "error: message\n");
+
+    writer.end_line();
+    EXPECT_EQ(out.str(), "error: message\n\n");
+}
+
+TEST(StyledLineWriterTest, Ansi) {
+    std::ostringstream out;
+    ants::StyledLineWriter writer(out, /*use_escape_sequences=*/true);
+    EXPECT_TRUE(writer.is_colored());
+
+    // Adjacent strings of the same style are rendered with a single escape sequence, and empty
+    // strings do not change the style.
+    writer.append("err", ants::StyleSpec::Red);
+    writer.append("", ants::StyleSpec::Blue);
+    writer.append("or", ants::StyleSpec::Red);
+    writer.append(": ", {});
+    writer.append("message", ants::StyleSpec::Default + ants::StyleSpec::Bold);
+    writer.end_line();
+    EXPECT_EQ(out.str(), "\033[31merror\033[0m: \033[1mmessage\033[0m\n");
+
+    // Each line starts with the default style.
+    out.str("");
+    writer.append("  ", {});
+    writer.append("|", ants::StyleSpec::Blue);
+    writer.append(" code", {});
+    writer.end_line();
+    writer.end_line();
+    EXPECT_EQ(out.str(), "  \033[34m|\033[0m code\n\n");
+}
 }  // namespace
@@ -4,11 +4,31 @@
 
 #include "gtest/gtest.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <ranges>
+#include <string_view>
 #include <vector>
 
 namespace {
 using LineParts = std::vector<std::vector<ants::StyledStringViewPart>>;
 
+static_assert(std::ranges::forward_range<ants::StyledLineRange>);
+static_assert(std::ranges::forward_range<ants::StyledLine>);
+
+/// Collects the lines yielded by `styled_lines()` into the same form as `styled_line_parts()`.
+auto collect_styled_lines(ants::StyledString const& str) -> LineParts {
+    LineParts lines;
+    for (ants::StyledLine const& line : str.styled_lines()) {
+        std::vector<ants::StyledStringViewPart>& parts = lines.emplace_back();
+        for (ants::StyledStringViewPart const part : line) {
+            parts.push_back(part);
+        }
+    }
+    return lines;
+}
+
 TEST(StyledStringTest, AppendContent) {
     {
         auto str = ants::StyledString::inferred("Hello");
@@ -274,6 +294,58 @@ TEST(StyledStringTest, AppendParts) {
     }
 }
 
+TEST(StyledStringTest, AppendStyledString) {
+    auto other = ants::StyledString::styled("World", ants::Style::Addition);
+    other.append_newline();
+    other.append("!", ants::Style::Removal);
+
+    {
+        auto str = ants::StyledString::inferred("Hello");
+        str.append(other);
+        EXPECT_EQ(str.content(), "HelloWorld\n!");
+        // clang-format off
+        EXPECT_EQ(
+            str.styled_line_parts(),
+            (LineParts {
+                {
+                    { .content = "Hello", .style = ants::Style::Auto },
+                    { .content = "World", .style = ants::Style::Addition },
+                },
+                { { .content = "!", .style = ants::Style::Removal } },
+            })
+        );
+        // clang-format on
+    }
+
+    {
+        // The styled parts of an empty string are replaced.
+        ants::StyledString str;
+        str.append(other);
+        EXPECT_EQ(str.content(), other.content());
+        EXPECT_EQ(str.styled_line_parts(), other.styled_line_parts());
+
+        // Appending an empty string has no effect.
+        str.append(ants::StyledString());
+        EXPECT_EQ(str.styled_line_parts(), other.styled_line_parts());
+    }
+
+    {
+        // The style of the appended string does not extend over a trailing newline character.
+        auto str = ants::StyledString::styled("Hello", ants::Style::Addition);
+        str.append_newline();
+        str.append(ants::StyledString::inferred("World"));
+        // clang-format off
+        EXPECT_EQ(
+            str.styled_line_parts(),
+            (LineParts {
+                { { .content = "Hello", .style = ants::Style::Addition } },
+                { { .content = "World", .style = ants::Style::Auto } },
+            })
+        );
+        // clang-format on
+    }
+}
+
 TEST(StyledStringTest, AppendNewline) {
     {
         auto str = ants::StyledString::inferred("Hello");
@@ -410,6 +482,25 @@ TEST(StyledStringTest, AppendSpace) {
     }
 }
 
+TEST(StyledStringTest, AppendExpandingTabs) {
+    auto str = ants::StyledString::inferred("a");
+    str.append_expanding_tabs("\tb\t\tc", 2, ants::Style::SourceCode);
+    EXPECT_EQ(str.content(), "a  b    c");
+    // clang-format off
+    EXPECT_EQ(
+        str.styled_line_parts(),
+        (LineParts { {
+            { .content = "a", .style = ants::Style::Auto },
+            { .content = "  b    c", .style = ants::Style::SourceCode },
+        } })
+    );
+    // clang-format on
+
+    str.append_expanding_tabs("d\t", 0, ants::Style::SourceCode);
+    str.append_expanding_tabs("", 4, ants::Style::SourceCode);
+    EXPECT_EQ(str.content(), "a  b    cd");
+}
+
 TEST(StyledStringTest, SetStyledContent) {
     {
         auto str = ants::StyledString();
@@ -562,6 +653,78 @@ TEST(StyledStringTest, SetStyledContent) {
     }
 }
 
+TEST(StyledStringTest, RemovePrefix) {
+    {
+        auto str = ants::StyledString::inferred("Hello\nWorld");
+        str.set_style(ants::Style::Highlight, 3, 8);
+
+        str.remove_prefix(0);
+        EXPECT_EQ(str.content(), "Hello\nWorld");
+
+        str.remove_prefix(4);
+        EXPECT_EQ(str.content(), "o\nWorld");
+        // clang-format off
+        EXPECT_EQ(
+            str.styled_line_parts(),
+            (LineParts { {
+                { { .content = "o", .style = ants::Style::Highlight } },
+                {
+                    { .content = "Wo", .style = ants::Style::Highlight },
+                    { .content = "rld", .style = ants::Style::Auto },
+                },
+            } })
+        );
+        // clang-format on
+
+        str.remove_prefix(2);
+        EXPECT_EQ(str.content(), "World");
+        // clang-format off
+        EXPECT_EQ(
+            str.styled_line_parts(),
+            (LineParts { {
+                { .content = "Wo", .style = ants::Style::Highlight },
+                { .content = "rld", .style = ants::Style::Auto },
+            } })
+        );
+        // clang-format on
+
+        // Removing exactly at the boundary of two styles.
+        str.remove_prefix(2);
+        EXPECT_EQ(
+            str.styled_line_parts(),
+            (LineParts { { { .content = "rld", .style = ants::Style::Auto } } })
+        );
+
+        str.append("!", ants::Style::Default);
+        // clang-format off
+        EXPECT_EQ(
+            str.styled_line_parts(),
+            (LineParts { {
+                { .content = "rld", .style = ants::Style::Auto },
+                { .content = "!", .style = ants::Style::Default },
+            } })
+        );
+        // clang-format on
+    }
+
+    {
+        auto str = ants::StyledString::inferred("Hello");
+        str.remove_prefix(5);
+        EXPECT_TRUE(str.empty());
+        EXPECT_EQ(str.styled_line_parts(), LineParts {});
+
+        str.append("World", ants::Style::Highlight);
+        EXPECT_EQ(
+            str.styled_line_parts(),
+            (LineParts { { { .content = "World", .style = ants::Style::Highlight } } })
+        );
+
+        str.remove_prefix(100);
+        EXPECT_TRUE(str.empty());
+        EXPECT_EQ(str.styled_line_parts(), LineParts {});
+    }
+}
+
 TEST(StyledStringTest, Constructor) {
     {
         auto const str = ants::StyledString::inferred("abc");
@@ -607,4 +770,123 @@ TEST(StyledStringTest, Constructor) {
         EXPECT_EQ(str.styled_line_parts(), expected);
     }
 }
+
+TEST(StyledStringTest, StyledLines) {
+    EXPECT_TRUE(ants::StyledString().styled_lines().empty());
+
+    auto str = ants::StyledString::inferred("Hello\nWorld\r\n\n");
+    str.set_style(ants::Style::Highlight, 2, 8);
+    // clang-format off
+    EXPECT_EQ(
+        collect_styled_lines(str),
+        (LineParts {
+            {
+                { .content = "He", .style = ants::Style::Auto },
+                { .content = "llo", .style = ants::Style::Highlight },
+            },
+            {
+                { .content = "Wo", .style = ants::Style::Highlight },
+                { .content = "rld", .style = ants::Style::Auto },
+            },
+            { { .content = "", .style = ants::Style::Auto } },
+        })
+    );
+    // clang-format on
+    EXPECT_EQ(collect_styled_lines(str), str.styled_line_parts());
+    EXPECT_EQ(str.styled_lines().front().content(), "Hello");
+
+    // The '\r' is kept if its style differs from the style of the newline character.
+    str.set_style(ants::Style::Highlight, 11, 12);
+    EXPECT_EQ(collect_styled_lines(str), str.styled_line_parts());
+    EXPECT_EQ((*std::ranges::next(str.styled_lines().begin())).content(), "World\r");
+}
+
+TEST(StyledStringTest, SetStyles) {
+    {
+        auto str = ants::StyledString::inferred("Hello World");
+        str.set_styles({});
+        EXPECT_EQ(
+            str.styled_line_parts(),
+            (LineParts { { { .content = "Hello World", .style = ants::Style::Auto } } })
+        );
+
+        // Later edits overwrite earlier ones, and the empty edit modifies nothing.
+        std::vector<ants::StyleEdit> const edits {
+            { .start_index = 0, .end_index = 8, .style = ants::Style::Highlight },
+            { .start_index = 2, .end_index = 4, .style = ants::Style::Addition },
+            { .start_index = 3, .end_index = 3, .style = ants::Style::Removal },
+            { .start_index = 6, .end_index = 11, .style = ants::Style::custom(1) },
+        };
+        str.set_styles(edits);
+        // clang-format off
+        EXPECT_EQ(
+            str.styled_line_parts(),
+            (LineParts { {
+                { .content = "He", .style = ants::Style::Highlight },
+                { .content = "ll", .style = ants::Style::Addition },
+                { .content = "o ", .style = ants::Style::Highlight },
+                { .content = "World", .style = ants::Style::custom(1) },
+            } })
+        );
+        // clang-format on
+    }
+
+    // The result is the same as applying the edits one by one.
+    for (unsigned seed = 0; seed != 50; ++seed) {
+        auto expected = ants::StyledString::inferred("0123456789\nabcdefghij\nklmnopqrst");
+        expected.set_style(ants::Style::SourceCode, 4, 15);
+
+        std::vector<ants::StyleEdit> edits;
+        unsigned state = seed;
+        auto const next = [&](unsigned bound) {
+            state = state * 1103515245 + 12345;
+            return (state >> 16) % bound;
+        };
+        for (unsigned idx = 0; idx != 8; ++idx) {
+            std::size_t const beg = next(32);
+            std::size_t const end = beg + next(33 - beg);
+            auto const style = ants::Style::custom(static_cast<std::int8_t>(next(3) + 1));
+            edits.push_back({ .start_index = beg, .end_index = end, .style = style });
+        }
+
+        auto actual = expected;
+        for (ants::StyleEdit const& edit : edits) {
+            expected.set_style(edit.style, edit.start_index, edit.end_index);
+        }
+        actual.set_styles(edits);
+        EXPECT_EQ(actual.styled_line_parts(), expected.styled_line_parts());
+    }
+}
+
+TEST(StyledStringTest, Builder) {
+    ants::StyledString expected;
+    ants::StyledStringBuilder builder;
+    builder.reserve(32, 8);
+
+    auto const write = [&](std::size_t position, std::string_view content, ants::Style style) {
+        expected.set_styled_content(position, content, style, ants::Style::Default);
+        builder.set_styled_content(position, content, style, ants::Style::Default);
+    };
+    write(5, "_____", ants::Style::PrimaryUnderline);
+    write(3, "|", ants::Style::SecondaryUnderline);
+    write(7, "label", ants::Style::Auto);
+    write(14, "|", ants::Style::PrimaryUnderline);
+    write(0, "^^^", ants::Style::SecondaryUnderline);
+
+    std::vector<ants::StyledStringViewPart> const parts {
+        { .content = "ab", .style = ants::Style::Highlight },
+        { .content = "cd", .style = ants::Style::Auto },
+    };
+    expected.set_styled_content(12, parts, ants::Style::PrimaryLabel);
+    builder.set_styled_content(12, parts, ants::Style::PrimaryLabel);
+
+    EXPECT_EQ(builder.content(), expected.content());
+    ants::StyledString const result = builder.build();
+    EXPECT_EQ(result.content(), "^^^| __labelabcd");
+    EXPECT_EQ(result.styled_line_parts(), expected.styled_line_parts());
+
+    // The builder is left empty.
+    EXPECT_TRUE(builder.content().empty());
+    EXPECT_TRUE(builder.build().empty());
+}
 }  // namespace
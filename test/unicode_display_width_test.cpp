@@ -0,0 +1,46 @@
+#include "annotate_snippets/detail/unicode_display_width.hpp"
+
+#include "gtest/gtest.h"
+
+#include <string>
+
+namespace {
+using ants::detail::code_point_display_width;
+using ants::detail::display_width;
+
+TEST(UnicodeDisplayWidthTest, CodePoint) {
+    EXPECT_EQ(code_point_display_width('a'), 1);
+    EXPECT_EQ(code_point_display_width(0x4e2d), 2);  // 中
+    EXPECT_EQ(code_point_display_width(0x0301), 0);  // COMBINING ACUTE ACCENT
+    EXPECT_EQ(code_point_display_width(0x1f600), 2);  // 😀
+    EXPECT_EQ(code_point_display_width(0xe0100), 0);  // VARIATION SELECTOR-17
+    EXPECT_EQ(code_point_display_width(0x10ffff), 1);
+    EXPECT_EQ(code_point_display_width(ants::detail::invalid_code_point), 1);
+}
+
+TEST(UnicodeDisplayWidthTest, Ascii) {
+    EXPECT_EQ(display_width(""), 0);
+    EXPECT_EQ(display_width("Hello, world!"), 13);
+    EXPECT_EQ(display_width("\tint\tx;"), 7);
+    EXPECT_EQ(display_width("\tint\tx;", 4), 13);
+    EXPECT_EQ(display_width(std::string(100, 'x') + "\t", 8), 108);
+}
+
+TEST(UnicodeDisplayWidthTest, Unicode) {
+    EXPECT_EQ(display_width("中文"), 4);
+    EXPECT_EQ(display_width("안녕하세요"), 10);
+    EXPECT_EQ(display_width("ｆｕｌｌ"), 8);
+    EXPECT_EQ(display_width("😀🚀"), 4);
+    EXPECT_EQ(display_width("✅"), 2);
+    EXPECT_EQ(display_width("→ü"), 2);
+
+    // Combining marks and zero-width characters occupy no column.
+    EXPECT_EQ(display_width("e\u0301"), 1);
+    EXPECT_EQ(display_width("a\u200bb"), 2);
+    EXPECT_EQ(display_width("\U0001f44d\ufe0f"), 2);
+
+    EXPECT_EQ(display_width("\t中\t", 4), 10);
+    // Invalid UTF-8 bytes occupy one column each.
+    EXPECT_EQ(display_width("a\xff\xfe"), 3);
+}
+}  // namespace